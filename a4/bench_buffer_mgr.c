@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "dberror.h"
+#include "storage_mgr.h"
+#include "buffer_mgr.h"
+
+#define BENCH_FILENAME "bench_buffer_mgr.db"
+#define BENCH_DEFAULT_NUM_PAGES (16384)
+#define BENCH_DEFAULT_NUM_OPS (4000000)
+
+// benchmark methods
+static void benchRandomPinHits (int numPages, int numOps, bool hugePages);
+static void benchPinDirtyUnpin (int numPages, int numOps, bool frameHandles);
+
+// helper methods
+static uint64_t nowNanos (void);
+static uint32_t nextRandom (uint32_t *state);
+
+// main method
+int
+main (int argc, char **argv)
+{
+	int numPages = argc > 1 ? atoi(argv[1]) : BENCH_DEFAULT_NUM_PAGES;
+	int numOps = argc > 2 ? atoi(argv[2]) : BENCH_DEFAULT_NUM_OPS;
+
+	benchRandomPinHits(numPages, numOps, FALSE);
+	benchRandomPinHits(numPages, numOps, TRUE);
+	benchPinDirtyUnpin(numPages, numOps, FALSE);
+	benchPinDirtyUnpin(numPages, numOps, TRUE);
+
+	destroyPageFile(BENCH_FILENAME);
+	return 0;
+}
+
+// ************************************************************
+// Random `pinPage` hits over a fully resident pool. Every pin touches a byte
+// in the middle of its frame so the access pattern is dominated by TLB reach
+// of the frame arena rather than by the page table lookup alone.
+void
+benchRandomPinHits (int numPages, int numOps, bool hugePages)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	BM_PoolOptions options = BM_POOL_OPTIONS_DEFAULT;
+	options.hugePages = hugePages;
+	options.prefault = TRUE;
+
+	destroyPageFile(BENCH_FILENAME);
+	CHECK(initBufferPoolWithOptions(bm, BENCH_FILENAME, numPages, RS_LRU, NULL, &options));
+
+	// warm up: make every page resident
+	for (int i = 0; i < numPages; i++) {
+		CHECK(pinPage(bm, h, i));
+		CHECK(unpinPage(bm, h));
+	}
+
+	uint32_t seed = 0x9e3779b9u;
+	uint64_t checksum = 0;
+	uint64_t begin = nowNanos();
+	for (int i = 0; i < numOps; i++) {
+		PageNumber pageNum = (PageNumber) (nextRandom(&seed) % numPages);
+		CHECK(pinPage(bm, h, pageNum));
+		checksum += (unsigned char) h->buffer[PAGE_SIZE / 2];
+		CHECK(unpinPage(bm, h));
+	}
+	uint64_t elapsed = nowNanos() - begin;
+
+	printf("bench=random_pin_hits arena=%s huge_bytes=%zu pages=%d ops=%d "
+			"reads=%d ns_per_op=%.2f checksum=%llu\n",
+			hugePages ? "huge" : "calloc",
+			getArenaHugePageBytes(bm),
+			numPages,
+			numOps,
+			getNumReadIO(bm),
+			(double) elapsed / numOps,
+			(unsigned long long) checksum);
+
+	CHECK(shutdownBufferPool(bm));
+	free(bm);
+	free(h);
+}
+
+// ************************************************************
+// Random pin -> markDirty -> unpin cycles over a fully resident pool, either
+// resolving the handle through its frame index (as `pinPage` fills it in) or,
+// for comparison, through the page table lookup.
+void
+benchPinDirtyUnpin (int numPages, int numOps, bool frameHandles)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	BM_PoolOptions options = BM_POOL_OPTIONS_DEFAULT;
+	options.prefault = TRUE;
+
+	destroyPageFile(BENCH_FILENAME);
+	CHECK(initBufferPoolWithOptions(bm, BENCH_FILENAME, numPages, RS_LRU, NULL, &options));
+
+	for (int i = 0; i < numPages; i++) {
+		CHECK(pinPage(bm, h, i));
+		CHECK(unpinPage(bm, h));
+	}
+
+	uint32_t seed = 0x9e3779b9u;
+	uint64_t begin = nowNanos();
+	for (int i = 0; i < numOps; i++) {
+		PageNumber pageNum = (PageNumber) (nextRandom(&seed) % numPages);
+		CHECK(pinPage(bm, h, pageNum));
+		if (!frameHandles) {
+			// forget the frame so every call falls back to the lookup
+			h->frame = NO_PAGE;
+		}
+		h->buffer[0] += 1;
+		CHECK(markDirty(bm, h));
+		CHECK(unpinPage(bm, h));
+	}
+	uint64_t elapsed = nowNanos() - begin;
+
+	printf("bench=pin_dirty_unpin handles=%s pages=%d ops=%d ns_per_op=%.2f\n",
+			frameHandles ? "frame" : "lookup",
+			numPages,
+			numOps,
+			(double) elapsed / numOps);
+
+	CHECK(shutdownBufferPool(bm));
+	free(bm);
+	free(h);
+}
+
+// ************************************************************
+uint64_t
+nowNanos (void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+// xorshift32, deterministic across runs
+uint32_t
+nextRandom (uint32_t *state)
+{
+	uint32_t x = *state;
+	x ^= x << 13u;
+	x ^= x >> 17u;
+	x ^= x << 5u;
+	*state = x;
+	return x;
+}
@@ -0,0 +1,243 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+/* linux specific */
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+
+#include "dberror.h"
+#include "storage_mgr.h"
+#include "buffer_mgr.h"
+#include "record_mgr.h"
+#include "rm_page.h"
+#include "wal.h"
+
+// the record manager always works on these
+#define BENCH_FILENAME "storage.db"
+#define BENCH_WAL_FILENAME "storage.db.wal"
+#define BENCH_SAVED_FILENAME "bench_recovery.db.saved"
+#define BENCH_SAVED_WAL_FILENAME "bench_recovery.db.wal.saved"
+
+#define BENCH_DEFAULT_LOG_MB (64)
+#define BENCH_NUM_ROWS (60000)
+#define BENCH_NUM_POOL_PAGES (512)
+
+// Crash recovery benchmark
+//
+//     bench_recovery [log size in MB] [redo workers...]
+//
+// Fills a table, then updates random rows with checkpoints turned off until
+// the log holds the requested number of bytes, and crashes. The crashed
+// database is then recovered from the same copy once per number of redo
+// workers, and one `key=value` line is printed per run:
+//
+//     bench=recovery workers=4 log_bytes=... records=... seconds=...
+//     records_per_sec=... pages_hash=...
+//
+// `pages_hash` is over the recovered page file, it is the same for every run.
+
+// benchmark methods
+static void crashWithLog (uint64_t logBytes);
+static void benchRecovery (int numWorkers);
+
+// helper methods
+static void copyFile (const char *from, const char *to);
+static uint64_t hashFile (const char *fileName);
+static uint64_t nowNanos (void);
+static uint32_t nextRandom (uint32_t *state);
+
+// main method
+int
+main (int argc, char **argv)
+{
+	uint64_t logBytes = (uint64_t) (argc > 1 ? atoi(argv[1]) : BENCH_DEFAULT_LOG_MB) * 1024 * 1024;
+	int defaultWorkers[] = {1, 2, 4, 8};
+	int numRuns = argc > 2 ? argc - 2 : (int) (sizeof(defaultWorkers) / sizeof(int));
+
+	// the crash has to take the whole process down, the log is left as is
+	pid_t pid = fork();
+	if (pid < 0) {
+		fprintf(stderr, "bench_recovery: cannot fork\n");
+		return 1;
+	}
+	if (pid == 0) {
+		crashWithLog(logBytes);
+	}
+	int status = 0;
+	waitpid(pid, &status, 0);
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		fprintf(stderr, "bench_recovery: crashing process failed\n");
+		return 1;
+	}
+
+	copyFile(BENCH_FILENAME, BENCH_SAVED_FILENAME);
+	copyFile(BENCH_WAL_FILENAME, BENCH_SAVED_WAL_FILENAME);
+	for (int i = 0; i < numRuns; i++) {
+		benchRecovery(argc > 2 ? atoi(argv[i + 2]) : defaultWorkers[i]);
+	}
+
+	unlink(BENCH_SAVED_FILENAME);
+	unlink(BENCH_SAVED_WAL_FILENAME);
+	destroyPageFile(BENCH_FILENAME);
+	unlink(BENCH_WAL_FILENAME);
+	return 0;
+}
+
+// ************************************************************
+// Runs in the child: builds up `logBytes` of log without checkpoints, makes it
+// durable, and exits without shutting anything down
+void
+crashWithLog (uint64_t logBytes)
+{
+	destroyPageFile(BENCH_FILENAME);
+	unlink(BENCH_WAL_FILENAME);
+	CHECK(initRecordManager(NULL));
+	WAL_Log *log = RM_getInstance()->wal;
+	WAL_setCheckpointInterval(log, 0);
+
+	char *names[] = {"a", "b", "c"};
+	DataType dataTypes[] = {DT_INT, DT_STRING, DT_INT};
+	int typeLength[] = {0, 4, 0};
+	int keys[] = {0};
+	Schema *schema = createSchema(3, names, dataTypes, typeLength, 1, keys);
+	CHECK(createTable("bench", schema));
+
+	RM_TableData table;
+	CHECK(openTable(&table, "bench"));
+	Record *record;
+	CHECK(createRecord(&record, table.schema));
+
+	RID *rids = malloc(BENCH_NUM_ROWS * sizeof(RID));
+	size_t recordSize = getRecordSize(table.schema);
+	for (int i = 0; i < BENCH_NUM_ROWS; i++) {
+		memset(record->data, 0, recordSize);
+		*(int *) record->data = i;
+		CHECK(insertRecord(&table, record));
+		rids[i] = record->id;
+	}
+
+	uint32_t seed = 0x9e3779b9u;
+	uint64_t begin = WAL_getAppendLSN(log);
+	for (int i = 0; WAL_getAppendLSN(log) - begin < logBytes; i++) {
+		record->id = rids[nextRandom(&seed) % BENCH_NUM_ROWS];
+		memset(record->data, 0, recordSize);
+		*(int *) record->data = i;
+		*(int *) (record->data + recordSize - sizeof(int)) = (int) nextRandom(&seed);
+		CHECK(updateRecord(&table, record));
+	}
+	CHECK(WAL_commit(log));
+	_exit(0);
+}
+
+// Recovers a fresh copy of the crashed database with `numWorkers` redo workers
+void
+benchRecovery (int numWorkers)
+{
+	copyFile(BENCH_SAVED_FILENAME, BENCH_FILENAME);
+	copyFile(BENCH_SAVED_WAL_FILENAME, BENCH_WAL_FILENAME);
+
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	CHECK(initBufferPool(bm, BENCH_FILENAME, BENCH_NUM_POOL_PAGES, RS_LRU, NULL));
+	CHECK(pinPage(bm, h, RM_PAGE_DBHEADER));
+	uint64_t dbId = ((RM_DatabaseHeader *) h->buffer)->dbId;
+	CHECK(unpinPage(bm, h));
+
+	int fd = open(BENCH_WAL_FILENAME, O_RDONLY);
+	off_t logSize = lseek(fd, 0, SEEK_END);
+	close(fd);
+
+	WAL_Options options = WAL_OPTIONS_DEFAULT;
+	options.numRedoWorkers = numWorkers;
+	WAL_Log *log = NULL;
+	uint64_t begin = nowNanos();
+	CHECK(WAL_openWithOptions(BENCH_WAL_FILENAME, dbId, bm, &options, &log));
+	uint64_t elapsed = nowNanos() - begin;
+	uint64_t numRedone = log->numRedone;
+
+	CHECK(WAL_close(log));
+	CHECK(shutdownBufferPool(bm));
+
+	printf("bench=recovery workers=%d log_bytes=%lld records=%llu seconds=%.3f "
+			"records_per_sec=%.0f pages_hash=%016llx\n",
+			numWorkers,
+			(long long) logSize,
+			(unsigned long long) numRedone,
+			(double) elapsed / 1e9,
+			elapsed > 0 ? (double) numRedone * 1e9 / (double) elapsed : 0.0,
+			(unsigned long long) hashFile(BENCH_FILENAME));
+
+	free(bm);
+	free(h);
+}
+
+// ************************************************************
+// Copies a file and drops it from the page cache, every run starts cold
+void
+copyFile (const char *from, const char *to)
+{
+	int in = open(from, O_RDONLY);
+	int out = open(to, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (in < 0 || out < 0) {
+		fprintf(stderr, "bench_recovery: cannot copy %s to %s\n", from, to);
+		exit(1);
+	}
+
+	char *buffer = malloc(1024 * 1024);
+	ssize_t n;
+	while ((n = read(in, buffer, 1024 * 1024)) > 0) {
+		if (write(out, buffer, n) != n) {
+			fprintf(stderr, "bench_recovery: short write to %s\n", to);
+			exit(1);
+		}
+	}
+	free(buffer);
+
+	fdatasync(out);
+	posix_fadvise(out, 0, 0, POSIX_FADV_DONTNEED);
+	close(in);
+	close(out);
+}
+
+// FNV-1a over the whole file
+uint64_t
+hashFile (const char *fileName)
+{
+	FILE *file = fopen(fileName, "rb");
+	if (file == NULL) {
+		return 0;
+	}
+
+	uint64_t hash = 14695981039346656037ull;
+	int c;
+	while ((c = fgetc(file)) != EOF) {
+		hash ^= (uint64_t) c;
+		hash *= 1099511628211ull;
+	}
+	fclose(file);
+	return hash;
+}
+
+uint64_t
+nowNanos (void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+// xorshift32, deterministic across runs
+uint32_t
+nextRandom (uint32_t *state)
+{
+	uint32_t x = *state;
+	x ^= x << 13u;
+	x ^= x >> 17u;
+	x ^= x << 5u;
+	*state = x;
+	return x;
+}
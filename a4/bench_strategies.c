@@ -0,0 +1,290 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "dberror.h"
+#include "storage_mgr.h"
+#include "buffer_mgr.h"
+#include "buffer_mgr_stat.h"
+#include "replacement_strategy.h"
+
+#define BENCH_FILENAME "bench_strategies.db"
+#define BENCH_DEFAULT_NUM_OPS (400000)
+#define BENCH_NUM_FILE_PAGES (4096)
+#define BENCH_ZIPF_THETA (0.99)
+// share of accesses that go to the hot set in the hot set workloads
+#define BENCH_HOT_PERCENT (80)
+// number of times the hot set moves during a shifting run
+#define BENCH_NUM_SHIFTS (8)
+
+// Replacement strategy benchmark
+//
+//     bench_strategies [ops] [pool size...]
+//
+// Drives pinPage/unpinPage with synthetic workloads over a file of
+// BENCH_NUM_FILE_PAGES pages, for every implemented replacement strategy and
+// pool size, and prints one `key=value` line per run:
+//
+//     bench=strategies workload=zipf strategy=LRU pages=256 file_pages=4096
+//     ops=400000 ops_per_sec=... hit_ratio=... p50_ns=... p99_ns=...
+//
+// The first tenth of every run only warms the pool up and is not measured.
+
+typedef enum BenchWorkload {
+	WL_UNIFORM = 0,    // every page equally likely
+	WL_ZIPF = 1,       // skewed, BENCH_ZIPF_THETA
+	WL_LOOP = 2,       // sequential scan over the whole file, repeated
+	WL_SCAN_HOT = 3,   // hot set of half the pool, interleaved with a scan
+	WL_SHIFTING = 4,   // hot set of half the pool that moves over time
+} BenchWorkload;
+#define BENCH_NUM_WORKLOADS (5)
+
+typedef struct BenchGenerator {
+	BenchWorkload workload;
+	int numPages;          // size of the pool under test
+	int numOps;
+	uint32_t seed;
+	long op;
+	long scanPos;          // position of the scan in the scan workloads
+	const double *zipfCdf;
+} BenchGenerator;
+
+// benchmark methods
+static void benchStrategy (BenchWorkload workload, ReplacementStrategy strategy, int numPages,
+		int numOps, const double *zipfCdf);
+
+// helper methods
+static PageNumber nextPage (BenchGenerator *gen);
+static double *makeZipfCdf (int n, double theta);
+static const char *workloadName (BenchWorkload workload);
+static int compareNanos (const void *a, const void *b);
+static uint64_t nowNanos (void);
+static uint32_t nextRandom (uint32_t *state);
+
+// main method
+int
+main (int argc, char **argv)
+{
+	int numOps = argc > 1 ? atoi(argv[1]) : BENCH_DEFAULT_NUM_OPS;
+	int defaultSizes[] = {64, 256, 1024};
+	int numSizes = argc > 2 ? argc - 2 : (int) (sizeof(defaultSizes) / sizeof(int));
+	int *sizes = malloc(numSizes * sizeof(int));
+	for (int i = 0; i < numSizes; i++) {
+		sizes[i] = argc > 2 ? atoi(argv[i + 2]) : defaultSizes[i];
+	}
+
+	SM_FileHandle fh;
+	destroyPageFile(BENCH_FILENAME);
+	CHECK(createPageFile(BENCH_FILENAME));
+	CHECK(openPageFile(BENCH_FILENAME, &fh));
+	CHECK(ensureCapacity(BENCH_NUM_FILE_PAGES, &fh));
+	CHECK(closePageFile(&fh));
+
+	double *zipfCdf = makeZipfCdf(BENCH_NUM_FILE_PAGES, BENCH_ZIPF_THETA);
+	for (int w = 0; w < BENCH_NUM_WORKLOADS; w++) {
+		for (int s = 0; s < BM_REPLACEMENT_STRAT_COUNT; s++) {
+			// strategies aliased to another handler would repeat its numbers
+			if (RS_StrategyHandlerImpl[s].strategy != (ReplacementStrategy) s) {
+				continue;
+			}
+			for (int i = 0; i < numSizes; i++) {
+				benchStrategy((BenchWorkload) w, (ReplacementStrategy) s, sizes[i], numOps, zipfCdf);
+			}
+		}
+	}
+
+	free(zipfCdf);
+	free(sizes);
+	destroyPageFile(BENCH_FILENAME);
+	return 0;
+}
+
+// ************************************************************
+// One workload against one strategy and pool size. Every pin is timed on its
+// own for the latency percentiles, throughput is taken over the whole
+// measured phase.
+void
+benchStrategy (BenchWorkload workload, ReplacementStrategy strategy, int numPages,
+		int numOps, const double *zipfCdf)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	BM_PoolOptions options = BM_POOL_OPTIONS_DEFAULT;
+	options.hugePages = FALSE;
+
+	CHECK(initBufferPoolWithOptions(bm, BENCH_FILENAME, numPages, strategy, NULL, &options));
+
+	BenchGenerator gen = {
+			.workload = workload,
+			.numPages = numPages,
+			.numOps = numOps,
+			.seed = 0x9e3779b9u,
+			.op = 0,
+			.scanPos = 0,
+			.zipfCdf = zipfCdf,
+	};
+
+	int numWarmup = numOps / 10;
+	for (int i = 0; i < numWarmup; i++) {
+		CHECK(pinPage(bm, h, nextPage(&gen)));
+		CHECK(unpinPage(bm, h));
+	}
+
+	BM_PoolStats before, after;
+	getPoolStats(bm, &before);
+
+	int numMeasured = numOps - numWarmup;
+	uint32_t *nanos = malloc(numMeasured * sizeof(uint32_t));
+	uint64_t begin = nowNanos();
+	for (int i = 0; i < numMeasured; i++) {
+		PageNumber pageNum = nextPage(&gen);
+		uint64_t pinBegin = nowNanos();
+		CHECK(pinPage(bm, h, pageNum));
+		nanos[i] = (uint32_t) (nowNanos() - pinBegin);
+		CHECK(unpinPage(bm, h));
+	}
+	uint64_t elapsed = nowNanos() - begin;
+
+	getPoolStats(bm, &after);
+	uint64_t hits = after.counters[BM_STAT_HITS] - before.counters[BM_STAT_HITS];
+	uint64_t misses = after.counters[BM_STAT_MISSES] - before.counters[BM_STAT_MISSES];
+
+	qsort(nanos, numMeasured, sizeof(uint32_t), compareNanos);
+	printf("bench=strategies workload=%s strategy=%s pages=%d file_pages=%d ops=%d "
+			"ops_per_sec=%.0f hit_ratio=%.4f p50_ns=%u p99_ns=%u\n",
+			workloadName(workload),
+			strategyName(strategy),
+			numPages,
+			BENCH_NUM_FILE_PAGES,
+			numMeasured,
+			elapsed > 0 ? (double) numMeasured * 1e9 / (double) elapsed : 0.0,
+			hits + misses > 0 ? (double) hits / (double) (hits + misses) : 0.0,
+			numMeasured > 0 ? nanos[numMeasured / 2] : 0,
+			numMeasured > 0 ? nanos[(int) ((long) numMeasured * 99 / 100)] : 0);
+
+	free(nanos);
+	CHECK(shutdownBufferPool(bm));
+	free(bm);
+	free(h);
+}
+
+// ************************************************************
+PageNumber
+nextPage (BenchGenerator *gen)
+{
+	int hotSize = gen->numPages / 2;
+	if (hotSize < 1) {
+		hotSize = 1;
+	} else if (hotSize > BENCH_NUM_FILE_PAGES / 2) {
+		hotSize = BENCH_NUM_FILE_PAGES / 2;
+	}
+	long op = gen->op++;
+
+	switch (gen->workload) {
+	case WL_UNIFORM:
+		return (PageNumber) (nextRandom(&gen->seed) % BENCH_NUM_FILE_PAGES);
+
+	case WL_ZIPF: {
+		// inverse transform sampling, rank 0 is the most popular page
+		double u = (double) nextRandom(&gen->seed) / (double) UINT32_MAX;
+		int lo = 0, hi = BENCH_NUM_FILE_PAGES - 1;
+		while (lo < hi) {
+			int mid = lo + (hi - lo) / 2;
+			if (gen->zipfCdf[mid] < u) {
+				lo = mid + 1;
+			} else {
+				hi = mid;
+			}
+		}
+		return (PageNumber) lo;
+	}
+
+	case WL_LOOP:
+		return (PageNumber) (op % BENCH_NUM_FILE_PAGES);
+
+	case WL_SCAN_HOT:
+		if ((int) (nextRandom(&gen->seed) % 100) < BENCH_HOT_PERCENT) {
+			return (PageNumber) (nextRandom(&gen->seed) % hotSize);
+		}
+		// the scan covers the cold part of the file only
+		return (PageNumber) (hotSize + gen->scanPos++ % (BENCH_NUM_FILE_PAGES - hotSize));
+
+	case WL_SHIFTING: {
+		long shiftLength = gen->numOps / BENCH_NUM_SHIFTS > 0 ? gen->numOps / BENCH_NUM_SHIFTS : 1;
+		long base = (op / shiftLength) * hotSize;
+		if ((int) (nextRandom(&gen->seed) % 100) < BENCH_HOT_PERCENT) {
+			return (PageNumber) ((base + nextRandom(&gen->seed) % hotSize) % BENCH_NUM_FILE_PAGES);
+		}
+		return (PageNumber) (nextRandom(&gen->seed) % BENCH_NUM_FILE_PAGES);
+	}
+
+	default:
+		return 0;
+	}
+}
+
+// Cumulative distribution of a Zipfian over `n` ranks
+double *
+makeZipfCdf (int n, double theta)
+{
+	double *cdf = malloc(n * sizeof(double));
+	double sum = 0;
+	for (int i = 0; i < n; i++) {
+		sum += 1.0 / pow(i + 1, theta);
+		cdf[i] = sum;
+	}
+	for (int i = 0; i < n; i++) {
+		cdf[i] /= sum;
+	}
+	return cdf;
+}
+
+const char *
+workloadName (BenchWorkload workload)
+{
+	switch (workload) {
+	case WL_UNIFORM:
+		return "uniform";
+	case WL_ZIPF:
+		return "zipf";
+	case WL_LOOP:
+		return "loop";
+	case WL_SCAN_HOT:
+		return "scan_hot";
+	case WL_SHIFTING:
+		return "shifting";
+	default:
+		return "?";
+	}
+}
+
+int
+compareNanos (const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *) a;
+	uint32_t y = *(const uint32_t *) b;
+	return (x > y) - (x < y);
+}
+
+uint64_t
+nowNanos (void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+// xorshift32, deterministic across runs
+uint32_t
+nextRandom (uint32_t *state)
+{
+	uint32_t x = *state;
+	x ^= x << 13u;
+	x ^= x >> 17u;
+	x ^= x << 5u;
+	*state = x;
+	return x;
+}
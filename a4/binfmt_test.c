@@ -293,22 +293,22 @@ bool expect_nested_schema_format_to_round_trip()
     attrs[0] = RM_SCHEMA_ATTR_FORMAT;
     BF_SET_U8 (attrs[0].attrType) = (uint8_t) DT_INT;
     BF_SET_STR(attrs[0].attrName) = "id";
-    BF_SET_U8 (attrs[0].attrTypeLen) = 0;
+    BF_SET_U16(attrs[0].attrTypeLen) = 0;
 
     attrs[1] = RM_SCHEMA_ATTR_FORMAT;
     BF_SET_U8 (attrs[1].attrType) = (uint8_t) DT_STRING;
     BF_SET_STR(attrs[1].attrName) = "name";
-    BF_SET_U8 (attrs[1].attrTypeLen) = 200;
+    BF_SET_U16(attrs[1].attrTypeLen) = 200;
 
     attrs[2] = RM_SCHEMA_ATTR_FORMAT;
     BF_SET_U8 (attrs[2].attrType) = (uint8_t) DT_FLOAT;
     BF_SET_STR(attrs[2].attrName) = "amount";
-    BF_SET_U8 (attrs[2].attrTypeLen) = 0;
+    BF_SET_U16(attrs[2].attrTypeLen) = 0;
 
     attrs[3] = RM_SCHEMA_ATTR_FORMAT;
     BF_SET_U8 (attrs[3].attrType) = (uint8_t) DT_BOOL;
     BF_SET_STR(attrs[3].attrName) = "is_employee";
-    BF_SET_U8 (attrs[3].attrTypeLen) = 0;
+    BF_SET_U16(attrs[3].attrTypeLen) = 0;
 
     struct RM_SCHEMA_FORMAT_T schema = RM_SCHEMA_FORMAT;
     BF_SET_STR(schema.tblName) = "test_table";
@@ -363,7 +363,7 @@ bool expect_nested_schema_format_to_round_trip()
             return false;
         }
 
-        if (cur_chunk->attrTypeLen.u8 != attrs[i].attrTypeLen.u8) {
+        if (cur_chunk->attrTypeLen.u16 != attrs[i].attrTypeLen.u16) {
             fprintf(stderr, "[%s:%d] FAIL: expected value to be the same\n", __FUNCTION__, __LINE__);
             return false;
         }
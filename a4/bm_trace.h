@@ -0,0 +1,45 @@
+#ifndef BM_TRACE_H
+#define BM_TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "dt.h"
+
+// Binary buffer pool access trace
+//
+// A trace file is a `BM_TraceHeader` followed by one `BM_TraceRecord` per
+// `pinPage` call, in call order, in host byte order. Traces are written by a
+// pool with tracing enabled (see `startPoolTrace`) and replayed offline by
+// `trace_replay`.
+#define BM_TRACE_MAGIC "BMTRACE"
+#define BM_TRACE_MAGIC_LEN (8)
+#define BM_TRACE_VERSION (1)
+
+typedef struct PACKED_STRUCT BM_TraceHeader {
+    char magic[BM_TRACE_MAGIC_LEN];
+    uint32_t version;
+    uint32_t numPages;  // size of the traced pool
+    uint32_t strategy;  // replacement strategy of the traced pool
+} BM_TraceHeader;
+
+typedef uint8_t BM_TraceFlags;
+#define BM_TRACE_FLAGS_HIT   ((BM_TraceFlags) (1u << 0u))  /* page was resident */
+#define BM_TRACE_FLAGS_RING  ((BM_TraceFlags) (1u << 1u))  /* pinned through a scan ring */
+
+typedef struct PACKED_STRUCT BM_TraceRecord {
+    int32_t pageNum;
+    BM_TraceFlags flags;
+    uint64_t nanos;  // monotonic clock at the time of the pin
+} BM_TraceRecord;
+
+// Records buffered in memory before being written out as one block
+#define BM_TRACE_BUFFER_RECORDS (4096)
+
+typedef struct BM_TraceRecorder {
+    FILE *file;
+    int numBuffered;
+    BM_TraceRecord buffer[BM_TRACE_BUFFER_RECORDS];
+} BM_TraceRecorder;
+
+#endif
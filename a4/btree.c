@@ -11,6 +11,7 @@
 #include "rm_macros.h"
 #include "rm_page.h"
 #include "btree_binfmt.h"
+#include "rm_catalog.h"
 
 void IM_IndexMetadata_makeFromMessage(
         IM_IndexMetadata *meta,
@@ -60,7 +61,7 @@ RC IM_writeIndexPage(BM_BufferPool *pool)
 
     RM_Page_init(pageHandle.buffer, RM_PAGE_INDEX, RM_PAGE_KIND_INDEX);
 
-    TRY_OR_RETURN(forcePage(pool, &pageHandle));
+    TRY_OR_RETURN(markDirty(pool, &pageHandle));
     TRY_OR_RETURN(unpinPage(pool, &pageHandle));
 
     return RC_OK;
@@ -193,6 +194,7 @@ void IM_makeEntry_i32(
 RC IM_findIndex(
         BM_BufferPool *pool,
         char *name,
+        RM_PageNumber descriptorPageNum,
         BM_PageHandle *descriptor_page_out_opt,
         struct RM_PageTuple **tup_out_opt,
         struct IM_DESCRIPTOR_FORMAT_T *msg_out_opt)
@@ -205,9 +207,9 @@ RC IM_findIndex(
 
     size_t nameLength = strlen(name);
 
-    //store the schema page in pageHandle
+    //store the descriptor page in pageHandle
     BM_PageHandle pageHandle = {};
-    TRY_OR_RETURN(pinPage(pool, &pageHandle, RM_PAGE_INDEX));
+    TRY_OR_RETURN(pinPage(pool, &pageHandle, descriptorPageNum));
 
     //open the schema page and store the header and data
     RM_Page *pg = (RM_Page*) pageHandle.buffer;
@@ -224,6 +226,9 @@ RC IM_findIndex(
     for (int i = 0; i < num; i++) {
         size_t slot = i * sizeof(RM_PageSlotPtr);
         off = (RM_PageSlotPtr *) (&pg->dataBegin + slot);
+        if (*off == RM_PAGE_SLOT_DEAD) {
+            continue;
+        }
         if (*off >= RM_PAGE_DATA_SIZE) {
             PANIC("tuple offset cannot be greater than page data size");
         }
@@ -248,6 +253,7 @@ RC IM_findIndex(
     }
 
     if (!hit) {
+        TRY_OR_RETURN(unpinPage(pool, &pageHandle));
         return RC_IM_KEY_NOT_FOUND;
     }
 
@@ -269,6 +275,48 @@ RC IM_findIndex(
     return RC_OK;
 }
 
+// Fills the index half of the catalog cache from the chain of index
+// descriptor pages
+RC IM_loadIndexCatalog(BM_BufferPool *pool, RM_Catalog *catalog)
+{
+    PANIC_IF_NULL(pool);
+    PANIC_IF_NULL(catalog);
+
+    PageNumber pageNum = catalog->indexChain.firstPageNum;
+    while (true) {
+        BM_PageHandle pageHandle = {};
+        TRY_OR_RETURN(pinPage(pool, &pageHandle, pageNum));
+        RM_Page *page = (RM_Page *) pageHandle.buffer;
+
+        for (int i = 0; i < page->header.numTuples; i++) {
+            RM_PageTuple *tup = RM_Page_getLiveTuple(page, i);
+            if (tup == NULL) {
+                continue;
+            }
+            struct IM_DESCRIPTOR_FORMAT_T indexMsg = IM_DESCRIPTOR_FORMAT;
+            BF_read((BF_MessageElement *) &indexMsg, &tup->dataBegin, BF_NUM_ELEMENTS(sizeof(IM_DESCRIPTOR_FORMAT)));
+
+            IM_IndexMetadata meta;
+            IM_IndexMetadata_makeFromMessage(&meta, &indexMsg);
+            RM_Catalog_putIndex(catalog, RM_CatalogIndex_create(
+                    BF_AS_STR(indexMsg.idxName),
+                    BF_AS_U8(indexMsg.idxKeyType),
+                    &meta,
+                    pageNum));
+        }
+
+        PageNumber nextPageNum = page->header.nextPageNum;
+        TRY_OR_RETURN(unpinPage(pool, &pageHandle));
+        if (nextPageNum == RM_PAGE_NEXT_PAGENUM_UNSET) {
+            break;
+        }
+        pageNum = nextPageNum;
+    }
+
+    catalog->indexChain.lastPageNum = pageNum;
+    catalog->indexesLoaded = true;
+    return RC_OK;
+}
 
 RC IM_insertSplit_byAllocLeftRight(
         RM_Page *oldPage,
@@ -284,7 +332,6 @@ RC IM_insertSplit_byAllocLeftRight(
               "make sure that you using the in-memory 'sizeof(entry)' NOT 'BF_recomputeSize()'");
     }
 
-    BP_Metadata *meta = pool->mgmtData;
     RM_PageHeader *pageHeader = &oldPage->header;
     const uint16_t initialNumEntries = pageHeader->numTuples;
 
@@ -297,7 +344,8 @@ RC IM_insertSplit_byAllocLeftRight(
     uint16_t targetSlotIdx = IM_getEntryInsertionIndex(keyValue, oldPage, maxEntriesPerNode);
 
     // Allocate the left anf right leaf nodes
-    int leftPageNum = meta->fileHandle->totalNumPages;
+    int leftPageNum;
+    TRY_OR_RETURN(RM_Page_allocate(pool, 2, &leftPageNum));
     int rightPageNum = leftPageNum + 1;
 
     BM_PageHandle leftPageHandle = {};
@@ -387,8 +435,8 @@ RC IM_insertSplit_byAllocLeftRight(
     // Clear all nodes on the old page and reset flags
     RM_Page_deleteAllTuples(oldPage);
 
-    TRY_OR_RETURN(forcePage(pool, &leftPageHandle));
-    TRY_OR_RETURN(forcePage(pool, &rightPageHandle));
+    TRY_OR_RETURN(markDirty(pool, &leftPageHandle));
+    TRY_OR_RETURN(markDirty(pool, &rightPageHandle));
 
     TRY_OR_RETURN(unpinPage(pool, &leftPageHandle));
     TRY_OR_RETURN(unpinPage(pool, &rightPageHandle));
@@ -423,7 +471,6 @@ RC IM_insertSplit_byReuseLeftAllocRight(
               "make sure that you using the in-memory 'sizeof(entry)' NOT 'BF_recomputeSize()'");
     }
 
-    BP_Metadata *meta = pool->mgmtData;
     RM_PageHeader *pageHeader = &oldPage->header;
     const uint16_t initialNumEntries = pageHeader->numTuples;
 
@@ -442,7 +489,8 @@ RC IM_insertSplit_byReuseLeftAllocRight(
     // We will reuse the old page as the *left* leaf node since then we can
     // avoid messing with a previous sibling leaf node's next pointer.
     int leftPageNum = oldPage->header.pageNum;
-    int rightPageNum = meta->fileHandle->totalNumPages;
+    int rightPageNum;
+    TRY_OR_RETURN(RM_Page_allocate(pool, 1, &rightPageNum));
 
     BM_PageHandle rightPageHandle = {};
     TRY_OR_RETURN(pinPage(pool, &rightPageHandle, rightPageNum));
@@ -550,7 +598,7 @@ RC IM_insertSplit_byReuseLeftAllocRight(
         IM_writeEntry_i32(tup, entry);
     }
 
-    TRY_OR_RETURN(forcePage(pool, &rightPageHandle));
+    TRY_OR_RETURN(markDirty(pool, &rightPageHandle));
     TRY_OR_RETURN(unpinPage(pool, &rightPageHandle));
 
     if (ctx_out != NULL) {
@@ -585,7 +633,6 @@ RC IM_insertSplitInner_byAllocLeftRight(
     }
 
     IM_ENTRY_FORMAT_T yankedEntry = {0};
-    BP_Metadata *meta = pool->mgmtData;
     RM_PageHeader *pageHeader = &oldPage->header;
     const uint16_t initialNumEntries = pageHeader->numTuples;
 
@@ -593,7 +640,8 @@ RC IM_insertSplitInner_byAllocLeftRight(
     uint16_t targetSlotIdx = IM_getEntryInsertionIndex(keyValue, oldPage, maxEntriesPerNode);
 
     // Allocate the left and right leaf nodes
-    int leftPageNum = meta->fileHandle->totalNumPages;
+    int leftPageNum;
+    TRY_OR_RETURN(RM_Page_allocate(pool, 2, &leftPageNum));
     int rightPageNum = leftPageNum + 1;
 
     BM_PageHandle leftPageHandle = {};
@@ -615,6 +663,8 @@ RC IM_insertSplitInner_byAllocLeftRight(
 
     SET_FLAG(leftPage->header.flags, RM_PAGE_FLAGS_INDEX_INNER);
     SET_FLAG(rightPage->header.flags, RM_PAGE_FLAGS_INDEX_INNER);
+    TRY_OR_RETURN(IM_keepNodeResident(pool, leftPageNum));
+    TRY_OR_RETURN(IM_keepNodeResident(pool, rightPageNum));
     
     // Setup the links for the new pages
     //
@@ -751,8 +801,8 @@ RC IM_insertSplitInner_byAllocLeftRight(
     // Clear all nodes on the old page and reset storage flags
     RM_Page_deleteAllTuples(oldPage);
 
-    TRY_OR_RETURN(forcePage(pool, &leftPageHandle));
-    TRY_OR_RETURN(forcePage(pool, &rightPageHandle));
+    TRY_OR_RETURN(markDirty(pool, &leftPageHandle));
+    TRY_OR_RETURN(markDirty(pool, &rightPageHandle));
 
     TRY_OR_RETURN(unpinPage(pool, &leftPageHandle));
     TRY_OR_RETURN(unpinPage(pool, &rightPageHandle));
@@ -792,7 +842,6 @@ RC IM_insertSplitInner_byReuseLeftAllocRight(
               "make sure that you using the in-memory 'sizeof(entry)' NOT 'BF_recomputeSize()'");
     }
 
-    BP_Metadata *meta = pool->mgmtData;
     RM_PageHeader *pageHeader = &oldPage->header;
     const uint16_t initialNumEntries = pageHeader->numTuples;
 
@@ -811,7 +860,8 @@ RC IM_insertSplitInner_byReuseLeftAllocRight(
     // We will reuse the old page as the *left* leaf node since then we can
     // avoid messing with a previous sibling leaf node's next pointer.
     int leftPageNum = oldPage->header.pageNum;
-    int rightPageNum = meta->fileHandle->totalNumPages;
+    int rightPageNum;
+    TRY_OR_RETURN(RM_Page_allocate(pool, 1, &rightPageNum));
 
     BM_PageHandle rightPageHandle = {};
     TRY_OR_RETURN(pinPage(pool, &rightPageHandle, rightPageNum));
@@ -826,6 +876,7 @@ RC IM_insertSplitInner_byReuseLeftAllocRight(
     UNSET_FLAG(rightPage->header.flags, RM_PAGE_FLAGS_INDEX_LEAF);
     SET_FLAG(leftPage->header.flags, RM_PAGE_FLAGS_INDEX_INNER);
     SET_FLAG(rightPage->header.flags, RM_PAGE_FLAGS_INDEX_INNER);
+    TRY_OR_RETURN(IM_keepNodeResident(pool, rightPageNum));
 
     // Setup the links for the new pages
     //
@@ -962,7 +1013,7 @@ RC IM_insertSplitInner_byReuseLeftAllocRight(
     // Set the left node's end pointer to the yanked entry's pointer
     leftPage->header.nextPageNum = BF_AS_U16(yankedEntry.idxEntryRidPageNum);
 
-    TRY_OR_RETURN(forcePage(pool, &rightPageHandle));
+    TRY_OR_RETURN(markDirty(pool, &rightPageHandle));
     TRY_OR_RETURN(unpinPage(pool, &rightPageHandle));
     
     if (ctx_out != NULL) {
@@ -1398,11 +1449,147 @@ RC IM_insertKey_i32(
 
 finally:
     IM_NodeTrace_free(parents);
-    TRY_OR_RETURN(forcePage(pool, &leafNodePageHandle));
+    TRY_OR_RETURN(markDirty(pool, &leafNodePageHandle));
     TRY_OR_RETURN(unpinPage(pool, &leafNodePageHandle));
     return rc;
 }
 
+// Reads the routing decision for `searchKey` out of a node page.
+//
+// @return false if the page is not an index page, or is not a sane one, which
+//      is corruption unless the page was read optimistically and changed
+static bool
+IM_routeNode(
+        RM_Page *node,
+        int32_t searchKey,
+        uint16_t maxEntriesPerNode,
+        IM_NodeRoute *route_out)
+{
+    // Ensure that we are reading from a index page
+    if (node->header.kind != RM_PAGE_KIND_INDEX) {
+        return false;
+    }
+
+    route_out->isLeaf = IS_FLAG_SET(node->header.flags, RM_PAGE_FLAGS_INDEX_LEAF);
+    if (route_out->isLeaf) {
+        return true;
+    }
+
+    // Otherwise, the current node must be an internal node, a RID pointer
+    // will point to the child node.
+    //
+    // Find the index that is less than or equal to the search key
+    //
+    uint16_t nodeNumTuples = node->header.numTuples;
+    if (nodeNumTuples > maxEntriesPerNode) {
+        return false;
+    }
+
+    uint16_t slotId = IM_getEntryIndexByPredicate(
+            searchKey,
+            node,
+            IM_GETENTRY_OP_LT,
+            maxEntriesPerNode,
+            NULL,
+            NULL);
+    route_out->slotId = slotId;
+
+    //
+    // Determine the next page number
+    //
+
+    // Check if the slot index == numTuples,
+    //   if so, we need to use the `page.header->nextPageNum` pointer as the
+    //   right-most pointer on the node to get the next page
+    //
+    if (slotId == nodeNumTuples) {
+        route_out->childPageNum = node->header.nextPageNum;
+    }
+    else if (slotId < nodeNumTuples) {
+        // Traverse to the newly selected node
+        RM_PageTuple *nextTup = RM_Page_getTuple(node, slotId, NULL);
+
+        // Determine where the next page is located
+        IM_ENTRY_FORMAT_T entry;
+        IM_readEntry_i32(nextTup, &entry);
+        route_out->childPageNum = BF_AS_U16(entry.idxEntryRidPageNum);
+    }
+    else {
+        return false;
+    }
+
+    return true;
+}
+
+// Routes through a node on the way down the tree.
+//
+// Every lookup passes through the root and the upper inner nodes, so rather
+// than pinning them (and bumping their fix counts on every descent), resident
+// nodes are read optimistically and the read is retried if the frame changed
+// in the meantime. Nodes that are not resident, or keep changing, are pinned.
+static void
+IM_routeThroughNode(
+        BM_BufferPool *pool,
+        RM_PageNumber nodePageNum,
+        int32_t searchKey,
+        uint16_t maxEntriesPerNode,
+        IM_NodeRoute *route_out)
+{
+    BM_PageHandle nodeHandle = {};
+    for (int attempt = 0; attempt < IM_OPTIMISTIC_READ_MAX_ATTEMPTS; attempt++) {
+        uint32_t version;
+        if (beginOptimisticRead(pool, &nodeHandle, nodePageNum, &version) != RC_OK) {
+            break;
+        }
+
+        bool isSane = IM_routeNode(
+                (RM_Page *) nodeHandle.buffer,
+                searchKey,
+                maxEntriesPerNode,
+                route_out);
+
+        if (validateOptimisticRead(pool, &nodeHandle, version)) {
+            if (!isSane) {
+                PANIC("attempted to read from bad node page '%d'. expected index page.", nodePageNum);
+            }
+            return;
+        }
+    }
+
+    // Pin the node page
+    if (pinPage(pool, &nodeHandle, nodePageNum) != RC_OK) {
+        PANIC("failed to get node page '%d'", nodePageNum);
+    }
+
+    RM_Page *node = (RM_Page *) nodeHandle.buffer;
+    if (!IM_routeNode(node, searchKey, maxEntriesPerNode, route_out)) {
+        PANIC("attempted to read from bad node page '%d'. expected index page.", nodePageNum);
+    }
+
+    // Inner nodes of an index opened in an earlier session are only marked
+    // once they had to be read in
+    if (IS_FLAG_SET(node->header.flags, RM_PAGE_FLAGS_INDEX_ROOT)
+        || IS_FLAG_SET(node->header.flags, RM_PAGE_FLAGS_INDEX_INNER)) {
+        IM_keepNodeResident(pool, nodePageNum);
+    }
+
+    if (unpinPage(pool, &nodeHandle) != RC_OK) {
+        PANIC("failed to unpin node page");
+    }
+}
+
+/**
+ * Keeps a root or inner node in the pool, since every descent goes through
+ * them. Once the pool's resident budget is used up the node is simply left to
+ * the replacement strategy.
+ */
+RC
+IM_keepNodeResident(BM_BufferPool *pool, RM_PageNumber nodePageNum)
+{
+    RC rc = markPageResident(pool, nodePageNum);
+    return rc == RC_BM_RESIDENT_BUDGET_EXCEEDED ? RC_OK : rc;
+}
+
 RM_PageNumber
 IM_getLeafNode(
         BM_BufferPool *pool,
@@ -1414,12 +1601,6 @@ IM_getLeafNode(
 {
     PANIC_IF_NULL(pool);
 
-    BM_PageHandle parentNodeHandle = {};
-    RM_Page *parentNode = NULL;
-
-    BM_PageHandle nodeHandle = {};
-    RM_Page *node = NULL;
-
     IM_NodeTrace *trace = NULL;
     if (trace_out_opt != NULL) {
         trace = malloc(sizeof(IM_NodeTrace));
@@ -1431,90 +1612,28 @@ IM_getLeafNode(
     RID parentRid;
     RM_PageNumber nodePageNum = rootPageNum;
     do {
-        // Pin the next node page
-        if (pinPage(pool, &nodeHandle, nodePageNum) != RC_OK) {
-            PANIC("failed to get node page '%d'", nodePageNum);
-        }
-        node = (RM_Page *) nodeHandle.buffer;
-
-        // Ensure that we are reading from a index page
-        if (node->header.kind != RM_PAGE_KIND_INDEX) {
-            PANIC("attempted to read from wrong page kind. expected index page.");
-        }
+        // Route through the node, without pinning it if it is resident
+        IM_NodeRoute route;
+        IM_routeThroughNode(pool, nodePageNum, searchKey, maxEntriesPerNode, &route);
 
         // If the node is still a leaf node, then we don't have to go any further
-        if (IS_FLAG_SET(node->header.flags, RM_PAGE_FLAGS_INDEX_LEAF)) {
-            if (unpinPage(pool, &nodeHandle) != RC_OK) {
-                PANIC("failed to unpin node page");
-            }
-
+        if (route.isLeaf) {
             break;
         }
 
-        // Otherwise, the current node must be an internal node, a RID pointer
-        // will point to the child node.
-        //
-        // Find the index that is less than or equal to the search key
-        //
-        uint16_t slotId = IM_getEntryIndexByPredicate(
-                searchKey,
-                node,
-                IM_GETENTRY_OP_LT,
-                maxEntriesPerNode,
-                NULL,
-                NULL);
-
         parentRid.page = nodePageNum;
-        parentRid.slot = slotId;
+        parentRid.slot = route.slotId;
 
         // If tracing is enabled, append to the list
         if (trace != NULL) {
             IM_NodeTrace_append(trace, parentRid);
         }
 
-        //
-        // Determine the next page number
-        //
-
-        // Check if the slot index == numTuples,
-        //   if so, we need to use the `page.header->nextPageNum` pointer as the
-        //   right-most pointer on the node to get the next page
-        //
-        uint16_t nodeNumTuples = node->header.numTuples;
-        if (slotId == nodeNumTuples) {
-            nodePageNum = node->header.nextPageNum;
-        }
-        else if (slotId < nodeNumTuples) {
-            // Traverse to the newly selected node
-            RM_PageTuple *nextTup = RM_Page_getTuple(node, slotId, NULL);
-
-            // Determine where the next page is located
-            IM_ENTRY_FORMAT_T entry;
-            IM_readEntry_i32(nextTup, &entry);
-            nodePageNum = BF_AS_U16(entry.idxEntryRidPageNum);
-        }
-        else {
-            PANIC("bad 'slotId' value. expected to be <= number of tuples in node");
-            nodePageNum = -1;  // stop static analyzer from complaining
-        }
-
+        nodePageNum = route.childPageNum;
         if (nodePageNum == (RM_PageNumber) -1) {
             PANIC("bad 'nextPageNum'. got -1.");
         }
 
-        // Unpin previous parent, if available
-        if (parentNode != NULL) {
-            if (unpinPage(pool, &parentNodeHandle) != RC_OK) {
-                PANIC("failed to unpin parent node page");
-            }
-            memset(&parentNodeHandle, 0, sizeof(parentNodeHandle));
-            parentNode = NULL;
-        }
-
-        // Move current page to parent page
-        parentNode = node;
-        parentNodeHandle = nodeHandle;
-
     } while (true);
 
     if (parent_out_opt != NULL) {
@@ -2004,7 +2123,7 @@ finally:
     return rc;
 }
 
-RC IM_deleteIndex(BM_BufferPool *pool, char *idxId)
+RC IM_deleteIndex(BM_BufferPool *pool, char *idxId, RM_PageNumber descriptorPageNum)
 {
     PANIC_IF_NULL(idxId);
 
@@ -2014,6 +2133,7 @@ RC IM_deleteIndex(BM_BufferPool *pool, char *idxId)
     TRY_OR_RETURN(IM_findIndex(
             pool,
             idxId,
+            descriptorPageNum,
             &systemPageHandle,
             &indexTup,
             &indexData));
@@ -2025,7 +2145,7 @@ RC IM_deleteIndex(BM_BufferPool *pool, char *idxId)
 
     // We can delete the index descriptor tuple now since we already have the
     // data loaded
-    RM_Page_deleteTuple(systemPage, indexTup->slotId);
+    RM_Page_killTuple(systemPage, indexTup->slotId);
 
     // Allocate a stack to push parent nodes when we need to traverse it's
     // children
@@ -2046,6 +2166,7 @@ RC IM_deleteIndex(BM_BufferPool *pool, char *idxId)
         if (isCurPageRoot && isCurPageLeaf) {
             // The index consists of only the root page
             RM_Page_free(curPage);
+            TRY_OR_RETURN(unmarkPageResident(pool, curPageNum));
             break;
         }
 
@@ -2093,6 +2214,7 @@ RC IM_deleteIndex(BM_BufferPool *pool, char *idxId)
 
             // Delete this inner node
             RM_Page_free(curPage);
+            TRY_OR_RETURN(unmarkPageResident(pool, curPageNum));
 
             // Attempt to pop the parent to read the rest of the parent inner slots
             bool finished = false;
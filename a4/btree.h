@@ -3,8 +3,13 @@
 #include "btree_binfmt.h"
 #include "buffer_mgr.h"
 
+struct RM_Catalog;
+
 #define IM_NODETRACE_INITIAL_CAPACITY (16)
 
+// Optimistic reads of an inner node before falling back to pinning it
+#define IM_OPTIMISTIC_READ_MAX_ATTEMPTS (3)
+
 typedef struct IM_IndexMetadata {
     RM_PageNumber rootNodePageNum;
     uint16_t maxEntriesPerNode;
@@ -21,6 +26,12 @@ typedef struct IM_NodeTrace {
     uint16_t entryCapacity;
 } IM_NodeTrace;
 
+typedef struct IM_NodeRoute {
+    bool isLeaf;
+    uint16_t slotId;              // entry followed, if not a leaf
+    RM_PageNumber childPageNum;   // child to descend to, if not a leaf
+} IM_NodeRoute;
+
 typedef struct IM_SplitLeafNodeCtx {
     RM_PageNumber leftPageNum;
     RM_PageNumber rightPageNum;
@@ -71,6 +82,9 @@ IM_getLeafNode(
         RID *parent_out_opt,
         IM_NodeTrace **trace_out_opt);
 
+RC
+IM_keepNodeResident(BM_BufferPool *pool, RM_PageNumber nodePageNum);
+
 RC
 IM_writeIndexPage(BM_BufferPool *pool);
 
@@ -85,10 +99,16 @@ RC
 IM_findIndex(
         BM_BufferPool *pool,
         char *name,
+        RM_PageNumber descriptorPageNum,
         BM_PageHandle *descriptor_page_out_opt,
         RM_PageTuple **tup_out_opt,
         struct IM_DESCRIPTOR_FORMAT_T *msg_out_opt);
 
+RC
+IM_loadIndexCatalog(
+        BM_BufferPool *pool,
+        struct RM_Catalog *catalog);
+
 bool
 IM_getEntryIndex(
         int32_t keyValue,
@@ -124,7 +144,8 @@ IM_writeEntryAt_i32(
 RC
 IM_deleteIndex(
         BM_BufferPool *pool,
-        char *idxId);
+        char *idxId,
+        RM_PageNumber descriptorPageNum);
 
 RC
 IM_getNumNodes(
@@ -9,6 +9,8 @@
 #include "btree.h"
 #include "btree_mgr.h"
 #include "record_mgr.h"
+#include "rm_catalog.h"
+#include "wal.h"
 
 typedef struct IM_Metadata {
     RM_Metadata *recordManager;
@@ -16,6 +18,24 @@ typedef struct IM_Metadata {
 
 static IM_Metadata *g_instance = NULL;
 
+static void BT_prefetchNextLeaf(BM_BufferPool *pool, RM_Page *leaf);
+
+// Looks `idxId` up in the catalog cache, loading it on first use
+static RC IM_lookupIndex(char *idxId, RM_CatalogIndex **index_out)
+{
+    RM_Catalog *catalog = g_instance->recordManager->catalog;
+    if (!catalog->indexesLoaded) {
+        TRY_OR_RETURN(IM_loadIndexCatalog(g_instance->recordManager->bufferPool, catalog));
+    }
+
+    RM_CatalogIndex *index = RM_Catalog_getIndex(catalog, idxId);
+    if (index == NULL) {
+        return RC_IM_KEY_NOT_FOUND;
+    }
+    *index_out = index;
+    return RC_OK;
+}
+
 // init and shutdown index manager
 RC initIndexManager(void *mgmtData IGNORE_UNUSED)
 {
@@ -76,7 +96,6 @@ RC createBtree (char *idxId, DataType keyType, int n)
 
     RC rc;
     BM_BufferPool *pool = g_instance->recordManager->bufferPool;
-    BP_Metadata *meta = pool->mgmtData;
 
     uint64_t indexNameLength = strlen(idxId);
     if (indexNameLength > BF_LSTRING_MAX_STRLEN) {
@@ -84,7 +103,8 @@ RC createBtree (char *idxId, DataType keyType, int n)
     }
 
     //check if index with same name already exists
-    rc = IM_findIndex(pool, idxId, NULL, NULL, NULL);
+    RM_CatalogIndex *existing;
+    rc = IM_lookupIndex(idxId, &existing);
     if (rc == RC_OK) {
         return RC_IM_KEY_ALREADY_EXISTS;
     }
@@ -95,7 +115,8 @@ RC createBtree (char *idxId, DataType keyType, int n)
     //
     // Initialize root index node page
     //
-    int dataPageNum = meta->fileHandle->totalNumPages;
+    int dataPageNum;
+    TRY_OR_RETURN(RM_Page_allocate(pool, 1, &dataPageNum));
 
     BM_PageHandle dataPageHandle = {};
     TRY_OR_RETURN(pinPage(pool, &dataPageHandle, dataPageNum));
@@ -104,8 +125,9 @@ RC createBtree (char *idxId, DataType keyType, int n)
     rootPage->header.flags |= RM_PAGE_FLAGS_INDEX_ROOT;  // make page as root node
     rootPage->header.flags |= RM_PAGE_FLAGS_INDEX_LEAF;  // mark root as initially a leaf node
 
-    TRY_OR_RETURN(forcePage(pool, &dataPageHandle));
+    TRY_OR_RETURN(markDirty(pool, &dataPageHandle));
     TRY_OR_RETURN(unpinPage(pool, &dataPageHandle));
+    TRY_OR_RETURN(IM_keepNodeResident(pool, dataPageNum));
 
     //
     // Setup information for the index descriptor into the disk format
@@ -121,27 +143,35 @@ RC createBtree (char *idxId, DataType keyType, int n)
             BF_NUM_ELEMENTS(sizeof(indexDisk)));
 
     //
-    // Open index descriptor page and reserve the required amount of space
+    // Reserve the required amount of space on an index descriptor page, the
+    // chain of them grows by a page when they are full
     //
     BM_PageHandle pageHandle = {};
-    TRY_OR_RETURN(pinPage(pool, &pageHandle, RM_PAGE_INDEX));
-
-    RM_Page *systemPage = (RM_Page *) pageHandle.buffer;
-    RM_PageTuple *tup = RM_Page_reserveTupleAtEnd(systemPage, spaceRequired);
-    if (tup == NULL) {
-        rc = RC_RM_NO_MORE_TUPLES;
-        goto finally;
-    }
+    RM_PageTuple *tup;
+    TRY_OR_RETURN(RM_CatalogChain_reserveTuple(
+            pool,
+            &g_instance->recordManager->catalog->indexChain,
+            RM_PAGE_KIND_INDEX,
+            spaceRequired,
+            &pageHandle,
+            &tup));
 
     //
     // Write out of the index tuple data
     //
     void *tupleBuffer = &tup->dataBegin;
     BF_write((BF_MessageElement *) &indexDisk, tupleBuffer, BF_NUM_ELEMENTS(sizeof(indexDisk)));
-    if ((rc = forcePage(pool, &pageHandle)) != RC_OK) {
+    if ((rc = markDirty(pool, &pageHandle)) != RC_OK) {
         goto finally;
     }
 
+    // the cache was loaded by the lookup above, keep it complete
+    IM_IndexMetadata indexMeta;
+    IM_IndexMetadata_makeFromMessage(&indexMeta, &indexDisk);
+    RM_Catalog_putIndex(
+            g_instance->recordManager->catalog,
+            RM_CatalogIndex_create(idxId, keyType, &indexMeta, pageHandle.pageNum));
+
     rc = RC_OK;
 
     finally:
@@ -156,20 +186,24 @@ RC openBtree (BTreeHandle **tree, char *idxId)
     RC rc;
     BM_BufferPool *pool = g_instance->recordManager->bufferPool;
 
-    struct IM_DESCRIPTOR_FORMAT_T indexMsg = {};
-    BM_PageHandle pageHandle = {};
-    if ((rc = IM_findIndex(pool, idxId, &pageHandle, NULL, &indexMsg)) != RC_OK) {
-        return rc;
-    }
+    RM_CatalogIndex *index;
+    TRY_OR_RETURN(IM_lookupIndex(idxId, &index));
 
     BTreeHandle *indexHandle = malloc(sizeof(BTreeHandle));
     indexHandle->idxId = idxId;
-    indexHandle->keyType = BF_AS_U8(indexMsg.idxKeyType);
+    indexHandle->keyType = index->keyType;
 
     IM_IndexMetadata *meta = malloc(sizeof(IM_IndexMetadata));
-    IM_IndexMetadata_makeFromMessage(meta, &indexMsg);
+    *meta = index->meta;
     indexHandle->mgmtData = meta;
 
+    // every operation on the tree starts at its root
+    if ((rc = IM_keepNodeResident(pool, meta->rootNodePageNum)) != RC_OK) {
+        free(meta);
+        free(indexHandle);
+        return rc;
+    }
+
     *tree = indexHandle;
     return RC_OK;
 }
@@ -179,7 +213,8 @@ RC closeBtree (BTreeHandle *tree)
     free(tree->mgmtData);
     free(tree);
 
-    return RC_OK;
+    // make the changes durable through the log, like `closeTable`
+    return WAL_commit(g_instance->recordManager->wal);
 }
 
 RC deleteBtree(char *idxId)
@@ -187,7 +222,13 @@ RC deleteBtree(char *idxId)
     PANIC_IF_NULL(idxId);
     BM_BufferPool *pool = g_instance->recordManager->bufferPool;
 
-    return IM_deleteIndex(pool, idxId);
+    RM_Catalog *catalog = g_instance->recordManager->catalog;
+    RM_CatalogIndex *index;
+    TRY_OR_RETURN(IM_lookupIndex(idxId, &index));
+    TRY_OR_RETURN(IM_deleteIndex(pool, idxId, index->pageNum));
+    catalog->indexChain.freedPageNum = index->pageNum;
+    RM_Catalog_removeIndex(catalog, idxId);
+    return RC_OK;
 }
 
 // access information about a b-tree
@@ -292,7 +333,8 @@ RC insertKey (BTreeHandle *tree, Value *key, RID rid)
     BM_BufferPool *pool = g_instance->recordManager->bufferPool;
     IM_IndexMetadata *indexMeta = (IM_IndexMetadata *) tree->mgmtData;
 
-    return IM_insertKey_i32(pool, indexMeta, key->v.intV, rid);
+    TRY_OR_RETURN(IM_insertKey_i32(pool, indexMeta, key->v.intV, rid));
+    return WAL_checkpointStep(g_instance->recordManager->wal, pool);
 }
 
 RC deleteKey (BTreeHandle *tree, Value *key)
@@ -312,7 +354,8 @@ RC deleteKey (BTreeHandle *tree, Value *key)
     BM_BufferPool *pool = g_instance->recordManager->bufferPool;
     IM_IndexMetadata *indexMeta = (IM_IndexMetadata *) tree->mgmtData;
 
-    return IM_deleteKey_i32(pool, indexMeta, keyValue);
+    TRY_OR_RETURN(IM_deleteKey_i32(pool, indexMeta, keyValue));
+    return WAL_checkpointStep(g_instance->recordManager->wal, pool);
 }
 
 RC openTreeScan (BTreeHandle *tree, BT_ScanHandle **handle)
@@ -358,6 +401,7 @@ RC nextEntry (BT_ScanHandle *handle, RID *result){
                 pool,
                 &scandata->currentPageHandle,
                 scandata->currentNodePageNum));
+        BT_prefetchNextLeaf(pool, (RM_Page *) scandata->currentPageHandle.buffer);
     }
 
     RM_Page *currentPage = (RM_Page *) scandata->currentPageHandle.buffer;
@@ -386,6 +430,7 @@ RC nextEntry (BT_ScanHandle *handle, RID *result){
                 scandata->currentNodePageNum));
 
         currentPage = (RM_Page *) scandata->currentPageHandle.buffer;
+        BT_prefetchNextLeaf(pool, currentPage);
     }
 
     RM_PageTuple *tup = RM_Page_getTuple(currentPage, scandata->currentSlotId, NULL);
@@ -398,6 +443,17 @@ RC nextEntry (BT_ScanHandle *handle, RID *result){
     return RC_OK;
 }
 
+// Leaves are chained in key order, so the next leaf of a scan is known as
+// soon as the current one is pinned and can be read while entries are
+// returned from this one
+static void BT_prefetchNextLeaf(BM_BufferPool *pool, RM_Page *leaf)
+{
+    int nextPageNumQ = leaf->header.nextPageNum;
+    if (nextPageNumQ != RM_PAGE_NEXT_PAGENUM_UNSET && nextPageNumQ >= 0) {
+        prefetchPage(pool, nextPageNumQ);
+    }
+}
+
 RC closeTreeScan (BT_ScanHandle *handle){
 	BT_ScanData *data = handle->mgmtData;
     free(data);
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <stdio_ext.h>
 #include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
@@ -6,15 +7,64 @@
 /* linux specific */
 #include <stdbool.h>
 #include <inttypes.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
 
 #include "dberror.h"
 #include "storage_mgr.h"
 #include "buffer_mgr.h"
+#include "bm_trace.h"
 #include "replacement_strategy.h"
 #include "freespace.h"
 #include "debug.h"
 #include "rm_macros.h"
 
+// Background reader for `prefetchPage`.
+//
+// A single worker thread per pool services reads into frames that have
+// already been reserved, mapped and internally pinned by the caller, so the
+// worker never touches the page table, the hash map or the replacement
+// strategy. Completed frames are handed back through `done` and are reaped
+// (internal pin dropped) on the calling thread, so descriptor state is only
+// ever modified by the pool's owner.
+typedef struct BP_Prefetcher {
+    pthread_t worker;
+    pthread_mutex_t lock;
+    pthread_cond_t requested;  // a read was queued, or the worker should stop
+    pthread_cond_t completed;  // a read finished
+    int fd;
+
+    int capacity;              // one slot per frame, a frame is queued once
+    int *queue;                // frame indexes waiting for the worker
+    int queueHead;
+    int queueLen;
+    int *done;                 // frame indexes read but not reaped yet
+    int doneLen;
+    bool *isDone;              // per frame, read has completed
+    PageNumber *pageNums;      // per frame, page being read
+    char **buffers;            // per frame, destination of the read
+
+    int numInFlight;           // owner thread only, reads not reaped yet
+    bool stop;
+} BP_Prefetcher;
+
+// Share of the pool that reads in flight may hold, pools smaller than this
+// many frames do not prefetch at all
+#define BM_PREFETCH_MAX_IN_FLIGHT_DIVISOR (4)
+
+// Counter updates go to the calling thread's shard of the pool statistics
+#define BM_STAT_ADD(_META, _COUNTER, _N) \
+    __atomic_fetch_add(&statShard(_META)->counters[_COUNTER], (_N), __ATOMIC_RELAXED)
+
+#define BM_STRATEGY_STAT_ADD(_META, _SLOT, _COUNTER, _N) \
+    __atomic_fetch_add(&statShard(_META)->strategyCounters[_SLOT][_COUNTER], (_N), __ATOMIC_RELAXED)
+
+// Attempts at collecting two identical passes over the shards before
+// `getPoolStats` settles for the last one
+#define BM_STAT_SNAPSHOT_MAX_ATTEMPTS (8)
+
 //Helper Functions
 typedef enum BM_EvictMode {
     BM_EVICTMODE_FRESH,
@@ -22,6 +72,14 @@ typedef enum BM_EvictMode {
 } BM_EvictMode;
 
 static BM_LinkedListElement *evict(BM_BufferPool *bm, BM_EvictMode mode);
+static void releaseFrame(BM_BufferPool *bm, BM_LinkedListElement *el);
+static BM_LinkedListElement *recycleRingFrame(
+        BM_BufferPool *bm,
+        BM_AccessStrategy *strategy);
+static void adoptRingFrame(
+        BM_AccessStrategy *strategy,
+        BM_LinkedListElement *el,
+        PageNumber pageNum);
 
 static bool resolveByHandle(
         BM_BufferPool *bm,
@@ -33,6 +91,43 @@ static bool resolveByPageNum(
         PageNumber num,
         BM_LinkedListElement **el_out);
 
+static BP_StatShard *statShard(BP_Metadata *meta);
+static void syncFrameMirror(BP_Metadata *meta, BM_LinkedListElement *el);
+static int statStrategySlot(BM_BufferPool *bm, BM_AccessStrategy *strategy);
+static void collectPoolStats(BP_Metadata *meta, BM_PoolStats *stats_out);
+
+static void recordPin(BP_Metadata *meta, PageNumber pageNum, BM_TraceFlags flags);
+static void flushTrace(BM_TraceRecorder *trace);
+
+static void beginFrameLoad(BP_PageDescriptor *pd);
+static void endFrameLoad(BP_PageDescriptor *pd);
+static void publishFrameWrite(BP_PageDescriptor *pd);
+
+static int comparePageNums(const void *a, const void *b);
+
+static void logFrameChange(BP_Metadata *meta, BP_PageDescriptor *pd);
+static void beforeFrameWrite(BP_Metadata *meta, BP_PageDescriptor *pd);
+static void resetFrameShadow(BP_Metadata *meta, BP_PageDescriptor *pd);
+
+static char *allocArena(BP_Metadata *meta, int numPages);
+static void freeArena(BP_Metadata *meta);
+
+static BM_LinkedListElement *acquireFrame(
+        BM_BufferPool *bm,
+        BM_AccessStrategy *strategy,
+        bool *isInPlace_out);
+static BM_LinkedListElement *fixFrame(
+        BM_BufferPool *bm,
+        const PageNumber pageNum,
+        BM_AccessStrategy *strategy,
+        bool isInternal);
+
+static BP_Prefetcher *startPrefetcher(BM_BufferPool *bm);
+static void stopPrefetcher(BM_BufferPool *bm);
+static void *prefetchWorker(void *arg);
+static void reapPrefetches(BM_BufferPool *bm);
+static bool waitForPrefetch(BM_BufferPool *bm, BM_LinkedListElement *el);
+
 //
 
 RC initBufferPool(
@@ -42,6 +137,18 @@ RC initBufferPool(
 		ReplacementStrategy strategy,
 		void *stratData)
 {
+    BM_PoolOptions options = BM_POOL_OPTIONS_DEFAULT;
+    return initBufferPoolWithOptions(bm, pageFileName, numPages, strategy, stratData, &options);
+}
+
+RC initBufferPoolWithOptions(
+        BM_BufferPool *const bm,
+        const char *const pageFileName,
+        const int numPages,
+        ReplacementStrategy strategy,
+        void *stratData,
+        const BM_PoolOptions *options)
+{
 
 	BP_Metadata *meta = NULL;
 	BP_Statistics *stats = NULL;
@@ -60,25 +167,44 @@ RC initBufferPool(
     meta->clock = 0; //for clock replacement
     meta->refCounter = 0; //nothing using buffer yet
     meta->inUse = 0;	  //no pages in use
+    meta->prefetcher = NULL;
+    meta->trace = NULL;
+    meta->shadowBuffer = NULL;
+    memset(&meta->logHooks, 0, sizeof(BM_LogHooks));
+    meta->options = options != NULL ? *options : BM_POOL_OPTIONS_DEFAULT;
+    meta->residentBudget = meta->options.residentBudget != BM_RESIDENT_BUDGET_DEFAULT
+            ? meta->options.residentBudget
+            : numPages / BM_RESIDENT_BUDGET_DEFAULT_DIVISOR;
+    meta->numResident = 0;
 
     stats = malloc(sizeof(BP_Statistics));
-    stats->diskReads = 0;
-    stats->diskWrites = 0;
-    stats->lastFrameContents = calloc(numPages, sizeof(PageNumber));
+    stats->shards = aligned_alloc(
+            _Alignof(BP_StatShard),
+            BM_STAT_NUM_SHARDS * sizeof(BP_StatShard));
+    memset(stats->shards, 0, BM_STAT_NUM_SHARDS * sizeof(BP_StatShard));
+    stats->lastFrameContents = malloc(numPages * sizeof(PageNumber));
     stats->lastDirtyFlags = calloc(numPages, sizeof(bool));
     stats->lastFixCounts = calloc(numPages, sizeof(int));
+    for (int i = 0; i < numPages; i++) {
+        // -1 represents an unused frame
+        stats->lastFrameContents[i] = NO_PAGE;
+    }
     meta->stats = stats;
 
     // set up pagetable
     meta->pageDescriptors = LinkedList_create(numPages, sizeof(BP_PageDescriptor));
 
     // allocate memory pool
-    meta->pageBuffer = calloc(numPages, PAGE_SIZE);
+    meta->pageBuffer = allocArena(meta, numPages);
     for (uint32_t i = 0; i < numPages; i++) {
         BM_LinkedListElement *el = &meta->pageDescriptors->elementsMetaBuffer[i];
         BP_PageDescriptor *pd = (BP_PageDescriptor *) el->data;
         pd->handle.pageNum = -1;
         pd->handle.buffer = meta->pageBuffer + (i * PAGE_SIZE);
+        pd->handle.frame = i;
+        pd->handle.generation = 0;  // never matches a handle from `pinPage`
+        pd->version = 1;  // empty
+        pd->recLSN = BM_NO_LSN;
     }
 
     // allocate hash map
@@ -98,6 +224,13 @@ RC initBufferPool(
     // initialize strategy handler
     meta->strategyHandler->init(bm);
 
+    if (meta->options.traceFileName != NULL) {
+        if ((rc = startPoolTrace(bm, meta->options.traceFileName)) != RC_OK) {
+            shutdownBufferPool(bm);
+            return rc;
+        }
+    }
+
 	return RC_OK;
 
 error:
@@ -122,6 +255,10 @@ RC shutdownBufferPool(BM_BufferPool *const bm){
 		return RC_BM_IN_USE;
 	}
 
+	// let reads that are still in flight land before the arena goes away
+	stopPrefetcher(bm);
+	stopPoolTrace(bm);
+
 	closePageFile(meta->fileHandle);
 
     BP_Statistics *stats = meta->stats;
@@ -132,7 +269,10 @@ RC shutdownBufferPool(BM_BufferPool *const bm){
     stats->lastDirtyFlags = NULL;
 
     free(stats->lastFrameContents);
-    stats->lastFixCounts = NULL;
+    stats->lastFrameContents = NULL;
+
+    free(stats->shards);
+    stats->shards = NULL;
 
     free(stats);
 
@@ -142,8 +282,9 @@ RC shutdownBufferPool(BM_BufferPool *const bm){
 	HashMap_free(meta->pageMapping);
 	meta->pageMapping = NULL;
 
-	free(meta->pageBuffer);
-	meta->pageBuffer = NULL;
+	freeArena(meta);
+	free(meta->shadowBuffer);
+	meta->shadowBuffer = NULL;
 
 	free(meta->fileHandle);
 	meta->fileHandle = NULL;
@@ -159,18 +300,152 @@ RC shutdownBufferPool(BM_BufferPool *const bm){
 	return RC_OK;
 }
 
+/**
+ * Writes back every dirty page in the pool.
+ *
+ * Dirty frames are sorted by page number and each run of consecutive pages is
+ * written with one vectored write, so that a full flush turns into mostly
+ * sequential I/O regardless of where the pages sit in the pool.
+ */
 RC forceFlushPool(BM_BufferPool *const bm){
 	BP_Metadata *meta = bm->mgmtData;
-    BM_LinkedList *pageTable = meta->pageDescriptors;
-    BM_LinkedListElement *el = pageTable->head;
-	while (el != pageTable->sentinel) {
+	SM_FileHandle *storage = meta->fileHandle;
+    BM_LinkedListElement *frames = meta->pageDescriptors->elementsMetaBuffer;
+
+    int numDirty = 0;
+    BM_LinkedListElement **dirty = malloc(bm->numPages * sizeof(BM_LinkedListElement *));
+    for (int i = 0; i < bm->numPages; i++) {
+        BP_PageDescriptor *pd = BM_DEREF_ELEMENT(&frames[i]);
+        if (pd->dirty && pd->handle.pageNum != NO_PAGE) {
+            dirty[numDirty++] = &frames[i];
+        }
+    }
+    if (numDirty == 0) {
+        free(dirty);
+        return RC_OK;
+    }
+    qsort(dirty, numDirty, sizeof(BM_LinkedListElement *), comparePageNums);
+    for (int i = 0; i < numDirty; i++) {
+        beforeFrameWrite(meta, BM_DEREF_ELEMENT(dirty[i]));
+    }
+
+    // ensure that we have enough pages before writing, once for the flush
+    PageNumber lastPageNum = BM_DEREF_ELEMENT(dirty[numDirty - 1])->handle.pageNum;
+    ensureCapacity(lastPageNum + 1, storage);
+
+    RC rc = RC_OK;
+    SM_PageHandle *buffers = malloc(numDirty * sizeof(SM_PageHandle));
+    int runBegin = 0;
+    while (runBegin < numDirty) {
+        PageNumber firstPageNum = BM_DEREF_ELEMENT(dirty[runBegin])->handle.pageNum;
+        int runLen = 0;
+        while (runBegin + runLen < numDirty
+               && BM_DEREF_ELEMENT(dirty[runBegin + runLen])->handle.pageNum
+                       == firstPageNum + runLen) {
+            buffers[runLen] = BM_DEREF_ELEMENT(dirty[runBegin + runLen])->handle.buffer;
+            runLen++;
+        }
+
+        if ((rc = writeBlocks(firstPageNum, runLen, storage, buffers)) != RC_OK) {
+            break;
+        }
+
+        for (int i = runBegin; i < runBegin + runLen; i++) {
+            BP_PageDescriptor *pd = BM_DEREF_ELEMENT(dirty[i]);
+            pd->dirty = false;
+            pd->recLSN = BM_NO_LSN;
+            publishFrameWrite(pd);
+            syncFrameMirror(meta, dirty[i]);
+        }
+        BM_STAT_ADD(meta, BM_STAT_WRITES, runLen);
+        runBegin += runLen;
+    }
+
+    free(buffers);
+    free(dirty);
+	return rc;
+}
+
+/**
+ * Writes back every dirty page in the pool and waits until the page file is
+ * durable.
+ */
+RC syncBufferPool(BM_BufferPool *const bm){
+    BP_Metadata *meta = bm->mgmtData;
+    TRY_OR_RETURN(forceFlushPool(bm));
+    return syncPageFile(meta->fileHandle);
+}
+
+/**
+ * Installs write-ahead logging hooks on the pool.
+ *
+ * From then on every change to a page is handed to `hooks->logChange` as
+ * soon as the page is marked dirty or unpinned, with the page contents as of
+ * the previous call to diff against, and `hooks->beforeWrite` is called
+ * before any page is written back, so the log can be made durable up to the
+ * page's last change first. Pages can then stay dirty across commits and can
+ * be evicted while their changes are still being made.
+ *
+ * Install the hooks before making any change that has to be logged: pages
+ * already in the pool are taken as they are.
+ *
+ * The copies to diff against double the memory of the pool, and every
+ * `markDirty`, and every unpin of a page changed since, compares a whole page.
+ */
+RC setPoolLogHooks(BM_BufferPool *const bm, const BM_LogHooks *hooks){
+    PANIC_IF_NULL(bm);
+    PANIC_IF_NULL(hooks);
+
+    BP_Metadata *meta = bm->mgmtData;
+    if (meta->shadowBuffer == NULL) {
+        meta->shadowBuffer = malloc((size_t) bm->numPages * PAGE_SIZE);
+    }
+    memcpy(meta->shadowBuffer, meta->pageBuffer, (size_t) bm->numPages * PAGE_SIZE);
+    meta->logHooks = *hooks;
+    return RC_OK;
+}
+
+/**
+ * Lists every page with logged changes that have not been written back, and
+ * the log position of the oldest of them, for a checkpoint.
+ *
+ * @param pages_out  room for `bm->numPages` entries
+ * @return the number of entries filled in
+ */
+int getDirtyPageTable(BM_BufferPool *const bm, BM_DirtyPage *pages_out){
+    BP_Metadata *meta = bm->mgmtData;
+    BM_LinkedListElement *frames = meta->pageDescriptors->elementsMetaBuffer;
+
+    int n = 0;
+    for (int i = 0; i < bm->numPages; i++) {
+        BP_PageDescriptor *pd = BM_DEREF_ELEMENT(&frames[i]);
+        if (pd->dirty && pd->recLSN != BM_NO_LSN && pd->handle.pageNum != NO_PAGE) {
+            pages_out[n].pageNum = pd->handle.pageNum;
+            pages_out[n].recLSN = pd->recLSN;
+            n++;
+        }
+    }
+    return n;
+}
+
+/**
+ * Writes back those of `pageNums` that are still in the pool and have not
+ * been clean since `maxRecLSN`. Pages that were written back and changed
+ * again since then, or that have been evicted, are left alone.
+ */
+RC flushDirtyPages(BM_BufferPool *const bm, const PageNumber *pageNums, int n,
+        uint64_t maxRecLSN){
+    for (int i = 0; i < n; i++) {
+        BM_LinkedListElement *el = NULL;
+        if (!resolveByPageNum(bm, pageNums[i], &el)) {
+            continue;
+        }
         BP_PageDescriptor *pd = BM_DEREF_ELEMENT(el);
-		if (pd->dirty) {
-			forcePage(bm, &pd->handle);
-		}
-        el = el->next;
+        if (pd->dirty && !pd->ioPending && pd->recLSN <= maxRecLSN) {
+            TRY_OR_RETURN(forcePage(bm, &pd->handle));
+        }
     }
-	return RC_OK;
+    return RC_OK;
 }
 
 // Buffer Manager Interface Access Pages
@@ -183,6 +458,10 @@ RC markDirty (BM_BufferPool *const bm, BM_PageHandle *const page){
 
     BP_PageDescriptor *pd = BM_DEREF_ELEMENT(el);
     pd->dirty = TRUE;
+    pd->changed = true;
+    logFrameChange(meta, pd);
+    publishFrameWrite(pd);
+    syncFrameMirror(meta, el);
 
 #if LOG_DEBUG
     printf("DEBUG: markDirty: pg@0x%08" PRIxPTR
@@ -205,8 +484,14 @@ RC unpinPage (BM_BufferPool *const bm, BM_PageHandle *const page) {
     }
 
     BP_PageDescriptor *pd = BM_DEREF_ELEMENT(el);
+    if (pd->changed) {
+        // catch writes made after the page was marked dirty
+        logFrameChange(meta, pd);
+        pd->changed = false;
+    }
     meta->refCounter -= 1; //decrement buf mgr ref counter for thread use
     pd->fixCount -= 1;
+    syncFrameMirror(meta, el);
     return RC_OK;
 }
 
@@ -228,9 +513,13 @@ RC forcePage (BM_BufferPool *const bm, BM_PageHandle *const page) {
     // ensure that we have enough pages before writing
     // recall that `pageNum` is zero-indexed
     ensureCapacity(page->pageNum + 1, storage);
-    writeBlock(page->pageNum, storage, page->buffer);
+    beforeFrameWrite(meta, pd);
+    writeBlock(page->pageNum, storage, pd->handle.buffer);
     pd->dirty = false;
-    meta->stats->diskWrites += 1;
+    pd->recLSN = BM_NO_LSN;
+    publishFrameWrite(pd);
+    syncFrameMirror(meta, el);
+    BM_STAT_ADD(meta, BM_STAT_WRITES, 1);
 
 	return RC_OK;
 }
@@ -239,185 +528,701 @@ RC pinPage (
         BM_BufferPool *bm,
         BM_PageHandle *const page,
         const PageNumber pageNum)
+{
+    return pinPageWithStrategy(bm, page, pageNum, NULL);
+}
+
+/**
+ * Pins a page, optionally through a scan-scoped access strategy.
+ *
+ * When `strategy` is non-null, a miss recycles one of the strategy's ring
+ * frames, if it is no longer in use, instead of asking the pool's replacement
+ * strategy for a victim. Pages loaded this way are not promoted in the
+ * replacement strategy so they are the first to go if the ring lets them go.
+ */
+RC pinPageWithStrategy (
+        BM_BufferPool *bm,
+        BM_PageHandle *const page,
+        const PageNumber pageNum,
+        BM_AccessStrategy *strategy)
 {
     PANIC_IF_NULL(bm);
     PANIC_IF_NULL(page);
 
-	BP_Metadata *meta = bm->mgmtData;
-    BM_LinkedList *pageTable = meta->pageDescriptors;
-	SM_FileHandle *storage = meta->fileHandle;
+    BM_LinkedListElement *el = fixFrame(bm, pageNum, strategy, false);
+    *page = BM_DEREF_ELEMENT(el)->handle;
+	return RC_OK;
+}
 
-	// check if page number exists
-    BM_LinkedListElement *el;
-    BP_PageDescriptor *pd;
-    if (resolveByPageNum(bm, pageNum, &el)) {
-        pd = BM_DEREF_ELEMENT(el);
-        pd->fixCount += 1;
+// Buffer Manager Interface Resident Pages
+
+/**
+ * Keeps a page in the pool regardless of the replacement strategy.
+ *
+ * Meant for the few pages nearly every request starts from, such as the
+ * catalog pages and the inner nodes of an index. The page is loaded if needed
+ * and then holds an internal pin, the same way a frame with a read in flight
+ * does, so no strategy and no scan ring can elect it. Writes to it are still
+ * flushed as usual.
+ *
+ * The internal pin is not a pin of the caller: it is not counted as a hit or
+ * a miss, not traced, and left out of `getFixCounts`. Loading the page still
+ * counts as a read.
+ *
+ * @return RC_BM_RESIDENT_BUDGET_EXCEEDED if `BM_PoolOptions.residentBudget`
+ *         pages are already resident; the page is left alone in that case.
+ */
+RC markPageResident (BM_BufferPool *const bm, const PageNumber pageNum) {
+    PANIC_IF_NULL(bm);
 
-    } else {
-        bool isFull = meta->inUse == bm->numPages;
-        if (isFull) {
-            // evict if buffer full
-            // use `BM_EVICTMODE_FRESH` so that that links between the element
-            // are not altered (we want to do an in-place update)
-            el = evict(bm, BM_EVICTMODE_FRESH);
-        } else {
-            // find empty space in memory pool
-            el = LinkedList_fresh(pageTable);
-        }
+    BP_Metadata *meta = bm->mgmtData;
+    BM_LinkedListElement *el = NULL;
+    if (resolveByPageNum(bm, pageNum, &el) && BM_DEREF_ELEMENT(el)->resident) {
+        return RC_OK;
+    }
+    if (meta->numResident >= meta->residentBudget) {
+        return RC_BM_RESIDENT_BUDGET_EXCEEDED;
+    }
 
-	    if (el == NULL) {
-	        fprintf(stderr, "pinPage: failed to pin page, evicted but list was full");
-	        exit(1);
-	    }
-        meta->inUse += 1;
-        pd = BM_DEREF_ELEMENT(el);
-        pd->handle.pageNum = pageNum;
-        pd->fixCount = 1;
-        pd->dirty = false;
+    el = fixFrame(bm, pageNum, NULL, true);
+    BP_PageDescriptor *pd = BM_DEREF_ELEMENT(el);
+    pd->resident = true;
+    meta->numResident += 1;
+    syncFrameMirror(meta, el);
+    return RC_OK;
+}
 
-        // update page number to element mapping
-        HashMap_put(meta->pageMapping, pageNum, el);
-        if (!isFull) {
-            // Only insert if the buffer was not full, and we're *not*
-            // doing an insert in place
-            meta->strategyHandler->insert(bm, el);
-        }
+/**
+ * Hands a page marked by `markPageResident` back to the replacement strategy.
+ * Pages that are not resident are left alone.
+ */
+RC unmarkPageResident (BM_BufferPool *const bm, const PageNumber pageNum) {
+    PANIC_IF_NULL(bm);
 
-        readBlock(pageNum, storage, pd->handle.buffer);
-        meta->stats->diskReads += 1;
+    BP_Metadata *meta = bm->mgmtData;
+    BM_LinkedListElement *el = NULL;
+    if (!resolveByPageNum(bm, pageNum, &el) || !BM_DEREF_ELEMENT(el)->resident) {
+        return RC_OK;
     }
 
-	// fetch page from memory
-    meta->refCounter += 1; //increment buf mgr ref counter for thread use
-    meta->strategyHandler->use(bm, el);
+    BP_PageDescriptor *pd = BM_DEREF_ELEMENT(el);
+    pd->resident = false;
+    pd->fixCount -= 1;
+    meta->numResident -= 1;
+    syncFrameMirror(meta, el);
+    return RC_OK;
+}
+
+int getNumResidentPages (BM_BufferPool *const bm) {
+    BP_Metadata *meta = bm->mgmtData;
+    return meta->numResident;
+}
+
+// Buffer Manager Interface Tracing
+
+/**
+ * Starts recording every pin of the pool to `traceFileName`, see `bm_trace.h`
+ * for the format. Tracing costs a clock read and a buffered copy per pin, and
+ * is meant to be left on for a representative stretch of a workload and then
+ * replayed with `trace_replay`.
+ *
+ * @return RC_WRITE_FAILED if the trace file cannot be created.
+ */
+RC startPoolTrace (BM_BufferPool *const bm, const char *traceFileName) {
+    PANIC_IF_NULL(bm);
+    PANIC_IF_NULL(traceFileName);
+
+    BP_Metadata *meta = bm->mgmtData;
+    stopPoolTrace(bm);
 
-    if (page) {
-        *page = pd->handle;
+    FILE *file = fopen(traceFileName, "wb");
+    if (file == NULL) {
+        return RC_WRITE_FAILED;
     }
 
-	return RC_OK;
+    BM_TraceHeader header = {
+            .magic = BM_TRACE_MAGIC,
+            .version = BM_TRACE_VERSION,
+            .numPages = bm->numPages,
+            .strategy = bm->strategy,
+    };
+    if (fwrite(&header, sizeof(header), 1, file) != 1) {
+        fclose(file);
+        return RC_WRITE_FAILED;
+    }
+
+    BM_TraceRecorder *trace = malloc(sizeof(BM_TraceRecorder));
+    trace->file = file;
+    trace->numBuffered = 0;
+    meta->trace = trace;
+    return RC_OK;
 }
 
+RC stopPoolTrace (BM_BufferPool *const bm) {
+    PANIC_IF_NULL(bm);
 
-// Statistics Interface
-PageNumber *getFrameContents (BM_BufferPool *const bm) {
     BP_Metadata *meta = bm->mgmtData;
-    BP_Statistics *stats = meta->stats;
+    BM_TraceRecorder *trace = meta->trace;
+    if (trace == NULL) {
+        return RC_OK;
+    }
 
-    // Repopulate from linked list
-    BM_LinkedList *descriptors = meta->pageDescriptors;
-    BM_LinkedListElement *el = descriptors->sentinel->next;
+    flushTrace(trace);
+    RC rc = fclose(trace->file) == 0 ? RC_OK : RC_WRITE_FAILED;
+    free(trace);
+    meta->trace = NULL;
+    return rc;
+}
 
-    PageNumber *frameContents = stats->lastFrameContents;
-    memset(frameContents, 0, sizeof(PageNumber) * bm->numPages);
+// Buffer Manager Interface Optimistic Reads
+
+/**
+ * Starts reading a resident page without pinning it.
+ *
+ * The frame may be evicted, reloaded or written at any time while it is being
+ * read, so whatever is read out of `page->buffer` must be treated as a guess
+ * until `validateOptimisticRead` confirms nothing intervened. Callers must
+ * neither follow pointers nor trust lengths read from the page beyond what is
+ * needed to stay within the frame, and should fall back to `pinPage` after a
+ * few failed attempts. Writers publish their changes through `markDirty` or
+ * `forcePage`, both of which bump the frame version.
+ *
+ * Like the rest of the pool, this is for the thread that owns the pool only.
+ * The page table lookup is not synchronized with `pinPage`, and a write to a
+ * pinned frame is only seen once it is published, not while it is under way,
+ * so a concurrent reader could see a torn page under an unchanged version.
+ * What the version does catch is the frame being reloaded or written by the
+ * caller itself between the two calls, e.g. when it pins other pages while
+ * reading. An optimistic read saves the fix count and replacement strategy
+ * updates of a pin.
+ *
+ * @return RC_PAGE_NOT_IN_BUFFER if the page is not resident or still being
+ *      read in, in which case the caller has to pin it.
+ */
+RC beginOptimisticRead (
+        BM_BufferPool *const bm,
+        BM_PageHandle *const page,
+        const PageNumber pageNum,
+        uint32_t *version_out)
+{
+    PANIC_IF_NULL(bm);
+    PANIC_IF_NULL(page);
+    PANIC_IF_NULL(version_out);
 
-    bool endFlag = false;
-    for (uint32_t i = 0; i < bm->numPages; ++i) {
-        if (!endFlag && el == descriptors->sentinel) {
-            // Mark flag for when we pass the end of actually used pages
-            endFlag = true;
-        }
+    BM_LinkedListElement *el = NULL;
+    if (!resolveByPageNum(bm, pageNum, &el)) {
+        return RC_PAGE_NOT_IN_BUFFER;
+    }
 
-        if (!endFlag) {
-            BP_PageDescriptor *pd = BM_DEREF_ELEMENT(el);
-            frameContents[i] = pd->handle.pageNum;
-            el = el->next;
+    BP_PageDescriptor *pd = BM_DEREF_ELEMENT(el);
+    uint32_t version = __atomic_load_n(&pd->version, __ATOMIC_ACQUIRE);
+    if ((version & 1u) != 0 || pd->handle.pageNum != pageNum) {
+        return RC_PAGE_NOT_IN_BUFFER;
+    }
 
-        } else {
-            // Fill the rest of the buffer with -1 for the page number
-            // to represent an unused page
-            frameContents[i] = -1;
-        }
+    *page = pd->handle;
+    *version_out = version;
+    return RC_OK;
+}
+
+/**
+ * Ends an optimistic read started with `beginOptimisticRead`.
+ *
+ * @return true if the frame still holds the same page, unmodified, so that
+ *      everything read from it since the read began is consistent.
+ */
+bool validateOptimisticRead (
+        BM_BufferPool *const bm,
+        const BM_PageHandle *const page,
+        uint32_t version)
+{
+	BP_Metadata *meta = bm->mgmtData;
+
+    // the frame is found from the buffer address, which never moves
+    size_t index = (size_t) (page->buffer - meta->pageBuffer) / PAGE_SIZE;
+    BP_PageDescriptor *pd = BM_DEREF_ELEMENT(
+            &meta->pageDescriptors->elementsMetaBuffer[index]);
+
+    // order the caller's reads of the page before the version re-check
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&pd->version, __ATOMIC_RELAXED) == version
+            && pd->handle.pageNum == page->pageNum;
+}
+
+// Buffer Manager Interface Prefetching
+RC prefetchPage (BM_BufferPool *const bm, const PageNumber pageNum) {
+    return prefetchPageWithStrategy(bm, pageNum, NULL);
+}
+
+RC prefetchPages (BM_BufferPool *const bm, const PageNumber *pageNums, int n) {
+    PANIC_IF_NULL(pageNums);
+    for (int i = 0; i < n; i++) {
+        TRY_OR_RETURN(prefetchPageWithStrategy(bm, pageNums[i], NULL));
     }
-    
-    return frameContents;
+    return RC_OK;
 }
 
-bool *getDirtyFlags (BM_BufferPool *const bm){
+/**
+ * Starts reading a page into the pool in the background, without pinning it.
+ *
+ * This is a hint: nothing happens if the page is already resident, lies past
+ * the end of the file, or if no frame can be freed for it right now. A later
+ * `pinPage` of the page either finds it loaded (a prefetch hit) or waits for
+ * the read to finish (a late prefetch). Frames are taken exactly as a
+ * `pinPageWithStrategy` miss with the same `strategy` would take them.
+ */
+RC prefetchPageWithStrategy (
+        BM_BufferPool *const bm,
+        const PageNumber pageNum,
+        BM_AccessStrategy *strategy)
+{
+    PANIC_IF_NULL(bm);
+
     BP_Metadata *meta = bm->mgmtData;
-    BP_Statistics *stats = meta->stats;
+    SM_FileHandle *storage = meta->fileHandle;
+    reapPrefetches(bm);
+
+    BP_Prefetcher *pf = meta->prefetcher;
+    int maxInFlight = bm->numPages / BM_PREFETCH_MAX_IN_FLIGHT_DIVISOR;
+    if (pf != NULL && pf->numInFlight >= maxInFlight) {
+        // leave enough frames for the pins the prefetches are meant to help
+        return RC_OK;
+    }
 
-    // Repopulate from linked list
-    BM_LinkedList *descriptors = meta->pageDescriptors;
-    BM_LinkedListElement *el = descriptors->sentinel->next;
+    BM_LinkedListElement *el = NULL;
+    if (pageNum < 0
+        || pageNum >= storage->totalNumPages
+        || maxInFlight == 0
+        || resolveByPageNum(bm, pageNum, &el)) {
+        return RC_OK;
+    }
 
-    bool *dirtyFlags = stats->lastDirtyFlags;
-    memset(dirtyFlags, 0, sizeof(bool) * bm->numPages);
+    bool isInPlace = false;
+    el = acquireFrame(bm, strategy, &isInPlace);
+    if (el == NULL) {
+        // every frame is pinned, not worth waiting for one
+        return RC_OK;
+    }
 
-    bool endFlag = false;
-    for (uint32_t i = 0; i < bm->numPages; ++i) {
-        if (!endFlag && el == descriptors->sentinel) {
-            // Mark flag for when we pass the end of actually used pages
-            endFlag = true;
-        }
+    if (pf == NULL) {
+        pf = startPrefetcher(bm);
+    }
 
-        if (!endFlag) {
-            BP_PageDescriptor *pd = BM_DEREF_ELEMENT(el);
-            dirtyFlags[i] = pd->dirty;
-            el = el->next;
+    // the frame holds an internal pin until the read has been reaped so that
+    // it can be neither evicted nor recycled while the worker writes to it
+    meta->inUse += 1;
+    BP_PageDescriptor *pd = BM_DEREF_ELEMENT(el);
+    beginFrameLoad(pd);
+    pd->handle.pageNum = pageNum;
+    pd->fixCount = 1;
+    pd->dirty = false;
+    pd->ringOwned = false;
+    pd->ioPending = true;
+    pd->prefetched = true;
+    pd->resident = false;
+    pd->changed = false;
+    pd->recLSN = BM_NO_LSN;
+
+    HashMap_put(meta->pageMapping, pageNum, el);
+    if (!isInPlace) {
+        meta->strategyHandler->insert(bm, el);
+    }
+    if (strategy != NULL) {
+        adoptRingFrame(strategy, el, pageNum);
+    }
 
-        } else {
-            // Fill the rest of the buffer with `false` by default
-            dirtyFlags[i] = false;
-        }
+    // the worker reads through the descriptor, so anything still sitting in
+    // the stream buffer from `writeBlock` has to reach the file first. Most
+    // prefetches find the buffer empty and skip the call.
+    FILE *file = storage->mgmtInfo;
+    if (__fpending(file) > 0) {
+        fflush(file);
+    }
+
+    pthread_mutex_lock(&pf->lock);
+    int slot = (pf->queueHead + pf->queueLen) % pf->capacity;
+    pf->queue[slot] = el->index;
+    pf->queueLen += 1;
+    pf->isDone[el->index] = false;
+    pf->pageNums[el->index] = pageNum;
+    pf->buffers[el->index] = pd->handle.buffer;
+    pthread_cond_signal(&pf->requested);
+    pthread_mutex_unlock(&pf->lock);
+
+    pf->numInFlight += 1;
+    syncFrameMirror(meta, el);
+    BM_STAT_ADD(meta, BM_STAT_PREFETCH_ISSUED, 1);
+    BM_STAT_ADD(meta, BM_STAT_READS, 1);
+    return RC_OK;
+}
+
+// Buffer Manager Interface Access Strategies
+BM_AccessStrategy *createRingStrategy (BM_BufferPool *const bm, int ringSize) {
+    PANIC_IF_NULL(bm);
+
+    // never let a ring take over a meaningful share of the pool
+    int maxRingSize = bm->numPages / 4;
+    if (ringSize > maxRingSize) {
+        ringSize = maxRingSize;
+    }
+    if (ringSize < 1) {
+        ringSize = 1;
     }
 
-    return dirtyFlags;
+    BM_AccessStrategy *strategy = malloc(sizeof(BM_AccessStrategy));
+    strategy->ringSize = ringSize;
+    strategy->current = 0;
+    strategy->ring = calloc(ringSize, sizeof(BM_LinkedListElement *));
+    strategy->ringPageNums = malloc(ringSize * sizeof(PageNumber));
+    for (int i = 0; i < ringSize; i++) {
+        strategy->ringPageNums[i] = NO_PAGE;
+    }
+    return strategy;
+}
+
+void freeAccessStrategy (BM_AccessStrategy *strategy) {
+    if (strategy == NULL) {
+        return;
+    }
+
+    free(strategy->ring);
+    free(strategy->ringPageNums);
+    free(strategy);
+}
+
+// Statistics Interface
+PageNumber *getFrameContents (BM_BufferPool *const bm) {
+    BP_Metadata *meta = bm->mgmtData;
+    return meta->stats->lastFrameContents;
+}
+
+bool *getDirtyFlags (BM_BufferPool *const bm){
+    BP_Metadata *meta = bm->mgmtData;
+    return meta->stats->lastDirtyFlags;
 }
 
 int *getFixCounts (BM_BufferPool *const bm){
     BP_Metadata *meta = bm->mgmtData;
-    BP_Statistics *stats = meta->stats;
+    return meta->stats->lastFixCounts;
+}
+
+int getNumReadIO (BM_BufferPool *const bm){
+    BM_PoolStats stats;
+    collectPoolStats(bm->mgmtData, &stats);
+    return (int) stats.counters[BM_STAT_READS];
+}
+
+int getNumWriteIO (BM_BufferPool *const bm){
+    BM_PoolStats stats;
+    collectPoolStats(bm->mgmtData, &stats);
+    return (int) stats.counters[BM_STAT_WRITES];
+}
+
+int getNumPrefetchHits (BM_BufferPool *const bm){
+    BM_PoolStats stats;
+    collectPoolStats(bm->mgmtData, &stats);
+    return (int) stats.counters[BM_STAT_PREFETCH_HITS];
+}
 
-    // Repopulate from linked list
-    BM_LinkedList *descriptors = meta->pageDescriptors;
-    BM_LinkedListElement *el = descriptors->sentinel->next;
+int getNumPrefetchLate (BM_BufferPool *const bm){
+    BM_PoolStats stats;
+    collectPoolStats(bm->mgmtData, &stats);
+    return (int) stats.counters[BM_STAT_PREFETCH_LATE];
+}
+
+int getNumPrefetchWasted (BM_BufferPool *const bm){
+    BM_PoolStats stats;
+    collectPoolStats(bm->mgmtData, &stats);
+    return (int) stats.counters[BM_STAT_PREFETCH_WASTED];
+}
 
-    int *fixCounts = stats->lastFixCounts;
-    memset(fixCounts, 0, sizeof(int) * bm->numPages);
+/**
+ * Takes a consistent snapshot of the counters of a pool.
+ *
+ * Counters only ever grow, so two identical passes over the shards mean that
+ * nothing was counted in between and the snapshot matches the state of the
+ * pool at that point. If pins keep racing with the collection, the last pass
+ * is returned after a few attempts, in which case each counter is still exact
+ * but they may be off from each other by the pins in flight.
+ */
+void getPoolStats (BM_BufferPool *const bm, BM_PoolStats *stats_out) {
+    PANIC_IF_NULL(bm);
+    PANIC_IF_NULL(stats_out);
 
-    bool endFlag = false;
-    for (uint32_t i = 0; i < bm->numPages; ++i) {
-        if (!endFlag && el == descriptors->sentinel) {
-            // Mark flag for when we pass the end of actually used pages
-            endFlag = true;
+    BP_Metadata *meta = bm->mgmtData;
+    BM_PoolStats previous;
+    collectPoolStats(meta, stats_out);
+    for (int attempt = 1; attempt < BM_STAT_SNAPSHOT_MAX_ATTEMPTS; attempt++) {
+        previous = *stats_out;
+        collectPoolStats(meta, stats_out);
+        if (memcmp(&previous, stats_out, sizeof(previous)) == 0) {
+            break;
         }
+    }
+}
 
-        if (!endFlag) {
-            BP_PageDescriptor *pd = BM_DEREF_ELEMENT(el);
-            fixCounts[i] = pd->fixCount;
-            el = el->next;
+/**
+ * Reports how much of the frame arena is actually backed by transparent huge
+ * pages, by looking up the arena mapping in `/proc/self/smaps`.
+ *
+ * @return the number of bytes backed by huge pages, or 0 if the arena is not
+ *      mapped, the kernel did not grant any huge pages, or the information is
+ *      unavailable.
+ */
+size_t getArenaHugePageBytes (BM_BufferPool *const bm) {
+    BP_Metadata *meta = bm->mgmtData;
+    if (!meta->pageBufferIsMapped) {
+        return 0;
+    }
+
+    FILE *smaps = fopen("/proc/self/smaps", "r");
+    if (smaps == NULL) {
+        return 0;
+    }
 
-        } else {
-            // Fill the rest of the buffer with 0 for unused pages
-            fixCounts[i] = 0;
+    uintptr_t arenaBegin = (uintptr_t) meta->pageBuffer;
+    uintptr_t arenaEnd = arenaBegin + meta->pageBufferSize;
+    size_t hugeBytes = 0;
+    bool inArena = false;
+    char line[256];
+    while (fgets(line, sizeof(line), smaps) != NULL) {
+        uintptr_t begin, end;
+        size_t kb;
+        if (sscanf(line, "%" SCNxPTR "-%" SCNxPTR " ", &begin, &end) == 2) {
+            // the arena may be split over multiple VMAs by the kernel
+            inArena = begin < arenaEnd && end > arenaBegin;
+        }
+        else if (inArena && sscanf(line, "AnonHugePages: %zu kB", &kb) == 1) {
+            hugeBytes += kb * 1024;
         }
     }
 
-    return fixCounts;
+    fclose(smaps);
+    return hugeBytes;
 }
 
-int getNumReadIO (BM_BufferPool *const bm){
-    BP_Metadata *meta = bm->mgmtData;
-    BP_Statistics *stats = meta->stats;
-    return stats->diskReads;
+
+/*		HELPER FUNCTIONS		*/
+
+// Shard of the statistics owned by the calling thread. Threads are spread
+// over the shards round robin the first time they touch any pool.
+static _Thread_local int tlsStatShard = -1;
+static int nextStatShard = 0;
+
+static BP_StatShard *statShard(BP_Metadata *meta) {
+    if (tlsStatShard < 0) {
+        tlsStatShard = __atomic_fetch_add(&nextStatShard, 1, __ATOMIC_RELAXED)
+                % BM_STAT_NUM_SHARDS;
+    }
+    return &meta->stats->shards[tlsStatShard];
 }
 
-int getNumWriteIO (BM_BufferPool *const bm){
-    BP_Metadata *meta = bm->mgmtData;
+static void collectPoolStats(BP_Metadata *meta, BM_PoolStats *stats_out) {
+    memset(stats_out, 0, sizeof(*stats_out));
+    for (int i = 0; i < BM_STAT_NUM_SHARDS; i++) {
+        BP_StatShard *shard = &meta->stats->shards[i];
+        for (int c = 0; c < BM_STAT_COUNTER_COUNT; c++) {
+            stats_out->counters[c] +=
+                    __atomic_load_n(&shard->counters[c], __ATOMIC_RELAXED);
+        }
+        for (int slot = 0; slot < BM_STAT_STRATEGY_SLOTS; slot++) {
+            for (int c = 0; c < BM_STRATEGY_STAT_COUNTER_COUNT; c++) {
+                stats_out->strategyCounters[slot][c] += __atomic_load_n(
+                        &shard->strategyCounters[slot][c], __ATOMIC_RELAXED);
+            }
+        }
+    }
+}
+
+static int statStrategySlot(BM_BufferPool *bm, BM_AccessStrategy *strategy) {
+    return strategy != NULL ? BM_STAT_STRATEGY_RING : (int) bm->strategy;
+}
+
+static void recordPin(BP_Metadata *meta, PageNumber pageNum, BM_TraceFlags flags) {
+    BM_TraceRecorder *trace = meta->trace;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    BM_TraceRecord *record = &trace->buffer[trace->numBuffered++];
+    record->pageNum = pageNum;
+    record->flags = flags;
+    record->nanos = (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+
+    if (trace->numBuffered == BM_TRACE_BUFFER_RECORDS) {
+        flushTrace(trace);
+    }
+}
+
+static void flushTrace(BM_TraceRecorder *trace) {
+    // a trace is best-effort, a short write only truncates it
+    fwrite(trace->buffer, sizeof(BM_TraceRecord), trace->numBuffered, trace->file);
+    trace->numBuffered = 0;
+}
+
+// Orders frame elements by the page they hold, for `qsort`
+static int comparePageNums(const void *a, const void *b) {
+    PageNumber x = BM_DEREF_ELEMENT(*(BM_LinkedListElement * const *) a)->handle.pageNum;
+    PageNumber y = BM_DEREF_ELEMENT(*(BM_LinkedListElement * const *) b)->handle.pageNum;
+    return (x > y) - (x < y);
+}
+
+// Copies the state of a frame into the statistics mirrors. The pin that
+// keeps a page resident belongs to the pool, so it is left out of the count.
+static void syncFrameMirror(BP_Metadata *meta, BM_LinkedListElement *el) {
+    BP_PageDescriptor *pd = BM_DEREF_ELEMENT(el);
     BP_Statistics *stats = meta->stats;
-    return stats->diskWrites;
+    stats->lastFrameContents[el->index] = pd->handle.pageNum;
+    stats->lastDirtyFlags[el->index] = pd->dirty;
+    stats->lastFixCounts[el->index] = pd->resident ? pd->fixCount - 1 : pd->fixCount;
 }
 
+// Hands any change to the page since it was last logged to the log hooks
+static void logFrameChange(BP_Metadata *meta, BP_PageDescriptor *pd) {
+    if (meta->shadowBuffer == NULL) {
+        return;
+    }
+    char *shadow = meta->shadowBuffer + (size_t) pd->handle.frame * PAGE_SIZE;
+    if (memcmp(shadow, pd->handle.buffer, PAGE_SIZE) == 0) {
+        return;
+    }
+    bool isFirstChange = pd->recLSN == BM_NO_LSN;
+    uint64_t lsn = meta->logHooks.logChange(meta->logHooks.ctx, &pd->handle, shadow, isFirstChange);
+    if (isFirstChange) {
+        pd->recLSN = lsn;
+    }
+    // the hook may stamp the page, so copy afterwards
+    memcpy(shadow, pd->handle.buffer, PAGE_SIZE);
+}
+
+// Write-ahead rule: the log goes first
+static void beforeFrameWrite(BP_Metadata *meta, BP_PageDescriptor *pd) {
+    if (meta->shadowBuffer == NULL) {
+        return;
+    }
+    logFrameChange(meta, pd);
+    meta->logHooks.beforeWrite(meta->logHooks.ctx, &pd->handle);
+}
+
+// Takes a freshly loaded page as the base for the next change
+static void resetFrameShadow(BP_Metadata *meta, BP_PageDescriptor *pd) {
+    if (meta->shadowBuffer == NULL) {
+        return;
+    }
+    memcpy(meta->shadowBuffer + (size_t) pd->handle.frame * PAGE_SIZE, pd->handle.buffer, PAGE_SIZE);
+}
+
+// Frame versions count changes to a frame: the version is odd while a frame
+// is empty or being loaded, and moves on with every load and every published
+// write, so an optimistic reader on the pool's thread only has to compare the
+// version before and after. They are not a sequence lock, writers change a
+// pinned frame before publishing the write through markDirty or forcePage.
+static void beginFrameLoad(BP_PageDescriptor *pd) {
+    // handles to whatever the frame held before no longer resolve directly
+    pd->handle.generation += 1;
+    if ((pd->version & 1u) == 0) {
+        __atomic_add_fetch(&pd->version, 1, __ATOMIC_RELEASE);
+    }
+}
+
+static void endFrameLoad(BP_PageDescriptor *pd) {
+    __atomic_add_fetch(&pd->version, 1, __ATOMIC_RELEASE);
+}
+
+static void publishFrameWrite(BP_PageDescriptor *pd) {
+    __atomic_add_fetch(&pd->version, 2, __ATOMIC_RELEASE);
+}
+
+#define BM_HUGE_PAGE_SIZE (2u * 1024u * 1024u)
+
+static char *allocArena(BP_Metadata *meta, int numPages) {
+    size_t size = (size_t) numPages * PAGE_SIZE;
+    meta->pageBufferSize = size;
+    meta->pageBufferIsMapped = false;
+
+#ifdef MADV_HUGEPAGE
+    if (meta->options.hugePages && size >= BM_HUGE_PAGE_SIZE) {
+        // Over-allocate so that the arena can start on a huge page boundary,
+        // otherwise the kernel can only back the aligned interior of the range
+        size_t mapSize = size + BM_HUGE_PAGE_SIZE;
+        char *map = mmap(NULL, mapSize, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (map != MAP_FAILED) {
+            uintptr_t aligned = ((uintptr_t) map + (BM_HUGE_PAGE_SIZE - 1))
+                    & ~((uintptr_t) BM_HUGE_PAGE_SIZE - 1);
+            size_t head = aligned - (uintptr_t) map;
+            size_t tail = mapSize - head - size;
+            if (head > 0) { munmap(map, head); }
+            if (tail > 0) { munmap((char *) aligned + size, tail); }
+
+            // Advice is best-effort: THP may be disabled system-wide
+            madvise((void *) aligned, size, MADV_HUGEPAGE);
+            meta->pageBufferIsMapped = true;
+
+            char *arena = (char *) aligned;
+            if (meta->options.prefault) {
+                // Anonymous mappings are already zeroed, so touching a single
+                // byte per frame is enough to fault the arena in
+                for (size_t off = 0; off < size; off += PAGE_SIZE) {
+                    arena[off] = 0;
+                }
+            }
+
+            LOG_DEBUG("mapped %zu byte arena @ 0x%" PRIxPTR, size, aligned);
+            return arena;
+        }
+    }
+#endif
+
+    char *arena = calloc(numPages, PAGE_SIZE);
+    if (arena == NULL) {
+        PANIC("failed to allocate %zu byte frame arena", size);
+    }
+    if (meta->options.prefault) {
+        for (size_t off = 0; off < size; off += PAGE_SIZE) {
+            arena[off] = 0;
+        }
+    }
+    return arena;
+}
+
+static void freeArena(BP_Metadata *meta) {
+    if (meta->pageBuffer == NULL) {
+        return;
+    }
+
+    if (meta->pageBufferIsMapped) {
+        munmap(meta->pageBuffer, meta->pageBufferSize);
+    } else {
+        free(meta->pageBuffer);
+    }
+
+    meta->pageBuffer = NULL;
+    meta->pageBufferSize = 0;
+    meta->pageBufferIsMapped = false;
+}
 
-/*		HELPER FUNCTIONS		*/
 static BM_LinkedListElement *evict(BM_BufferPool *bm, BM_EvictMode mode) {
 	BP_Metadata *meta = bm->mgmtData;
     BM_LinkedListElement *el = meta->strategyHandler->elect(bm);
     if (el == NULL) {
         return NULL;
     }
+
+    BM_STAT_ADD(meta, BM_STAT_EVICTIONS, 1);
+    BM_STRATEGY_STAT_ADD(meta, bm->strategy, BM_STRATEGY_STAT_EVICTIONS, 1);
+    releaseFrame(bm, el);
+    if (mode == BM_EVICTMODE_FRESH) {
+        return el;
+    } else { // if (mode == BM_EVICTMODE_REMOVE) {
+        LinkedList_remove(meta->pageDescriptors, el);
+        return NULL;
+    }
+}
+
+// Writes back and detaches the page held by a frame, leaving it empty but
+// still linked into the page descriptor list
+static void releaseFrame(BM_BufferPool *bm, BM_LinkedListElement *el) {
+	BP_Metadata *meta = bm->mgmtData;
     BP_PageDescriptor *pd = BM_DEREF_ELEMENT(el);
     uint32_t pageNum = pd->handle.pageNum;
 
@@ -428,22 +1233,71 @@ static BM_LinkedListElement *evict(BM_BufferPool *bm, BM_EvictMode mode) {
 #endif
 
     if (pd->dirty) {
+        BM_STAT_ADD(meta, BM_STAT_DIRTY_EVICTIONS, 1);
         forcePage(bm, &pd->handle);
     }
+    if (pd->prefetched) {
+        BM_STAT_ADD(meta, BM_STAT_PREFETCH_WASTED, 1);
+    }
 
+    // invalidate optimistic readers before the frame changes identity
+    beginFrameLoad(pd);
     pd->dirty = false;
+    pd->recLSN = BM_NO_LSN;
     pd->fixCount = 0;
+    pd->ringOwned = false;
+    pd->prefetched = false;
     pd->handle.pageNum = -1;
     memset(pd->handle.buffer, 0, PAGE_SIZE);
     meta->inUse -= 1;
 
     HashMap_remove(meta->pageMapping, pageNum, NULL);
-    if (mode == BM_EVICTMODE_FRESH) {
-        return el;
-    } else { // if (mode == BM_EVICTMODE_REMOVE) {
-        LinkedList_remove(meta->pageDescriptors, el);
+    syncFrameMirror(meta, el);
+}
+
+// Picks the next ring frame to reuse for a scan miss. Returns NULL while the
+// ring is still growing, or if the frame has been pinned or promoted by
+// someone else since the ring loaded it, in which case the ring gives it up to
+// the pool and a frame is taken through the regular path instead.
+static BM_LinkedListElement *recycleRingFrame(
+        BM_BufferPool *bm,
+        BM_AccessStrategy *strategy)
+{
+    int slot = strategy->current;
+    BM_LinkedListElement *el = strategy->ring[slot];
+    if (el == NULL) {
+        return NULL;
+    }
+
+    BP_PageDescriptor *pd = BM_DEREF_ELEMENT(el);
+    bool isStillOwned = pd->ringOwned
+            && pd->fixCount == 0
+            && pd->handle.pageNum == strategy->ringPageNums[slot];
+    if (!isStillOwned) {
+        strategy->ring[slot] = NULL;
+        strategy->ringPageNums[slot] = NO_PAGE;
         return NULL;
     }
+
+    BP_Metadata *meta = bm->mgmtData;
+    BM_STAT_ADD(meta, BM_STAT_EVICTIONS, 1);
+    BM_STRATEGY_STAT_ADD(meta, BM_STAT_STRATEGY_RING, BM_STRATEGY_STAT_EVICTIONS, 1);
+    releaseFrame(bm, el);
+    return el;
+}
+
+static void adoptRingFrame(
+        BM_AccessStrategy *strategy,
+        BM_LinkedListElement *el,
+        PageNumber pageNum)
+{
+    int slot = strategy->current;
+    strategy->ring[slot] = el;
+    strategy->ringPageNums[slot] = pageNum;
+    strategy->current = (slot + 1) % strategy->ringSize;
+
+    BP_PageDescriptor *pd = BM_DEREF_ELEMENT(el);
+    pd->ringOwned = true;
 }
 
 static bool resolveByHandle(
@@ -455,6 +1309,22 @@ static bool resolveByHandle(
         return false;
     }
 
+    // Handles filled in by `pinPage` know their frame, so the lookup is only
+    // needed for handles built by hand or that outlived their frame's load
+    BP_Metadata *meta = bm->mgmtData;
+    if (handle->frame >= 0 && handle->frame < bm->numPages) {
+        BM_LinkedListElement *el = &meta->pageDescriptors->elementsMetaBuffer[handle->frame];
+        BP_PageDescriptor *pd = BM_DEREF_ELEMENT(el);
+        if (pd->handle.generation == handle->generation
+            && pd->handle.pageNum == handle->pageNum
+            && handle->generation != 0) {
+            if (el_out) {
+                *el_out = el;
+            }
+            return true;
+        }
+    }
+
     return resolveByPageNum(bm, handle->pageNum, el_out);
 }
 
@@ -482,4 +1352,292 @@ static bool resolveByPageNum(
         *el_out = el;
     }
     return true;
-}
\ No newline at end of file
+}
+
+// Pins a page for `pinPageWithStrategy`, or for the pool itself if
+// `isInternal` is set. Internal pins are left out of the pin statistics and
+// the trace, and do not hold up shutdown; the reads they cause still count.
+static BM_LinkedListElement *fixFrame(
+        BM_BufferPool *bm,
+        const PageNumber pageNum,
+        BM_AccessStrategy *strategy,
+        bool isInternal)
+{
+	BP_Metadata *meta = bm->mgmtData;
+	SM_FileHandle *storage = meta->fileHandle;
+
+	// check if page number exists
+    BM_LinkedListElement *el;
+    BP_PageDescriptor *pd;
+    bool isRingLoad = false;
+    bool isHit = false;
+    int strategySlot = statStrategySlot(bm, strategy);
+    reapPrefetches(bm);
+    if (resolveByPageNum(bm, pageNum, &el)) {
+        pd = BM_DEREF_ELEMENT(el);
+        bool isLate = pd->ioPending;
+        if (isLate) {
+            // asked for too late, the read is still in flight
+            waitForPrefetch(bm, el);
+        }
+        if (!isInternal) {
+            if (isLate) {
+                BM_STAT_ADD(meta, BM_STAT_PREFETCH_LATE, 1);
+                BM_STAT_ADD(meta, BM_STAT_PIN_WAITS, 1);
+            } else if (pd->prefetched) {
+                BM_STAT_ADD(meta, BM_STAT_PREFETCH_HITS, 1);
+            }
+            BM_STAT_ADD(meta, BM_STAT_HITS, 1);
+            BM_STRATEGY_STAT_ADD(meta, strategySlot, BM_STRATEGY_STAT_HITS, 1);
+        }
+        isHit = true;
+        pd->prefetched = false;
+        pd->fixCount += 1;
+        if (strategy == NULL) {
+            // a regular access promotes the page out of any scan ring
+            pd->ringOwned = false;
+        }
+
+    } else {
+        bool isInPlace = false;
+        el = acquireFrame(bm, strategy, &isInPlace);
+        while (el == NULL && waitForPrefetch(bm, NULL)) {
+            // the only unpinned frames were being prefetched into
+            if (!isInternal) {
+                BM_STAT_ADD(meta, BM_STAT_PIN_WAITS, 1);
+            }
+            el = acquireFrame(bm, strategy, &isInPlace);
+        }
+	    if (el == NULL) {
+	        fprintf(stderr, "pinPage: failed to pin page, evicted but list was full");
+	        exit(1);
+	    }
+        meta->inUse += 1;
+        pd = BM_DEREF_ELEMENT(el);
+        beginFrameLoad(pd);
+        pd->handle.pageNum = pageNum;
+        pd->fixCount = 1;
+        pd->dirty = false;
+        pd->ringOwned = false;
+        pd->ioPending = false;
+        pd->prefetched = false;
+        pd->resident = false;
+        pd->changed = false;
+        pd->recLSN = BM_NO_LSN;
+
+        // update page number to element mapping
+        HashMap_put(meta->pageMapping, pageNum, el);
+        if (!isInPlace) {
+            // Only insert if the buffer was not full, and we're *not*
+            // doing an insert in place
+            meta->strategyHandler->insert(bm, el);
+        }
+
+        if (readBlock(pageNum, storage, pd->handle.buffer) != RC_OK) {
+            // page was allocated but never written back
+            memset(pd->handle.buffer, 0, PAGE_SIZE);
+        }
+        resetFrameShadow(meta, pd);
+        BM_STAT_ADD(meta, BM_STAT_READS, 1);
+        if (!isInternal) {
+            BM_STAT_ADD(meta, BM_STAT_MISSES, 1);
+            BM_STRATEGY_STAT_ADD(meta, strategySlot, BM_STRATEGY_STAT_MISSES, 1);
+        }
+        endFrameLoad(pd);
+
+        if (strategy != NULL) {
+            adoptRingFrame(strategy, el, pageNum);
+            isRingLoad = true;
+        }
+    }
+
+	// fetch page from memory
+    if (!isInternal) {
+        meta->refCounter += 1; //increment buf mgr ref counter for thread use
+    }
+    if (!isRingLoad && !pd->ringOwned) {
+        meta->strategyHandler->use(bm, el);
+    }
+    syncFrameMirror(meta, el);
+
+    if (meta->trace != NULL && !isInternal) {
+        recordPin(meta, pageNum,
+                (isHit ? BM_TRACE_FLAGS_HIT : 0)
+                | (strategy != NULL ? BM_TRACE_FLAGS_RING : 0));
+    }
+
+    return el;
+}
+
+// Takes a free frame for a page that is about to be loaded: one of the
+// strategy's ring frames if possible, otherwise a replacement victim once the
+// pool is full, otherwise a fresh frame. `isInPlace_out` tells whether the
+// frame was already linked into the replacement strategy.
+static BM_LinkedListElement *acquireFrame(
+        BM_BufferPool *bm,
+        BM_AccessStrategy *strategy,
+        bool *isInPlace_out)
+{
+	BP_Metadata *meta = bm->mgmtData;
+    BM_LinkedListElement *el;
+    if (strategy != NULL
+        && (el = recycleRingFrame(bm, strategy)) != NULL) {
+        // reuse the scan's own frame, leaving the rest of the pool alone
+        *isInPlace_out = true;
+    } else if (meta->inUse == bm->numPages) {
+        // evict if buffer full
+        // use `BM_EVICTMODE_FRESH` so that that links between the element
+        // are not altered (we want to do an in-place update)
+        el = evict(bm, BM_EVICTMODE_FRESH);
+        *isInPlace_out = true;
+    } else {
+        // find empty space in memory pool
+        el = LinkedList_fresh(meta->pageDescriptors);
+        *isInPlace_out = false;
+    }
+    return el;
+}
+
+static BP_Prefetcher *startPrefetcher(BM_BufferPool *bm) {
+	BP_Metadata *meta = bm->mgmtData;
+    int numPages = bm->numPages;
+
+    BP_Prefetcher *pf = malloc(sizeof(BP_Prefetcher));
+    pf->fd = fileno((FILE *) meta->fileHandle->mgmtInfo);
+    pf->capacity = numPages;
+    pf->queue = malloc(numPages * sizeof(int));
+    pf->queueHead = 0;
+    pf->queueLen = 0;
+    pf->done = malloc(numPages * sizeof(int));
+    pf->doneLen = 0;
+    pf->isDone = calloc(numPages, sizeof(bool));
+    pf->pageNums = malloc(numPages * sizeof(PageNumber));
+    pf->buffers = calloc(numPages, sizeof(char *));
+    pf->numInFlight = 0;
+    pf->stop = false;
+
+    pthread_mutex_init(&pf->lock, NULL);
+    pthread_cond_init(&pf->requested, NULL);
+    pthread_cond_init(&pf->completed, NULL);
+    if (pthread_create(&pf->worker, NULL, prefetchWorker, pf) != 0) {
+        PANIC("failed to start prefetch worker");
+    }
+
+    meta->prefetcher = pf;
+    return pf;
+}
+
+// Drains the queue, joins the worker and reaps every outstanding read
+static void stopPrefetcher(BM_BufferPool *bm) {
+	BP_Metadata *meta = bm->mgmtData;
+    BP_Prefetcher *pf = meta->prefetcher;
+    if (pf == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&pf->lock);
+    pf->stop = true;
+    pthread_cond_signal(&pf->requested);
+    pthread_mutex_unlock(&pf->lock);
+    pthread_join(pf->worker, NULL);
+    reapPrefetches(bm);
+
+    pthread_cond_destroy(&pf->completed);
+    pthread_cond_destroy(&pf->requested);
+    pthread_mutex_destroy(&pf->lock);
+    free(pf->queue);
+    free(pf->done);
+    free(pf->isDone);
+    free(pf->pageNums);
+    free(pf->buffers);
+    free(pf);
+    meta->prefetcher = NULL;
+}
+
+static void *prefetchWorker(void *arg) {
+    BP_Prefetcher *pf = arg;
+
+    pthread_mutex_lock(&pf->lock);
+    while (true) {
+        while (pf->queueLen == 0 && !pf->stop) {
+            pthread_cond_wait(&pf->requested, &pf->lock);
+        }
+        if (pf->queueLen == 0) {
+            // only stop once everything queued has been read
+            break;
+        }
+
+        int index = pf->queue[pf->queueHead];
+        PageNumber pageNum = pf->pageNums[index];
+        char *buffer = pf->buffers[index];
+        pf->queueLen -= 1;
+        pf->queueHead = (pf->queueHead + 1) % pf->capacity;
+        pthread_mutex_unlock(&pf->lock);
+
+        off_t offset = (off_t) pageNum * PAGE_SIZE;
+        size_t n = 0;
+        while (n < PAGE_SIZE) {
+            ssize_t r = pread(pf->fd, buffer + n, PAGE_SIZE - n, offset + n);
+            if (r <= 0) {
+                break;
+            }
+            n += r;
+        }
+        if (n < PAGE_SIZE) {
+            // same as `readBlock`, anything past the end of the file is zero
+            memset(buffer + n, 0, PAGE_SIZE - n);
+        }
+
+        pthread_mutex_lock(&pf->lock);
+        pf->isDone[index] = true;
+        pf->done[pf->doneLen++] = index;
+        pthread_cond_broadcast(&pf->completed);
+    }
+    pthread_mutex_unlock(&pf->lock);
+    return NULL;
+}
+
+// Drops the internal pin of every frame whose read has completed
+static void reapPrefetches(BM_BufferPool *bm) {
+	BP_Metadata *meta = bm->mgmtData;
+    BP_Prefetcher *pf = meta->prefetcher;
+    if (pf == NULL || pf->numInFlight == 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&pf->lock);
+    for (int i = 0; i < pf->doneLen; i++) {
+        int index = pf->done[i];
+        BM_LinkedListElement *el = &meta->pageDescriptors->elementsMetaBuffer[index];
+        BP_PageDescriptor *pd = BM_DEREF_ELEMENT(el);
+        pd->ioPending = false;
+        pd->fixCount -= 1;
+        resetFrameShadow(meta, pd);
+        endFrameLoad(pd);
+        syncFrameMirror(meta, el);
+        pf->isDone[index] = false;
+        pf->numInFlight -= 1;
+    }
+    pf->doneLen = 0;
+    pthread_mutex_unlock(&pf->lock);
+}
+
+// Blocks until the read into `el` has completed, or until any read has
+// completed if `el` is NULL, and reaps it.
+//
+// @return false if there was nothing in flight to wait for
+static bool waitForPrefetch(BM_BufferPool *bm, BM_LinkedListElement *el) {
+	BP_Metadata *meta = bm->mgmtData;
+    BP_Prefetcher *pf = meta->prefetcher;
+    if (pf == NULL || pf->numInFlight == 0) {
+        return false;
+    }
+
+    pthread_mutex_lock(&pf->lock);
+    while (el != NULL ? !pf->isDone[el->index] : pf->doneLen == 0) {
+        pthread_cond_wait(&pf->completed, &pf->lock);
+    }
+    pthread_mutex_unlock(&pf->lock);
+    reapPrefetches(bm);
+    return true;
+}
@@ -44,21 +44,123 @@ typedef struct BM_BufferPool {
 typedef struct BM_PageHandle {
 	PageNumber pageNum;
 	char *buffer;
+	int frame;            // frame the page was pinned in, set by `pinPage`
+	uint32_t generation;  // load of that frame the handle refers to
 } BM_PageHandle;
 
 typedef struct BP_PageDescriptor {
     BM_PageHandle handle;
     int fixCount;
     bool dirty;
+    bool ringOwned; // loaded by a ring access strategy and not used since
+    bool ioPending; // prefetch read in flight, frame holds an internal pin
+    bool prefetched; // loaded by a prefetch and not pinned since
+    bool resident;   // kept by `markPageResident`, holds an internal pin
+    bool changed;    // marked dirty since it was last unpinned
+    uint64_t recLSN; // log position of the first change since it was last clean
+    uint32_t version; // odd while the frame is being (re)loaded, bumped on writes
     int age;
 } BP_PageDescriptor;
 
+// Scan-scoped buffer access strategy.
+//
+// A bulk sequential scan recycles a small private ring of frames rather than
+// competing for frames through the pool's replacement strategy, so that a
+// single large scan cannot flush the working set of every other client.
+typedef struct BM_AccessStrategy {
+    int ringSize;
+    int current;                    // ring slot that will be recycled next
+    struct BM_LinkedListElement **ring;  // frames owned by the ring
+    PageNumber *ringPageNums;       // page each ring frame was loaded with
+} BM_AccessStrategy;
+
 #define BM_DEREF_ELEMENT(_EL) ((BP_PageDescriptor *) (_EL)->data)
 
+// Options controlling how the frame arena backing the pool is allocated
+typedef struct BM_PoolOptions {
+    bool hugePages;  // back arenas of at least 2 MiB with `mmap` + `MADV_HUGEPAGE` (linux), off by default
+    bool prefault;   // touch every frame at init so the arena is resident
+    const char *traceFileName;  // record every pin to this file, if not NULL
+    int residentBudget;  // max pages kept by `markPageResident`
+} BM_PoolOptions;
+
+// Resident budget used unless the options give one: an eighth of the pool
+#define BM_RESIDENT_BUDGET_DEFAULT (-1)
+#define BM_RESIDENT_BUDGET_DEFAULT_DIVISOR (8)
+
+#define BM_POOL_OPTIONS_DEFAULT ((BM_PoolOptions) { .hugePages = FALSE, .prefault = FALSE, .traceFileName = NULL, .residentBudget = BM_RESIDENT_BUDGET_DEFAULT })
+
+// Write-ahead logging hooks, see `setPoolLogHooks`
+typedef struct BM_LogHooks {
+    // `page` differs from `before`, its contents when it was last loaded or
+    // logged; the change has to be logged before this returns. Returns the
+    // position in the log redo of the change would have to start from.
+    // `isFirstChange` is set when the page was clean, and its copy in the
+    // page file may be torn by the write back that follows.
+    uint64_t (*logChange)(void *ctx, BM_PageHandle *page, const char *before, bool isFirstChange);
+    // `page` is about to be written back; every change logged for it has to
+    // be durable before this returns
+    void (*beforeWrite)(void *ctx, const BM_PageHandle *page);
+    void *ctx;
+} BM_LogHooks;
+
+// `recLSN` of a page without logged changes
+#define BM_NO_LSN (UINT64_MAX)
+
+// Entry of the dirty page table, see `getDirtyPageTable`
+typedef struct BM_DirtyPage {
+    PageNumber pageNum;
+    uint64_t recLSN;
+} BM_DirtyPage;
+
+// Pool-wide event counters
+typedef enum BM_StatCounter {
+    BM_STAT_HITS = 0,           // pins that found the page resident
+    BM_STAT_MISSES,             // pins that had to read the page
+    BM_STAT_EVICTIONS,          // pages dropped to make room
+    BM_STAT_DIRTY_EVICTIONS,    // ... of which had to be written back first
+    BM_STAT_PIN_WAITS,          // pins that blocked on a read in flight
+    BM_STAT_READS,              // pages read from disk
+    BM_STAT_WRITES,             // pages written to disk
+    BM_STAT_PREFETCH_ISSUED,    // reads queued by `prefetchPage`
+    BM_STAT_PREFETCH_HITS,      // pins that found a completed prefetch
+    BM_STAT_PREFETCH_LATE,      // pins that had to wait for a prefetch in flight
+    BM_STAT_PREFETCH_WASTED,    // prefetched pages evicted before ever being pinned
+    BM_STAT_COUNTER_COUNT
+} BM_StatCounter;
+
+// Counters broken down by whoever chose the frame: the pool's replacement
+// strategy (indexed by `ReplacementStrategy`) or a scan ring
+typedef enum BM_StrategyStatCounter {
+    BM_STRATEGY_STAT_HITS = 0,
+    BM_STRATEGY_STAT_MISSES,
+    BM_STRATEGY_STAT_EVICTIONS,
+    BM_STRATEGY_STAT_COUNTER_COUNT
+} BM_StrategyStatCounter;
+
+#define BM_STAT_STRATEGY_RING (BM_REPLACEMENT_STRAT_COUNT)
+#define BM_STAT_STRATEGY_SLOTS (BM_REPLACEMENT_STRAT_COUNT + 1)
+
+// Counters are sharded by thread so that concurrent pins do not contend on
+// the same cache lines; a shard is only ever updated with relaxed atomics
+#define BM_STAT_NUM_SHARDS (16)
+
+typedef struct BP_StatShard {
+    uint64_t counters[BM_STAT_COUNTER_COUNT];
+    uint64_t strategyCounters[BM_STAT_STRATEGY_SLOTS][BM_STRATEGY_STAT_COUNTER_COUNT];
+} __attribute__((aligned(64))) BP_StatShard;
+
+// Point in time copy of the counters of a pool, see `getPoolStats`
+typedef struct BM_PoolStats {
+    uint64_t counters[BM_STAT_COUNTER_COUNT];
+    uint64_t strategyCounters[BM_STAT_STRATEGY_SLOTS][BM_STRATEGY_STAT_COUNTER_COUNT];
+} BM_PoolStats;
+
 typedef struct BP_Statistics {
-    int diskReads;
-    int diskWrites;
+    BP_StatShard *shards;
 
+    // mirrors of the frame table, kept up to date on every state change so
+    // that the statistics interface never has to walk the descriptors
     PageNumber *lastFrameContents;
     bool *lastDirtyFlags;
     int *lastFixCounts;
@@ -72,9 +174,18 @@ typedef struct BP_Metadata
     HS_HashMap *pageMapping;  // hash map of page number to page handles
     struct RS_StrategyHandler *strategyHandler;  // use forward declaration
     char *pageBuffer;         // contiguous memory pool for blocks
+    size_t pageBufferSize;    // size of the arena mapping in bytes
+    bool pageBufferIsMapped;  // arena was allocated with `mmap` (not `calloc`)
+    BM_PoolOptions options;
     uint32_t clock;			  // current clock timestamp
     int refCounter;			  // no. threads accessing PAGE DIR (increment before accessing)
     int inUse;
+    int residentBudget;       // max frames held by `markPageResident`
+    int numResident;          // frames currently held by `markPageResident`
+    struct BP_Prefetcher *prefetcher;  // started on the first prefetch
+    struct BM_TraceRecorder *trace;    // set while pins are being traced
+    BM_LogHooks logHooks;
+    char *shadowBuffer;       // per frame, contents as last logged; NULL without hooks
     BP_Statistics *stats;
     void *strategyMetadata;
 } BP_Metadata;
@@ -90,15 +201,50 @@ typedef struct BP_Metadata
 RC initBufferPool(BM_BufferPool *const bm, const char *const pageFileName, 
 		const int numPages, ReplacementStrategy strategy,
 		void *stratData);
+RC initBufferPoolWithOptions(BM_BufferPool *const bm, const char *const pageFileName,
+		const int numPages, ReplacementStrategy strategy,
+		void *stratData, const BM_PoolOptions *options);
 RC shutdownBufferPool(BM_BufferPool *const bm);
 RC forceFlushPool(BM_BufferPool *const bm);
 RC forceShutdownBufferPool(BM_BufferPool *const bm);
+RC syncBufferPool(BM_BufferPool *const bm);
+RC setPoolLogHooks(BM_BufferPool *const bm, const BM_LogHooks *hooks);
+int getDirtyPageTable(BM_BufferPool *const bm, BM_DirtyPage *pages_out);
+RC flushDirtyPages(BM_BufferPool *const bm, const PageNumber *pageNums, int n,
+		uint64_t maxRecLSN);
 // Buffer Manager Interface Access Pages
 RC markDirty (BM_BufferPool *const bm, BM_PageHandle *const page);
 RC unpinPage (BM_BufferPool *const bm, BM_PageHandle *const page);
 RC forcePage (BM_BufferPool *const bm, BM_PageHandle *const page);
 RC pinPage (BM_BufferPool *const bm, BM_PageHandle *const page, 
 		const PageNumber pageNum);
+RC pinPageWithStrategy (BM_BufferPool *const bm, BM_PageHandle *const page,
+		const PageNumber pageNum, BM_AccessStrategy *strategy);
+
+// Buffer Manager Interface Resident Pages
+RC markPageResident (BM_BufferPool *const bm, const PageNumber pageNum);
+RC unmarkPageResident (BM_BufferPool *const bm, const PageNumber pageNum);
+int getNumResidentPages (BM_BufferPool *const bm);
+
+// Buffer Manager Interface Tracing
+RC startPoolTrace (BM_BufferPool *const bm, const char *traceFileName);
+RC stopPoolTrace (BM_BufferPool *const bm);
+
+// Buffer Manager Interface Optimistic Reads
+RC beginOptimisticRead (BM_BufferPool *const bm, BM_PageHandle *const page,
+		const PageNumber pageNum, uint32_t *version_out);
+bool validateOptimisticRead (BM_BufferPool *const bm,
+		const BM_PageHandle *const page, uint32_t version);
+
+// Buffer Manager Interface Prefetching
+RC prefetchPage (BM_BufferPool *const bm, const PageNumber pageNum);
+RC prefetchPages (BM_BufferPool *const bm, const PageNumber *pageNums, int n);
+RC prefetchPageWithStrategy (BM_BufferPool *const bm, const PageNumber pageNum,
+		BM_AccessStrategy *strategy);
+
+// Buffer Manager Interface Access Strategies
+BM_AccessStrategy *createRingStrategy (BM_BufferPool *const bm, int ringSize);
+void freeAccessStrategy (BM_AccessStrategy *strategy);
 
 // Statistics Interface
 PageNumber *getFrameContents (BM_BufferPool *const bm);
@@ -106,5 +252,10 @@ bool *getDirtyFlags (BM_BufferPool *const bm);
 int *getFixCounts (BM_BufferPool *const bm);
 int getNumReadIO (BM_BufferPool *const bm);
 int getNumWriteIO (BM_BufferPool *const bm);
+int getNumPrefetchHits (BM_BufferPool *const bm);
+int getNumPrefetchLate (BM_BufferPool *const bm);
+int getNumPrefetchWasted (BM_BufferPool *const bm);
+void getPoolStats (BM_BufferPool *const bm, BM_PoolStats *stats_out);
+size_t getArenaHugePageBytes (BM_BufferPool *const bm);
 
 #endif
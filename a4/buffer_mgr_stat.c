@@ -7,6 +7,20 @@
 // local functions
 static void printStrat (BM_BufferPool *const bm);
 
+static const char *statCounterNames[BM_STAT_COUNTER_COUNT] = {
+	[BM_STAT_HITS] = "hits",
+	[BM_STAT_MISSES] = "misses",
+	[BM_STAT_EVICTIONS] = "evictions",
+	[BM_STAT_DIRTY_EVICTIONS] = "dirty_evictions",
+	[BM_STAT_PIN_WAITS] = "pin_waits",
+	[BM_STAT_READS] = "reads",
+	[BM_STAT_WRITES] = "writes",
+	[BM_STAT_PREFETCH_ISSUED] = "prefetch_issued",
+	[BM_STAT_PREFETCH_HITS] = "prefetch_hits",
+	[BM_STAT_PREFETCH_LATE] = "prefetch_late",
+	[BM_STAT_PREFETCH_WASTED] = "prefetch_wasted",
+};
+
 // external functions
 void 
 printPoolContent (BM_BufferPool *const bm)
@@ -78,6 +92,74 @@ sprintPageContent (BM_PageHandle *const page)
 	return message;
 }
 
+void
+printPoolStats (BM_BufferPool *const bm)
+{
+	char *message = sprintPoolStats(bm);
+	printf("%s", message);
+	free(message);
+}
+
+// One line of `name=value` pairs for the whole pool, followed by one line per
+// strategy that served any pin; lines are meant to be easy to grep and parse
+char *
+sprintPoolStats (BM_BufferPool *const bm)
+{
+	BM_PoolStats stats;
+	int i, c;
+	char *message;
+	int pos = 0;
+
+	getPoolStats(bm, &stats);
+	message = (char *) malloc(64 * (BM_STAT_COUNTER_COUNT + 4 * BM_STAT_STRATEGY_SLOTS));
+
+	uint64_t hits = stats.counters[BM_STAT_HITS];
+	uint64_t pins = hits + stats.counters[BM_STAT_MISSES];
+	pos += sprintf(message + pos, "pool=%s pages=%i hit_ratio=%.4f",
+			strategyName(bm->strategy), bm->numPages,
+			pins == 0 ? 0.0 : (double) hits / pins);
+	for (c = 0; c < BM_STAT_COUNTER_COUNT; c++)
+		pos += sprintf(message + pos, " %s=%llu", statCounterNames[c],
+				(unsigned long long) stats.counters[c]);
+	pos += sprintf(message + pos, "\n");
+
+	for (i = 0; i < BM_STAT_STRATEGY_SLOTS; i++) {
+		uint64_t *counters = stats.strategyCounters[i];
+		if (counters[BM_STRATEGY_STAT_HITS] == 0 && counters[BM_STRATEGY_STAT_MISSES] == 0)
+			continue;
+		pos += sprintf(message + pos, "  strategy=%s hits=%llu misses=%llu evictions=%llu\n",
+				strategyName(i),
+				(unsigned long long) counters[BM_STRATEGY_STAT_HITS],
+				(unsigned long long) counters[BM_STRATEGY_STAT_MISSES],
+				(unsigned long long) counters[BM_STRATEGY_STAT_EVICTIONS]);
+	}
+
+	return message;
+}
+
+// Name of a replacement strategy, or of a `BM_STAT_STRATEGY_*` slot
+const char *
+strategyName (int strategySlot)
+{
+	switch (strategySlot)
+	{
+	case RS_FIFO:
+		return "FIFO";
+	case RS_LRU:
+		return "LRU";
+	case RS_CLOCK:
+		return "CLOCK";
+	case RS_LFU:
+		return "LFU";
+	case RS_LRU_K:
+		return "LRU-K";
+	case BM_STAT_STRATEGY_RING:
+		return "RING";
+	default:
+		return "?";
+	}
+}
+
 void
 printStrat (BM_BufferPool *const bm)
 {
@@ -22,6 +22,7 @@ typedef int RC;
 #define RC_PAGE_NOT_IN_BUFFER 15
 
 #define RC_BM_IN_USE 16
+#define RC_BM_RESIDENT_BUDGET_EXCEEDED 17
 
 
 #define RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE 200
@@ -33,6 +34,9 @@ typedef int RC;
 #define RC_RM_UNKNOWN_TABLE 206
 #define RC_RM_NAME_TOO_LONG 207
 #define RC_RM_ATTR_NUM_OUT_OF_BOUNDS 208
+#define RC_RM_EXPR_NOT_COMPILABLE 209
+#define RC_RM_VALUE_TOO_LONG 210
+#define RC_RM_UNKNOWN_RECORD 211
 
 #define RC_IM_KEY_NOT_FOUND 300
 #define RC_IM_KEY_ALREADY_EXISTS 301
@@ -1,5 +1,10 @@
 #include <string.h>
 #include <stdlib.h>
+#include <limits.h>
+#include <stdint.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "dberror.h"
 #include "record_mgr.h"
@@ -26,6 +31,7 @@ valueEquals (Value *left, Value *right, Value *result)
 		result->v.boolV = (left->v.boolV == right->v.boolV);
 		break;
 	case DT_STRING:
+	case DT_VARCHAR:
 		result->v.boolV = (strcmp(left->v.stringV, right->v.stringV) == 0);
 		break;
 	}
@@ -51,6 +57,7 @@ valueSmaller (Value *left, Value *right, Value *result)
 	case DT_BOOL:
 		result->v.boolV = (left->v.boolV < right->v.boolV);
 	case DT_STRING:
+	case DT_VARCHAR:
 		result->v.boolV = (strcmp(left->v.stringV, right->v.stringV) < 0);
 		break;
 	}
@@ -180,6 +187,471 @@ freeExpr (Expr *expr)
 	return RC_OK;
 }
 
+// ************************************************************
+// compiled expressions
+
+static RC compileNode (Expr *expr, Schema *schema, ExprProgram *program, int *capacity, int depth);
+
+static ExprInstr *
+appendInstr (ExprProgram *program, int *capacity, ExprOpcode opcode)
+{
+	if (program->numInstrs == *capacity)
+	{
+		*capacity = *capacity * 2;
+		program->instrs = (ExprInstr *) realloc(program->instrs, *capacity * sizeof(ExprInstr));
+	}
+	ExprInstr *instr = &program->instrs[program->numInstrs++];
+	memset(instr, 0, sizeof(ExprInstr));
+	instr->opcode = opcode;
+	return instr;
+}
+
+// Resolves a constant or attribute reference to where its value comes from
+static RC
+compileOperand (Expr *expr, Schema *schema, ExprOperand *operand, DataType *dt)
+{
+	switch(expr->type)
+	{
+	case EXPR_CONST:
+	{
+		Value *cons = expr->expr.cons;
+		operand->offset = EXPR_OPERAND_CONST;
+		*dt = cons->dt;
+		switch(cons->dt)
+		{
+		case DT_INT:
+			operand->cons.intV = cons->v.intV;
+			break;
+		case DT_FLOAT:
+			operand->cons.floatV = cons->v.floatV;
+			break;
+		case DT_BOOL:
+			operand->cons.boolV = cons->v.boolV;
+			break;
+		case DT_STRING:
+			// the program may outlive the expression
+			operand->cons.stringV = (char *) malloc(strlen(cons->v.stringV) + 1);
+			strcpy(operand->cons.stringV, cons->v.stringV);
+			break;
+		case DT_VARCHAR:
+			THROW(RC_RM_EXPR_NOT_COMPILABLE, "varchar values are compared by evalExpr");
+		}
+		return RC_OK;
+	}
+	case EXPR_ATTRREF:
+	{
+		int attrNum = expr->expr.attrRef;
+		if (schema == NULL || attrNum < 0 || attrNum >= schema->numAttr)
+			THROW(RC_RM_ATTR_NUM_OUT_OF_BOUNDS, "attribute reference out of bounds");
+		// the bytes of a varchar are not at a fixed offset
+		if (schema->dataTypes[attrNum] == DT_VARCHAR)
+			THROW(RC_RM_EXPR_NOT_COMPILABLE, "varchar attributes are compared by evalExpr");
+		*dt = schema->dataTypes[attrNum];
+		operand->length = schema->typeLength[attrNum];
+		return getAttrOffset(schema, attrNum, &operand->offset);
+	}
+	default:
+		THROW(RC_RM_EXPR_NOT_COMPILABLE, "only constants and attributes can be compared");
+	}
+}
+
+static RC
+compileComparison (Operator *op, Schema *schema, ExprProgram *program, int *capacity)
+{
+	static const ExprOpcode equalOpcodes[] = {
+		[DT_INT] = EXPR_PROG_EQUAL_INT,
+		[DT_STRING] = EXPR_PROG_EQUAL_STRING,
+		[DT_FLOAT] = EXPR_PROG_EQUAL_FLOAT,
+		[DT_BOOL] = EXPR_PROG_EQUAL_BOOL,
+	};
+	static const ExprOpcode smallerOpcodes[] = {
+		[DT_INT] = EXPR_PROG_SMALLER_INT,
+		[DT_STRING] = EXPR_PROG_SMALLER_STRING,
+		[DT_FLOAT] = EXPR_PROG_SMALLER_FLOAT,
+		[DT_BOOL] = EXPR_PROG_SMALLER_BOOL,
+	};
+
+	ExprOperand args[2] = {};
+	DataType dts[2];
+	RC rc = compileOperand(op->args[0], schema, &args[0], &dts[0]);
+	if (rc == RC_OK)
+		rc = compileOperand(op->args[1], schema, &args[1], &dts[1]);
+	if (rc == RC_OK && dts[0] != dts[1])
+	{
+		RC_message = "equality comparison only supported for values of the same datatype";
+		rc = RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE;
+	}
+	if (rc != RC_OK)
+	{
+		for (int i = 0; i < 2; i++)
+			if (args[i].offset == EXPR_OPERAND_CONST && dts[i] == DT_STRING)
+				free(args[i].cons.stringV);
+		return rc;
+	}
+
+	ExprOpcode opcode = op->type == OP_COMP_EQUAL ? equalOpcodes[dts[0]] : smallerOpcodes[dts[0]];
+	ExprInstr *instr = appendInstr(program, capacity, opcode);
+	instr->args[0] = args[0];
+	instr->args[1] = args[1];
+	return RC_OK;
+}
+
+// Appends the instructions that leave the boolean value of `expr` on the stack
+static RC
+compileNode (Expr *expr, Schema *schema, ExprProgram *program, int *capacity, int depth)
+{
+	if (depth >= EXPR_PROGRAM_MAX_DEPTH)
+		THROW(RC_RM_EXPR_NOT_COMPILABLE, "expression nested too deeply");
+
+	if (expr->type != EXPR_OP)
+	{
+		ExprOperand operand = {};
+		DataType dt;
+		RC rc = compileOperand(expr, schema, &operand, &dt);
+		if (rc != RC_OK)
+			return rc;
+		if (dt != DT_BOOL)
+		{
+			if (operand.offset == EXPR_OPERAND_CONST && dt == DT_STRING)
+				free(operand.cons.stringV);
+			THROW(RC_RM_BOOLEAN_EXPR_ARG_IS_NOT_BOOLEAN, "boolean operators require boolean inputs");
+		}
+		appendInstr(program, capacity, EXPR_PROG_PUSH_BOOL)->args[0] = operand;
+		return RC_OK;
+	}
+
+	Operator *op = expr->expr.op;
+	RC rc;
+	switch(op->type)
+	{
+	case OP_COMP_EQUAL:
+	case OP_COMP_SMALLER:
+		return compileComparison(op, schema, program, capacity);
+	case OP_BOOL_NOT:
+		if ((rc = compileNode(op->args[0], schema, program, capacity, depth + 1)) != RC_OK)
+			return rc;
+		appendInstr(program, capacity, EXPR_PROG_NOT);
+		return RC_OK;
+	case OP_BOOL_AND:
+	case OP_BOOL_OR:
+		if ((rc = compileNode(op->args[0], schema, program, capacity, depth + 1)) != RC_OK)
+			return rc;
+		if ((rc = compileNode(op->args[1], schema, program, capacity, depth + 1)) != RC_OK)
+			return rc;
+		appendInstr(program, capacity, op->type == OP_BOOL_AND ? EXPR_PROG_AND : EXPR_PROG_OR);
+		return RC_OK;
+	default:
+		THROW(RC_RM_EXPR_NOT_COMPILABLE, "unknown operator");
+	}
+}
+
+/* Compiles a condition against the schema of the records it will be
+ * evaluated on. Fails for expressions `evalExpr` would reject, and with
+ * RC_RM_EXPR_NOT_COMPILABLE for ones that compare the result of an operator.
+ */
+RC
+compileExpr (Expr *expr, Schema *schema, ExprProgram **program)
+{
+	int capacity = 8;
+	ExprProgram *result = (ExprProgram *) malloc(sizeof(ExprProgram));
+	result->instrs = (ExprInstr *) malloc(capacity * sizeof(ExprInstr));
+	result->numInstrs = 0;
+
+	RC rc = compileNode(expr, schema, result, &capacity, 0);
+	if (rc != RC_OK)
+	{
+		freeExprProgram(result);
+		return rc;
+	}
+
+	*program = result;
+	return RC_OK;
+}
+
+static inline int
+loadInt (const ExprOperand *operand, const char *data)
+{
+	int value;
+	if (operand->offset == EXPR_OPERAND_CONST)
+		return operand->cons.intV;
+	memcpy(&value, data + operand->offset, sizeof(int));
+	return value;
+}
+
+static inline float
+loadFloat (const ExprOperand *operand, const char *data)
+{
+	float value;
+	if (operand->offset == EXPR_OPERAND_CONST)
+		return operand->cons.floatV;
+	memcpy(&value, data + operand->offset, sizeof(float));
+	return value;
+}
+
+static inline bool
+loadBool (const ExprOperand *operand, const char *data)
+{
+	if (operand->offset == EXPR_OPERAND_CONST)
+		return operand->cons.boolV;
+	return *(const bool *) (data + operand->offset);
+}
+
+// strcmp(), for string attributes that are only terminated if they are
+// shorter than their attribute
+static inline int
+compareStrings (const ExprOperand *left, const ExprOperand *right, const char *data)
+{
+	const char *l = left->offset == EXPR_OPERAND_CONST ? left->cons.stringV : data + left->offset;
+	const char *r = right->offset == EXPR_OPERAND_CONST ? right->cons.stringV : data + right->offset;
+	int lLen = left->offset == EXPR_OPERAND_CONST ? INT_MAX : left->length;
+	int rLen = right->offset == EXPR_OPERAND_CONST ? INT_MAX : right->length;
+
+	for (int i = 0; ; i++)
+	{
+		unsigned char lChar = i < lLen ? (unsigned char) l[i] : '\0';
+		unsigned char rChar = i < rLen ? (unsigned char) r[i] : '\0';
+		if (lChar != rChar || lChar == '\0')
+			return (int) lChar - (int) rChar;
+	}
+}
+
+// Evaluates an instruction that pushes a value rather than combining them
+static inline bool
+evalLeaf (const ExprInstr *instr, const char *data)
+{
+	const ExprOperand *l = &instr->args[0];
+	const ExprOperand *r = &instr->args[1];
+	switch(instr->opcode)
+	{
+	case EXPR_PROG_PUSH_BOOL:
+		return loadBool(l, data);
+	case EXPR_PROG_EQUAL_INT:
+		return loadInt(l, data) == loadInt(r, data);
+	case EXPR_PROG_SMALLER_INT:
+		return loadInt(l, data) < loadInt(r, data);
+	case EXPR_PROG_EQUAL_FLOAT:
+		return loadFloat(l, data) == loadFloat(r, data);
+	case EXPR_PROG_SMALLER_FLOAT:
+		return loadFloat(l, data) < loadFloat(r, data);
+	case EXPR_PROG_EQUAL_BOOL:
+		return loadBool(l, data) == loadBool(r, data);
+	case EXPR_PROG_SMALLER_BOOL:
+		return loadBool(l, data) < loadBool(r, data);
+	case EXPR_PROG_EQUAL_STRING:
+		return compareStrings(l, r, data) == 0;
+	case EXPR_PROG_SMALLER_STRING:
+		return compareStrings(l, r, data) < 0;
+	default:
+		return false;
+	}
+}
+
+/* Evaluates a compiled condition on the bytes of a record, nonzero if it
+ * holds. */
+int
+evalExprProgram (const ExprProgram *program, const char *data)
+{
+	bool stack[EXPR_PROGRAM_MAX_DEPTH + 1];
+	int top = -1;
+
+	for (int i = 0; i < program->numInstrs; i++)
+	{
+		const ExprInstr *instr = &program->instrs[i];
+		switch(instr->opcode)
+		{
+		case EXPR_PROG_NOT:
+			stack[top] = !stack[top];
+			break;
+		case EXPR_PROG_AND:
+			top--;
+			stack[top] = stack[top] && stack[top + 1];
+			break;
+		case EXPR_PROG_OR:
+			top--;
+			stack[top] = stack[top] || stack[top + 1];
+			break;
+		default:
+			stack[++top] = evalLeaf(instr, data);
+			break;
+		}
+	}
+
+	return stack[0];
+}
+
+// ************************************************************
+// batch evaluation
+
+typedef enum ExprColumnCmp {
+	EXPR_COLUMN_EQUAL,
+	EXPR_COLUMN_SMALLER,
+	EXPR_COLUMN_GREATER
+} ExprColumnCmp;
+
+// Compares every element of a column to a constant, 4 lanes at a time where
+// SSE2 is there, the lanes are bits of the selection bitmap
+#ifdef __SSE2__
+#define COMPARE_COLUMN(_column,_n,_cons,_out,_vecType,_load,_set1,_vecCmp,_mask,_op) \
+	do {									\
+		int _i = 0;							\
+		_vecType _c = _set1(_cons);					\
+		for (; _i + 4 <= (_n); _i += 4)					\
+		{								\
+			_vecType _v = _load(&(_column)[_i]);			\
+			(_out)[_i / 64] |= (uint64_t) _mask(_vecCmp(_v, _c)) << (_i % 64); \
+		}								\
+		for (; _i < (_n); _i++)						\
+			(_out)[_i / 64] |= (uint64_t) ((_column)[_i] _op (_cons)) << (_i % 64); \
+	} while (0)
+#else
+#define COMPARE_COLUMN(_column,_n,_cons,_out,_vecType,_load,_set1,_vecCmp,_mask,_op) \
+	do {									\
+		for (int _i = 0; _i < (_n); _i++)				\
+			(_out)[_i / 64] |= (uint64_t) ((_column)[_i] _op (_cons)) << (_i % 64); \
+	} while (0)
+#endif
+
+#ifdef __SSE2__
+#define LOAD_INTS(_p) _mm_loadu_si128((const __m128i *) (_p))
+#define MASK_INTS(_m) _mm_movemask_ps(_mm_castsi128_ps(_m))
+#endif
+
+static void
+compareIntColumn (const int32_t *column, int n, int32_t cons, ExprColumnCmp cmp, uint64_t *out)
+{
+	switch(cmp)
+	{
+	case EXPR_COLUMN_EQUAL:
+		COMPARE_COLUMN(column, n, cons, out, __m128i, LOAD_INTS, _mm_set1_epi32, _mm_cmpeq_epi32, MASK_INTS, ==);
+		break;
+	case EXPR_COLUMN_SMALLER:
+		COMPARE_COLUMN(column, n, cons, out, __m128i, LOAD_INTS, _mm_set1_epi32, _mm_cmplt_epi32, MASK_INTS, <);
+		break;
+	case EXPR_COLUMN_GREATER:
+		COMPARE_COLUMN(column, n, cons, out, __m128i, LOAD_INTS, _mm_set1_epi32, _mm_cmpgt_epi32, MASK_INTS, >);
+		break;
+	}
+}
+
+static void
+compareFloatColumn (const float *column, int n, float cons, ExprColumnCmp cmp, uint64_t *out)
+{
+	switch(cmp)
+	{
+	case EXPR_COLUMN_EQUAL:
+		COMPARE_COLUMN(column, n, cons, out, __m128, _mm_loadu_ps, _mm_set1_ps, _mm_cmpeq_ps, _mm_movemask_ps, ==);
+		break;
+	case EXPR_COLUMN_SMALLER:
+		COMPARE_COLUMN(column, n, cons, out, __m128, _mm_loadu_ps, _mm_set1_ps, _mm_cmplt_ps, _mm_movemask_ps, <);
+		break;
+	case EXPR_COLUMN_GREATER:
+		COMPARE_COLUMN(column, n, cons, out, __m128, _mm_loadu_ps, _mm_set1_ps, _mm_cmpgt_ps, _mm_movemask_ps, >);
+		break;
+	}
+}
+
+/* Evaluates a leaf instruction on a batch of records. An int or float
+ * attribute compared to a constant is gathered into a column and compared by
+ * the column kernels, anything else goes record by record. */
+static void
+evalLeafBatch (const ExprInstr *instr, const char *const *records, int numRecords, uint64_t *out)
+{
+	const ExprOperand *l = &instr->args[0];
+	const ExprOperand *r = &instr->args[1];
+	memset(out, 0, EXPR_BATCH_WORDS * sizeof(uint64_t));
+
+	bool isInt = instr->opcode == EXPR_PROG_EQUAL_INT || instr->opcode == EXPR_PROG_SMALLER_INT;
+	bool isFloat = instr->opcode == EXPR_PROG_EQUAL_FLOAT || instr->opcode == EXPR_PROG_SMALLER_FLOAT;
+	bool leftIsConst = l->offset == EXPR_OPERAND_CONST;
+	if ((isInt || isFloat) && leftIsConst != (r->offset == EXPR_OPERAND_CONST))
+	{
+		// const < attr is attr > const
+		const ExprOperand *attr = leftIsConst ? r : l;
+		const ExprOperand *cons = leftIsConst ? l : r;
+		ExprColumnCmp cmp = EXPR_COLUMN_EQUAL;
+		if (instr->opcode == EXPR_PROG_SMALLER_INT || instr->opcode == EXPR_PROG_SMALLER_FLOAT)
+			cmp = leftIsConst ? EXPR_COLUMN_GREATER : EXPR_COLUMN_SMALLER;
+
+		if (isInt)
+		{
+			int32_t column[EXPR_BATCH_SIZE];
+			for (int i = 0; i < numRecords; i++)
+				memcpy(&column[i], records[i] + attr->offset, sizeof(int32_t));
+			compareIntColumn(column, numRecords, cons->cons.intV, cmp, out);
+		}
+		else
+		{
+			float column[EXPR_BATCH_SIZE];
+			for (int i = 0; i < numRecords; i++)
+				memcpy(&column[i], records[i] + attr->offset, sizeof(float));
+			compareFloatColumn(column, numRecords, cons->cons.floatV, cmp, out);
+		}
+		return;
+	}
+
+	for (int i = 0; i < numRecords; i++)
+		out[i / 64] |= (uint64_t) evalLeaf(instr, records[i]) << (i % 64);
+}
+
+/* Evaluates a compiled condition on up to EXPR_BATCH_SIZE records at once.
+ * Bit i of `selection` is set if record i satisfies it. */
+void
+evalExprProgramBatch (const ExprProgram *program, const char *const *records, int numRecords, uint64_t *selection)
+{
+	uint64_t stack[EXPR_PROGRAM_MAX_DEPTH + 1][EXPR_BATCH_WORDS];
+	int top = -1;
+
+	for (int i = 0; i < program->numInstrs; i++)
+	{
+		const ExprInstr *instr = &program->instrs[i];
+		switch(instr->opcode)
+		{
+		case EXPR_PROG_NOT:
+			for (int w = 0; w < EXPR_BATCH_WORDS; w++)
+				stack[top][w] = ~stack[top][w];
+			break;
+		case EXPR_PROG_AND:
+			top--;
+			for (int w = 0; w < EXPR_BATCH_WORDS; w++)
+				stack[top][w] &= stack[top + 1][w];
+			break;
+		case EXPR_PROG_OR:
+			top--;
+			for (int w = 0; w < EXPR_BATCH_WORDS; w++)
+				stack[top][w] |= stack[top + 1][w];
+			break;
+		default:
+			evalLeafBatch(instr, records, numRecords, stack[++top]);
+			break;
+		}
+	}
+
+	// NOT sets the bits past the end of the batch
+	for (int w = 0; w < EXPR_BATCH_WORDS; w++)
+	{
+		int numBits = numRecords - w * 64;
+		uint64_t mask = numBits >= 64 ? UINT64_MAX : numBits <= 0 ? 0 : (1ull << numBits) - 1;
+		selection[w] = stack[0][w] & mask;
+	}
+}
+
+void
+freeExprProgram (ExprProgram *program)
+{
+	if (program == NULL)
+		return;
+	for (int i = 0; i < program->numInstrs; i++)
+	{
+		ExprInstr *instr = &program->instrs[i];
+		bool isString = instr->opcode == EXPR_PROG_EQUAL_STRING || instr->opcode == EXPR_PROG_SMALLER_STRING;
+		for (int j = 0; j < 2 && isString; j++)
+			if (instr->args[j].offset == EXPR_OPERAND_CONST)
+				free(instr->args[j].cons.stringV);
+	}
+	free(program->instrs);
+	free(program);
+}
+
 void 
 freeVal (Value *val)
 {
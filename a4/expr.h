@@ -1,6 +1,8 @@
 #ifndef EXPR_H
 #define EXPR_H
 
+#include <stdint.h>
+
 #include "dberror.h"
 #include "tables.h"
 
@@ -34,6 +36,58 @@ typedef struct Operator {
   Expr **args;
 } Operator;
 
+// Conditions compiled against a schema
+//
+// A program is the expression in postfix order, evaluated on a stack of
+// booleans. Comparisons are specialized on the datatype of their arguments
+// and read attributes straight from the record bytes at offsets taken from
+// the schema, so evaluating a program allocates nothing. A program can also
+// be evaluated on a batch of records at once, into a bitmap of the ones that
+// satisfy it, where an int or float attribute compared to a constant goes
+// through SIMD kernels.
+typedef enum ExprOpcode {
+  EXPR_PROG_PUSH_BOOL,		// boolean constant or attribute
+  EXPR_PROG_NOT,
+  EXPR_PROG_AND,
+  EXPR_PROG_OR,
+  EXPR_PROG_EQUAL_INT,
+  EXPR_PROG_SMALLER_INT,
+  EXPR_PROG_EQUAL_FLOAT,
+  EXPR_PROG_SMALLER_FLOAT,
+  EXPR_PROG_EQUAL_BOOL,
+  EXPR_PROG_SMALLER_BOOL,
+  EXPR_PROG_EQUAL_STRING,
+  EXPR_PROG_SMALLER_STRING
+} ExprOpcode;
+
+#define EXPR_OPERAND_CONST (-1)
+#define EXPR_PROGRAM_MAX_DEPTH (64)
+// Records evaluated at once by `evalExprProgramBatch`, one bit each
+#define EXPR_BATCH_SIZE (256)
+#define EXPR_BATCH_WORDS (EXPR_BATCH_SIZE / 64)
+
+// An attribute of the record or a constant
+typedef struct ExprOperand {
+  int offset;			// in the record, EXPR_OPERAND_CONST for a constant
+  int length;			// of a string attribute
+  union operand {
+    int intV;
+    float floatV;
+    bool boolV;
+    char *stringV;
+  } cons;
+} ExprOperand;
+
+typedef struct ExprInstr {
+  ExprOpcode opcode;
+  ExprOperand args[2];
+} ExprInstr;
+
+typedef struct ExprProgram {
+  ExprInstr *instrs;
+  int numInstrs;
+} ExprProgram;
+
 // expression evaluation methods
 extern RC valueEquals (Value *left, Value *right, Value *result);
 extern RC valueSmaller (Value *left, Value *right, Value *result);
@@ -42,6 +96,10 @@ extern RC boolAnd (Value *left, Value *right, Value *result);
 extern RC boolOr (Value *left, Value *right, Value *result);
 extern RC evalExpr (Record *record, Schema *schema, Expr *expr, Value **result);
 extern RC freeExpr (Expr *expr);
+extern RC compileExpr (Expr *expr, Schema *schema, ExprProgram **program);
+extern int evalExprProgram (const ExprProgram *program, const char *data);
+extern void evalExprProgramBatch (const ExprProgram *program, const char *const *records, int numRecords, uint64_t *selection);
+extern void freeExprProgram (ExprProgram *program);
 extern void freeVal(Value *val);
 
 
@@ -54,6 +112,7 @@ extern void freeVal(Value *val);
       (_result)->v.intV = _input->v.intV;					\
       break;								\
     case DT_STRING:							\
+    case DT_VARCHAR:							\
       (_result)->v.stringV = (char *) malloc(strlen(_input->v.stringV) + 1);	\
       strcpy((_result)->v.stringV, _input->v.stringV);			\
       break;								\
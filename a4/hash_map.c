@@ -106,25 +106,17 @@ bool HashMap_remove(HS_HashMap *self, uint32_t key, void **data) {
     }
 
     uint32_t i = hash(key) % self->numBuckets;
-    bool isRoot = true;
-    bool found = false;
     HS_Node *prev = NULL;
     HS_Node *node = &self->buckets[i];
-    HS_Node *lookahead = node->next;
-    do {
-        if (node->present && node->key == key) {
-            found = true;
-            break;
-        }
-        isRoot = false;
+    while (node != NULL && !(node->present && node->key == key)) {
         prev = node;
-        node = lookahead;
-        lookahead = node->next;
-    } while (lookahead != NULL);
+        node = node->next;
+    }
 
-    if (!found) {
+    if (node == NULL) {
         return false;
     }
+    bool isRoot = prev == NULL;
 
     if (data != NULL) {
         *data = node->data;
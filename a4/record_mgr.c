@@ -1,10 +1,16 @@
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
 
 #include "rm_page.h"
 #include "rm_macros.h"
 #include "rm_binfmt.h"
+#include "rm_fsm.h"
+#include "rm_catalog.h"
 #include "btree.h"
+#include "wal.h"
 
 #include "record_mgr.h"
 
@@ -13,16 +19,63 @@ static RM_Metadata *g_instance = NULL;
 static const char *const RM_MAGIC_BUF = RM_DATABASE_MAGIC;
 
 #define RM_DEFAULT_FILENAME "storage.db"
+#define RM_DEFAULT_WAL_FILENAME "storage.db.wal"
 #define RM_DEFAULT_NUM_POOL_PAGES (512)
 #define RM_DEFAULT_REPLACEMENT_STRATEGY (RS_LRU)
 
+// Sequential scans that have walked more than this share of the pool switch
+// over to a private ring of frames so they stop evicting everyone else's pages
+#define RM_SCAN_RING_THRESHOLD_DIVISOR (4)
+#define RM_SCAN_RING_SIZE (16)
+
+// Most data pages a bulk insert allocates at once
+#define RM_INSERT_MAX_NEW_PAGES (64)
+
+// Parallel scans hand out the pages of a table in morsels of this many
+// consecutive data pages
+#define RM_SCAN_MORSEL_PAGES (16)
+
+// Attributes that are next to each other both in a tuple and in the projected
+// record it is copied to, see `startProjectedScan`
+typedef struct RM_ProjectionRun {
+    int srcOffset;
+    int dstOffset;
+    int length;
+    bool varchar;   // a single VarcharRef, whose bytes are copied along
+} RM_ProjectionRun;
+
+typedef struct RM_ScanData {
+    Expr *cond;
+    ExprProgram *program;       // `cond` compiled, NULL if it has to be interpreted
+    int numPagesVisited;
+    BM_AccessStrategy *strategy;
+    BM_PageHandle pageHandle;   // page of `lastRID`, stays pinned between calls
+    bool pinned;
+    RM_ProjectionRun *projection;   // NULL to copy whole tuples
+    int numProjectionRuns;
+    int projectedVarcharOffset;     // where projected records keep the bytes of their varchars
+} RM_ScanData;
+
 RM_Metadata *RM_getInstance()
 {
     return g_instance;
 }
 
+// Identifies a database for its write-ahead log, so that a log left behind by
+// a database that has since been replaced is never replayed into this one
+static uint64_t RM_newDatabaseId()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    uint64_t id = (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+    id ^= (uint64_t) getpid() << 32u;
+    id ^= (uint64_t) clock();
+    return id;
+}
+
 static RC RM_writeDatabaseHeader(BM_BufferPool *pool)
 {
+    BP_Metadata *meta = pool->mgmtData;
     BM_PageHandle pageHandle = {};
     TRY_OR_RETURN(pinPage(pool, &pageHandle, RM_PAGE_DBHEADER));
 
@@ -32,10 +85,16 @@ static RC RM_writeDatabaseHeader(BM_BufferPool *pool)
     header->pageSize = PAGE_SIZE;
     header->numPages = 2; // include this page and the schema page
     header->schemaPageNum = RM_PAGE_SCHEMA; // schema page is always on page number 1
+    header->dbId = RM_newDatabaseId();
 
+    // the header is not logged, it has to be durable before the log is opened
     TRY_OR_RETURN(forcePage(pool, &pageHandle));
     TRY_OR_RETURN(unpinPage(pool, &pageHandle));
 
+    // reserve the catalog pages, they are only written back eventually
+    TRY_OR_RETURN(ensureCapacity(RM_PAGE_INDEX + 1, meta->fileHandle));
+    TRY_OR_RETURN(syncBufferPool(pool));
+
     return RC_OK;
 }
 
@@ -46,7 +105,7 @@ static RC RM_writeSchemaPage(BM_BufferPool *pool)
 
     RM_Page_init(pageHandle.buffer, RM_PAGE_SCHEMA, RM_PAGE_KIND_SCHEMA);
 
-    TRY_OR_RETURN(forcePage(pool, &pageHandle));
+    TRY_OR_RETURN(markDirty(pool, &pageHandle));
     TRY_OR_RETURN(unpinPage(pool, &pageHandle));
 
     return RC_OK;
@@ -63,6 +122,9 @@ RC initRecordManager (void *mgmtData IGNORE_UNUSED)
     if (g_instance == NULL) {
         PANIC("malloc: failed to allocate record manager metadata");
     }
+    g_instance->bufferPool = NULL;
+    g_instance->wal = NULL;
+    g_instance->catalog = RM_Catalog_create();
 
     BM_BufferPool *pool = malloc(sizeof(BM_BufferPool));
     rc = initBufferPool(
@@ -83,17 +145,32 @@ RC initRecordManager (void *mgmtData IGNORE_UNUSED)
     }
 
     // Check if the database has been already initialized by checking the magic bytes
-    if (memcmp(page.buffer, RM_MAGIC_BUF, RM_DATABASE_MAGIC_LEN) != 0) {
-        if ((rc = unpinPage(pool, &page)) != RC_OK) {
-            goto error;
-        }
-
+    bool isNew = memcmp(page.buffer, RM_MAGIC_BUF, RM_DATABASE_MAGIC_LEN) != 0;
+    if ((rc = unpinPage(pool, &page)) != RC_OK) {
+        goto error;
+    }
+    if (isNew) {
         // Write the database header in the first page
         rc = RM_writeDatabaseHeader(pool);
         if (rc != RC_OK) {
             goto error;
         }
+    }
 
+    // Open the log, replaying whatever a crash left in it. Every change to
+    // a page from here on is logged before the page may be written back.
+    if ((rc = pinPage(pool, &page, RM_PAGE_DBHEADER)) != RC_OK) {
+        goto error;
+    }
+    uint64_t dbId = ((RM_DatabaseHeader *) page.buffer)->dbId;
+    if ((rc = unpinPage(pool, &page)) != RC_OK) {
+        goto error;
+    }
+    if ((rc = WAL_open(RM_DEFAULT_WAL_FILENAME, dbId, pool, &g_instance->wal)) != RC_OK) {
+        goto error;
+    }
+
+    if (isNew) {
         // Create schema page
         rc = RM_writeSchemaPage(pool);
         if (rc != RC_OK) {
@@ -106,8 +183,13 @@ RC initRecordManager (void *mgmtData IGNORE_UNUSED)
             goto error;
         }
     }
-    else {
-        if ((rc = unpinPage(pool, &page)) != RC_OK) {
+
+    // Every table and index lookup starts from the catalog pages, keep them
+    // resident. Running out of resident budget only costs a possible miss.
+    PageNumber catalogPages[] = {RM_PAGE_DBHEADER, RM_PAGE_SCHEMA, RM_PAGE_INDEX};
+    for (int i = 0; i < (int) (sizeof(catalogPages) / sizeof(PageNumber)); i++) {
+        rc = markPageResident(pool, catalogPages[i]);
+        if (rc != RC_OK && rc != RC_BM_RESIDENT_BUDGET_EXCEEDED) {
             goto error;
         }
     }
@@ -126,11 +208,23 @@ RC shutdownRecordManager ()
     }
 
     BM_BufferPool *pool = g_instance->bufferPool;
+    WAL_Log *wal = g_instance->wal;
+    if (pool != NULL && wal != NULL) {
+        // a clean shutdown leaves nothing to replay
+        if (WAL_commit(wal) == RC_OK && syncBufferPool(pool) == RC_OK) {
+            WAL_truncate(wal);
+        }
+    }
     if (pool != NULL) {
         forceShutdownBufferPool(pool);
         free(pool);
         g_instance->bufferPool = NULL;
     }
+    if (wal != NULL) {
+        WAL_close(wal);
+        g_instance->wal = NULL;
+    }
+    RM_Catalog_free(g_instance->catalog);
 
     free(g_instance);
     g_instance = NULL;
@@ -140,35 +234,140 @@ RC shutdownRecordManager ()
     return RC_OK;
 }
 
+// Puts the tables described on one schema page into the catalog cache
+static void RM_loadSchemaPage(RM_Page *page, RM_Catalog *catalog)
+{
+    for (int i = 0; i < page->header.numTuples; i++) {
+        RM_PageTuple *tup = RM_Page_getLiveTuple(page, i);
+        if (tup == NULL) {
+            continue;
+        }
+        struct RM_SCHEMA_FORMAT_T schemaMsg = RM_SCHEMA_FORMAT;
+        BF_read((BF_MessageElement *) &schemaMsg, &tup->dataBegin, BF_NUM_ELEMENTS(sizeof(RM_SCHEMA_FORMAT)));
+
+        // names point into the page until the entry copies them
+        int numKeys = BF_ARRAY_U8_LEN(schemaMsg.tblKeys);
+        int numAttrs = BF_AS_U8(schemaMsg.tblNumAttr);
+        char *attrNames[numAttrs];
+        DataType dataTypes[numAttrs];
+        int typeLength[numAttrs];
+        int keyAttrs[numKeys];
+        struct RM_SCHEMA_ATTR_FORMAT_T *attrs = (struct RM_SCHEMA_ATTR_FORMAT_T *) BF_AS_ARRAY_MSG(schemaMsg.tblAttrs);
+        for (int a = 0; a < numAttrs; a++) {
+            attrNames[a] = BF_AS_STR(attrs[a].attrName);
+            dataTypes[a] = BF_AS_U8(attrs[a].attrType);
+            typeLength[a] = BF_AS_U16(attrs[a].attrTypeLen);
+        }
+        uint8_t *keyIndexes = BF_AS_ARRAY_U8(schemaMsg.tblKeys);
+        for (int k = 0; k < numKeys; k++) {
+            keyAttrs[k] = keyIndexes[k];
+        }
+
+        Schema schema = {
+                .numAttr = numAttrs,
+                .attrNames = attrNames,
+                .dataTypes = dataTypes,
+                .typeLength = typeLength,
+                .keyAttrs = keyAttrs,
+                .keySize = numKeys,
+                .dataPageNum = BF_AS_U16(schemaMsg.tblDataPageNum),
+                .fsmPageNum = BF_AS_U16(schemaMsg.tblFsmPageNum),
+        };
+        RM_Catalog_putTable(catalog, RM_CatalogTable_create(
+                BF_AS_STR(schemaMsg.tblName),
+                &schema,
+                page->header.pageNum));
+        free(attrs);
+    }
+}
+
+// Fills the table half of the catalog cache from the chain of schema pages
+static RC RM_loadTableCatalog(BM_BufferPool *pool, RM_Catalog *catalog)
+{
+    PageNumber pageNum = catalog->tableChain.firstPageNum;
+    while (true) {
+        BM_PageHandle pageHandle = {};
+        TRY_OR_RETURN(pinPage(pool, &pageHandle, pageNum));
+        RM_Page *page = (RM_Page *) pageHandle.buffer;
+        RM_loadSchemaPage(page, catalog);
+
+        PageNumber nextPageNum = page->header.nextPageNum;
+        TRY_OR_RETURN(unpinPage(pool, &pageHandle));
+        if (nextPageNum == RM_PAGE_NEXT_PAGENUM_UNSET) {
+            break;
+        }
+        pageNum = nextPageNum;
+    }
+
+    catalog->tableChain.lastPageNum = pageNum;
+    catalog->tablesLoaded = true;
+    return RC_OK;
+}
+
+// Looks `name` up in the catalog cache, loading it on first use
+static RC RM_lookupTable(char *name, RM_CatalogTable **table_out)
+{
+    RM_Catalog *catalog = g_instance->catalog;
+    if (!catalog->tablesLoaded) {
+        TRY_OR_RETURN(RM_loadTableCatalog(g_instance->bufferPool, catalog));
+    }
+
+    RM_CatalogTable *table = RM_Catalog_getTable(catalog, name);
+    if (table == NULL) {
+        return RC_RM_UNKNOWN_TABLE;
+    }
+    *table_out = table;
+    return RC_OK;
+}
+
 RC createTable (char *name, Schema *schema)
 {
     RC rc;
 
     //check if table with same name already exists
-    RM_TableData *temp = (RM_TableData *) alloca(sizeof(RM_TableData));
-    if ((openTable(temp, name)) == RC_OK){
-        closeTable(temp);
+    RM_CatalogTable *existing;
+    if ((rc = RM_lookupTable(name, &existing)) == RC_OK) {
         return RC_IM_KEY_ALREADY_EXISTS;
     }
+    else if (rc != RC_RM_UNKNOWN_TABLE) {
+        return rc;
+    }
 
     uint64_t tableNameLength = strlen(name);
     if (tableNameLength <= 0 || tableNameLength > BF_LSTRING_MAX_STRLEN) {
         return RC_RM_NAME_TOO_LONG;       
     }
 
+    // attribute lengths are stored in 16 bits
+    for (int i = 0; i < schema->numAttr; i++) {
+        if (schema->typeLength[i] < 0 || schema->typeLength[i] > UINT16_MAX) {
+            return RC_RM_VALUE_TOO_LONG;
+        }
+    }
+
     //
     // Initialize new data page
     //
     BM_BufferPool *pool = g_instance->bufferPool;
-    BP_Metadata *meta = pool->mgmtData;
-    int dataPageNum = meta->fileHandle->totalNumPages;
+    int dataPageNum;
+    TRY_OR_RETURN(RM_Page_allocate(pool, 1, &dataPageNum));
 
     BM_PageHandle dataPageHandle = {};
     TRY_OR_RETURN(pinPage(pool, &dataPageHandle, dataPageNum));
-    RM_Page_init(dataPageHandle.buffer, dataPageNum, RM_PAGE_KIND_DATA);
-    TRY_OR_RETURN(forcePage(pool, &dataPageHandle));
+    RM_Page *dataPage = RM_Page_init(dataPageHandle.buffer, dataPageNum, RM_PAGE_KIND_DATA);
+    uint16_t dataPageFreeSpace = RM_Page_getFreeSpace(dataPage);
+    TRY_OR_RETURN(markDirty(pool, &dataPageHandle));
     TRY_OR_RETURN(unpinPage(pool, &dataPageHandle));
 
+    //
+    // Initialize the free-space map, with the data page in it
+    //
+    int fsmPageNum;
+    TRY_OR_RETURN(RM_FSM_create(pool, &fsmPageNum));
+    RM_FSM fsm;
+    RM_FSM_init(&fsm, fsmPageNum);
+    TRY_OR_RETURN(RM_FSM_setPage(pool, &fsm, dataPageNum, dataPageFreeSpace));
+
     //
     // Setup/copy information from `Schema` interface into the disk format
     //
@@ -183,11 +382,12 @@ RC createTable (char *name, Schema *schema)
         attrs[i] = RM_SCHEMA_ATTR_FORMAT;
         BF_SET_U8 (attrs[i].attrType) = (uint8_t) schema->dataTypes[i];
         BF_SET_STR(attrs[i].attrName) = schema->attrNames[i];
-        BF_SET_U8 (attrs[i].attrTypeLen) = schema->typeLength[i];
+        BF_SET_U16(attrs[i].attrTypeLen) = schema->typeLength[i];
     }
 
     struct RM_SCHEMA_FORMAT_T schemaDisk = RM_SCHEMA_FORMAT;
     BF_SET_U16(schemaDisk.tblDataPageNum) = dataPageNum;
+    BF_SET_U16(schemaDisk.tblFsmPageNum) = fsmPageNum;
     BF_SET_STR(schemaDisk.tblName) = name;
     BF_SET_U8(schemaDisk.tblNumAttr) = numColumns;
     BF_SET_ARRAY_MSG(schemaDisk.tblAttrs, attrs, attrsSizeBytes);
@@ -204,27 +404,34 @@ RC createTable (char *name, Schema *schema)
             BF_NUM_ELEMENTS(sizeof(schemaDisk)));
 
     //
-    // Open schema page and reserve the required amount of space
+    // Reserve the required amount of space on a schema page, the chain of
+    // them grows by a page when they are full
     //
     BM_PageHandle pageHandle = {};
-    TRY_OR_RETURN(pinPage(pool, &pageHandle, RM_PAGE_SCHEMA));
-
-    RM_Page *page = (RM_Page *) pageHandle.buffer;
-    RM_PageTuple *tup = RM_Page_reserveTupleAtEnd(page, spaceRequired);
-    if (tup == NULL) {
-        rc = RC_RM_NO_MORE_TUPLES;
-        goto finally;
-    }
+    RM_PageTuple *tup;
+    TRY_OR_RETURN(RM_CatalogChain_reserveTuple(
+            pool,
+            &g_instance->catalog->tableChain,
+            RM_PAGE_KIND_SCHEMA,
+            spaceRequired,
+            &pageHandle,
+            &tup));
 
     //
     // Write out of the schema tuple data
     //
     void *tupleBuffer = &tup->dataBegin;
     BF_write((BF_MessageElement *) &schemaDisk, tupleBuffer, BF_NUM_ELEMENTS(sizeof(schemaDisk)));
-    if ((rc = forcePage(pool, &pageHandle)) != RC_OK) {
+    if ((rc = markDirty(pool, &pageHandle)) != RC_OK) {
         goto finally;
     }
 
+    // the cache was loaded by the lookup above, keep it complete
+    Schema tableSchema = *schema;
+    tableSchema.dataPageNum = dataPageNum;
+    tableSchema.fsmPageNum = fsmPageNum;
+    RM_Catalog_putTable(g_instance->catalog, RM_CatalogTable_create(name, &tableSchema, pageHandle.pageNum));
+
     rc = RC_OK;
 
     finally:
@@ -232,8 +439,11 @@ RC createTable (char *name, Schema *schema)
         return rc;
 }
 
+// Finds the schema tuple of `name` on the schema page `pageNum`, which is
+// left pinned in `page_out`
 RC findTable(
         char *name,
+        PageNumber pageNum,
         BM_PageHandle *page_out,
         struct RM_PageTuple **tup_out,
         struct RM_SCHEMA_FORMAT_T *msg_out)
@@ -242,7 +452,7 @@ RC findTable(
     BM_BufferPool *pool = g_instance->bufferPool;
     BM_PageHandle pageHandle = {};
     //store the schema page in pageHandle
-    TRY_OR_RETURN(pinPage(pool, &pageHandle, RM_PAGE_SCHEMA));
+    TRY_OR_RETURN(pinPage(pool, &pageHandle, pageNum));
     //open the schema page and store the header and data
     RM_Page *pg = (RM_Page*) pageHandle.buffer;
     RM_PageHeader *hdr = &pg->header;
@@ -258,6 +468,9 @@ RC findTable(
     for (int i = 0; i < num; i++) {
         size_t slot = i * sizeof(RM_PageSlotPtr);
         off = (RM_PageSlotPtr *) (&pg->dataBegin + slot);
+        if (*off == RM_PAGE_SLOT_DEAD) {
+            continue;
+        }
         if (*off >= RM_PAGE_DATA_SIZE) {
             PANIC("tuple offset cannot be greater than page data size");
         }
@@ -282,6 +495,7 @@ RC findTable(
     }
 
     if (!hit) {
+        TRY_OR_RETURN(unpinPage(pool, &pageHandle));
         return RC_RM_UNKNOWN_TABLE;
     }
     
@@ -301,67 +515,37 @@ RC findTable(
 }
 
 typedef struct RM_TableMetadata {
-    BM_PageHandle schemaHandle;
+    RM_CatalogTable *table;     // holds a reference on the catalog entry
+    RM_FSM fsm;
 } RM_TableMetadata;
 
-//move a table to memory by reading it from disk
+// Open a table by its catalog entry, the schema is shared with the catalog
+// and stays valid until the table is closed, even if it is deleted meanwhile
 RC openTable (RM_TableData *rel, char *name)
 {
-    int i;
-    RC rc;
-    
-    struct RM_SCHEMA_FORMAT_T schemaMsg = {};
+    RM_CatalogTable *table;
+    TRY_OR_RETURN(RM_lookupTable(name, &table));
+
     RM_TableMetadata *meta = malloc(sizeof(RM_TableMetadata));
-    if ((rc = findTable(name, &meta->schemaHandle, NULL, &schemaMsg))!=RC_OK) {
-        free(meta);
-        return rc;
-    }
-    
+    RM_CatalogTable_retain(table);
+    meta->table = table;
+    RM_FSM_init(&meta->fsm, table->schema.fsmPageNum);
+
+    rel->name = table->name;
+    rel->schema = &table->schema;
     rel->mgmtData = meta;
-    
-    int numKeys = BF_ARRAY_U8_LEN(schemaMsg.tblKeys);
-    int numAttrs = BF_AS_U8(schemaMsg.tblNumAttr);
-    rel->name = BF_AS_STR(schemaMsg.tblName);
-    rel->schema = malloc(sizeof(struct Schema));
-    rel->schema->dataPageNum = BF_AS_U16(schemaMsg.tblDataPageNum);
-    rel->schema->numAttr = numAttrs;
-    rel->schema->keySize = numKeys;
-    rel->schema->keyAttrs = calloc(numKeys, sizeof(int));
-    uint8_t *keyIndexes = BF_AS_ARRAY_U8(schemaMsg.tblKeys);
-    for (i = 0; i < numKeys; i++) {
-        rel->schema->keyAttrs[i] = keyIndexes[i];
-    }
-    rel->schema->dataTypes = calloc(numAttrs, sizeof(enum DataType));
-    rel->schema->attrNames = calloc(numAttrs, sizeof(char *));
-    rel->schema->typeLength = calloc(numAttrs, sizeof(int));
-    struct RM_SCHEMA_ATTR_FORMAT_T *dataTypes = (struct RM_SCHEMA_ATTR_FORMAT_T *) BF_AS_ARRAY_MSG(schemaMsg.tblAttrs);
-    for (i = 0; i < numAttrs; i++) {
-        struct RM_SCHEMA_ATTR_FORMAT_T *attr = &dataTypes[i];
-        rel->schema->dataTypes[i] = BF_AS_U8(attr->attrType);
-        rel->schema->typeLength[i] = BF_AS_U8(attr->attrTypeLen);
-        rel->schema->attrNames[i] = BF_AS_STR(attr->attrName);
-    }
-    
     return RC_OK;
 }
 
 RC closeTable (RM_TableData *rel)
 {
-    BM_BufferPool *pool = g_instance->bufferPool;
     RM_TableMetadata *meta = rel->mgmtData;
 
-    // decrease reference to schema table
-    unpinPage(pool, &meta->schemaHandle);
-
-    //write all pages back to disk
-    forceFlushPool(pool);
+    // make the changes durable through the log, pages are written back lazily
+    WAL_commit(g_instance->wal);
 
-    //free schema then relation
-    free(rel->schema->attrNames);
-    free(rel->schema->dataTypes);
-    free(rel->schema->typeLength);
-    free(rel->schema->keyAttrs);
-    free(rel->schema);
+    RM_CatalogTable_release(meta->table);
+    free(meta);
 
     // IMPORTANT: caller is in-charge of freeing the structure itself, if necessary
 
@@ -377,7 +561,9 @@ RC deleteTable (char *name)
     struct RM_SCHEMA_FORMAT_T schema = {};
     RM_PageTuple *tup = NULL;
 
-    TRY_OR_RETURN(findTable(name, &schemaPageHandle, &tup, &schema));
+    RM_CatalogTable *table;
+    TRY_OR_RETURN(RM_lookupTable(name, &table));
+    TRY_OR_RETURN(findTable(name, table->pageNum, &schemaPageHandle, &tup, &schema));
     RM_Page *schemaPage = (RM_Page *) schemaPageHandle.buffer;
 
     int lastPageNum = BF_AS_U16(schema.tblDataPageNum);
@@ -391,20 +577,39 @@ RC deleteTable (char *name)
 //        printf("deleteTable('%s'): free page #%d\n", name, lastPageNum);
         RM_Page_init(dataPage, lastPageNum, RM_PAGE_KIND_FREE);
 
-        TRY_OR_RETURN(forcePage(pool, &dataPageHandle));
+        TRY_OR_RETURN(markDirty(pool, &dataPageHandle));
         TRY_OR_RETURN(unpinPage(pool, &dataPageHandle));
 
         lastPageNum = tmpPageNum;
-    } while (lastPageNum > 0);
+    } while (lastPageNum != RM_PAGE_NEXT_PAGENUM_UNSET);
+
+    TRY_OR_RETURN(RM_FSM_freeAll(pool, BF_AS_U16(schema.tblFsmPageNum)));
 
-    RM_Page_deleteTuple(schemaPage, tup->slotId);
+    RM_Page_killTuple(schemaPage, tup->slotId);
+    g_instance->catalog->tableChain.freedPageNum = table->pageNum;
+    RM_Catalog_removeTable(g_instance->catalog, name);
 
-    TRY_OR_RETURN(forcePage(pool, &schemaPageHandle));
+    TRY_OR_RETURN(markDirty(pool, &schemaPageHandle));
     TRY_OR_RETURN(unpinPage(pool, &schemaPageHandle));
 
     return RC_OK;
 }
 
+// Returns the ring strategy a sequential walk should pin pages through after
+// having visited `numPagesVisited` pages, creating it on first use
+static BM_AccessStrategy *RM_getScanStrategy(
+        BM_BufferPool *pool,
+        int numPagesVisited,
+        BM_AccessStrategy **strategy_inout)
+{
+    if (*strategy_inout == NULL
+        && numPagesVisited >= pool->numPages / RM_SCAN_RING_THRESHOLD_DIVISOR)
+    {
+        *strategy_inout = createRingStrategy(pool, RM_SCAN_RING_SIZE);
+    }
+    return *strategy_inout;
+}
+
 int getNumTuples (RM_TableData *rel)
 {
     int totalNumTups = 0;
@@ -412,88 +617,259 @@ int getNumTuples (RM_TableData *rel)
     int pageNum = rel->schema->dataPageNum;
     BM_BufferPool *pool = g_instance->bufferPool;
     BM_PageHandle handle;
+    BM_AccessStrategy *strategy = NULL;
+    int numPagesVisited = 0;
 
     do{
-        if (pinPage(pool, &handle, pageNum) != RC_OK) { return -1; }
+        RM_getScanStrategy(pool, numPagesVisited, &strategy);
+        if (pinPageWithStrategy(pool, &handle, pageNum, strategy) != RC_OK) {
+            totalNumTups = -1;
+            break;
+        }
 
         RM_Page *page = (RM_Page *) handle.buffer;
         RM_PageHeader *header = &page->header;
 
-        uint16_t numTups = header->numTuples;
+        uint16_t numTups = RM_Page_getNumRecords(page);
         totalNumTups += (int) numTups;
         pageNum = header->nextPageNum;
+        numPagesVisited++;
 
-        if (unpinPage(pool, &handle) != RC_OK) { return -1; }
+        if (unpinPage(pool, &handle) != RC_OK) {
+            totalNumTups = -1;
+            break;
+        }
 
-    } while ( pageNum != -1 ); //will quit when there isn't a new page to scan
+    } while (pageNum != RM_PAGE_NEXT_PAGENUM_UNSET); //will quit when there isn't a new page to scan
 
+    freeAccessStrategy(strategy);
     return totalNumTups;
 }
 
+static bool RM_hasVarchar(Schema *schema)
+{
+    for (int i = 0; i < schema->numAttr; i++) {
+        if (schema->dataTypes[i] == DT_VARCHAR) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Bytes of a record its tuple holds: the fixed-size attributes, and the bytes
+// of the varchars up to the last one
+static int RM_getTupleLength(Schema *schema, const char *data)
+{
+    if (!RM_hasVarchar(schema)) {
+        return getRecordSize(schema);
+    }
+
+    int length;
+    getAttrOffset(schema, schema->numAttr, &length);
+    for (int i = 0; i < schema->numAttr; i++) {
+        if (schema->dataTypes[i] != DT_VARCHAR) {
+            continue;
+        }
+        int offset;
+        VarcharRef ref;
+        getAttrOffset(schema, i, &offset);
+        memcpy(&ref, data + offset, sizeof(ref));
+        if (ref.length > 0 && ref.offset + ref.length > length) {
+            length = ref.offset + ref.length;
+        }
+    }
+    return length;
+}
+
+/* Sets DT_VARCHAR attribute `attrNum` to the `len` bytes at `str`. The bytes
+ * of all varchars are packed again right after the fixed-size attributes, in
+ * attribute order, so that a record never holds bytes no attribute uses.
+ */
+static void RM_setVarchar(Record *record, Schema *schema, int attrNum, const char *str, int len)
+{
+    int areaOffset;
+    getAttrOffset(schema, schema->numAttr, &areaOffset);
+    char packed[getRecordSize(schema) - areaOffset];
+    int packedLen = 0;
+
+    for (int i = 0; i < schema->numAttr; i++) {
+        if (schema->dataTypes[i] != DT_VARCHAR) {
+            continue;
+        }
+        int offset;
+        VarcharRef ref;
+        getAttrOffset(schema, i, &offset);
+        memcpy(&ref, record->data + offset, sizeof(ref));
+        const char *bytes = i == attrNum ? str : record->data + ref.offset;
+        uint16_t length = i == attrNum ? len : ref.length;
+        memcpy(packed + packedLen, bytes, length);
+
+        ref.offset = areaOffset + packedLen;
+        ref.length = length;
+        memcpy(record->data + offset, &ref, sizeof(ref));
+        packedLen += length;
+    }
+    memcpy(record->data + areaOffset, packed, packedLen);
+}
+
+// Allocates `numPages` data pages and links them, in order, at the end of the
+// page chain of a table
+static RC RM_appendDataPages(BM_BufferPool *pool, RM_FSM *fsm, int numPages, PageNumber *firstPageNum_out)
+{
+    PageNumber lastPageNum;
+    TRY_OR_RETURN(RM_FSM_getLastDataPage(pool, fsm, &lastPageNum));
+
+    int firstPageNum;
+    TRY_OR_RETURN(RM_Page_allocate(pool, numPages, &firstPageNum));
+    for (int i = 0; i < numPages; i++) {
+        BM_PageHandle pageHandle = {};
+        TRY_OR_RETURN(pinPage(pool, &pageHandle, firstPageNum + i));
+        RM_Page *page = RM_Page_init(pageHandle.buffer, firstPageNum + i, RM_PAGE_KIND_DATA);
+        if (i + 1 < numPages) {
+            page->header.nextPageNum = firstPageNum + i + 1;
+        }
+        uint16_t freeSpace = RM_Page_getFreeSpace(page);
+        TRY_OR_RETURN(markDirty(pool, &pageHandle));
+        TRY_OR_RETURN(unpinPage(pool, &pageHandle));
+        TRY_OR_RETURN(RM_FSM_setPage(pool, fsm, firstPageNum + i, freeSpace));
+    }
+
+    BM_PageHandle lastPageHandle = {};
+    TRY_OR_RETURN(pinPage(pool, &lastPageHandle, lastPageNum));
+    ((RM_Page *) lastPageHandle.buffer)->header.nextPageNum = firstPageNum;
+    TRY_OR_RETURN(markDirty(pool, &lastPageHandle));
+    TRY_OR_RETURN(unpinPage(pool, &lastPageHandle));
+
+    *firstPageNum_out = firstPageNum;
+    return RC_OK;
+}
+
 // handling records in a table
 RC insertRecord (RM_TableData *rel, Record *record)
 {
-    //get page that holds the records for the data. Assume overflow handled in RM_ReserveTuple(...);
-    int pageNum = rel->schema->dataPageNum;
-    if (pageNum == RM_PAGE_SCHEMA || pageNum < 0) {
-        PANIC("bad data page num %d for table '%s'", pageNum, rel->name);
-    }
+    return insertRecords(rel, &record, 1);
+}
 
+/* Inserts `numRecords` records and sets their RIDs. A page is pinned and
+ * dirtied once for all the records that go into it, and when the table runs
+ * out of room, enough pages for the rest are allocated at once.
+ *
+ * A record too long for any page fails with RC_RM_VALUE_TOO_LONG, the
+ * records before it stay inserted.
+ */
+RC insertRecords (RM_TableData *rel, Record **records, int numRecords)
+{
     BM_BufferPool *pool = g_instance->bufferPool;
-    BP_Metadata *meta = pool->mgmtData;
+    RM_TableMetadata *meta = rel->mgmtData;
 
-    BM_PageHandle pageHandle = {};
+    // records with DT_VARCHAR attributes only take the room their strings do
     size_t recordSize = getRecordSize(rel->schema);
+    bool varying = RM_hasVarchar(rel->schema);
+
+    // the free-space map gives the page to insert into, new pages if none
+    // has room. It may overestimate the room on a page, then it is corrected
+    // once the page is full and asked again.
+    int numInserted = 0;
+    while (numInserted < numRecords) {
+        size_t tupLen = varying ? (size_t) RM_getTupleLength(rel->schema, records[numInserted]->data) : recordSize;
+        size_t spaceRequired = sizeof(RM_PageSlotPtr) + RM_TUP_SIZE(tupLen);
+        if (spaceRequired > RM_PAGE_DATA_SIZE) {
+            return RC_RM_VALUE_TOO_LONG;
+        }
 
-    //loop through all available pages in relation
-    do {
-        TRY_OR_RETURN(pinPage(pool, &pageHandle, pageNum));
+        PageNumber pageNum;
+        TRY_OR_RETURN(RM_FSM_findPage(pool, &meta->fsm, spaceRequired, &pageNum));
+        if (pageNum == NO_PAGE) {
+            int tupsPerPage = RM_PAGE_DATA_SIZE / spaceRequired;
+            int numPages = (numRecords - numInserted + tupsPerPage - 1) / tupsPerPage;
+            numPages = numPages < RM_INSERT_MAX_NEW_PAGES ? numPages : RM_INSERT_MAX_NEW_PAGES;
+            TRY_OR_RETURN(RM_appendDataPages(pool, &meta->fsm, numPages, &pageNum));
+        }
 
+        BM_PageHandle pageHandle = {};
+        TRY_OR_RETURN(pinPage(pool, &pageHandle, pageNum));
         RM_Page *page = (RM_Page *) pageHandle.buffer;
-        RM_PageHeader *pageHeader = &page->header;
 
-        RM_PageTuple *tup = RM_Page_reserveTupleAtEnd(page, recordSize);
-        if (tup == NULL) {
-            unpinPage(pool, &pageHandle);
-            //check overflow pages. if none, create and link them
-            if (pageHeader->nextPageNum != -1) {
-                pageNum = (int) pageHeader->nextPageNum;
-                continue; //try with next page
-            } else {
-                int newpageNum = meta->fileHandle->totalNumPages;
-
-                //create new page
-                BM_PageHandle newdata = {};
-                TRY_OR_RETURN(pinPage(pool, &newdata, newpageNum));
-                RM_Page_init(newdata.buffer, newpageNum, RM_PAGE_KIND_DATA);
-                TRY_OR_RETURN(forcePage(pool, &newdata));
-                TRY_OR_RETURN(unpinPage(pool, &newdata));
-                //link new page to table
-                pageHeader->nextPageNum = newpageNum;
-
-                //set page to reserve tuple and try again
-                pageNum = newpageNum;
-                continue;
+        int numOnPage = 0;
+        RM_PageTuple *tup;
+        while ((tup = RM_Page_reserveTuple(page, tupLen)) != NULL) {
+            Record *record = records[numInserted++];
+            record->id.page = pageNum;
+            record->id.slot = tup->slotId;
+            memcpy(&tup->dataBegin, record->data, tupLen);
+            numOnPage++;
+            if (numInserted == numRecords) {
+                break;
+            }
+            if (varying) {
+                tupLen = RM_getTupleLength(rel->schema, records[numInserted]->data);
             }
-            PANIC("cannot create a new page to insert record");
         }
 
-        record->id.page = pageNum;
-        record->id.slot = tup->slotId;
-        memcpy(&tup->dataBegin, record->data, recordSize);
-
-        TRY_OR_RETURN(markDirty(pool, &pageHandle));
+        // records are left over only if the page filled up
+        bool full = numInserted < numRecords;
+        uint16_t freeSpace = RM_Page_getFreeSpace(page);
+        if (numOnPage > 0) {
+            TRY_OR_RETURN(markDirty(pool, &pageHandle));
+        }
         TRY_OR_RETURN(unpinPage(pool, &pageHandle));
+        if (full) {
+            TRY_OR_RETURN(RM_FSM_setPage(pool, &meta->fsm, pageNum, freeSpace));
+        }
+        if (numOnPage > 0) {
+            TRY_OR_RETURN(WAL_checkpointStep(g_instance->wal, pool));
+        }
+    }
+    return RC_OK;
+}
 
-        //printf("insertRecord: table = \"%s\", rid = %d:%d\n", rel->name, record->id.page, record->id.slot);
-        return RC_OK;
+/* Inserts the record `home` as a tuple on another page, because it no longer
+ * fits on its own, and sets where it went. The tuple starts with `home`, so
+ * that scans return the record with the RID it has always had.
+ */
+static RC RM_moveRecord(RM_TableData *rel, RID home, const char *data, uint16_t len, RM_PageForward *to_out)
+{
+    BM_BufferPool *pool = g_instance->bufferPool;
+    RM_TableMetadata *meta = rel->mgmtData;
 
-    } while (1); // hdr->nextPageNum != -1 );
+    uint16_t tupLen = sizeof(RM_PageForward) + len;
+    size_t spaceRequired = sizeof(RM_PageSlotPtr) + RM_TUP_SIZE(tupLen);
+    if (spaceRequired > RM_PAGE_DATA_SIZE) {
+        return RC_RM_NO_MORE_TUPLES;
+    }
+
+    while (true) {
+        PageNumber pageNum;
+        TRY_OR_RETURN(RM_FSM_findPage(pool, &meta->fsm, spaceRequired, &pageNum));
+        if (pageNum == NO_PAGE) {
+            TRY_OR_RETURN(RM_appendDataPages(pool, &meta->fsm, 1, &pageNum));
+        }
+
+        BM_PageHandle pageHandle = {};
+        TRY_OR_RETURN(pinPage(pool, &pageHandle, pageNum));
+        RM_Page *page = (RM_Page *) pageHandle.buffer;
+        RM_PageTuple *tup = RM_Page_reserveTuple(page, tupLen);
+        if (tup == NULL) {
+            // the free-space map overestimated the room on the page
+            uint16_t freeSpace = RM_Page_getFreeSpace(page);
+            TRY_OR_RETURN(unpinPage(pool, &pageHandle));
+            TRY_OR_RETURN(RM_FSM_setPage(pool, &meta->fsm, pageNum, freeSpace));
+            continue;
+        }
+
+        RM_PageForward from = {home.page, home.slot};
+        memcpy(&tup->dataBegin, &from, sizeof(from));
+        memcpy(&tup->dataBegin + sizeof(from), data, len);
+        tup->len |= RM_TUP_FLAG_MOVED;
+        *to_out = (RM_PageForward) {pageNum, tup->slotId};
+
+        TRY_OR_RETURN(markDirty(pool, &pageHandle));
+        return unpinPage(pool, &pageHandle);
+    }
 }
 
-/* Finds the record using an RID and deletes it from table. 
- * Also sets flags for additional slot ptrs
- * 
+/* Finds the record using an RID and deletes it from table. Its slot is left
+ * as a tombstone, so the RIDs of the other records stay valid.
  */
 RC deleteRecord (RM_TableData *rel, RID id)
 {
@@ -504,27 +880,123 @@ RC deleteRecord (RM_TableData *rel, RID id)
     TRY_OR_RETURN(pinPage(pool, &handle, id.page)); //page nonexistent or RC_OK
     RM_Page *page = (RM_Page *) handle.buffer;
 
-    RM_Page_deleteTuple(page, id.slot);
+    RM_PageTuple *tup = RM_Page_getLiveTuple(page, id.slot);
+    if (tup == NULL) {
+        TRY_OR_RETURN(unpinPage(pool, &handle));
+        return RC_RM_UNKNOWN_RECORD;
+    }
 
+    // a record that moved is deleted where it is, then its address
+    if (tup->len & RM_TUP_FLAG_FORWARD) {
+        RM_PageForward to;
+        memcpy(&to, &tup->dataBegin, sizeof(to));
+        TRY_OR_RETURN(deleteRecord(rel, (RID) {to.pageNum, to.slotId}));
+    }
+
+    RM_Page_killTuple(page, id.slot);
+    uint16_t freeSpace = RM_Page_getFreeSpace(page);
+
+    TRY_OR_RETURN(markDirty(pool, &handle));
+    TRY_OR_RETURN(unpinPage(pool, &handle));
+
+    // let inserts find the space again
+    RM_TableMetadata *meta = rel->mgmtData;
+    TRY_OR_RETURN(RM_FSM_raisePage(pool, &meta->fsm, id.page, freeSpace));
+    return WAL_checkpointStep(g_instance->wal, pool);
+}
+
+/* Writes the record over the one with its RID, which may have moved. A
+ * record that grows past the room on the page it is on moves to a page with
+ * room, and the tuple of its RID is left holding its address.
+ */
+static RC RM_updateMovedRecord(RM_TableData *rel, RM_Page *home, Record *record, uint16_t len)
+{
+    BM_BufferPool *pool = g_instance->bufferPool;
+    RM_TableMetadata *meta = rel->mgmtData;
+
+    // tuples of `home` move when it is compacted, they are looked up by slot
+    RM_PageForward to;
+    memcpy(&to, &RM_Page_getTuple(home, record->id.slot, NULL)->dataBegin, sizeof(to));
+    BM_PageHandle handle;
+    TRY_OR_RETURN(pinPage(pool, &handle, to.pageNum));
+    RM_Page *page = (RM_Page *) handle.buffer;
+
+    RM_PageTuple *tup = RM_Page_resizeTuple(page, to.slotId, sizeof(RM_PageForward) + len);
+    if (tup != NULL) {
+        memcpy(RM_TUP_RECORD(tup), record->data, len);
+        TRY_OR_RETURN(markDirty(pool, &handle));
+        return unpinPage(pool, &handle);
+    }
+
+    // outgrew the page it moved to as well
+    RM_Page_killTuple(page, to.slotId);
+    uint16_t freeSpace = RM_Page_getFreeSpace(page);
     TRY_OR_RETURN(markDirty(pool, &handle));
     TRY_OR_RETURN(unpinPage(pool, &handle));
+    TRY_OR_RETURN(RM_FSM_raisePage(pool, &meta->fsm, to.pageNum, freeSpace));
+
+    TRY_OR_RETURN(RM_moveRecord(rel, record->id, record->data, len, &to));
+    memcpy(&RM_Page_getTuple(home, record->id.slot, NULL)->dataBegin, &to, sizeof(to));
     return RC_OK;
 }
 
-//take a record that exists in the table and update it
+/* Writes `record` over the record with its RID. A record with varchars that
+ * grew stays on its page while the page has room for it, and is moved to
+ * another page otherwise, see `RM_moveRecord`. Its RID stays valid either way.
+ */
 RC updateRecord (RM_TableData *rel, Record *record)
 {
     BM_BufferPool *pool = g_instance->bufferPool;
     BM_PageHandle handle;
+    uint16_t len = RM_getTupleLength(rel->schema, record->data);
 
     //pin page containing record if it exists
     TRY_OR_RETURN(pinPage(pool, &handle, record->id.page)); //page nonexistent or RC_OK
     RM_Page *page = (RM_Page *) handle.buffer;
 
-    RM_Page_setTuple(page, record);
+    RM_PageTuple *tup = RM_Page_getLiveTuple(page, record->id.slot);
+    if (tup == NULL) {
+        TRY_OR_RETURN(unpinPage(pool, &handle));
+        return RC_RM_UNKNOWN_RECORD;
+    }
+    if (tup->len & RM_TUP_FLAG_FORWARD) {
+        TRY_OR_RETURN(RM_updateMovedRecord(rel, page, record, len));
+    } else if ((tup = RM_Page_resizeTuple(page, record->id.slot, len)) != NULL) {
+        memcpy(&tup->dataBegin, record->data, len);
+    } else {
+        RM_PageForward to;
+        TRY_OR_RETURN(RM_moveRecord(rel, record->id, record->data, len, &to));
+        tup = RM_Page_resizeTuple(page, record->id.slot, sizeof(to));
+        tup->len |= RM_TUP_FLAG_FORWARD;
+        memcpy(&tup->dataBegin, &to, sizeof(to));
+        page->header.flags |= RM_PAGE_FLAGS_HAS_FORWARDS;
+    }
 
     TRY_OR_RETURN(markDirty(pool, &handle));
     TRY_OR_RETURN(unpinPage(pool, &handle));
+    return WAL_checkpointStep(g_instance->wal, pool);
+}
+
+/* Pins the page the record `id` is on, following the address it left behind
+ * if it moved, and returns its tuple. RC_RM_UNKNOWN_RECORD if it was deleted.
+ */
+static RC RM_pinRecord(RID id, BM_PageHandle *handle, RM_PageTuple **tup_out)
+{
+    BM_BufferPool *pool = g_instance->bufferPool;
+    TRY_OR_RETURN(pinPage(pool, handle, id.page));
+    RM_PageTuple *tup = RM_Page_getLiveTuple((RM_Page *) handle->buffer, id.slot);
+    if (tup == NULL) {
+        TRY_OR_RETURN(unpinPage(pool, handle));
+        return RC_RM_UNKNOWN_RECORD;
+    }
+    if (tup->len & RM_TUP_FLAG_FORWARD) {
+        RM_PageForward to;
+        memcpy(&to, &tup->dataBegin, sizeof(to));
+        TRY_OR_RETURN(unpinPage(pool, handle));
+        TRY_OR_RETURN(pinPage(pool, handle, to.pageNum));
+        tup = RM_Page_getTuple((RM_Page *) handle->buffer, to.slotId, NULL);
+    }
+    *tup_out = tup;
     return RC_OK;
 }
 
@@ -532,22 +1004,60 @@ RC getRecord (RM_TableData *rel, RID id, Record *record) //assume RID points to
 {
     BM_BufferPool *pool = g_instance->bufferPool;
     BM_PageHandle handle;
+    RM_PageTuple *tup;
+    TRY_OR_RETURN(RM_pinRecord(id, &handle, &tup));
 
-    //pin page containing record if it exists
-    TRY_OR_RETURN(pinPage(pool, &handle, id.page)); //page nonexistent or RC_OK
-    RM_Page *page = (RM_Page *) handle.buffer;
+    //copy the data out so the record outlives the pin, with room for its
+    //varchars to grow through `setAttr`
+    size_t len = RM_TUP_RECORD_LEN(tup);
+    size_t size = getRecordSize(rel->schema);
+    record->id = id;
+    record->data = malloc(len > size ? len : size);
+    memcpy(record->data, RM_TUP_RECORD(tup), len);
 
-    RM_Page_getRecord(page, record, id);
     unpinPage(pool, &handle);
     return RC_OK;
 }
 
+/* Like `getRecord`, without copying: `view->record.data` points into the
+ * frame of the page, which stays pinned until `releaseRecordView`. The view
+ * must not be written through.
+ */
+RC getRecordView (RM_TableData *rel IGNORE_UNUSED, RID id, RM_RecordView *view)
+{
+    RM_PageTuple *tup;
+    TRY_OR_RETURN(RM_pinRecord(id, &view->pageHandle, &tup));
+    view->record.id = id;
+    view->record.data = RM_TUP_RECORD(tup);
+    return RC_OK;
+}
+
+RC releaseRecordView (RM_RecordView *view)
+{
+    view->record.data = NULL;
+    return unpinPage(g_instance->bufferPool, &view->pageHandle);
+}
+
 // scans
 /* Starting a scan initializes the RM_ScanHandle data structure passed as an argument to startScan */
 RC startScan (RM_TableData *rel, RM_ScanHandle *scan, Expr *cond)
 {
+    RM_ScanData *scanData = malloc(sizeof(RM_ScanData));
+    scanData->cond = cond;
+    // expressions that do not compile are left to `evalExpr`
+    scanData->program = NULL;
+    if (cond != NULL && compileExpr(cond, rel->schema, &scanData->program) != RC_OK) {
+        scanData->program = NULL;
+    }
+    scanData->numPagesVisited = 0;
+    scanData->strategy = NULL;
+    scanData->pinned = false;
+    scanData->projection = NULL;
+    scanData->numProjectionRuns = 0;
+    scanData->projectedVarcharOffset = 0;
+
     scan->rel = rel;
-    scan->mgmtData = (void*)cond;
+    scan->mgmtData = scanData;
     scan->lastRID = malloc(sizeof(RID));
     //start from beginning
     scan->lastRID->page = rel->schema->dataPageNum;
@@ -555,84 +1065,539 @@ RC startScan (RM_TableData *rel, RM_ScanHandle *scan, Expr *cond)
     return RC_OK;
 }
 
-//NOTE: if cond is NULL, then we will get all tuples
-RC next(RM_ScanHandle *scan, Record *record)
+// Bytes of an attribute in a record, as `getAttr` reads them
+static int RM_getAttrSize(Schema *schema, int attrNum)
+{
+    switch (schema->dataTypes[attrNum]) {
+        case DT_INT: return sizeof(int);
+        case DT_BOOL: return sizeof(bool);
+        case DT_FLOAT: return sizeof(float);
+        case DT_STRING: return schema->typeLength[attrNum];
+        case DT_VARCHAR: return sizeof(VarcharRef);
+        default:
+            PANIC("unhandled datatype: dt = %d", schema->dataTypes[attrNum]);
+    }
+}
+
+/* Like `startScan`, but `next` and `nextBatch` only copy the attributes
+ * `attrs` of each record, in that order, laid out as in the schema returned
+ * by `createProjectedSchema` for the same attributes. The condition is still
+ * evaluated on the whole tuple, and `nextView` still borrows whole tuples.
+ */
+RC startProjectedScan (RM_TableData *rel, RM_ScanHandle *scan, Expr *cond, int numAttrs, int *attrs)
+{
+    Schema *schema = rel->schema;
+    for (int i = 0; i < numAttrs; i++) {
+        if (attrs[i] < 0 || attrs[i] >= schema->numAttr) {
+            return RC_RM_ATTR_NUM_OUT_OF_BOUNDS;
+        }
+    }
+    TRY_OR_RETURN(startScan(rel, scan, cond));
+
+    // one copy per run of attributes that stay next to each other
+    RM_ScanData *scanData = scan->mgmtData;
+    scanData->projection = malloc((numAttrs > 0 ? numAttrs : 1) * sizeof(RM_ProjectionRun));
+    int dstOffset = 0;
+    for (int i = 0; i < numAttrs; i++) {
+        int srcOffset;
+        TRY_OR_RETURN(getAttrOffset(schema, attrs[i], &srcOffset));
+        int length = RM_getAttrSize(schema, attrs[i]);
+        bool varchar = schema->dataTypes[attrs[i]] == DT_VARCHAR;
+
+        RM_ProjectionRun *last = scanData->numProjectionRuns > 0
+                ? &scanData->projection[scanData->numProjectionRuns - 1]
+                : NULL;
+        if (last != NULL
+            && !varchar
+            && !last->varchar
+            && last->srcOffset + last->length == srcOffset
+            && last->dstOffset + last->length == dstOffset) {
+            last->length += length;
+        } else {
+            scanData->projection[scanData->numProjectionRuns++] = (RM_ProjectionRun) {
+                .srcOffset = srcOffset,
+                .dstOffset = dstOffset,
+                .length = length,
+                .varchar = varchar,
+            };
+        }
+
+        // the projected schema lays attributes out the same way
+        int nextOffset;
+        TRY_OR_RETURN(getAttrOffset(schema, attrs[i] + 1, &nextOffset));
+        dstOffset += nextOffset - srcOffset;
+    }
+    scanData->projectedVarcharOffset = dstOffset;
+    return RC_OK;
+}
+
+// Whether a record satisfies the condition of a scan, all records do without one
+static bool RM_matchesCondition(Record *record, Schema *schema, Expr *cond, ExprProgram *program)
+{
+    if (cond == NULL) {
+        return true;
+    }
+    if (program != NULL) {
+        return evalExprProgram(program, record->data);
+    }
+    Value *result = NULL;
+    if (evalExpr(record, schema, cond, &result) != RC_OK) {
+        return false;
+    }
+    bool hit = result->v.boolV == true;
+    freeVal(result);
+    return hit;
+}
+
+// Sets bit i of `selection` if tuple i satisfies the condition of a scan, for
+// up to EXPR_BATCH_SIZE tuples
+static void RM_selectTuples(
+        Schema *schema,
+        Expr *cond,
+        ExprProgram *program,
+        const char *const *tupData,
+        int numTuples,
+        uint64_t *selection)
+{
+    if (cond == NULL) {
+        memset(selection, 0xff, EXPR_BATCH_WORDS * sizeof(uint64_t));
+    } else if (program != NULL) {
+        evalExprProgramBatch(program, tupData, numTuples, selection);
+    } else {
+        memset(selection, 0, EXPR_BATCH_WORDS * sizeof(uint64_t));
+        for (int i = 0; i < numTuples; i++) {
+            Record view = { .data = (char *) tupData[i] };
+            selection[i / 64] |= (uint64_t) RM_matchesCondition(&view, schema, cond, NULL) << (i % 64);
+        }
+    }
+}
+
+// The records of a run of slots of a page, as scans see them
+typedef struct RM_ScanBatch {
+    const char *tupData[EXPR_BATCH_SIZE];
+    uint16_t lens[EXPR_BATCH_SIZE];
+    RID ids[EXPR_BATCH_SIZE];
+    int numTuples;
+} RM_ScanBatch;
+
+// Gathers the records in the `numSlots` slots from `slot` on, skipping the
+// addresses of moved ones, see `RM_Page_getScanRecord`
+static void RM_gatherBatch(RM_Page *page, int slot, int numSlots, RM_ScanBatch *batch)
+{
+    int n = 0;
+    for (int i = 0; i < numSlots; i++) {
+        Record view;
+        if (RM_Page_getScanRecord(page, slot + i, &view, &batch->lens[n])) {
+            batch->tupData[n] = view.data;
+            batch->ids[n] = view.id;
+            n++;
+        }
+    }
+    batch->numTuples = n;
+}
+
+// Pins the page of `lastRID` unless the scan already holds it
+static RC RM_pinScanPage(RM_ScanHandle *scan)
 {
     BM_BufferPool *pool = g_instance->bufferPool;
-    
-    //unpack
-    Expr *cond = (Expr *)(scan->mgmtData);
-    RM_TableData *rel = scan->rel;
+    RM_ScanData *scanData = scan->mgmtData;
     RID *rid = scan->lastRID;
-    BM_PageHandle handle;
-    bool hit = false;
+    if (scanData->pinned) {
+        return RC_OK;
+    }
 
-    //try to gettuple THEN check if it works with expr
-    do{
-        if (pinPage(pool, &handle, rid->page) != RC_OK) { return -1; }
-        //get page
-        RM_Page *page = (RM_Page *) handle.buffer;
-        RM_PageHeader *header = &page->header;
+    BM_AccessStrategy *strategy = RM_getScanStrategy(
+            pool,
+            scanData->numPagesVisited,
+            &scanData->strategy);
+    TRY_OR_RETURN(pinPageWithStrategy(pool, &scanData->pageHandle, rid->page, strategy));
+    scanData->pinned = true;
+
+    // start reading the next page in the chain while this one is walked
+    PageNumber nextPageNum = ((RM_Page *) scanData->pageHandle.buffer)->header.nextPageNum;
+    if (rid->slot == 0 && nextPageNum != RM_PAGE_NEXT_PAGENUM_UNSET) {
+        prefetchPageWithStrategy(pool, nextPageNum, strategy);
+    }
+    return RC_OK;
+}
 
-        //check if tuple slot exists
-        if (rid->slot < header->numTuples){ //either there is a tuple in the page or another one
-           
-            //tuple exists. get it and check cond and return
-            Record *tmp = alloca(sizeof(Record));
-            getRecord(rel, *rid, tmp);
-
-            Value *result = (Value *) alloca(sizeof(Value));
-            //check condition here (call evalExpr)
-            evalExpr(tmp, rel->schema, cond, &result);
-            if(result->v.boolV == true){
-                //MARKER(result->v.boolV);
-                hit = true;
-                getRecord(rel, *rid, record);
-            }
+// Unpins the page the scan is on and moves to the next one in the chain,
+// RC_RM_NO_MORE_TUPLES if it was the last
+static RC RM_nextScanPage(RM_ScanHandle *scan)
+{
+    RM_ScanData *scanData = scan->mgmtData;
+    RID *rid = scan->lastRID;
+
+    int32_t nextPageNum = ((RM_Page *) scanData->pageHandle.buffer)->header.nextPageNum;
+    scanData->pinned = false;
+    TRY_OR_RETURN(unpinPage(g_instance->bufferPool, &scanData->pageHandle));
+    if (nextPageNum == RM_PAGE_NEXT_PAGENUM_UNSET) {
+        return RC_RM_NO_MORE_TUPLES;
+    }
+
+    rid->page = nextPageNum;
+    rid->slot = 0;
+    scanData->numPagesVisited++;
+    return RC_OK;
+}
+
+/* Points `record` at the next tuple that satisfies the condition of the
+ * scan, in the frame of its page, and sets how many bytes it has.
+ *
+ * The scan keeps the page it is on pinned between calls and walks its slots
+ * in place: the condition is evaluated on the tuple bytes in the page. The
+ * page is unpinned when the scan moves on to the next one in the chain.
+ */
+static RC RM_nextTuple(RM_ScanHandle *scan, Record *record, uint16_t *len_out)
+{
+    RM_ScanData *scanData = scan->mgmtData;
+    Schema *schema = scan->rel->schema;
+    RID *rid = scan->lastRID;
+
+    while (true) {
+        TRY_OR_RETURN(RM_pinScanPage(scan));
+
+        RM_Page *page = (RM_Page *) scanData->pageHandle.buffer;
+        while (rid->slot < page->header.numTuples) {
+            bool isRecord = RM_Page_getScanRecord(page, rid->slot, record, len_out);
             rid->slot++;
 
-            if (hit) {
-                if (unpinPage(pool, &handle) != RC_OK) { return -1; }
-                //printf("Scan: found Tuple\n");
+            if (isRecord && RM_matchesCondition(record, schema, scanData->cond, scanData->program)) {
                 return RC_OK;
             }
+        }
+
+        TRY_OR_RETURN(RM_nextScanPage(scan));
+    }
+}
+
+// Copies a tuple into `record->data`, only the projected attributes if the
+// scan has a projection
+static void RM_copyOut(RM_ScanData *scanData, Record *record, const char *tupData, size_t len)
+{
+    if (scanData->projection == NULL) {
+        memcpy(record->data, tupData, len);
+        return;
+    }
+    int varcharOffset = scanData->projectedVarcharOffset;
+    for (int i = 0; i < scanData->numProjectionRuns; i++) {
+        RM_ProjectionRun *run = &scanData->projection[i];
+        if (!run->varchar) {
+            memcpy(record->data + run->dstOffset, tupData + run->srcOffset, run->length);
+            continue;
+        }
+        VarcharRef ref;
+        memcpy(&ref, tupData + run->srcOffset, sizeof(ref));
+        memcpy(record->data + varcharOffset, tupData + ref.offset, ref.length);
+        ref.offset = varcharOffset;
+        memcpy(record->data + run->dstOffset, &ref, sizeof(ref));
+        varcharOffset += ref.length;
+    }
+}
+
+// Copies the next record that satisfies the condition into `record->data`
+//NOTE: if cond is NULL, then we will get all tuples
+RC next(RM_ScanHandle *scan, Record *record)
+{
+    Record view;
+    uint16_t len;
+    TRY_OR_RETURN(RM_nextTuple(scan, &view, &len));
+
+    record->id = view.id;
+    RM_copyOut(scan->mgmtData, record, view.data, len);
+    return RC_OK;
+}
+
+/* Like `next`, without copying: `record->data` points into the frame of the
+ * page the scan is on. It stays valid until the next call to `next`,
+ * `nextView` or `closeScan`, which release it, and must not be written
+ * through.
+ */
+RC nextView(RM_ScanHandle *scan, Record *record)
+{
+    uint16_t len;
+    return RM_nextTuple(scan, record, &len);
+}
+
+/* Copies up to `maxRecords` records that satisfy the condition of the scan
+ * into `records`, and how many into `numRecords_out`. RC_RM_NO_MORE_TUPLES
+ * once there are none left.
+ *
+ * The condition is evaluated on up to EXPR_BATCH_SIZE tuples of a page at a
+ * time, see `evalExprProgramBatch`, and never on more tuples than there is
+ * room left for, so that no tuple is evaluated twice.
+ */
+RC nextBatch(RM_ScanHandle *scan, Record **records, int maxRecords, int *numRecords_out)
+{
+    RM_ScanData *scanData = scan->mgmtData;
+    Schema *schema = scan->rel->schema;
+    RID *rid = scan->lastRID;
+
+    int numRecords = 0;
+    *numRecords_out = 0;
+    if (maxRecords <= 0) {
+        return RC_OK;
+    }
+
+    while (numRecords < maxRecords) {
+        TRY_OR_RETURN(RM_pinScanPage(scan));
+        RM_Page *page = (RM_Page *) scanData->pageHandle.buffer;
+        int numTuples = page->header.numTuples;
+        if (rid->slot >= numTuples) {
+            RC rc = RM_nextScanPage(scan);
+            if (rc == RC_RM_NO_MORE_TUPLES) {
+                break;
+            }
+            TRY_OR_RETURN(rc);
             continue;
-            //set up to check next tuple or quit
-            if (rid->slot == header->numTuples){
-                if(header->nextPageNum != -1){ 
-                    free(rid);
-                    if (unpinPage(pool, &handle) != RC_OK) { return -1; }
-                    return RC_RM_NO_MORE_TUPLES; 
-                }
-                else {  
-                    rid->page = header->nextPageNum;
-                    if (unpinPage(pool, &handle) != RC_OK) { return -1; }
-                    rid->slot = 0;
-                    continue;
-                }
+        }
+
+        int batchSize = numTuples - rid->slot;
+        batchSize = batchSize < maxRecords - numRecords ? batchSize : maxRecords - numRecords;
+        batchSize = batchSize < EXPR_BATCH_SIZE ? batchSize : EXPR_BATCH_SIZE;
+
+        RM_ScanBatch batch;
+        RM_gatherBatch(page, rid->slot, batchSize, &batch);
+
+        uint64_t selection[EXPR_BATCH_WORDS];
+        RM_selectTuples(schema, scanData->cond, scanData->program, batch.tupData, batch.numTuples, selection);
+
+        for (int i = 0; i < batch.numTuples; i++) {
+            if ((selection[i / 64] >> (i % 64)) & 1u) {
+                Record *record = records[numRecords++];
+                record->id = batch.ids[i];
+                RM_copyOut(scanData, record, batch.tupData[i], batch.lens[i]);
             }
         }
-        else if(header->nextPageNum != -1){ //case where tup in a diff page
-            rid->page = header->nextPageNum;
-            if (unpinPage(pool, &handle) != RC_OK) { return -1; }
-            continue;   //try all pages
+        rid->slot += batchSize;
+    }
+
+    *numRecords_out = numRecords;
+    return numRecords > 0 ? RC_OK : RC_RM_NO_MORE_TUPLES;
+}
+
+// A parallel scan in progress, shared by its workers
+typedef struct RM_ParallelScan {
+    RM_TableData *rel;
+    Expr *cond;
+    ExprProgram *program;
+    RM_ScanConsumer consume;
+    void *ctx;
+
+    PageNumber *pageNums;       // data pages of the table
+    int numPages;
+    int numMorsels;
+    int nextMorsel;             // next morsel to hand out, atomic
+    bool stop;                  // a worker failed, atomic
+
+    // the buffer pool has a single owner at a time, the worker holding this
+    pthread_mutex_t poolLock;
+} RM_ParallelScan;
+
+typedef struct RM_ScanWorker {
+    RM_ParallelScan *scan;
+    int index;
+    pthread_t thread;
+    Record **buffer;            // output buffer, handed to the consumer when full
+    int numBuffered;
+    int numPagesVisited;
+    BM_AccessStrategy *strategy;
+    RC rc;
+} RM_ScanWorker;
+
+static RC RM_flushScanWorker(RM_ScanWorker *worker)
+{
+    RM_ParallelScan *scan = worker->scan;
+    if (worker->numBuffered == 0) {
+        return RC_OK;
+    }
+    RC rc = scan->consume(scan->ctx, worker->index, worker->buffer, worker->numBuffered);
+    worker->numBuffered = 0;
+    return rc;
+}
+
+// Evaluates the condition on every tuple of a pinned page, and buffers the
+// ones that satisfy it
+static RC RM_scanWorkerPage(RM_ScanWorker *worker, BM_PageHandle *handle)
+{
+    RM_ParallelScan *scan = worker->scan;
+    Schema *schema = scan->rel->schema;
+    RM_Page *page = (RM_Page *) handle->buffer;
+    int numTuples = page->header.numTuples;
+
+    for (int slot = 0; slot < numTuples; slot += EXPR_BATCH_SIZE) {
+        int batchSize = numTuples - slot < EXPR_BATCH_SIZE ? numTuples - slot : EXPR_BATCH_SIZE;
+        RM_ScanBatch batch;
+        RM_gatherBatch(page, slot, batchSize, &batch);
+
+        uint64_t selection[EXPR_BATCH_WORDS];
+        RM_selectTuples(schema, scan->cond, scan->program, batch.tupData, batch.numTuples, selection);
+
+        for (int i = 0; i < batch.numTuples; i++) {
+            if (((selection[i / 64] >> (i % 64)) & 1u) == 0) {
+                continue;
+            }
+            Record *record = worker->buffer[worker->numBuffered++];
+            record->id = batch.ids[i];
+            memcpy(record->data, batch.tupData[i], batch.lens[i]);
+            if (worker->numBuffered == EXPR_BATCH_SIZE) {
+                TRY_OR_RETURN(RM_flushScanWorker(worker));
+            }
         }
-        else { 
-            if (unpinPage(pool, &handle) != RC_OK) { return -1; }
-            free(rid);
-            return RC_RM_NO_MORE_TUPLES; 
+    }
+    return RC_OK;
+}
+
+// Claims morsels until there are none left. Only calls into the buffer pool
+// are serialized, pages are evaluated concurrently.
+static RC RM_scanMorsels(RM_ScanWorker *worker)
+{
+    RM_ParallelScan *scan = worker->scan;
+    BM_BufferPool *pool = g_instance->bufferPool;
+
+    while (!__atomic_load_n(&scan->stop, __ATOMIC_RELAXED)) {
+        int morsel = __atomic_fetch_add(&scan->nextMorsel, 1, __ATOMIC_RELAXED);
+        if (morsel >= scan->numMorsels) {
+            break;
         }
-        PANIC("control should not reach here");;
-    } while (1); //will quit when there isn't a new page to scan
 
+        int begin = morsel * RM_SCAN_MORSEL_PAGES;
+        int end = begin + RM_SCAN_MORSEL_PAGES < scan->numPages ? begin + RM_SCAN_MORSEL_PAGES : scan->numPages;
+        for (int i = begin; i < end; i++) {
+            BM_PageHandle handle = {};
+            pthread_mutex_lock(&scan->poolLock);
+            BM_AccessStrategy *strategy = RM_getScanStrategy(
+                    pool,
+                    worker->numPagesVisited++,
+                    &worker->strategy);
+            RC rc = pinPageWithStrategy(pool, &handle, scan->pageNums[i], strategy);
+            if (rc == RC_OK && i + 1 < end) {
+                prefetchPageWithStrategy(pool, scan->pageNums[i + 1], strategy);
+            }
+            pthread_mutex_unlock(&scan->poolLock);
+            TRY_OR_RETURN(rc);
+
+            rc = RM_scanWorkerPage(worker, &handle);
+
+            pthread_mutex_lock(&scan->poolLock);
+            RC unpinRc = unpinPage(pool, &handle);
+            pthread_mutex_unlock(&scan->poolLock);
+            TRY_OR_RETURN(rc);
+            TRY_OR_RETURN(unpinRc);
+        }
+    }
+    return RM_flushScanWorker(worker);
+}
+
+static void *RM_scanWorkerMain(void *arg)
+{
+    RM_ScanWorker *worker = arg;
+    worker->rc = RM_scanMorsels(worker);
+    if (worker->rc != RC_OK) {
+        __atomic_store_n(&worker->scan->stop, true, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+/* Scans a whole table on `numWorkers` threads, RM_PARALLEL_SCAN_WORKERS_AUTO
+ * for one per CPU, and returns once every record has been seen.
+ *
+ * The data pages of the table are listed from its free-space map and split
+ * into morsels of RM_SCAN_MORSEL_PAGES consecutive pages, which the workers
+ * claim from a shared counter. Each worker evaluates the condition on its
+ * pages and collects the records that satisfy it in a buffer of its own,
+ * which is handed to `consume` on the worker's thread whenever it fills up.
+ * `workerIndex` is below RM_PARALLEL_SCAN_MAX_WORKERS, so per-worker state
+ * such as partial aggregates can be kept without locking. The records are
+ * reused after `consume` returns, and come in no particular order.
+ *
+ * `consume` must not call into the record manager. A scan stops at the
+ * first error, from the pool or from `consume`, and returns it.
+ */
+RC parallelScan (RM_TableData *rel, Expr *cond, int numWorkers, RM_ScanConsumer consume, void *ctx)
+{
+    BM_BufferPool *pool = g_instance->bufferPool;
+    RM_TableMetadata *meta = rel->mgmtData;
+
+    if (numWorkers == RM_PARALLEL_SCAN_WORKERS_AUTO) {
+        long numCpus = sysconf(_SC_NPROCESSORS_ONLN);
+        numWorkers = numCpus > 0 ? (int) numCpus : 1;
+    }
+    if (numWorkers > RM_PARALLEL_SCAN_MAX_WORKERS) {
+        numWorkers = RM_PARALLEL_SCAN_MAX_WORKERS;
+    }
+
+    RM_ParallelScan scan = {
+        .rel = rel,
+        .cond = cond,
+        .consume = consume,
+        .ctx = ctx,
+    };
+    TRY_OR_RETURN(RM_FSM_listPages(pool, &meta->fsm, &scan.pageNums, &scan.numPages));
+    scan.numMorsels = (scan.numPages + RM_SCAN_MORSEL_PAGES - 1) / RM_SCAN_MORSEL_PAGES;
+    if (cond != NULL && compileExpr(cond, rel->schema, &scan.program) != RC_OK) {
+        scan.program = NULL;
+    }
+    pthread_mutex_init(&scan.poolLock, NULL);
+
+    // the calling thread is worker 0
+    RM_ScanWorker *workers = calloc(numWorkers, sizeof(RM_ScanWorker));
+    for (int i = 0; i < numWorkers; i++) {
+        RM_ScanWorker *worker = &workers[i];
+        worker->scan = &scan;
+        worker->index = i;
+        worker->buffer = malloc(EXPR_BATCH_SIZE * sizeof(Record *));
+        for (int j = 0; j < EXPR_BATCH_SIZE; j++) {
+            createRecord(&worker->buffer[j], rel->schema);
+        }
+        if (i > 0 && pthread_create(&worker->thread, NULL, RM_scanWorkerMain, worker) != 0) {
+            PANIC("pthread_create: failed to start a scan worker");
+        }
+    }
+    RM_scanWorkerMain(&workers[0]);
+
+    RC rc = RC_OK;
+    for (int i = 0; i < numWorkers; i++) {
+        RM_ScanWorker *worker = &workers[i];
+        if (i > 0) {
+            pthread_join(worker->thread, NULL);
+        }
+        if (rc == RC_OK) {
+            rc = worker->rc;
+        }
+        freeAccessStrategy(worker->strategy);
+        for (int j = 0; j < EXPR_BATCH_SIZE; j++) {
+            freeRecord(worker->buffer[j]);
+        }
+        free(worker->buffer);
+    }
+
+    free(workers);
+    pthread_mutex_destroy(&scan.poolLock);
+    freeExprProgram(scan.program);
+    free(scan.pageNums);
+    return rc;
 }
 
 /* Closing a scan indicates to the record manager that all associated resources can be cleaned up. */
 RC closeScan (RM_ScanHandle *scan)
 {
     // freeExpr done by caller
-    // scan->lastRID is free'd by next()
-    // unpin pages done in next()
+    RM_ScanData *scanData = scan->mgmtData;
+    if (scanData != NULL) {
+        // the scan was left before it reached the end of the table
+        if (scanData->pinned) {
+            TRY_OR_RETURN(unpinPage(g_instance->bufferPool, &scanData->pageHandle));
+        }
+        freeAccessStrategy(scanData->strategy);
+        freeExprProgram(scanData->program);
+        free(scanData->projection);
+        free(scanData);
+        scan->mgmtData = NULL;
+    }
+
+    free(scan->lastRID);
+    scan->lastRID = NULL;
     return RC_OK;
 } 
 
@@ -642,6 +1607,7 @@ int getRecordSize (Schema *schema)
     PANIC_IF_NULL(schema);
 
     int total = 0;
+    int varcharSize = 0;
     int n = schema->numAttr;
     for (int i = 0; i < n; i++) {
         DataType dt = schema->dataTypes[i];
@@ -650,11 +1616,17 @@ int getRecordSize (Schema *schema)
             case DT_BOOL: total += sizeof(bool); break;
             case DT_FLOAT: total += sizeof(float); break;
             case DT_STRING: total += schema->typeLength[i]; break;
+            case DT_VARCHAR: varcharSize += schema->typeLength[i]; break;
             default:
                 PANIC("unhandled datatype: dt = %d", dt);
         }
     }
 
+    // the bytes of varchars go where `getAttrOffset` ends the fixed-size part
+    if (varcharSize > 0) {
+        getAttrOffset(schema, n, &total);
+        total += varcharSize;
+    }
     return total;
 }
 
@@ -676,6 +1648,44 @@ Schema *createSchema (
     return self;
 }
 
+/* Schema of the records a scan started with `startProjectedScan` on the same
+ * attributes returns. It is allocated in one piece, `freeSchema` frees all
+ * of it, and borrows the attribute names of `schema`.
+ */
+Schema *createProjectedSchema (Schema *schema, int numAttrs, int *attrs)
+{
+    size_t size = sizeof(Schema)
+            + numAttrs * (sizeof(char *) + sizeof(DataType) + 2 * sizeof(int));
+    Schema *self = malloc(size);
+    char **attrNames = (char **) (self + 1);
+    DataType *dataTypes = (DataType *) (attrNames + numAttrs);
+    int *typeLength = (int *) (dataTypes + numAttrs);
+    int *keys = typeLength + numAttrs;
+
+    int keySize = 0;
+    for (int i = 0; i < numAttrs; i++) {
+        attrNames[i] = schema->attrNames[attrs[i]];
+        dataTypes[i] = schema->dataTypes[attrs[i]];
+        typeLength[i] = schema->typeLength[attrs[i]];
+        // only key attributes that were projected stay keys
+        for (int k = 0; k < schema->keySize; k++) {
+            if (schema->keyAttrs[k] == attrs[i]) {
+                keys[keySize++] = i;
+            }
+        }
+    }
+
+    self->numAttr = numAttrs;
+    self->attrNames = attrNames;
+    self->dataTypes = dataTypes;
+    self->typeLength = typeLength;
+    self->keySize = keySize;
+    self->keyAttrs = keys;
+    self->dataPageNum = schema->dataPageNum;
+    self->fsmPageNum = schema->fsmPageNum;
+    return self;
+}
+
 RC freeSchema (Schema *schema)
 {
     free(schema);
@@ -693,6 +1703,10 @@ RC createRecord (Record **record, Schema *schema)
     }
 
     r->data = (char *) r + sizeof(Record);
+    // varchars start out empty
+    if (RM_hasVarchar(schema)) {
+        memset(r->data, 0, size);
+    }
     *record = r;
     return RC_OK;
 }
@@ -731,6 +1745,17 @@ RC getAttr (Record *record, Schema *schema, int attrNum, Value **value)
             break;
         }
 
+        case DT_VARCHAR: {
+            VarcharRef ref;
+            memcpy(&ref, buf, sizeof(ref));
+            char *str = (char *) malloc(ref.length + 1);
+            memcpy(str, record->data + ref.offset, ref.length);
+            str[ref.length] = '\0';
+            result->dt = DT_STRING;
+            result->v.stringV = str;
+            break;
+        }
+
         case DT_BOOL:
             result->v.boolV = *(bool *) buf;
             break;
@@ -776,6 +1801,16 @@ RC setAttr (Record *record, Schema *schema, int attrNum, Value *value)
             break;
         }
 
+        case DT_VARCHAR: {
+            int len = strlen(value->v.stringV);
+            if (len > schema->typeLength[attrNum]) {
+                free(result);
+                return RC_RM_VALUE_TOO_LONG;
+            }
+            RM_setVarchar(record, schema, attrNum, value->v.stringV, len);
+            break;
+        }
+
         case DT_BOOL:
             *(bool *) buf = value->v.boolV;  //set value to buf
             break;
@@ -6,8 +6,13 @@
 #include "tables.h"
 #include "buffer_mgr.h"
 
+struct WAL_Log;
+struct RM_Catalog;
+
 typedef struct RM_Metadata {
     BM_BufferPool *bufferPool;
+    struct WAL_Log *wal;
+    struct RM_Catalog *catalog;
 } RM_Metadata;
 
 extern RM_Metadata *RM_getInstance();
@@ -26,6 +31,20 @@ typedef struct RM_ScanHandle
 	void *mgmtData;
 } RM_ScanHandle;
 
+// Receives the records of a parallel scan, see `parallelScan`
+typedef RC (*RM_ScanConsumer) (void *ctx, int workerIndex, Record **records, int numRecords);
+
+#define RM_PARALLEL_SCAN_WORKERS_AUTO (0)
+#define RM_PARALLEL_SCAN_MAX_WORKERS (64)
+
+// A record borrowed from the page frame it is on: `record.data` points into
+// the frame, which stays pinned until the view is released
+typedef struct RM_RecordView
+{
+	Record record;
+	BM_PageHandle pageHandle;
+} RM_RecordView;
+
 // table and manager
 extern RC initRecordManager (void *mgmtData);
 extern RC shutdownRecordManager ();
@@ -37,18 +56,26 @@ extern int getNumTuples (RM_TableData *rel);
 
 // handling records in a table
 extern RC insertRecord (RM_TableData *rel, Record *record);
+extern RC insertRecords (RM_TableData *rel, Record **records, int numRecords);
 extern RC deleteRecord (RM_TableData *rel, RID id);
 extern RC updateRecord (RM_TableData *rel, Record *record);
 extern RC getRecord (RM_TableData *rel, RID id, Record *record);
+extern RC getRecordView (RM_TableData *rel, RID id, RM_RecordView *view);
+extern RC releaseRecordView (RM_RecordView *view);
 
 // scans
 extern RC startScan (RM_TableData *rel, RM_ScanHandle *scan, Expr *cond);
+extern RC startProjectedScan (RM_TableData *rel, RM_ScanHandle *scan, Expr *cond, int numAttrs, int *attrs);
 extern RC next (RM_ScanHandle *scan, Record *record);
+extern RC nextView (RM_ScanHandle *scan, Record *record);
+extern RC nextBatch (RM_ScanHandle *scan, Record **records, int maxRecords, int *numRecords);
+extern RC parallelScan (RM_TableData *rel, Expr *cond, int numWorkers, RM_ScanConsumer consume, void *ctx);
 extern RC closeScan (RM_ScanHandle *scan);
 
 // dealing with schemas
 extern int getRecordSize (Schema *schema);
 extern Schema *createSchema (int numAttr, char **attrNames, DataType *dataTypes, int *typeLength, int keySize, int *keys);
+extern Schema *createProjectedSchema (Schema *schema, int numAttrs, int *attrs);
 extern RC freeSchema (Schema *schema);
 
 // dealing with records and attribute values
@@ -14,7 +14,7 @@ const struct PACKED_STRUCT RM_SCHEMA_ATTR_FORMAT_T {
         },
         .attrTypeLen = {
                 .name = "attr_type_len",
-                .type = BF_UINT8,
+                .type = BF_UINT16,
         },
         .attrName = {
                 .name = "attr_name",
@@ -25,6 +25,7 @@ const struct PACKED_STRUCT RM_SCHEMA_ATTR_FORMAT_T {
 const struct PACKED_STRUCT RM_SCHEMA_FORMAT_T {
     BF_MessageElement tblName;
     BF_MessageElement tblDataPageNum;
+    BF_MessageElement tblFsmPageNum;
     BF_MessageElement tblKeys;
     BF_MessageElement tblNumAttr;
     BF_MessageElement tblAttrs;
@@ -37,6 +38,10 @@ const struct PACKED_STRUCT RM_SCHEMA_FORMAT_T {
                 .name = "tbl_data_pgnum",
                 .type = BF_UINT16,
         },
+        .tblFsmPageNum = {
+                .name = "tbl_fsm_pgnum",
+                .type = BF_UINT16,
+        },
         .tblNumAttr = {
                 .name = "tbl_num_attr",
                 .type = BF_UINT8,
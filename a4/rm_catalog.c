@@ -0,0 +1,329 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "dt.h"
+#include "rm_macros.h"
+#include "rm_catalog.h"
+#include "record_mgr.h"
+
+// FNV-1a
+static uint32_t
+RM_Catalog_hashName(const char *name)
+{
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *c = (const unsigned char *) name; *c != '\0'; c++) {
+        hash ^= *c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+RM_Catalog *RM_Catalog_create()
+{
+    RM_Catalog *self = malloc(sizeof(RM_Catalog));
+    if (self == NULL) {
+        PANIC("malloc: failed to allocate catalog cache");
+    }
+    self->tables = HashMap_create(RM_CATALOG_NUM_BUCKETS);
+    self->indexes = HashMap_create(RM_CATALOG_NUM_BUCKETS);
+    self->tableChain = (RM_CatalogChain) {RM_PAGE_SCHEMA, NO_PAGE, NO_PAGE};
+    self->indexChain = (RM_CatalogChain) {RM_PAGE_INDEX, NO_PAGE, NO_PAGE};
+    self->tablesLoaded = false;
+    self->indexesLoaded = false;
+    return self;
+}
+
+// Drops every entry of a map whose values are chains linked through `next`
+#define RM_CATALOG_CLEAR(MAP, TYPE, FREE) \
+    do { \
+        for (uint32_t i_ = 0; i_ < (MAP)->numBuckets; i_++) { \
+            for (HS_Node *node_ = &(MAP)->buckets[i_]; node_ != NULL; node_ = node_->next) { \
+                if (!node_->present) { \
+                    continue; \
+                } \
+                TYPE *entry_ = node_->data; \
+                while (entry_ != NULL) { \
+                    TYPE *next_ = entry_->next; \
+                    FREE(entry_); \
+                    entry_ = next_; \
+                } \
+            } \
+        } \
+    } while (0)
+
+void RM_Catalog_free(RM_Catalog *self)
+{
+    if (self == NULL) {
+        return;
+    }
+
+    // tables that are still open keep their entries until they are closed
+    RM_CATALOG_CLEAR(self->tables, RM_CatalogTable, RM_CatalogTable_release);
+    RM_CATALOG_CLEAR(self->indexes, RM_CatalogIndex, free);
+    HashMap_free(self->tables);
+    HashMap_free(self->indexes);
+    free(self);
+}
+
+/*
+ * Catalog pages
+ */
+
+// Leaves the page pinned if it had room, `*tup_out` is NULL if it did not
+static RC
+RM_CatalogChain_tryReserve(
+        BM_BufferPool *pool,
+        PageNumber pageNum,
+        uint16_t len,
+        BM_PageHandle *page_out,
+        RM_PageTuple **tup_out)
+{
+    TRY_OR_RETURN(pinPage(pool, page_out, pageNum));
+    *tup_out = RM_Page_reserveTuple((RM_Page *) page_out->buffer, len);
+    if (*tup_out == NULL) {
+        TRY_OR_RETURN(unpinPage(pool, page_out));
+    }
+    return RC_OK;
+}
+
+/**
+ * Reserves `len` bytes for a new tuple on a page of the chain, and returns
+ * that page pinned. The page a tuple was last deleted from and the last page
+ * are tried, and if neither has room, a page of kind `pageKind` is appended.
+ * The chain has to have been loaded.
+ */
+RC RM_CatalogChain_reserveTuple(
+        BM_BufferPool *pool,
+        RM_CatalogChain *self,
+        uint8_t pageKind,
+        uint16_t len,
+        BM_PageHandle *page_out,
+        RM_PageTuple **tup_out)
+{
+    if (self->lastPageNum == NO_PAGE) {
+        PANIC("catalog chain has not been loaded");
+    }
+
+    RM_PageTuple *tup = NULL;
+    if (self->freedPageNum != NO_PAGE) {
+        TRY_OR_RETURN(RM_CatalogChain_tryReserve(pool, self->freedPageNum, len, page_out, &tup));
+        if (tup == NULL) {
+            self->freedPageNum = NO_PAGE;
+        }
+    }
+    if (tup == NULL) {
+        TRY_OR_RETURN(RM_CatalogChain_tryReserve(pool, self->lastPageNum, len, page_out, &tup));
+    }
+    if (tup != NULL) {
+        *tup_out = tup;
+        return RC_OK;
+    }
+
+    int pageNum;
+    TRY_OR_RETURN(RM_Page_allocate(pool, 1, &pageNum));
+    TRY_OR_RETURN(pinPage(pool, page_out, pageNum));
+    RM_Page *page = RM_Page_init(page_out->buffer, pageNum, pageKind);
+    tup = RM_Page_reserveTuple(page, len);
+    if (tup == NULL) {
+        unpinPage(pool, page_out);
+        return RC_RM_NO_MORE_TUPLES;
+    }
+
+    BM_PageHandle lastPageHandle = {};
+    TRY_OR_RETURN(pinPage(pool, &lastPageHandle, self->lastPageNum));
+    ((RM_Page *) lastPageHandle.buffer)->header.nextPageNum = pageNum;
+    TRY_OR_RETURN(markDirty(pool, &lastPageHandle));
+    TRY_OR_RETURN(unpinPage(pool, &lastPageHandle));
+
+    self->lastPageNum = pageNum;
+    *tup_out = tup;
+    return RC_OK;
+}
+
+/*
+ * Tables
+ */
+
+/**
+ * Returns a copy of `schema`, named `name`, in a single allocation. The
+ * attribute names of `schema` may point into a page frame, the copy does not.
+ */
+RM_CatalogTable *RM_CatalogTable_create(const char *name, Schema *schema, PageNumber pageNum)
+{
+    int numAttrs = schema->numAttr;
+    int numKeys = schema->keySize;
+    size_t namesSize = strlen(name) + 1;
+    for (int i = 0; i < numAttrs; i++) {
+        namesSize += strlen(schema->attrNames[i]) + 1;
+    }
+
+    size_t size = sizeof(RM_CatalogTable)
+            + numAttrs * (sizeof(char *) + sizeof(DataType) + sizeof(int))
+            + numKeys * sizeof(int)
+            + namesSize;
+    RM_CatalogTable *self = malloc(size);
+    if (self == NULL) {
+        PANIC("malloc: failed to allocate catalog entry");
+    }
+
+    char **attrNames = (char **) (self + 1);
+    DataType *dataTypes = (DataType *) (attrNames + numAttrs);
+    int *typeLength = (int *) (dataTypes + numAttrs);
+    int *keys = typeLength + numAttrs;
+    char *names = (char *) (keys + numKeys);
+
+    self->name = names;
+    names = stpcpy(names, name) + 1;
+    for (int i = 0; i < numAttrs; i++) {
+        attrNames[i] = names;
+        names = stpcpy(names, schema->attrNames[i]) + 1;
+        dataTypes[i] = schema->dataTypes[i];
+        typeLength[i] = schema->typeLength[i];
+    }
+    memcpy(keys, schema->keyAttrs, numKeys * sizeof(int));
+
+    self->schema.numAttr = numAttrs;
+    self->schema.attrNames = attrNames;
+    self->schema.dataTypes = dataTypes;
+    self->schema.typeLength = typeLength;
+    self->schema.keyAttrs = keys;
+    self->schema.keySize = numKeys;
+    self->schema.dataPageNum = schema->dataPageNum;
+    self->schema.fsmPageNum = schema->fsmPageNum;
+    self->pageNum = pageNum;
+    self->refCount = 1;
+    self->next = NULL;
+    return self;
+}
+
+void RM_CatalogTable_retain(RM_CatalogTable *table)
+{
+    table->refCount++;
+}
+
+void RM_CatalogTable_release(RM_CatalogTable *table)
+{
+    if (--table->refCount == 0) {
+        free(table);
+    }
+}
+
+RM_CatalogTable *RM_Catalog_getTable(RM_Catalog *self, const char *name)
+{
+    RM_CatalogTable *table = NULL;
+    HashMap_get(self->tables, RM_Catalog_hashName(name), (void **) &table);
+    while (table != NULL && strcmp(table->name, name) != 0) {
+        table = table->next;
+    }
+    return table;
+}
+
+/**
+ * Takes over the reference the caller holds on `table`, and replaces any
+ * entry of the same name.
+ */
+void RM_Catalog_putTable(RM_Catalog *self, RM_CatalogTable *table)
+{
+    RM_Catalog_removeTable(self, table->name);
+
+    uint32_t hash = RM_Catalog_hashName(table->name);
+    RM_CatalogTable *head = NULL;
+    HashMap_get(self->tables, hash, (void **) &head);
+    table->next = head;
+    HashMap_put(self->tables, hash, table);
+}
+
+void RM_Catalog_removeTable(RM_Catalog *self, const char *name)
+{
+    uint32_t hash = RM_Catalog_hashName(name);
+    RM_CatalogTable *head = NULL;
+    if (!HashMap_get(self->tables, hash, (void **) &head)) {
+        return;
+    }
+
+    RM_CatalogTable **link = &head;
+    while (*link != NULL && strcmp((*link)->name, name) != 0) {
+        link = &(*link)->next;
+    }
+    RM_CatalogTable *table = *link;
+    if (table == NULL) {
+        return;
+    }
+    *link = table->next;
+
+    if (head == NULL) {
+        HashMap_remove(self->tables, hash, NULL);
+    } else {
+        HashMap_put(self->tables, hash, head);
+    }
+    RM_CatalogTable_release(table);
+}
+
+/*
+ * Indexes
+ */
+
+RM_CatalogIndex *RM_CatalogIndex_create(const char *name, DataType keyType, IM_IndexMetadata *meta, PageNumber pageNum)
+{
+    size_t nameSize = strlen(name) + 1;
+    RM_CatalogIndex *self = malloc(sizeof(RM_CatalogIndex) + nameSize);
+    if (self == NULL) {
+        PANIC("malloc: failed to allocate catalog entry");
+    }
+
+    self->name = (char *) (self + 1);
+    memcpy(self->name, name, nameSize);
+    self->keyType = keyType;
+    self->meta = *meta;
+    self->pageNum = pageNum;
+    self->next = NULL;
+    return self;
+}
+
+RM_CatalogIndex *RM_Catalog_getIndex(RM_Catalog *self, const char *name)
+{
+    RM_CatalogIndex *index = NULL;
+    HashMap_get(self->indexes, RM_Catalog_hashName(name), (void **) &index);
+    while (index != NULL && strcmp(index->name, name) != 0) {
+        index = index->next;
+    }
+    return index;
+}
+
+// Takes over `index`, and replaces any entry of the same name
+void RM_Catalog_putIndex(RM_Catalog *self, RM_CatalogIndex *index)
+{
+    RM_Catalog_removeIndex(self, index->name);
+
+    uint32_t hash = RM_Catalog_hashName(index->name);
+    RM_CatalogIndex *head = NULL;
+    HashMap_get(self->indexes, hash, (void **) &head);
+    index->next = head;
+    HashMap_put(self->indexes, hash, index);
+}
+
+void RM_Catalog_removeIndex(RM_Catalog *self, const char *name)
+{
+    uint32_t hash = RM_Catalog_hashName(name);
+    RM_CatalogIndex *head = NULL;
+    if (!HashMap_get(self->indexes, hash, (void **) &head)) {
+        return;
+    }
+
+    RM_CatalogIndex **link = &head;
+    while (*link != NULL && strcmp((*link)->name, name) != 0) {
+        link = &(*link)->next;
+    }
+    RM_CatalogIndex *index = *link;
+    if (index == NULL) {
+        return;
+    }
+    *link = index->next;
+
+    if (head == NULL) {
+        HashMap_remove(self->indexes, hash, NULL);
+    } else {
+        HashMap_put(self->indexes, hash, head);
+    }
+    free(index);
+}
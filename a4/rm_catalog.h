@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "hash_map.h"
+#include "dberror.h"
+#include "tables.h"
+#include "btree.h"
+#include "buffer_mgr.h"
+#include "rm_page.h"
+
+// Catalog cache
+//
+// Schema tuples are kept in a chain of catalog pages starting at
+// RM_PAGE_SCHEMA, index descriptors in one starting at RM_PAGE_INDEX, linked
+// through `nextPageNum`. The cache holds decoded copies of them keyed by name,
+// so that opening a table or an index is a hash lookup rather than a walk over
+// the chain. Each half of the cache is loaded from its chain the first time a
+// name is looked up, and is then kept complete: DDL puts the entries it
+// creates and removes the ones it deletes. An entry remembers the catalog
+// page its tuple is on, so that deleting it only has to search that page.
+
+#define RM_CATALOG_NUM_BUCKETS (64)
+
+// A chain of catalog pages
+typedef struct RM_CatalogChain {
+    PageNumber firstPageNum;
+    PageNumber lastPageNum;     // known once the chain has been loaded
+    PageNumber freedPageNum;    // last page a tuple was deleted from, or NO_PAGE
+} RM_CatalogChain;
+
+// A table as described by its schema tuple. The attribute arrays and names of
+// `schema` are part of the same allocation.
+typedef struct RM_CatalogTable {
+    char *name;
+    Schema schema;
+    PageNumber pageNum;             // catalog page of the schema tuple
+    int refCount;                   // one for the catalog, one per open handle
+    struct RM_CatalogTable *next;   // same name hash
+} RM_CatalogTable;
+
+typedef struct RM_CatalogIndex {
+    char *name;
+    DataType keyType;
+    IM_IndexMetadata meta;
+    PageNumber pageNum;             // catalog page of the descriptor
+    struct RM_CatalogIndex *next;   // same name hash
+} RM_CatalogIndex;
+
+typedef struct RM_Catalog {
+    HS_HashMap *tables;     // hash of the name -> RM_CatalogTable chain
+    HS_HashMap *indexes;    // hash of the name -> RM_CatalogIndex chain
+    RM_CatalogChain tableChain;
+    RM_CatalogChain indexChain;
+    bool tablesLoaded;
+    bool indexesLoaded;
+} RM_Catalog;
+
+RM_Catalog *RM_Catalog_create();
+void RM_Catalog_free(RM_Catalog *self);
+
+RC RM_CatalogChain_reserveTuple(
+        BM_BufferPool *pool,
+        RM_CatalogChain *self,
+        uint8_t pageKind,
+        uint16_t len,
+        BM_PageHandle *page_out,
+        RM_PageTuple **tup_out);
+
+RM_CatalogTable *RM_CatalogTable_create(const char *name, Schema *schema, PageNumber pageNum);
+RM_CatalogTable *RM_Catalog_getTable(RM_Catalog *self, const char *name);
+void RM_Catalog_putTable(RM_Catalog *self, RM_CatalogTable *table);
+void RM_Catalog_removeTable(RM_Catalog *self, const char *name);
+void RM_CatalogTable_retain(RM_CatalogTable *table);
+void RM_CatalogTable_release(RM_CatalogTable *table);
+
+RM_CatalogIndex *RM_CatalogIndex_create(const char *name, DataType keyType, IM_IndexMetadata *meta, PageNumber pageNum);
+RM_CatalogIndex *RM_Catalog_getIndex(RM_Catalog *self, const char *name);
+void RM_Catalog_putIndex(RM_Catalog *self, RM_CatalogIndex *index);
+void RM_Catalog_removeIndex(RM_Catalog *self, const char *name);
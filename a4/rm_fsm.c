@@ -0,0 +1,309 @@
+#include <string.h>
+
+#include "dt.h"
+#include "dberror.h"
+#include "rm_page.h"
+#include "rm_macros.h"
+#include "rm_fsm.h"
+#include "buffer_mgr.h"
+
+static uint8_t
+RM_FSM_category(uint16_t freeSpace)
+{
+    uint16_t category = 1 + freeSpace / RM_FSM_CATEGORY_BYTES;
+    return category < RM_FSM_MAX_CATEGORY ? (uint8_t) category : RM_FSM_MAX_CATEGORY;
+}
+
+// Lowest category that guarantees `spaceRequired` free bytes
+static uint8_t
+RM_FSM_minCategory(uint16_t spaceRequired)
+{
+    uint16_t category = 1 + (spaceRequired + RM_FSM_CATEGORY_BYTES - 1) / RM_FSM_CATEGORY_BYTES;
+    return category < RM_FSM_MAX_CATEGORY ? (uint8_t) category : RM_FSM_MAX_CATEGORY;
+}
+
+/**
+ * Returns the `index`-th map page in `mapPageNum_out`, following the chain
+ * past the pages seen so far. Without `create`, NO_PAGE means the map does
+ * not reach that far, with it the missing map pages are allocated.
+ */
+static RC
+RM_FSM_getMapPage(BM_BufferPool *pool, RM_FSM *self, int index, bool create, PageNumber *mapPageNum_out)
+{
+    if (index >= RM_FSM_MAX_MAP_PAGES) {
+        PANIC("page number past the end of the free-space map");
+    }
+
+    while (self->numMapPages <= index) {
+        BM_PageHandle pageHandle = {};
+        TRY_OR_RETURN(pinPage(pool, &pageHandle, self->mapPageNums[self->numMapPages - 1]));
+        RM_Page *page = (RM_Page *) pageHandle.buffer;
+
+        if (page->header.nextPageNum == RM_PAGE_NEXT_PAGENUM_UNSET) {
+            if (!create) {
+                TRY_OR_RETURN(unpinPage(pool, &pageHandle));
+                *mapPageNum_out = NO_PAGE;
+                return RC_OK;
+            }
+
+            int nextPageNum;
+            TRY_OR_RETURN(RM_FSM_create(pool, &nextPageNum));
+            page->header.nextPageNum = nextPageNum;
+            TRY_OR_RETURN(markDirty(pool, &pageHandle));
+        }
+
+        self->mapPageNums[self->numMapPages++] = page->header.nextPageNum;
+        TRY_OR_RETURN(unpinPage(pool, &pageHandle));
+    }
+
+    *mapPageNum_out = self->mapPageNums[index];
+    return RC_OK;
+}
+
+// Sets the category of a page, or only raises it
+static RC
+RM_FSM_update(BM_BufferPool *pool, RM_FSM *self, PageNumber pageNum, uint8_t category, bool onlyRaise)
+{
+    PageNumber mapPageNum;
+    TRY_OR_RETURN(RM_FSM_getMapPage(pool, self, pageNum / RM_FSM_PAGES_PER_MAP_PAGE, true, &mapPageNum));
+
+    BM_PageHandle pageHandle = {};
+    TRY_OR_RETURN(pinPage(pool, &pageHandle, mapPageNum));
+    uint8_t *categories = (uint8_t *) &((RM_Page *) pageHandle.buffer)->dataBegin;
+    uint8_t *entry = &categories[pageNum % RM_FSM_PAGES_PER_MAP_PAGE];
+    if (onlyRaise ? *entry < category : *entry != category) {
+        *entry = category;
+        TRY_OR_RETURN(markDirty(pool, &pageHandle));
+    }
+    TRY_OR_RETURN(unpinPage(pool, &pageHandle));
+    return RC_OK;
+}
+
+// Looks for a page of at least `minCategory` in [begin, end)
+static RC
+RM_FSM_search(
+        BM_BufferPool *pool,
+        RM_FSM *self,
+        uint8_t minCategory,
+        PageNumber begin,
+        PageNumber end,
+        PageNumber *pageNum_out)
+{
+    *pageNum_out = NO_PAGE;
+    for (PageNumber base = begin - begin % RM_FSM_PAGES_PER_MAP_PAGE;
+         base < end;
+         base += RM_FSM_PAGES_PER_MAP_PAGE)
+    {
+        PageNumber mapPageNum;
+        TRY_OR_RETURN(RM_FSM_getMapPage(pool, self, base / RM_FSM_PAGES_PER_MAP_PAGE, false, &mapPageNum));
+        if (mapPageNum == NO_PAGE) {
+            return RC_OK;
+        }
+
+        BM_PageHandle pageHandle = {};
+        TRY_OR_RETURN(pinPage(pool, &pageHandle, mapPageNum));
+        const uint8_t *categories = (const uint8_t *) &((RM_Page *) pageHandle.buffer)->dataBegin;
+        int first = base < begin ? begin - base : 0;
+        int last = end - base < RM_FSM_PAGES_PER_MAP_PAGE ? end - base : RM_FSM_PAGES_PER_MAP_PAGE;
+        for (int i = first; i < last; i++) {
+            if (categories[i] >= minCategory) {
+                *pageNum_out = base + i;
+                break;
+            }
+        }
+        TRY_OR_RETURN(unpinPage(pool, &pageHandle));
+
+        if (*pageNum_out != NO_PAGE) {
+            return RC_OK;
+        }
+    }
+    return RC_OK;
+}
+
+void
+RM_FSM_init(RM_FSM *self, PageNumber firstMapPageNum)
+{
+    for (int i = 0; i < RM_FSM_MAX_MAP_PAGES; i++) {
+        self->mapPageNums[i] = NO_PAGE;
+    }
+    self->mapPageNums[0] = firstMapPageNum;
+    self->numMapPages = 1;
+    self->lastDataPageNum = NO_PAGE;
+    self->hint = 0;
+}
+
+/**
+ * Allocates an empty map page, one that has no page in the table.
+ */
+RC
+RM_FSM_create(BM_BufferPool *pool, int *firstMapPageNum_out)
+{
+    int pageNum;
+    TRY_OR_RETURN(RM_Page_allocate(pool, 1, &pageNum));
+
+    BM_PageHandle pageHandle = {};
+    TRY_OR_RETURN(pinPage(pool, &pageHandle, pageNum));
+    RM_Page_init(pageHandle.buffer, pageNum, RM_PAGE_KIND_FSM);
+    TRY_OR_RETURN(markDirty(pool, &pageHandle));
+    TRY_OR_RETURN(unpinPage(pool, &pageHandle));
+
+    *firstMapPageNum_out = pageNum;
+    return RC_OK;
+}
+
+/**
+ * Finds a data page of the table that has `spaceRequired` free bytes
+ * according to the map, starting from the last page found. NO_PAGE if there
+ * is none.
+ */
+RC
+RM_FSM_findPage(BM_BufferPool *pool, RM_FSM *self, uint16_t spaceRequired, PageNumber *pageNum_out)
+{
+    BP_Metadata *meta = pool->mgmtData;
+    PageNumber end = meta->fileHandle->totalNumPages;
+    PageNumber hint = self->hint < end ? self->hint : 0;
+    uint8_t minCategory = RM_FSM_minCategory(spaceRequired);
+
+    TRY_OR_RETURN(RM_FSM_search(pool, self, minCategory, hint, end, pageNum_out));
+    if (*pageNum_out == NO_PAGE && hint > 0) {
+        TRY_OR_RETURN(RM_FSM_search(pool, self, minCategory, 0, hint, pageNum_out));
+    }
+    if (*pageNum_out != NO_PAGE) {
+        self->hint = *pageNum_out;
+    }
+    return RC_OK;
+}
+
+/**
+ * Records the free space of a data page of the table, which also adds a new
+ * page to the map.
+ */
+RC
+RM_FSM_setPage(BM_BufferPool *pool, RM_FSM *self, PageNumber pageNum, uint16_t freeSpace)
+{
+    TRY_OR_RETURN(RM_FSM_update(pool, self, pageNum, RM_FSM_category(freeSpace), false));
+    if (self->lastDataPageNum != NO_PAGE && pageNum > self->lastDataPageNum) {
+        self->lastDataPageNum = pageNum;
+    }
+    return RC_OK;
+}
+
+/**
+ * Records that a data page of the table has at least `freeSpace` free bytes.
+ */
+RC
+RM_FSM_raisePage(BM_BufferPool *pool, RM_FSM *self, PageNumber pageNum, uint16_t freeSpace)
+{
+    return RM_FSM_update(pool, self, pageNum, RM_FSM_category(freeSpace), true);
+}
+
+/**
+ * Returns the last page of the data page chain of the table. Pages are only
+ * ever added at the end of the page file, so that is the highest page number
+ * in the map, unless some other handle of the table added more since.
+ */
+RC
+RM_FSM_getLastDataPage(BM_BufferPool *pool, RM_FSM *self, PageNumber *pageNum_out)
+{
+    if (self->lastDataPageNum == NO_PAGE) {
+        PageNumber mapPageNum = self->mapPageNums[0];
+        for (int i = 1; i < RM_FSM_MAX_MAP_PAGES && mapPageNum != NO_PAGE; i++) {
+            TRY_OR_RETURN(RM_FSM_getMapPage(pool, self, i, false, &mapPageNum));
+        }
+
+        for (int i = self->numMapPages - 1; i >= 0 && self->lastDataPageNum == NO_PAGE; i--) {
+            BM_PageHandle pageHandle = {};
+            TRY_OR_RETURN(pinPage(pool, &pageHandle, self->mapPageNums[i]));
+            const uint8_t *categories = (const uint8_t *) &((RM_Page *) pageHandle.buffer)->dataBegin;
+            for (int j = RM_FSM_PAGES_PER_MAP_PAGE - 1; j >= 0; j--) {
+                if (categories[j] != RM_FSM_NOT_IN_TABLE) {
+                    self->lastDataPageNum = i * RM_FSM_PAGES_PER_MAP_PAGE + j;
+                    break;
+                }
+            }
+            TRY_OR_RETURN(unpinPage(pool, &pageHandle));
+        }
+        if (self->lastDataPageNum == NO_PAGE) {
+            PANIC("free-space map without any data page");
+        }
+    }
+
+    while (true) {
+        BM_PageHandle pageHandle = {};
+        TRY_OR_RETURN(pinPage(pool, &pageHandle, self->lastDataPageNum));
+        int32_t nextPageNum = ((RM_Page *) pageHandle.buffer)->header.nextPageNum;
+        TRY_OR_RETURN(unpinPage(pool, &pageHandle));
+        if (nextPageNum == RM_PAGE_NEXT_PAGENUM_UNSET) {
+            break;
+        }
+        self->lastDataPageNum = nextPageNum;
+    }
+
+    *pageNum_out = self->lastDataPageNum;
+    return RC_OK;
+}
+
+/**
+ * Lists the data pages of the table in page number order, without touching
+ * them. `pageNums_out` is allocated with malloc.
+ */
+RC
+RM_FSM_listPages(BM_BufferPool *pool, RM_FSM *self, PageNumber **pageNums_out, int *numPages_out)
+{
+    BP_Metadata *meta = pool->mgmtData;
+    PageNumber end = meta->fileHandle->totalNumPages;
+    PageNumber *pageNums = malloc((end > 0 ? end : 1) * sizeof(PageNumber));
+    int numPages = 0;
+
+    for (PageNumber base = 0; base < end; base += RM_FSM_PAGES_PER_MAP_PAGE) {
+        PageNumber mapPageNum;
+        BM_PageHandle pageHandle = {};
+        RC rc = RM_FSM_getMapPage(pool, self, base / RM_FSM_PAGES_PER_MAP_PAGE, false, &mapPageNum);
+        if (rc == RC_OK && mapPageNum != NO_PAGE) {
+            rc = pinPage(pool, &pageHandle, mapPageNum);
+        }
+        if (rc != RC_OK) {
+            free(pageNums);
+            return rc;
+        }
+        if (mapPageNum == NO_PAGE) {
+            break;
+        }
+
+        const uint8_t *categories = (const uint8_t *) &((RM_Page *) pageHandle.buffer)->dataBegin;
+        int last = end - base < RM_FSM_PAGES_PER_MAP_PAGE ? end - base : RM_FSM_PAGES_PER_MAP_PAGE;
+        for (int i = 0; i < last; i++) {
+            if (categories[i] != RM_FSM_NOT_IN_TABLE) {
+                pageNums[numPages++] = base + i;
+            }
+        }
+        if ((rc = unpinPage(pool, &pageHandle)) != RC_OK) {
+            free(pageNums);
+            return rc;
+        }
+    }
+
+    *pageNums_out = pageNums;
+    *numPages_out = numPages;
+    return RC_OK;
+}
+
+/**
+ * Frees every map page of a table that is being deleted.
+ */
+RC
+RM_FSM_freeAll(BM_BufferPool *pool, PageNumber firstMapPageNum)
+{
+    int32_t pageNum = firstMapPageNum;
+    while (pageNum != RM_PAGE_NEXT_PAGENUM_UNSET) {
+        BM_PageHandle pageHandle = {};
+        TRY_OR_RETURN(pinPage(pool, &pageHandle, pageNum));
+        RM_Page *page = (RM_Page *) pageHandle.buffer;
+        int32_t nextPageNum = page->header.nextPageNum;
+        RM_Page_free(page);
+        TRY_OR_RETURN(markDirty(pool, &pageHandle));
+        TRY_OR_RETURN(unpinPage(pool, &pageHandle));
+        pageNum = nextPageNum;
+    }
+    return RC_OK;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "dberror.h"
+#include "buffer_mgr.h"
+#include "rm_page.h"
+
+// Free-space map of a table
+//
+// One byte per page of the page file, in a chain of `RM_PAGE_KIND_FSM` pages
+// that each cover RM_FSM_PAGES_PER_MAP_PAGE consecutive page numbers. A page
+// that does not belong to the table has category RM_FSM_NOT_IN_TABLE, a data
+// page of the table has 1 + its free bytes / RM_FSM_CATEGORY_BYTES.
+//
+// The map is only an upper bound: an insert does not update it, the category
+// of a page is lowered when an insert finds it too full, and raised again when
+// a delete frees space on it.
+
+#define RM_FSM_PAGES_PER_MAP_PAGE ((int) RM_PAGE_DATA_SIZE)
+#define RM_FSM_CATEGORY_BYTES (PAGE_SIZE / 256)
+#define RM_FSM_NOT_IN_TABLE ((uint8_t) 0)
+#define RM_FSM_MAX_CATEGORY ((uint8_t) 255)
+
+// `RM_PageNumber` is 16 bits, so are the page numbers a map has to cover
+#define RM_FSM_MAX_MAP_PAGES ((UINT16_MAX + RM_FSM_PAGES_PER_MAP_PAGE) / RM_FSM_PAGES_PER_MAP_PAGE)
+
+// Free-space map of an open table, caches where its map pages are
+typedef struct RM_FSM {
+    PageNumber mapPageNums[RM_FSM_MAX_MAP_PAGES];  // NO_PAGE until first seen
+    int numMapPages;                // leading entries of `mapPageNums` known
+    PageNumber lastDataPageNum;     // end of the data page chain, NO_PAGE until needed
+    PageNumber hint;                // where the next search starts
+} RM_FSM;
+
+void RM_FSM_init(RM_FSM *self, PageNumber firstMapPageNum);
+RC RM_FSM_create(BM_BufferPool *pool, int *firstMapPageNum_out);
+RC RM_FSM_findPage(BM_BufferPool *pool, RM_FSM *self, uint16_t spaceRequired, PageNumber *pageNum_out);
+RC RM_FSM_setPage(BM_BufferPool *pool, RM_FSM *self, PageNumber pageNum, uint16_t freeSpace);
+RC RM_FSM_raisePage(BM_BufferPool *pool, RM_FSM *self, PageNumber pageNum, uint16_t freeSpace);
+RC RM_FSM_getLastDataPage(BM_BufferPool *pool, RM_FSM *self, PageNumber *pageNum_out);
+RC RM_FSM_listPages(BM_BufferPool *pool, RM_FSM *self, PageNumber **pageNums_out, int *numPages_out);
+RC RM_FSM_freeAll(BM_BufferPool *pool, PageNumber firstMapPageNum);
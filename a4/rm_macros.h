@@ -8,7 +8,7 @@
 
 #ifndef __RM_PANIC_FMT__
 #define __RM_PANIC_FMT__
-__attribute__((noreturn)) static void *
+__attribute__((noreturn, unused)) static void *
 panic_fmt(char *fmt, ...)
 {
     va_list myargs;
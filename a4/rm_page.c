@@ -15,6 +15,8 @@ RM_Page_deleteAllTuples(RM_Page *self) {
     // Reset any storage flags
     self->header.flags &= (RM_PageFlags) ~RM_PAGE_FLAGS_TUPS_FULL;
     self->header.flags &= (RM_PageFlags) ~RM_PAGE_FLAGS_HAS_TRAILING;
+    self->header.flags &= (RM_PageFlags) ~RM_PAGE_FLAGS_HAS_FORWARDS;
+    self->header.flags &= (RM_PageFlags) ~RM_PAGE_FLAGS_HAS_DEAD_SLOTS;
 
     // Set any other flags to empty
     self->header.flags |= RM_PAGE_FLAGS_HAS_FREE_PTRS;
@@ -22,6 +24,7 @@ RM_Page_deleteAllTuples(RM_Page *self) {
     self->header.freespaceLowerOffset = 0;                      //next available byte in page
     self->header.freespaceUpperEnd = RM_PAGE_DATA_SIZE;         //byte where tuple data starts
     self->header.freespaceTrailingOffset = 0;                   //first available byte after tuple
+    self->header.fragmentedSpace = 0;
 }
 
 RM_Page *
@@ -50,11 +53,28 @@ RM_Page_freeAt(BM_BufferPool *pool, RM_PageNumber pageNumber)
     RM_Page *page = (RM_Page *) pageHandle.buffer;
     RM_Page_free(page);
 
-    TRY_OR_RETURN(forcePage(pool, &pageHandle));
+    TRY_OR_RETURN(markDirty(pool, &pageHandle));
     TRY_OR_RETURN(unpinPage(pool, &pageHandle));
     return RC_OK;
 }
 
+/**
+ * Hands out the next `numPages` page numbers at the end of the page file.
+ *
+ * Pages are written back whenever the buffer pool gets to them, so the file
+ * is extended right away: its size is what the next allocation starts from.
+ */
+RC
+RM_Page_allocate(BM_BufferPool *pool, int numPages, int *firstPageNum_out)
+{
+    BP_Metadata *meta = pool->mgmtData;
+    int firstPageNum = meta->fileHandle->totalNumPages;
+    TRY_OR_RETURN(ensureCapacity(firstPageNum + numPages, meta->fileHandle));
+
+    *firstPageNum_out = firstPageNum;
+    return RC_OK;
+}
+
 RM_PageTuple *
 RM_Page_reserveTupleAtEnd(RM_Page *self, uint16_t len)
 {
@@ -111,6 +131,180 @@ RM_Page_reserveTupleAtEnd(RM_Page *self, uint16_t len)
     return tup;
 }
 
+// Bytes between the slot pointers and the tuples
+static uint16_t
+RM_Page_getContiguousSpace(const RM_Page *self)
+{
+    RM_PageFlags flags = self->header.flags;
+    if (IS_FLAG_UNSET(flags, RM_PAGE_FLAGS_HAS_FREE_PTRS)
+        || IS_FLAG_SET(flags, RM_PAGE_FLAGS_TUPS_FULL)
+        || self->header.freespaceUpperEnd < self->header.freespaceLowerOffset) {
+        return 0;
+    }
+    return self->header.freespaceUpperEnd - self->header.freespaceLowerOffset;
+}
+
+/**
+ * Bytes `RM_Page_reserveTuple` can still hand out, slot pointer included,
+ * compacting the page if it has to
+ */
+uint16_t
+RM_Page_getFreeSpace(const RM_Page *self)
+{
+    return RM_Page_getContiguousSpace(self) + self->header.fragmentedSpace;
+}
+
+// Sets `RM_PAGE_FLAGS_HAS_FREE_PTRS` after the free space moved
+static void
+RM_Page_updateFreePtrs(RM_Page *self)
+{
+    if (self->header.freespaceLowerOffset < self->header.freespaceUpperEnd) {
+        self->header.flags |= RM_PAGE_FLAGS_HAS_FREE_PTRS;
+    } else {
+        self->header.flags &= ~RM_PAGE_FLAGS_HAS_FREE_PTRS;
+    }
+}
+
+/**
+ * Moves the live tuples together at the end of the page, so that the bytes of
+ * deleted and resized tuples are free space again. Slots keep their ids.
+ */
+void
+RM_Page_compact(RM_Page *self)
+{
+    char tuples[RM_PAGE_DATA_SIZE];
+    memcpy(tuples, &self->dataBegin, RM_PAGE_DATA_SIZE);
+
+    RM_PageSlotPtr *slots = (RM_PageSlotPtr *) &self->dataBegin;
+    uint16_t upperEnd = RM_PAGE_DATA_SIZE;
+    for (uint16_t i = 0; i < self->header.numTuples; i++) {
+        if (slots[i] == RM_PAGE_SLOT_DEAD) {
+            continue;
+        }
+        const RM_PageTuple *tup = (const RM_PageTuple *) (tuples + slots[i]);
+        uint16_t tupSize = RM_TUP_SIZE(RM_TUP_LEN(tup));
+        upperEnd -= tupSize;
+        memcpy(&self->dataBegin + upperEnd, tup, tupSize);
+        slots[i] = upperEnd;
+    }
+
+    self->header.freespaceUpperEnd = upperEnd;
+    self->header.fragmentedSpace = 0;
+    RM_Page_updateFreePtrs(self);
+}
+
+/**
+ * Like `RM_Page_reserveTupleAtEnd`, but takes the slot of a deleted tuple if
+ * there is one, and compacts the page if only its fragmented space has room.
+ * For pages whose tuples are addressed by RID rather than kept in order.
+ */
+RM_PageTuple *
+RM_Page_reserveTuple(RM_Page *self, uint16_t len)
+{
+    RM_PageSlotPtr *slots = (RM_PageSlotPtr *) &self->dataBegin;
+    int slotId = -1;
+    if (IS_FLAG_SET(self->header.flags, RM_PAGE_FLAGS_HAS_DEAD_SLOTS)) {
+        for (uint16_t i = 0; i < self->header.numTuples; i++) {
+            if (slots[i] == RM_PAGE_SLOT_DEAD) {
+                slotId = i;
+                break;
+            }
+        }
+        if (slotId < 0) {
+            self->header.flags &= ~RM_PAGE_FLAGS_HAS_DEAD_SLOTS;
+        }
+    }
+
+    uint16_t tupSize = RM_TUP_SIZE(len);
+    uint16_t spaceRequired = tupSize + (slotId < 0 ? sizeof(RM_PageSlotPtr) : 0);
+    if (RM_Page_getFreeSpace(self) < spaceRequired) {
+        return NULL;
+    }
+    if (RM_Page_getContiguousSpace(self) < spaceRequired) {
+        RM_Page_compact(self);
+    }
+    if (slotId < 0) {
+        return RM_Page_reserveTupleAtEnd(self, len);
+    }
+
+    uint16_t tupOffset = self->header.freespaceUpperEnd - tupSize;
+    RM_PageTuple *tup = (RM_PageTuple *) (&self->dataBegin + tupOffset);
+    self->header.freespaceUpperEnd -= tupSize;
+    RM_Page_updateFreePtrs(self);
+
+    slots[slotId] = tupOffset;
+    tup->slotId = slotId;
+    tup->len = len;
+    return tup;
+}
+
+/**
+ * Deletes the tuple in slot `slotId` and leaves a tombstone in the slot, see
+ * `RM_PAGE_SLOT_DEAD`. Its bytes count as fragmented space until the page is
+ * compacted. Tombstones at the end of the slot array are dropped.
+ */
+void
+RM_Page_killTuple(RM_Page *self, RM_PageSlotId slotId)
+{
+    RM_PageSlotPtr *slotPtr;
+    RM_PageTuple *tup = RM_Page_getTuple(self, slotId, &slotPtr);
+    self->header.fragmentedSpace += RM_TUP_SIZE(RM_TUP_LEN(tup));
+    *slotPtr = RM_PAGE_SLOT_DEAD;
+    self->header.flags |= RM_PAGE_FLAGS_HAS_DEAD_SLOTS;
+
+    RM_PageSlotPtr *slots = (RM_PageSlotPtr *) &self->dataBegin;
+    while (self->header.numTuples > 0 && slots[self->header.numTuples - 1] == RM_PAGE_SLOT_DEAD) {
+        self->header.numTuples--;
+        self->header.freespaceLowerOffset -= sizeof(RM_PageSlotPtr);
+    }
+    if (self->header.numTuples == 0) {
+        RM_Page_deleteAllTuples(self);
+    } else {
+        RM_Page_updateFreePtrs(self);
+    }
+}
+
+/**
+ * Gives the tuple in slot `slotId` room for `len` bytes, keeping its flags.
+ * It stays in place if it does not grow, and is otherwise moved into the free
+ * space with its bytes, reusing its slot pointer. Returns NULL and leaves the
+ * tuple as it was if the page does not have room.
+ */
+RM_PageTuple *
+RM_Page_resizeTuple(RM_Page *self, RM_PageSlotId slotId, uint16_t len)
+{
+    RM_PageSlotPtr *slotPtr;
+    RM_PageTuple *tup = RM_Page_getTuple(self, slotId, &slotPtr);
+    RM_PageSlotLength flags = tup->len & ~RM_TUP_LEN_MASK;
+    if (len <= RM_TUP_LEN(tup)) {
+        self->header.fragmentedSpace += RM_TUP_LEN(tup) - len;
+        tup->len = flags | len;
+        return tup;
+    }
+
+    // the old bytes are left behind, only the tuple itself needs room
+    uint16_t tupSize = RM_TUP_SIZE(len);
+    if (RM_Page_getFreeSpace(self) < tupSize) {
+        return NULL;
+    }
+    if (RM_Page_getContiguousSpace(self) < tupSize) {
+        RM_Page_compact(self);
+        tup = RM_Page_getTuple(self, slotId, &slotPtr);
+    }
+    self->header.fragmentedSpace += RM_TUP_SIZE(RM_TUP_LEN(tup));
+
+    uint16_t tupOffset = self->header.freespaceUpperEnd - tupSize;
+    RM_PageTuple *moved = (RM_PageTuple *) (&self->dataBegin + tupOffset);
+    memcpy(&moved->dataBegin, &tup->dataBegin, RM_TUP_LEN(tup));
+    moved->slotId = slotId;
+    moved->len = flags | len;
+
+    self->header.freespaceUpperEnd -= tupSize;
+    RM_Page_updateFreePtrs(self);
+    *slotPtr = tupOffset;
+    return moved;
+}
+
 RM_PageTuple *
 RM_Page_reserveTupleAtIndex(RM_Page *page, uint16_t slotNum, const uint16_t len)
 {
@@ -146,10 +340,17 @@ RM_Page_reserveTupleAtIndex(RM_Page *page, uint16_t slotNum, const uint16_t len)
     return targetTup;
 }
 
+// Deletes the entry in slot `slotNum` of an index page, the slots after it
+// move down by one, see `RM_Page_killTuple` for pages addressed by RID
 void
 RM_Page_deleteTuple(RM_Page *page, uint16_t slotNum)
 {
     PANIC_IF_NULL(page);
+    // shifting the slots of a data or catalog page would change the RIDs of
+    // the records after it and break the forwards pointing at them
+    if (page->header.kind != RM_PAGE_KIND_INDEX) {
+        PANIC("slots of page %d are addressed by RID, kill the tuple instead", page->header.pageNum);
+    }
     LOG_DEBUG("page num = %d, slot id = %d, num tups %d -> %d",
             page->header.pageNum,
             slotNum,
@@ -227,6 +428,9 @@ RM_Page_getTuple(
     
     size_t slot = slotIdx * sizeof(RM_PageSlotPtr);
     RM_PageSlotPtr *off = (RM_PageSlotPtr *) (&self->dataBegin + slot);
+    if (*off == RM_PAGE_SLOT_DEAD) {
+        PANIC("'slotIdx' %d was deleted", slotIdx);
+    }
     RM_PageTuple *tup = (RM_PageTuple *) (&self->dataBegin + *off);
 
     if (ptr_out != NULL) {
@@ -236,43 +440,69 @@ RM_Page_getTuple(
     return tup;
 }
 
-//assume we always have the right page from calling method 
-void
-RM_Page_getRecord(RM_Page *self, Record *record, RID rid){
-    uint16_t numTuples = self->header.numTuples;
-    int slotNum = rid.slot; 
-    if (slotNum >= numTuples) PANIC("slotNum > max slots in page");
-
-    //get position of tuple
-    size_t slot = slotNum * sizeof(RM_PageSlotPtr);
-    RM_PageSlotPtr *off = (RM_PageSlotPtr *) (&self->dataBegin + slot);
-    RM_PageTuple *tup = (RM_PageTuple *) (&self->dataBegin + *off);
+// The tuple in slot `slotId`, NULL if there is no such slot or it was deleted
+RM_PageTuple *
+RM_Page_getLiveTuple(RM_Page *self, RM_PageSlotId slotId)
+{
+    if (slotId >= self->header.numTuples) {
+        return NULL;
+    }
+    const RM_PageSlotPtr *slots = (const RM_PageSlotPtr *) &self->dataBegin;
+    if (slots[slotId] == RM_PAGE_SLOT_DEAD) {
+        return NULL;
+    }
+    return (RM_PageTuple *) (&self->dataBegin + slots[slotId]);
+}
 
-    //read the data and assign it into the record ptr
-    RM_PageSlotLength n = tup->len;
-    void *buf = malloc(n);
-    memcpy(buf, &tup->dataBegin, n);
+/**
+ * Points the record at the tuple in slot `slotId` the way a scan sees it: a
+ * moved record keeps the RID it was inserted with. Returns false for a tuple
+ * that only holds the address its record moved to, which scans skip.
+ */
+bool
+RM_Page_getScanRecord(RM_Page *self, RM_PageSlotId slotId, Record *record, uint16_t *len_out)
+{
+    RM_PageTuple *tup = RM_Page_getLiveTuple(self, slotId);
+    if (tup == NULL || (tup->len & RM_TUP_FLAG_FORWARD)) {
+        return false;
+    }
 
-    record->id = rid;
-    record->data = buf;
+    if (tup->len & RM_TUP_FLAG_MOVED) {
+        RM_PageForward home;
+        memcpy(&home, &tup->dataBegin, sizeof(home));
+        record->id.page = home.pageNum;
+        record->id.slot = home.slotId;
+    } else {
+        record->id.page = self->header.pageNum;
+        record->id.slot = slotId;
+    }
+    record->data = RM_TUP_RECORD(tup);
+    *len_out = RM_TUP_RECORD_LEN(tup);
+    return true;
 }
 
-void
-RM_Page_setTuple(RM_Page *self, Record *r){
-
+// Records that live on the page, not counting tombstones and the addresses of
+// moved records
+uint16_t
+RM_Page_getNumRecords(const RM_Page *self)
+{
     uint16_t numTuples = self->header.numTuples;
-    int slotNum = r->id.slot; 
-    if (slotNum >= numTuples) PANIC("slotNum > max slots in page");
-
-    //get position of tuple
-    size_t slot = slotNum * sizeof(RM_PageSlotPtr);
-    RM_PageSlotPtr *off = (RM_PageSlotPtr *) (&self->dataBegin + slot);
-
-    RM_PageTuple *tup = (RM_PageTuple *) (&self->dataBegin + *off);
-    RM_PageSlotLength n = tup->len;
+    if (IS_FLAG_UNSET(self->header.flags, RM_PAGE_FLAGS_HAS_FORWARDS | RM_PAGE_FLAGS_HAS_DEAD_SLOTS)) {
+        return numTuples;
+    }
 
-    //copy record into tuple
-    memcpy(&tup->dataBegin, (void *)r->data, n);
+    const RM_PageSlotPtr *slots = (const RM_PageSlotPtr *) &self->dataBegin;
+    uint16_t numRecords = 0;
+    for (uint16_t i = 0; i < numTuples; i++) {
+        if (slots[i] == RM_PAGE_SLOT_DEAD) {
+            continue;
+        }
+        const RM_PageTuple *tup = (const RM_PageTuple *) (&self->dataBegin + slots[i]);
+        if (!(tup->len & RM_TUP_FLAG_FORWARD)) {
+            numRecords++;
+        }
+    }
+    return numRecords;
 }
 
 RC
@@ -19,6 +19,7 @@ typedef struct PACKED_STRUCT RM_DatabaseHeader {
     uint16_t pageSize;
     RM_PageNumber numPages;
     RM_PageNumber schemaPageNum;
+    uint64_t dbId;  // random, ties the write-ahead log to this database
 } RM_DatabaseHeader;
 
 typedef uint16_t RM_PageFlags;
@@ -28,11 +29,14 @@ typedef uint16_t RM_PageFlags;
 #define RM_PAGE_FLAGS_INDEX_ROOT     ((RM_PageFlags) (1u << 3u))
 #define RM_PAGE_FLAGS_INDEX_INNER    ((RM_PageFlags) (1u << 4u))
 #define RM_PAGE_FLAGS_INDEX_LEAF     ((RM_PageFlags) (1u << 5u))
+#define RM_PAGE_FLAGS_HAS_FORWARDS   ((RM_PageFlags) (1u << 6u))  /* if some tuples only hold the address their record moved to */
+#define RM_PAGE_FLAGS_HAS_DEAD_SLOTS ((RM_PageFlags) (1u << 7u))  /* if some slots may be tombstones of deleted tuples */
 
 typedef uint8_t RM_PageKind;
 #define RM_PAGE_KIND_SCHEMA 1u
 #define RM_PAGE_KIND_DATA   2u
 #define RM_PAGE_KIND_INDEX  3u
+#define RM_PAGE_KIND_FSM    4u
 #define RM_PAGE_KIND_FREE   0xffu
 
 typedef struct PACKED_STRUCT RM_PageHeader {
@@ -61,9 +65,10 @@ typedef struct PACKED_STRUCT RM_PageHeader {
     uint16_t freespaceTrailingOffset;
 
     /**
-     * recordID for schema?
+     * Bytes of deleted and resized tuples that are not part of the free space between the slot pointers and the
+     * tuples. `RM_Page_compact` turns them back into free space.
      */
-    uint16_t RID;
+    uint16_t fragmentedSpace;
 
     /**
      * integer in case data in table exceeds 4096 Bytes (set to -1 if only one page)
@@ -71,6 +76,12 @@ typedef struct PACKED_STRUCT RM_PageHeader {
      */
     int32_t nextPageNum;
 
+    /**
+     * LSN of the last write-ahead log record that changed this page.
+     * The page may only be written back once the log is durable up to here.
+     */
+    uint64_t pageLSN;
+
 } RM_PageHeader;
 
 #define RM_PAGE_NEXT_PAGENUM_UNSET   ((uint16_t) -1)
@@ -91,6 +102,14 @@ typedef uint16_t RM_PageSlotPtr;
 typedef uint16_t RM_PageSlotId;
 typedef uint16_t RM_PageSlotLength;
 
+/*
+ * Deleting a tuple from a data or catalog page leaves a tombstone in its slot,
+ * so that the ids of the slots after it, and the RIDs built from them, stay
+ * valid. Tombstones are reused by later tuples. Index pages keep their
+ * entries in order instead, and shift them with `RM_Page_deleteTuple`.
+ */
+#define RM_PAGE_SLOT_DEAD ((RM_PageSlotPtr) 0xffffu)
+
 typedef struct PACKED_STRUCT RM_PageTuple {
     RM_PageSlotId slotId;
     RM_PageSlotLength len;
@@ -105,18 +124,47 @@ typedef struct PACKED_STRUCT RM_PageTuple {
 #define RM_TUP_SIZE(DATA_SIZE) \
     sizeof(RM_PageSlotId) + sizeof(RM_PageSlotLength) + (DATA_SIZE)
 
+/*
+ * A record that grows past the room left on its page is moved to another
+ * page, and its tuple is shrunk to the address it moved to, so that its RID
+ * stays valid. The tuple it moved to starts with that RID. The top bits of
+ * `len` of a data tuple tell the two apart from ordinary tuples.
+ */
+#define RM_TUP_FLAG_FORWARD ((RM_PageSlotLength) (1u << 15u))  /* tuple holds an RM_PageForward */
+#define RM_TUP_FLAG_MOVED   ((RM_PageSlotLength) (1u << 14u))  /* tuple holds an RM_PageForward, then the record */
+#define RM_TUP_LEN_MASK     ((RM_PageSlotLength) (RM_TUP_FLAG_MOVED - 1u))
+#define RM_TUP_LEN(TUP) ((RM_PageSlotLength) ((TUP)->len & RM_TUP_LEN_MASK))
+
+typedef struct PACKED_STRUCT RM_PageForward {
+    RM_PageNumber pageNum;
+    RM_PageSlotId slotId;
+} RM_PageForward;
+
+// The record a tuple holds, past the RID of a moved one
+#define RM_TUP_RECORD(TUP) \
+    (&(TUP)->dataBegin + (((TUP)->len & RM_TUP_FLAG_MOVED) ? sizeof(RM_PageForward) : 0))
+#define RM_TUP_RECORD_LEN(TUP) \
+    (RM_TUP_LEN(TUP) - (((TUP)->len & RM_TUP_FLAG_MOVED) ? sizeof(RM_PageForward) : 0))
+
 RM_Page *RM_Page_init(void *buffer, RM_PageNumber pageNumber, RM_PageKind kind);
 RM_Page *RM_Page_free(RM_Page *page);
 RC RM_Page_freeAt(BM_BufferPool *pool, RM_PageNumber pageNumber);
+RC RM_Page_allocate(BM_BufferPool *pool, int numPages, int *firstPageNum_out);
 RM_PageTuple *RM_Page_reserveTupleAtEnd(RM_Page *self, uint16_t len);
+uint16_t RM_Page_getFreeSpace(const RM_Page *self);
 RM_PageTuple *RM_Page_reserveTupleAtIndex(RM_Page *page, uint16_t slotNum, const uint16_t len);
+RM_PageTuple *RM_Page_resizeTuple(RM_Page *self, RM_PageSlotId slotId, uint16_t len);
+RM_PageTuple *RM_Page_reserveTuple(RM_Page *self, uint16_t len);
+void RM_Page_killTuple(RM_Page *self, RM_PageSlotId slotId);
+void RM_Page_compact(RM_Page *self);
 
 RM_PageTuple *RM_Page_getTuple(
         RM_Page *self,
         RM_PageSlotId slotIdx,
         RM_PageSlotPtr **ptr_out);
-void RM_Page_getRecord(RM_Page *self, Record *record, RID rid);
-void RM_Page_setTuple(RM_Page *self, Record *r);
+RM_PageTuple *RM_Page_getLiveTuple(RM_Page *self, RM_PageSlotId slotId);
+bool RM_Page_getScanRecord(RM_Page *self, RM_PageSlotId slotId, Record *record, uint16_t *len_out);
+uint16_t RM_Page_getNumRecords(const RM_Page *self);
 void RM_Page_deleteTuple(RM_Page *self, RM_PageSlotId slotId);
 void RM_Page_deleteAllTuples(RM_Page *self);
 
@@ -44,10 +44,10 @@ typedef struct VarString {
 
 #define ENSURE_SIZE(var,newsize)				\
 		do {								\
-			if (var->bufsize < newsize)					\
+			if ((size_t) var->bufsize < newsize)				\
 			{								\
 				int newbufsize = var->bufsize;				\
-				while((newbufsize *= 2) < newsize);			\
+				while((size_t) (newbufsize *= 2) < newsize);		\
 				var->buf = realloc(var->buf, newbufsize);			\
 			}								\
 		} while (0)
@@ -89,7 +89,7 @@ serializeTableContent(RM_TableData *rel)
 	int i;
 	VarString *result;
 	RM_ScanHandle *sc = (RM_ScanHandle *) malloc(sizeof(RM_ScanHandle));
-	Record *r = (Record *) malloc(sizeof(Record));
+	Record r;
 	MAKE_VARSTRING(result);
 
 	for(i = 0; i < rel->schema->numAttr; i++)
@@ -97,12 +97,13 @@ serializeTableContent(RM_TableData *rel)
 
 	startScan(rel, sc, NULL);
 
-	while(next(sc, r) != RC_RM_NO_MORE_TUPLES)
+	while(nextView(sc, &r) == RC_OK)
 	{
-		APPEND_STRING(result,serializeRecord(r, rel->schema));
+		APPEND_STRING(result,serializeRecord(&r, rel->schema));
 		APPEND_STRING(result,"\n");
 	}
 	closeScan(sc);
+	free(sc);
 
 	RETURN_STRING(result);
 }
@@ -131,6 +132,9 @@ serializeSchema(Schema *schema)
 		case DT_STRING:
 			APPEND(result,"STRING[%i]", schema->typeLength[i]);
 			break;
+		case DT_VARCHAR:
+			APPEND(result,"VARCHAR[%i]", schema->typeLength[i]);
+			break;
 		case DT_BOOL:
 			APPEND_STRING(result,"BOOL");
 			break;
@@ -200,6 +204,13 @@ serializeAttr(Record *record, Schema *schema, int attrNum)
 		free(buf);
 	}
 	break;
+	case DT_VARCHAR:
+	{
+		VarcharRef ref;
+		memcpy(&ref, attrData, sizeof(VarcharRef));
+		APPEND(result, "%s:%.*s", schema->attrNames[attrNum], (int) ref.length, record->data + ref.offset);
+	}
+	break;
 	case DT_FLOAT:
 	{
 		float val;
@@ -236,6 +247,7 @@ serializeValue(Value *val)
 		APPEND(result,"%f", val->v.floatV);
 		break;
 	case DT_STRING:
+	case DT_VARCHAR:
 		APPEND(result,"%s", val->v.stringV);
 		break;
 	case DT_BOOL:
@@ -301,6 +313,9 @@ attrOffset (Schema *schema, int attrNum, int *result)
 		case DT_BOOL:
 			offset += sizeof(bool);
 			break;
+		case DT_VARCHAR:
+			offset += sizeof(VarcharRef);
+			break;
 		}
 
 	*result = offset;
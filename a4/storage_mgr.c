@@ -8,10 +8,14 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <stdbool.h>
+#include <sys/uio.h>
 
 #include "dberror.h"
 #include "storage_mgr.h"
 
+// Pages handed to a single vectored write by `writeBlocks`
+#define SM_WRITEBLOCKS_MAX_IOV (64)
+
 /* manipulating page files */
 
 void initStorageManager (void){}
@@ -376,6 +380,85 @@ RC writeBlock (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage){
 	return RC_OK;
 }
 
+/**
+ * Writes a run of consecutive pages to disk using vectored writes, so that a
+ * run costs one system call per `SM_WRITEBLOCKS_MAX_IOV` pages instead of a
+ * seek and a write per page.
+ *
+ * @param pageNum  the page number to write the first page to
+ * @param numPages  the number of pages in the run
+ * @param fHandle  (in) the file handle
+ * @param memPages  (in) one page buffer per page of the run, in page order
+ * @return See `writeBlock()`
+ */
+RC writeBlocks (int pageNum, int numPages, SM_FileHandle *fHandle, SM_PageHandle *memPages){
+	if (fHandle == NULL) {
+	    return RC_FILE_HANDLE_NOT_INIT;
+	}
+
+	FILE *f = fHandle->mgmtInfo;
+	if (f == NULL || fileno(f) < 0) {
+	    return RC_FILE_HANDLE_NOT_INIT;
+	}
+
+	// Ensure the whole run is within bounds
+	if (pageNum < 0 || numPages < 0 || pageNum + numPages > fHandle->totalNumPages) {
+	    return RC_WRITE_FAILED;
+	}
+
+    // The writes bypass the stream, so anything it still buffers has to reach
+    // the file first, and any read-ahead it holds has to be dropped
+    if (fflush(f) != 0) {
+        return RC_WRITE_FAILED;
+    }
+
+    int fd = fileno(f);
+    struct iovec iov[SM_WRITEBLOCKS_MAX_IOV];
+    int numWritten = 0;
+    while (numWritten < numPages) {
+        int batch = numPages - numWritten;
+        if (batch > SM_WRITEBLOCKS_MAX_IOV) {
+            batch = SM_WRITEBLOCKS_MAX_IOV;
+        }
+        for (int i = 0; i < batch; i++) {
+            iov[i].iov_base = memPages[numWritten + i];
+            iov[i].iov_len = PAGE_SIZE;
+        }
+
+        struct iovec *cur = iov;
+        int curLen = batch;
+        off_t offset = (off_t) (pageNum + numWritten) * PAGE_SIZE;
+        while (curLen > 0) {
+            ssize_t n = pwritev(fd, cur, curLen, offset);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return RC_WRITE_FAILED;
+            }
+
+            // Skip over whatever was written for short writes
+            offset += n;
+            while (curLen > 0 && (size_t) n >= cur->iov_len) {
+                n -= cur->iov_len;
+                cur++;
+                curLen--;
+            }
+            if (curLen > 0) {
+                cur->iov_base = (char *) cur->iov_base + n;
+                cur->iov_len -= n;
+            }
+        }
+
+        numWritten += batch;
+    }
+
+	// Update current page position
+    fHandle->curPagePos = pageNum + numPages - 1;
+
+	return RC_OK;
+}
+
 /**
  * Writes a block to disk using the current position.
  * @param fHandle  the file handle
@@ -510,3 +593,26 @@ RC ensureCapacity (int numberOfPages, SM_FileHandle *fHandle){
 	fHandle->totalNumPages = numberOfPages;
 	return RC_OK;
 }
+
+/**
+ * Makes every page written to the file so far durable.
+ *
+ * @param fHandle  the file handle
+ * @return RC_WRITE_FAILED if the data could not be synced to the device
+ */
+RC syncPageFile (SM_FileHandle *fHandle)
+{
+	if (fHandle == NULL) {
+	    return RC_FILE_HANDLE_NOT_INIT;
+	}
+
+	FILE *f = fHandle->mgmtInfo;
+	if (f == NULL) {
+	    return RC_FILE_HANDLE_NOT_INIT;
+	}
+
+	if (fflush(f) != 0 || fdatasync(fileno(f)) != 0) {
+	    return RC_WRITE_FAILED;
+	}
+	return RC_OK;
+}
@@ -21,6 +21,9 @@ getAttrOffset (Schema *schema, int attrNum, int *result)
             case DT_BOOL:
                 offset += sizeof(bool);
                 break;
+            case DT_VARCHAR:
+                offset += sizeof(VarcharRef);
+                break;
         }
 
     *result = offset;
@@ -1,6 +1,8 @@
 #ifndef TABLES_H
 #define TABLES_H
 
+#include <stdint.h>
+
 #include "dt.h"
 #include "dberror.h"
 
@@ -9,7 +11,8 @@ typedef enum DataType {
 	DT_INT = 0,
 	DT_STRING = 1,
 	DT_FLOAT = 2,
-	DT_BOOL = 3
+	DT_BOOL = 3,
+	DT_VARCHAR = 4	// up to typeLength bytes, read and written as DT_STRING values
 } DataType;
 
 typedef struct Value {
@@ -22,6 +25,14 @@ typedef struct Value {
 	} v;
 } Value;
 
+// Where the bytes of a DT_VARCHAR attribute are in its record. The bytes of
+// all of them follow the fixed-size part of the record, so a record only
+// takes as much room as its strings do.
+typedef struct VarcharRef {
+	uint16_t offset;	// from the start of the record
+	uint16_t length;
+} VarcharRef;
+
 typedef struct RID {
 	int page;
 	int slot;
@@ -43,6 +54,7 @@ typedef struct Schema
 	int *keyAttrs;			//array of keyAttrs
 	int keySize;			//relative const
 	int dataPageNum;		//pagenum that stores first tuple of data
+	int fsmPageNum;			//pagenum of the first page of the free-space map
 } Schema;
 
 // TableData: Management Structure for a Record Manager to handle one relation
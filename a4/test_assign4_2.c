@@ -0,0 +1,1159 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "btree_mgr.h"
+#include "dberror.h"
+#include "expr.h"
+#include "record_mgr.h"
+#include "rm_catalog.h"
+#include "rm_page.h"
+#include "storage_mgr.h"
+#include "tables.h"
+#include "test_helper.h"
+
+#define ASSERT_EQUALS_SUMMARY(_l,_r, message)				\
+		do {									\
+			ASSERT_TRUE((_l).count == (_r).count && (_l).sumA == (_r).sumA && (_l).sumC == (_r).sumC, message); \
+		} while(0)
+
+#define ASSERT_RC(expected, code, message)				\
+		do {									\
+			ASSERT_TRUE((code) == (expected), message);			\
+		} while(0)
+
+// What every scan of a table has to agree on
+typedef struct ScanSummary {
+	Schema *schema;
+	long count;
+	long sumA;
+	long sumC;
+	long workerCounts[RM_PARALLEL_SCAN_MAX_WORKERS];  // records each worker of a parallel scan saw
+	long numBadWorkers;  // calls with a worker index out of range
+} ScanSummary;
+
+// test methods
+static void testPageTombstones (void);
+static void testStableRids (void);
+static void testForwarding (void);
+static void testFreeSpaceMap (void);
+static void testParallelScan (void);
+static void testLongAttributes (void);
+static void testInsertRecords (void);
+static void testRecordViews (void);
+static void testProjectedScan (void);
+static void testCatalogCache (void);
+static void testCatalogChain (void);
+
+// helper methods
+static Schema *fixedSchema (void);
+static Schema *varcharSchema (int maxLength);
+static Record *testRecord (Schema *schema, int a, const char *b, int c);
+static void setString (Record *record, Schema *schema, int attrNum, const char *b);
+static void checkRecord (RM_TableData *table, RID id, int a, const char *b, int c);
+static void makeString (char *buf, int i, int len);
+static void reopen (RM_TableData *table, char *name);
+static int numFilePages (void);
+static int numPins (void);
+static int numChainPages (PageNumber firstPageNum);
+static Schema *tenantSchema (int i);
+static void projectedRow (int i, char *b, char *d, char *e);
+static void checkProjectedScan (RM_TableData *table, Expr *cond, int numAttrs, int *attrs, int numExpected);
+static ScanSummary scanSummary (RM_TableData *table, Expr *cond);
+static ScanSummary batchSummary (RM_TableData *table, Expr *cond);
+static ScanSummary parallelSummary (RM_TableData *table, Expr *cond, int numWorkers);
+static RC summarize (void *ctx, int workerIndex, Record **records, int numRecords);
+
+// test name
+char *testName;
+
+// main method
+int
+main (void)
+{
+	testName = "";
+
+	destroyPageFile("storage.db");
+	TEST_CHECK(initRecordManager(NULL));
+
+	testPageTombstones();
+	testStableRids();
+	testForwarding();
+	testFreeSpaceMap();
+	testParallelScan();
+	testLongAttributes();
+	testInsertRecords();
+	testRecordViews();
+	testProjectedScan();
+	testCatalogCache();
+	testCatalogChain();
+
+	TEST_CHECK(shutdownRecordManager());
+	printf("PASSED ALL TESTS\n");
+	return 0;
+}
+
+// ************************************************************
+void
+testPageTombstones (void)
+{
+	static char buffer[PAGE_SIZE];
+	int tupleLen = 60;
+	testName = "test tombstoned slots and page compaction";
+
+	RM_Page *page = RM_Page_init(buffer, 3, RM_PAGE_KIND_DATA);
+	int n = 0;
+	RM_PageTuple *tup;
+	while ((tup = RM_Page_reserveTuple(page, tupleLen)) != NULL) {
+		ASSERT_EQUALS_INT(n, tup->slotId, "new tuples are appended");
+		memset(&tup->dataBegin, n, tupleLen);
+		n++;
+	}
+	ASSERT_TRUE(n > 8, "page holds several tuples");
+
+	// every other tuple leaves a tombstone behind
+	for (int i = 0; i < n; i += 2) {
+		RM_Page_killTuple(page, i);
+	}
+	int lastLive = n % 2 == 0 ? n - 1 : n - 2;
+	ASSERT_EQUALS_INT(lastLive + 1, page->header.numTuples, "slots after tombstones are kept");
+	ASSERT_EQUALS_INT(n / 2, RM_Page_getNumRecords(page), "tombstones are not records");
+	ASSERT_TRUE(RM_Page_getLiveTuple(page, 0) == NULL, "tombstone is not live");
+	ASSERT_TRUE(RM_Page_getFreeSpace(page) >= (n + 1) / 2 * tupleLen, "freed bytes count as free space");
+
+	// larger than any hole, fits once the page is compacted
+	tup = RM_Page_reserveTuple(page, 3 * tupleLen);
+	ASSERT_TRUE(tup != NULL, "reserve compacts the page");
+	ASSERT_EQUALS_INT(0, tup->slotId, "first tombstone is reused");
+	memset(&tup->dataBegin, 0x7f, 3 * tupleLen);
+
+	for (int i = 1; i < n; i += 2) {
+		RM_PageTuple *live = RM_Page_getLiveTuple(page, i);
+		ASSERT_TRUE(live != NULL && live->len == tupleLen, "live tuple keeps its slot");
+		int intact = 1;
+		for (int j = 0; j < tupleLen; j++) {
+			intact &= (&live->dataBegin)[j] == (char) i;
+		}
+		ASSERT_TRUE(intact, "live tuple keeps its bytes");
+	}
+	ASSERT_TRUE(RM_Page_getTuple(page, 0, NULL)->len == 3 * tupleLen, "reused slot holds the new tuple");
+
+	// tombstones at the end of the slot array are trimmed
+	RM_Page_killTuple(page, lastLive);
+	ASSERT_EQUALS_INT(lastLive - 1, page->header.numTuples, "trailing tombstones are dropped");
+
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testStableRids (void)
+{
+	int n = 5000;
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RID *rids = malloc(n * sizeof(RID));
+	RID *reinserted = malloc(n / 2 * sizeof(RID));
+	char b[16];
+	testName = "test RIDs stay valid across deletes and restarts";
+
+	Schema *schema = fixedSchema();
+	TEST_CHECK(createTable("stable", schema));
+	TEST_CHECK(openTable(table, "stable"));
+	for (int i = 0; i < n; i++) {
+		makeString(b, i, 8);
+		Record *r = testRecord(table->schema, i, b, 2 * i);
+		TEST_CHECK(insertRecord(table, r));
+		rids[i] = r->id;
+		freeRecord(r);
+	}
+
+	// in ascending order, so every delete has live slots after it
+	for (int i = 0; i < n; i += 2) {
+		TEST_CHECK(deleteRecord(table, rids[i]));
+	}
+	Record record;
+	ASSERT_RC(RC_RM_UNKNOWN_RECORD, getRecord(table, rids[0], &record), "get a deleted record");
+	ASSERT_RC(RC_RM_UNKNOWN_RECORD, deleteRecord(table, rids[2]), "delete a deleted record");
+	Record *r = testRecord(table->schema, 4, "gone", 8);
+	r->id = rids[4];
+	ASSERT_RC(RC_RM_UNKNOWN_RECORD, updateRecord(table, r), "update a deleted record");
+	freeRecord(r);
+	for (int i = 1; i < n; i += 2) {
+		makeString(b, i, 8);
+		checkRecord(table, rids[i], i, b, 2 * i);
+	}
+	ASSERT_EQUALS_INT(n / 2, getNumTuples(table), "half the records are left");
+
+	// the tombstones take the new records, the file does not grow
+	int numPages = numFilePages();
+	for (int i = 0; i < n / 2; i++) {
+		makeString(b, n + i, 8);
+		r = testRecord(table->schema, n + i, b, 2 * (n + i));
+		TEST_CHECK(insertRecord(table, r));
+		reinserted[i] = r->id;
+		freeRecord(r);
+	}
+	ASSERT_EQUALS_INT(numPages, numFilePages(), "reinserted records reuse the freed slots");
+	// apart from the room left at the end of the last page, they take freed slots
+	int numReused = 0, numAppended = 0;
+	for (int i = 0; i < n / 2; i++) {
+		bool isFreed = false;
+		for (int j = 0; j < n && !isFreed; j += 2) {
+			isFreed = reinserted[i].page == rids[j].page && reinserted[i].slot == rids[j].slot;
+		}
+		if (isFreed) {
+			numReused++;
+		} else if (reinserted[i].page == rids[n - 1].page && reinserted[i].slot > rids[n - 1].slot) {
+			numAppended++;
+		}
+	}
+	ASSERT_TRUE(numReused > 0, "freed slots are reused");
+	ASSERT_EQUALS_INT(n / 2, numReused + numAppended, "reinserted records take freed slots or the last page");
+
+	reopen(table, "stable");
+	for (int i = 1; i < n; i += 2) {
+		makeString(b, i, 8);
+		checkRecord(table, rids[i], i, b, 2 * i);
+	}
+	for (int i = 0; i < n / 2; i++) {
+		makeString(b, n + i, 8);
+		checkRecord(table, reinserted[i], n + i, b, 2 * (n + i));
+	}
+	ASSERT_EQUALS_INT(n, getNumTuples(table), "all records after restart");
+
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable("stable"));
+	freeSchema(schema);
+	free(reinserted);
+	free(rids);
+	free(table);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testForwarding (void)
+{
+	int n = 2000;
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RID *rids = malloc(n * sizeof(RID));
+	char **names = malloc(n * sizeof(char *));
+	int *alive = malloc(n * sizeof(int));
+	testName = "test records that outgrow their page are forwarded";
+
+	Schema *schema = varcharSchema(250);
+	TEST_CHECK(createTable("forward", schema));
+	TEST_CHECK(openTable(table, "forward"));
+	for (int i = 0; i < n; i++) {
+		names[i] = malloc(251);
+		makeString(names[i], i, 8);
+		Record *r = testRecord(table->schema, i, names[i], 3 * i);
+		TEST_CHECK(insertRecord(table, r));
+		rids[i] = r->id;
+		alive[i] = 1;
+		freeRecord(r);
+	}
+
+	// pages are full, growing moves the record and leaves a forward behind
+	for (int i = 0; i < n; i += 3) {
+		Record record;
+		TEST_CHECK(getRecord(table, rids[i], &record));
+		makeString(names[i], i, 150);
+		setString(&record, table->schema, 1, names[i]);
+		TEST_CHECK(updateRecord(table, &record));
+		free(record.data);
+	}
+	// a moved record that grows again moves again
+	for (int i = 0; i < n; i += 3) {
+		Record record;
+		TEST_CHECK(getRecord(table, rids[i], &record));
+		makeString(names[i], i + 1, 250);
+		setString(&record, table->schema, 1, names[i]);
+		TEST_CHECK(updateRecord(table, &record));
+		free(record.data);
+	}
+	// and shrinks where it is
+	for (int i = 0; i < n; i += 6) {
+		Record record;
+		TEST_CHECK(getRecord(table, rids[i], &record));
+		makeString(names[i], i + 2, 3);
+		setString(&record, table->schema, 1, names[i]);
+		TEST_CHECK(updateRecord(table, &record));
+		free(record.data);
+	}
+	for (int i = 0; i < n; i++) {
+		checkRecord(table, rids[i], i, names[i], 3 * i);
+	}
+
+	// deleting a forwarded record deletes the tuple it moved to as well
+	for (int i = 0; i < n; i += 4) {
+		TEST_CHECK(deleteRecord(table, rids[i]));
+		alive[i] = 0;
+	}
+	ScanSummary expected = {.schema = table->schema};
+	for (int i = 0; i < n; i++) {
+		if (alive[i]) {
+			checkRecord(table, rids[i], i, names[i], 3 * i);
+			expected.count++;
+			expected.sumA += i;
+			expected.sumC += 3 * i;
+		}
+	}
+	ScanSummary scanned = scanSummary(table, NULL);
+	ASSERT_EQUALS_INT((int) expected.count, (int) scanned.count, "scan skips forwards and tombstones");
+	ASSERT_TRUE(scanned.sumA == expected.sumA && scanned.sumC == expected.sumC, "scan returns every record once");
+	ASSERT_EQUALS_INT((int) expected.count, getNumTuples(table), "forwards are not counted");
+
+	reopen(table, "forward");
+	for (int i = 0; i < n; i++) {
+		if (alive[i]) {
+			checkRecord(table, rids[i], i, names[i], 3 * i);
+		}
+	}
+	scanned = scanSummary(table, NULL);
+	ASSERT_TRUE(scanned.count == expected.count && scanned.sumA == expected.sumA, "scan after restart");
+
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable("forward"));
+	freeSchema(schema);
+	for (int i = 0; i < n; i++) {
+		free(names[i]);
+	}
+	free(names);
+	free(alive);
+	free(rids);
+	free(table);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testFreeSpaceMap (void)
+{
+	int n = 3000;
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RID *rids = malloc(n * sizeof(RID));
+	char b[16];
+	testName = "test inserts go to the first page the free-space map has room on";
+
+	Schema *schema = fixedSchema();
+	TEST_CHECK(createTable("fsm", schema));
+	TEST_CHECK(openTable(table, "fsm"));
+	for (int i = 0; i < n; i++) {
+		makeString(b, i, 8);
+		Record *r = testRecord(table->schema, i, b, i);
+		TEST_CHECK(insertRecord(table, r));
+		rids[i] = r->id;
+		freeRecord(r);
+	}
+
+	// empty a page in the middle of the table, every page before it is full
+	int freedPage = rids[n / 3].page;
+	ASSERT_TRUE(freedPage != rids[0].page && freedPage != rids[n - 1].page, "page in the middle");
+	for (int i = n - 1; i >= 0; i--) {
+		if (rids[i].page == freedPage) {
+			TEST_CHECK(deleteRecord(table, rids[i]));
+		}
+	}
+
+	// a freshly opened table searches the map from the start
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(openTable(table, "fsm"));
+	Record *r = testRecord(table->schema, n, "fsm", n);
+	TEST_CHECK(insertRecord(table, r));
+	ASSERT_EQUALS_INT(freedPage, r->id.page, "insert takes the freed page");
+	freeRecord(r);
+
+	reopen(table, "fsm");
+	r = testRecord(table->schema, n + 1, "fsm", n + 1);
+	TEST_CHECK(insertRecord(table, r));
+	ASSERT_EQUALS_INT(freedPage, r->id.page, "map survives a restart");
+	freeRecord(r);
+
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable("fsm"));
+	freeSchema(schema);
+	free(rids);
+	free(table);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testParallelScan (void)
+{
+	int n = 20000;
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RID *rids = malloc(n * sizeof(RID));
+	char b[256];
+	Expr *cond, *l, *r;
+	testName = "test parallel, batch and tuple-at-a-time scans agree";
+
+	Schema *schema = varcharSchema(200);
+	TEST_CHECK(createTable("parallel", schema));
+	TEST_CHECK(openTable(table, "parallel"));
+	for (int i = 0; i < n; i++) {
+		makeString(b, i, 4 + i % 20);
+		Record *rec = testRecord(table->schema, i, b, i % 97);
+		TEST_CHECK(insertRecord(table, rec));
+		rids[i] = rec->id;
+		freeRecord(rec);
+	}
+	// forwards, tombstones and reused slots
+	for (int i = 0; i < n; i += 5) {
+		Record record;
+		TEST_CHECK(getRecord(table, rids[i], &record));
+		makeString(b, i, 200);
+		setString(&record, table->schema, 1, b);
+		TEST_CHECK(updateRecord(table, &record));
+		free(record.data);
+	}
+	for (int i = 0; i < n; i += 7) {
+		TEST_CHECK(deleteRecord(table, rids[i]));
+	}
+	for (int i = 0; i < n / 14; i++) {
+		Record *rec = testRecord(table->schema, n + i, "again", (n + i) % 97);
+		TEST_CHECK(insertRecord(table, rec));
+		freeRecord(rec);
+	}
+
+	// c < 50
+	MAKE_ATTRREF(l, 2);
+	MAKE_CONS(r, stringToValue("i50"));
+	MAKE_BINOP_EXPR(cond, l, r, OP_COMP_SMALLER);
+
+	for (int round = 0; round < 2; round++) {
+		ScanSummary all = scanSummary(table, NULL);
+		ASSERT_EQUALS_INT(getNumTuples(table), (int) all.count, "scan matches getNumTuples");
+
+		ScanSummary batch = batchSummary(table, NULL);
+		ScanSummary parallel = parallelSummary(table, NULL, 4);
+		ScanSummary automatic = parallelSummary(table, NULL, RM_PARALLEL_SCAN_WORKERS_AUTO);
+		ASSERT_EQUALS_SUMMARY(all, batch, "nextBatch matches next");
+		ASSERT_EQUALS_SUMMARY(all, parallel, "parallelScan matches next");
+		ASSERT_EQUALS_SUMMARY(all, automatic, "parallelScan with default workers matches next");
+
+		ScanSummary some = scanSummary(table, cond);
+		ScanSummary someBatch = batchSummary(table, cond);
+		ScanSummary someParallel = parallelSummary(table, cond, 4);
+		ASSERT_TRUE(some.count > 0 && some.count < all.count, "condition selects some records");
+		ASSERT_EQUALS_SUMMARY(some, someBatch, "nextBatch with condition matches next");
+		ASSERT_EQUALS_SUMMARY(some, someParallel, "parallelScan with condition matches next");
+
+		reopen(table, "parallel");
+	}
+
+	freeExpr(cond);
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable("parallel"));
+	freeSchema(schema);
+	free(rids);
+	free(table);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testLongAttributes (void)
+{
+	int n = 100;
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RID *rids = malloc(n * sizeof(RID));
+	char *b = malloc(1001);
+	testName = "test attributes longer than 255 bytes survive a restart";
+
+	Schema *tooLong = varcharSchema(UINT16_MAX + 1);
+	ASSERT_RC(RC_RM_VALUE_TOO_LONG, createTable("too_long", tooLong), "attribute length beyond 16 bits");
+	freeSchema(tooLong);
+
+	Schema *schema = varcharSchema(1000);
+	TEST_CHECK(createTable("long", schema));
+	TEST_CHECK(openTable(table, "long"));
+	for (int i = 0; i < n; i++) {
+		makeString(b, i, 500 + 5 * i);
+		Record *r = testRecord(table->schema, i, b, 4 * i);
+		TEST_CHECK(insertRecord(table, r));
+		rids[i] = r->id;
+		freeRecord(r);
+	}
+
+	reopen(table, "long");
+	ASSERT_EQUALS_INT(1000, table->schema->typeLength[1], "attribute length read back from the catalog");
+	for (int i = 0; i < n; i++) {
+		makeString(b, i, 500 + 5 * i);
+		checkRecord(table, rids[i], i, b, 4 * i);
+	}
+	ScanSummary expected = {.schema = table->schema, .count = n, .sumA = n * (n - 1) / 2, .sumC = 4 * (n * (n - 1) / 2)};
+	ASSERT_EQUALS_SUMMARY(expected, scanSummary(table, NULL), "scan after restart");
+
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable("long"));
+	freeSchema(schema);
+	free(b);
+	free(rids);
+	free(table);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testInsertRecords (void)
+{
+	int n = 1000;
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	Record **records = malloc(n * sizeof(Record *));
+	char b[16];
+	testName = "test batched inserts";
+
+	Schema *schema = fixedSchema();
+	TEST_CHECK(createTable("batch", schema));
+	TEST_CHECK(openTable(table, "batch"));
+	Record *first = testRecord(table->schema, -1, "first", -2);
+	TEST_CHECK(insertRecord(table, first));
+	for (int i = 0; i < n; i++) {
+		makeString(b, i, 8);
+		records[i] = testRecord(table->schema, i, b, 3 * i);
+	}
+	TEST_CHECK(insertRecords(table, records, n));
+
+	// the batch fills the page it starts on, then goes on to new ones
+	ASSERT_EQUALS_INT(first->id.page, records[0]->id.page, "batch starts on the page with room");
+	ASSERT_EQUALS_INT(first->id.slot + 1, records[0]->id.slot, "batch starts after the first record");
+	int numPages = 1;
+	int numOutOfOrder = 0;
+	for (int i = 1; i < n; i++) {
+		if (records[i]->id.page != records[i - 1]->id.page) {
+			numPages++;
+			numOutOfOrder += records[i]->id.slot != 0;
+		} else {
+			numOutOfOrder += records[i]->id.slot != records[i - 1]->id.slot + 1;
+		}
+	}
+	ASSERT_TRUE(numPages > 2, "batch spans several pages");
+	ASSERT_EQUALS_INT(0, numOutOfOrder, "records fill each page in slot order");
+	ASSERT_EQUALS_INT(n + 1, getNumTuples(table), "every record inserted");
+
+	reopen(table, "batch");
+	checkRecord(table, first->id, -1, "first", -2);
+	for (int i = 0; i < n; i++) {
+		makeString(b, i, 8);
+		checkRecord(table, records[i]->id, i, b, 3 * i);
+		freeRecord(records[i]);
+	}
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable("batch"));
+	freeSchema(schema);
+	freeRecord(first);
+
+	// a record no page can hold stops the batch, the ones before it stay
+	char *longString = malloc(PAGE_SIZE + 1);
+	makeString(longString, 0, PAGE_SIZE);
+	schema = varcharSchema(2 * PAGE_SIZE);
+	TEST_CHECK(createTable("batch_long", schema));
+	TEST_CHECK(openTable(table, "batch_long"));
+	records[0] = testRecord(table->schema, 0, "short", 0);
+	records[1] = testRecord(table->schema, 1, longString, 1);
+	records[2] = testRecord(table->schema, 2, "short", 2);
+	ASSERT_RC(RC_RM_VALUE_TOO_LONG, insertRecords(table, records, 3), "record longer than a page");
+	checkRecord(table, records[0]->id, 0, "short", 0);
+	ASSERT_EQUALS_INT(1, getNumTuples(table), "records after the long one are not inserted");
+	for (int i = 0; i < 3; i++) {
+		freeRecord(records[i]);
+	}
+
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable("batch_long"));
+	freeSchema(schema);
+	free(longString);
+	free(records);
+	free(table);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testRecordViews (void)
+{
+	int n = 600;
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RID *rids = malloc(n * sizeof(RID));
+	char b[16];
+	Value *value;
+	Expr *cond, *l, *r;
+	testName = "test record views borrowed from the page frames";
+
+	Schema *schema = fixedSchema();
+	TEST_CHECK(createTable("views", schema));
+	TEST_CHECK(openTable(table, "views"));
+	for (int i = 0; i < n; i++) {
+		makeString(b, i, 8);
+		Record *rec = testRecord(table->schema, i, b, i % 10);
+		TEST_CHECK(insertRecord(table, rec));
+		rids[i] = rec->id;
+		freeRecord(rec);
+	}
+	TEST_CHECK(deleteRecord(table, rids[1]));
+	int numBasePins = numPins();
+
+	// a view points into the frame, which stays pinned until it is released
+	RM_RecordView view;
+	TEST_CHECK(getRecordView(table, rids[2], &view));
+	ASSERT_TRUE(view.record.data >= view.pageHandle.buffer
+			&& view.record.data < view.pageHandle.buffer + PAGE_SIZE, "view points into the frame");
+	ASSERT_EQUALS_INT(numBasePins + 1, numPins(), "view holds a pin");
+	getAttr(&view.record, table->schema, 0, &value);
+	ASSERT_EQUALS_INT(2, value->v.intV, "view reads the record");
+	freeVal(value);
+	TEST_CHECK(releaseRecordView(&view));
+	ASSERT_TRUE(view.record.data == NULL, "released view points nowhere");
+	ASSERT_EQUALS_INT(numBasePins, numPins(), "release drops the pin");
+	ASSERT_RC(RC_RM_UNKNOWN_RECORD, getRecordView(table, rids[1], &view), "view of a deleted record");
+	ASSERT_EQUALS_INT(numBasePins, numPins(), "no pin is left behind for a deleted record");
+
+	// c < 5, a scan of views sees the same records as a copying one
+	MAKE_ATTRREF(l, 2);
+	MAKE_CONS(r, stringToValue("i5"));
+	MAKE_BINOP_EXPR(cond, l, r, OP_COMP_SMALLER);
+	ScanSummary expected = scanSummary(table, cond);
+	ScanSummary viewed = {.schema = table->schema};
+	BP_Metadata *meta = RM_getInstance()->bufferPool->mgmtData;
+	RM_ScanHandle scan;
+	Record record;
+	int numOutside = 0;
+	TEST_CHECK(startScan(table, &scan, cond));
+	while (nextView(&scan, &record) == RC_OK) {
+		numOutside += record.data < meta->pageBuffer
+				|| record.data >= meta->pageBuffer + meta->pageBufferSize;
+		Record *one = &record;
+		summarize(&viewed, 0, &one, 1);
+	}
+	ASSERT_EQUALS_INT(0, numOutside, "scan views point into the frames of the pool");
+	ASSERT_EQUALS_SUMMARY(expected, viewed, "nextView matches next");
+	TEST_CHECK(closeScan(&scan));
+	ASSERT_EQUALS_INT(numBasePins, numPins(), "closing the scan drops its pin");
+
+	freeExpr(cond);
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable("views"));
+	freeSchema(schema);
+	free(rids);
+	free(table);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testProjectedScan (void)
+{
+	int n = 500;
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	char b[64], d[16], e[64];
+	Value *value;
+	Expr *cond, *l, *r;
+	testName = "test projected scans";
+
+	// runs of fixed length attributes between varchars
+	char *names[] = { "a", "b", "c", "d", "e" };
+	DataType dt[] = { DT_INT, DT_VARCHAR, DT_INT, DT_STRING, DT_VARCHAR };
+	int sizes[] = { 0, 50, 0, 8, 30 };
+	int keys[] = { 0 };
+	Schema *schema = createSchema(5, names, dt, sizes, 1, keys);
+	TEST_CHECK(createTable("projected", schema));
+	TEST_CHECK(openTable(table, "projected"));
+	Record *record;
+	TEST_CHECK(createRecord(&record, table->schema));
+	for (int i = 0; i < n; i++) {
+		projectedRow(i, b, d, e);
+		MAKE_VALUE(value, DT_INT, i);
+		TEST_CHECK(setAttr(record, table->schema, 0, value));
+		freeVal(value);
+		setString(record, table->schema, 1, b);
+		MAKE_VALUE(value, DT_INT, 7 * i);
+		TEST_CHECK(setAttr(record, table->schema, 2, value));
+		freeVal(value);
+		setString(record, table->schema, 3, d);
+		setString(record, table->schema, 4, e);
+		TEST_CHECK(insertRecord(table, record));
+	}
+	freeRecord(record);
+
+	int all[] = { 0, 1, 2, 3, 4 };
+	int fixedRun[] = { 2, 3 };
+	int varchars[] = { 1, 2, 3, 4 };
+	int reordered[] = { 4, 0, 3 };
+	int single[] = { 1 };
+	checkProjectedScan(table, NULL, 5, all, n);
+	checkProjectedScan(table, NULL, 2, fixedRun, n);
+	checkProjectedScan(table, NULL, 4, varchars, n);
+	checkProjectedScan(table, NULL, 3, reordered, n);
+
+	// the condition is on an attribute that is not projected, c < 700
+	MAKE_ATTRREF(l, 2);
+	MAKE_CONS(r, stringToValue("i700"));
+	MAKE_BINOP_EXPR(cond, l, r, OP_COMP_SMALLER);
+	checkProjectedScan(table, cond, 1, single, 100);
+	freeExpr(cond);
+
+	RM_ScanHandle scan;
+	int outOfBounds[] = { 0, 5 };
+	ASSERT_RC(RC_RM_ATTR_NUM_OUT_OF_BOUNDS, startProjectedScan(table, &scan, NULL, 2, outOfBounds), "projected attribute out of bounds");
+
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable("projected"));
+	freeSchema(schema);
+	free(table);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testCatalogCache (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RM_TableData *other = (RM_TableData *) malloc(sizeof(RM_TableData));
+	BTreeHandle *tree;
+	testName = "test the catalog cache";
+
+	Schema *schema = fixedSchema();
+	TEST_CHECK(createTable("cached", schema));
+	freeSchema(schema);
+
+	// handles share the decoded schema and hold no pins
+	int numBasePins = numPins();
+	TEST_CHECK(openTable(table, "cached"));
+	TEST_CHECK(openTable(other, "cached"));
+	RM_CatalogTable *entry = RM_Catalog_getTable(RM_getInstance()->catalog, "cached");
+	ASSERT_TRUE(entry != NULL && table->schema == &entry->schema, "open table uses the cached schema");
+	ASSERT_TRUE(table->schema == other->schema, "handles share the cached schema");
+	ASSERT_EQUALS_INT(numBasePins, numPins(), "open tables hold no pins");
+	ASSERT_EQUALS_INT(3, entry->refCount, "catalog and both handles hold the entry");
+	TEST_CHECK(closeTable(other));
+	ASSERT_EQUALS_INT(2, entry->refCount, "closing a handle drops its reference");
+	TEST_CHECK(closeTable(table));
+
+	// DDL keeps the cache up to date
+	TEST_CHECK(deleteTable("cached"));
+	ASSERT_TRUE(RM_Catalog_getTable(RM_getInstance()->catalog, "cached") == NULL, "deleted table leaves the cache");
+	ASSERT_RC(RC_RM_UNKNOWN_TABLE, openTable(table, "cached"), "open a deleted table");
+	schema = varcharSchema(40);
+	TEST_CHECK(createTable("cached", schema));
+	freeSchema(schema);
+	TEST_CHECK(openTable(table, "cached"));
+	ASSERT_TRUE(table->schema->dataTypes[1] == DT_VARCHAR, "recreated table has the new schema");
+	TEST_CHECK(closeTable(table));
+
+	// after a restart the cache is only loaded by the first lookup
+	TEST_CHECK(shutdownRecordManager());
+	TEST_CHECK(initRecordManager(NULL));
+	ASSERT_TRUE(!RM_getInstance()->catalog->tablesLoaded, "tables are not loaded on startup");
+	TEST_CHECK(openTable(table, "cached"));
+	ASSERT_TRUE(RM_getInstance()->catalog->tablesLoaded, "first lookup loads the tables");
+	ASSERT_EQUALS_INT(40, table->schema->typeLength[1], "schema read back from the catalog");
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable("cached"));
+
+	// the same for index descriptors
+	TEST_CHECK(initIndexManager(NULL));
+	TEST_CHECK(createBtree("cached_idx", DT_INT, 4));
+	ASSERT_TRUE(RM_Catalog_getIndex(RM_getInstance()->catalog, "cached_idx") != NULL, "created index is cached");
+	TEST_CHECK(openBtree(&tree, "cached_idx"));
+	TEST_CHECK(closeBtree(tree));
+	TEST_CHECK(deleteBtree("cached_idx"));
+	ASSERT_TRUE(RM_Catalog_getIndex(RM_getInstance()->catalog, "cached_idx") == NULL, "deleted index leaves the cache");
+	ASSERT_RC(RC_IM_KEY_NOT_FOUND, openBtree(&tree, "cached_idx"), "open a deleted index");
+	TEST_CHECK(shutdownIndexManager());
+	TEST_CHECK(initRecordManager(NULL));
+
+	free(other);
+	free(table);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testCatalogChain (void)
+{
+	int n = 300;
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	char name[32];
+	testName = "test a catalog of many tables";
+
+	for (int i = 0; i < n; i++) {
+		sprintf(name, "tenant_%03d", i);
+		Schema *schema = tenantSchema(i);
+		TEST_CHECK(createTable(name, schema));
+		freeSchema(schema);
+	}
+	int numPages = numChainPages(RM_PAGE_SCHEMA);
+	ASSERT_TRUE(numPages > 2, "schemas span several catalog pages");
+
+	// every schema is found again from the chain, not just the cache
+	TEST_CHECK(shutdownRecordManager());
+	TEST_CHECK(initRecordManager(NULL));
+	int numWrong = 0;
+	for (int i = 0; i < n; i++) {
+		sprintf(name, "tenant_%03d", i);
+		TEST_CHECK(openTable(table, name));
+		numWrong += table->schema->numAttr != 2 || table->schema->typeLength[1] != 4 + i % 20;
+		TEST_CHECK(closeTable(table));
+	}
+	ASSERT_EQUALS_INT(0, numWrong, "every schema read back after a restart");
+
+	// tables created after deletes take the room the deleted ones left on
+	// their catalog page
+	bool *isDeleted = calloc(n, sizeof(bool));
+	int numDeleted = 0;
+	for (int i = 0; i < n; i++) {
+		sprintf(name, "tenant_%03d", i);
+		if (RM_Catalog_getTable(RM_getInstance()->catalog, name)->pageNum == RM_PAGE_SCHEMA) {
+			TEST_CHECK(deleteTable(name));
+			isDeleted[i] = true;
+			numDeleted++;
+		}
+	}
+	ASSERT_TRUE(numDeleted > 0 && numDeleted < n, "first catalog page holds some of the tables");
+	for (int i = 0; i < n; i++) {
+		if (isDeleted[i]) {
+			sprintf(name, "tenant_%03d", n + i);
+			Schema *schema = tenantSchema(i);
+			TEST_CHECK(createTable(name, schema));
+			freeSchema(schema);
+		}
+	}
+	ASSERT_EQUALS_INT(numPages, numChainPages(RM_PAGE_SCHEMA), "freed catalog room is reused");
+
+	TEST_CHECK(shutdownRecordManager());
+	TEST_CHECK(initRecordManager(NULL));
+	numWrong = 0;
+	for (int i = 0; i < 2 * n; i++) {
+		sprintf(name, "tenant_%03d", i);
+		RC rc = openTable(table, name);
+		if (i < n ? isDeleted[i] : !isDeleted[i - n]) {
+			numWrong += rc != RC_RM_UNKNOWN_TABLE;
+			continue;
+		}
+		TEST_CHECK(rc);
+		numWrong += table->schema->typeLength[1] != 4 + (i % n) % 20;
+		TEST_CHECK(closeTable(table));
+		TEST_CHECK(deleteTable(name));
+	}
+	ASSERT_EQUALS_INT(0, numWrong, "deleted tables stay deleted, the others are read back");
+
+	free(isDeleted);
+	free(table);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+Schema *
+fixedSchema (void)
+{
+	static char *names[] = { "a", "b", "c" };
+	static DataType dt[] = { DT_INT, DT_STRING, DT_INT };
+	static int sizes[] = { 0, 8, 0 };
+	static int keys[] = { 0 };
+	return createSchema(3, names, dt, sizes, 1, keys);
+}
+
+Schema *
+varcharSchema (int maxLength)
+{
+	static char *names[] = { "a", "b", "c" };
+	static DataType dt[] = { DT_INT, DT_VARCHAR, DT_INT };
+	static int sizes[] = { 0, 0, 0 };
+	static int keys[] = { 0 };
+	sizes[1] = maxLength;
+	return createSchema(3, names, dt, sizes, 1, keys);
+}
+
+Record *
+testRecord (Schema *schema, int a, const char *b, int c)
+{
+	Record *result;
+	Value *value;
+
+	TEST_CHECK(createRecord(&result, schema));
+
+	MAKE_VALUE(value, DT_INT, a);
+	TEST_CHECK(setAttr(result, schema, 0, value));
+	freeVal(value);
+
+	setString(result, schema, 1, b);
+
+	MAKE_VALUE(value, DT_INT, c);
+	TEST_CHECK(setAttr(result, schema, 2, value));
+	freeVal(value);
+
+	return result;
+}
+
+// Fixed length strings are copied at their full length, so the value is
+// padded up to it
+void
+setString (Record *record, Schema *schema, int attrNum, const char *b)
+{
+	size_t len = strlen(b);
+	size_t size = (size_t) schema->typeLength[attrNum] > len ? (size_t) schema->typeLength[attrNum] : len;
+	Value *value = (Value *) malloc(sizeof(Value));
+	value->dt = DT_STRING;
+	value->v.stringV = calloc(size + 1, 1);
+	memcpy(value->v.stringV, b, len);
+	TEST_CHECK(setAttr(record, schema, attrNum, value));
+	freeVal(value);
+}
+
+void
+checkRecord (RM_TableData *table, RID id, int a, const char *b, int c)
+{
+	Record record;
+	Value *value;
+	int isSame = 1;
+
+	TEST_CHECK(getRecord(table, id, &record));
+	getAttr(&record, table->schema, 0, &value);
+	isSame &= value->v.intV == a;
+	freeVal(value);
+	getAttr(&record, table->schema, 1, &value);
+	isSame &= strcmp(value->v.stringV, b) == 0;
+	freeVal(value);
+	getAttr(&record, table->schema, 2, &value);
+	isSame &= value->v.intV == c;
+	freeVal(value);
+	free(record.data);
+
+	if (!isSame) {
+		printf("[%s-%s-L%i-%s] FAILED: record %d at %d.%d has changed\n", TEST_INFO, a, id.page, id.slot);
+		exit(1);
+	}
+}
+
+void
+makeString (char *buf, int i, int len)
+{
+	for (int j = 0; j < len; j++) {
+		buf[j] = (char) ('a' + (i + j) % 26);
+	}
+	buf[len] = '\0';
+}
+
+// Closes the table and restarts the record manager, so that everything is
+// read back from the page file
+void
+reopen (RM_TableData *table, char *name)
+{
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(shutdownRecordManager());
+	TEST_CHECK(initRecordManager(NULL));
+	TEST_CHECK(openTable(table, name));
+}
+
+int
+numFilePages (void)
+{
+	BP_Metadata *meta = RM_getInstance()->bufferPool->mgmtData;
+	return meta->fileHandle->totalNumPages;
+}
+
+// Strings of row `i` of the projected scan test, of varying lengths
+void
+projectedRow (int i, char *b, char *d, char *e)
+{
+	makeString(b, i, 3 + i % 40);
+	makeString(d, i + 1, 8);
+	makeString(e, i + 2, i % 25);
+}
+
+// Scans `table` for the attributes `attrs` and checks that every record of
+// the projected schema holds what row `a` has in those attributes
+void
+checkProjectedScan (RM_TableData *table, Expr *cond, int numAttrs, int *attrs, int numExpected)
+{
+	Schema *projected = createProjectedSchema(table->schema, numAttrs, attrs);
+	RM_ScanHandle scan;
+	Record *record;
+	Value *value;
+	char b[64], d[16], e[64];
+	char *strings[] = { NULL, b, NULL, d, e };
+	int count = 0;
+	int numWrong = 0;
+	int a = -1;
+
+	TEST_CHECK(createRecord(&record, projected));
+	TEST_CHECK(startProjectedScan(table, &scan, cond, numAttrs, attrs));
+	while (next(&scan, record) == RC_OK) {
+		Record row;
+		TEST_CHECK(getRecord(table, record->id, &row));
+		getAttr(&row, table->schema, 0, &value);
+		a = value->v.intV;
+		freeVal(value);
+		free(row.data);
+
+		projectedRow(a, b, d, e);
+		for (int j = 0; j < numAttrs; j++) {
+			getAttr(record, projected, j, &value);
+			switch (attrs[j]) {
+				case 0:
+					numWrong += value->v.intV != a;
+					break;
+				case 2:
+					numWrong += value->v.intV != 7 * a;
+					break;
+				default:
+					numWrong += strcmp(value->v.stringV, strings[attrs[j]]) != 0;
+					break;
+			}
+			freeVal(value);
+		}
+		count++;
+	}
+	TEST_CHECK(closeScan(&scan));
+	ASSERT_EQUALS_INT(numExpected, count, "projected scan returns every record");
+	ASSERT_EQUALS_INT(0, numWrong, "projected records hold the projected attributes");
+
+	freeRecord(record);
+	freeSchema(projected);
+}
+
+// Catalog pages chained from `firstPageNum`
+int
+numChainPages (PageNumber firstPageNum)
+{
+	BM_BufferPool *pool = RM_getInstance()->bufferPool;
+	BM_PageHandle h = {};
+	PageNumber pageNum = firstPageNum;
+	int n = 0;
+	while (pageNum != RM_PAGE_NEXT_PAGENUM_UNSET) {
+		TEST_CHECK(pinPage(pool, &h, pageNum));
+		pageNum = ((RM_Page *) h.buffer)->header.nextPageNum;
+		TEST_CHECK(unpinPage(pool, &h));
+		n++;
+	}
+	return n;
+}
+
+// The schema borrows its arrays, it is only good until the next call
+Schema *
+tenantSchema (int i)
+{
+	static char *names[] = { "id", "tenant" };
+	static DataType dt[] = { DT_INT, DT_STRING };
+	static int sizes[] = { 0, 0 };
+	static int keys[] = { 0 };
+	sizes[1] = 4 + i % 20;
+	return createSchema(2, names, dt, sizes, 1, keys);
+}
+
+// Pins held on the pool of the record manager, apart from resident pages
+int
+numPins (void)
+{
+	BM_BufferPool *pool = RM_getInstance()->bufferPool;
+	int *fixCounts = getFixCounts(pool);
+	int n = 0;
+	for (int i = 0; i < pool->numPages; i++) {
+		n += fixCounts[i];
+	}
+	return n;
+}
+
+ScanSummary
+scanSummary (RM_TableData *table, Expr *cond)
+{
+	ScanSummary summary = {.schema = table->schema};
+	RM_ScanHandle scan;
+	Record *record;
+	Value *value;
+
+	TEST_CHECK(createRecord(&record, table->schema));
+	TEST_CHECK(startScan(table, &scan, cond));
+	while (next(&scan, record) == RC_OK) {
+		summary.count++;
+		getAttr(record, table->schema, 0, &value);
+		summary.sumA += value->v.intV;
+		freeVal(value);
+		getAttr(record, table->schema, 2, &value);
+		summary.sumC += value->v.intV;
+		freeVal(value);
+	}
+	TEST_CHECK(closeScan(&scan));
+	freeRecord(record);
+	return summary;
+}
+
+ScanSummary
+batchSummary (RM_TableData *table, Expr *cond)
+{
+	ScanSummary summary = {.schema = table->schema};
+	RM_ScanHandle scan;
+	Record *records[64];
+	int numRecords;
+
+	for (int i = 0; i < 64; i++) {
+		TEST_CHECK(createRecord(&records[i], table->schema));
+	}
+	TEST_CHECK(startScan(table, &scan, cond));
+	while (nextBatch(&scan, records, 64, &numRecords) == RC_OK) {
+		summarize(&summary, 0, records, numRecords);
+	}
+	TEST_CHECK(closeScan(&scan));
+	for (int i = 0; i < 64; i++) {
+		freeRecord(records[i]);
+	}
+	return summary;
+}
+
+ScanSummary
+parallelSummary (RM_TableData *table, Expr *cond, int numWorkers)
+{
+	ScanSummary summary = {.schema = table->schema};
+	TEST_CHECK(parallelScan(table, cond, numWorkers, summarize, &summary));
+
+	// every record is seen by exactly one of the workers that were asked for
+	int maxWorkers = numWorkers != RM_PARALLEL_SCAN_WORKERS_AUTO ? numWorkers : RM_PARALLEL_SCAN_MAX_WORKERS;
+	long numSeen = 0;
+	long numSeenByOthers = 0;
+	for (int i = 0; i < RM_PARALLEL_SCAN_MAX_WORKERS; i++) {
+		numSeen += summary.workerCounts[i];
+		numSeenByOthers += i >= maxWorkers ? summary.workerCounts[i] : 0;
+	}
+	ASSERT_EQUALS_INT(0, (int) summary.numBadWorkers, "worker indexes are in range");
+	ASSERT_EQUALS_INT(0, (int) numSeenByOthers, "only the workers asked for see records");
+	ASSERT_EQUALS_INT((int) summary.count, (int) numSeen, "per worker counts add up");
+	return summary;
+}
+
+// Workers call this concurrently
+RC
+summarize (void *ctx, int workerIndex, Record **records, int numRecords)
+{
+	ScanSummary *summary = ctx;
+	Value *value;
+	long sumA = 0;
+	long sumC = 0;
+	if (workerIndex < 0 || workerIndex >= RM_PARALLEL_SCAN_MAX_WORKERS) {
+		__atomic_add_fetch(&summary->numBadWorkers, 1, __ATOMIC_RELAXED);
+		return RC_OK;
+	}
+	for (int i = 0; i < numRecords; i++) {
+		getAttr(records[i], summary->schema, 0, &value);
+		sumA += value->v.intV;
+		freeVal(value);
+		getAttr(records[i], summary->schema, 2, &value);
+		sumC += value->v.intV;
+		freeVal(value);
+	}
+	__atomic_add_fetch(&summary->workerCounts[workerIndex], numRecords, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&summary->count, numRecords, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&summary->sumA, sumA, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&summary->sumC, sumC, __ATOMIC_RELAXED);
+	return RC_OK;
+}
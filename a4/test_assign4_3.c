@@ -0,0 +1,540 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bm_trace.h"
+#include "buffer_mgr.h"
+#include "buffer_mgr_stat.h"
+#include "dberror.h"
+#include "storage_mgr.h"
+#include "test_helper.h"
+
+#define TEST_FILENAME "testbuffer.bin"
+#define TEST_FILE_PAGES 256
+#define TEST_TRACE_FILENAME "testbuffer.trace"
+
+// test methods
+static void testRingStrategy (void);
+static void testPrefetch (void);
+static void testOptimisticRead (void);
+static void testPoolStats (void);
+static void testWriteBlocks (void);
+static void testFlushOrder (void);
+static void testResidentPages (void);
+
+// helper methods
+static void createTestFile (int numPages);
+static void checkPage (BM_PageHandle *h, PageNumber pageNum);
+static bool isResident (BM_BufferPool *bm, PageNumber pageNum);
+static int frameOf (BM_BufferPool *bm, PageNumber pageNum);
+static uint64_t countChange (void *ctx, BM_PageHandle *page, const char *before, bool isFirstChange);
+static void recordWrite (void *ctx, const BM_PageHandle *page);
+
+// Pages in the order the pool announced their write back
+typedef struct WriteOrder {
+	int numWrites;
+	PageNumber pageNums[64];
+} WriteOrder;
+
+// test name
+char *testName;
+
+// main method
+int
+main (void)
+{
+	testName = "";
+
+	initStorageManager();
+	createTestFile(TEST_FILE_PAGES);
+
+	testRingStrategy();
+	testPrefetch();
+	testOptimisticRead();
+	testPoolStats();
+	testWriteBlocks();
+	testFlushOrder();
+	testResidentPages();
+
+	TEST_CHECK(destroyPageFile(TEST_FILENAME));
+	printf("PASSED ALL TESTS\n");
+	return 0;
+}
+
+// ************************************************************
+void
+testRingStrategy (void)
+{
+	int numFrames = 16;
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	testName = "test a scan ring only recycles its own frames";
+
+	TEST_CHECK(initBufferPool(bm, TEST_FILENAME, numFrames, RS_LRU, NULL));
+	for (int i = 0; i < numFrames; i++) {
+		TEST_CHECK(pinPage(bm, h, i));
+		TEST_CHECK(unpinPage(bm, h));
+	}
+
+	// the ring takes at most `ringSize` frames from the pool, then only
+	// recycles them
+	BM_AccessStrategy *ring = createRingStrategy(bm, numFrames);
+	int ringSize = ring->ringSize;
+	ASSERT_EQUALS_INT(numFrames / 4, ringSize, "ring is capped at a quarter of the pool");
+	for (int i = 100; i < 200; i++) {
+		TEST_CHECK(pinPageWithStrategy(bm, h, i, ring));
+		checkPage(h, i);
+		TEST_CHECK(unpinPage(bm, h));
+	}
+
+	int numHot = 0;
+	for (int i = 0; i < numFrames; i++) {
+		numHot += isResident(bm, i);
+	}
+	ASSERT_TRUE(numHot >= numFrames - ringSize, "scan took at most a ring of frames from the pool");
+	ASSERT_TRUE(isResident(bm, 199), "ring holds the last page of the scan");
+
+	// a regular pin takes a page out of the ring, which then has to take a
+	// frame from the pool again
+	TEST_CHECK(pinPage(bm, h, 199));
+	TEST_CHECK(unpinPage(bm, h));
+	for (int i = 200; i < 200 + ringSize; i++) {
+		TEST_CHECK(pinPageWithStrategy(bm, h, i, ring));
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	ASSERT_TRUE(isResident(bm, 199), "promoted page is not recycled by the ring");
+
+	freeAccessStrategy(ring);
+	TEST_CHECK(shutdownBufferPool(bm));
+	free(bm);
+	free(h);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testPrefetch (void)
+{
+	int numFrames = 16;
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	testName = "test prefetch hits, late and wasted prefetches";
+
+	TEST_CHECK(initBufferPool(bm, TEST_FILENAME, numFrames, RS_LRU, NULL));
+
+	// pinned after the reads had plenty of time to finish
+	PageNumber pageNums[] = { 10, 11, 12, 13 };
+	TEST_CHECK(prefetchPages(bm, pageNums, 4));
+	ASSERT_EQUALS_INT(4, getNumReadIO(bm), "each prefetch reads its page");
+	usleep(100 * 1000);
+	for (int i = 0; i < 4; i++) {
+		TEST_CHECK(pinPage(bm, h, pageNums[i]));
+		checkPage(h, pageNums[i]);
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	ASSERT_EQUALS_INT(4, getNumPrefetchHits(bm), "pins of completed prefetches are hits");
+	ASSERT_EQUALS_INT(4, getNumReadIO(bm), "prefetched pages are not read again");
+
+	// pinned right away, the read may still be in flight
+	TEST_CHECK(prefetchPage(bm, 14));
+	TEST_CHECK(pinPage(bm, h, 14));
+	checkPage(h, 14);
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_EQUALS_INT(5, getNumPrefetchHits(bm) + getNumPrefetchLate(bm), "every prefetched pin is a hit or late");
+	ASSERT_EQUALS_INT(0, getNumPrefetchWasted(bm), "no prefetch was wasted yet");
+
+	// pinning a page again is a plain hit
+	TEST_CHECK(pinPage(bm, h, 10));
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_EQUALS_INT(5, getNumPrefetchHits(bm) + getNumPrefetchLate(bm), "only the first pin uses the prefetch");
+
+	// evicted before anyone pinned them
+	PageNumber unusedPageNums[] = { 40, 41, 42 };
+	TEST_CHECK(prefetchPages(bm, unusedPageNums, 3));
+	usleep(100 * 1000);
+	for (int i = 50; i < 50 + numFrames; i++) {
+		TEST_CHECK(pinPage(bm, h, i));
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	ASSERT_EQUALS_INT(3, getNumPrefetchWasted(bm), "evicted prefetches are wasted");
+
+	// a page written back on eviction is read back by a prefetch
+	TEST_CHECK(pinPage(bm, h, 30));
+	sprintf(h->buffer, "Changed-30");
+	TEST_CHECK(markDirty(bm, h));
+	TEST_CHECK(unpinPage(bm, h));
+	for (int i = 50; i < 50 + numFrames; i++) {
+		TEST_CHECK(pinPage(bm, h, i + numFrames));
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	ASSERT_TRUE(!isResident(bm, 30), "written page was evicted");
+	TEST_CHECK(prefetchPage(bm, 30));
+	TEST_CHECK(pinPage(bm, h, 30));
+	ASSERT_EQUALS_STRING("Changed-30", h->buffer, "prefetch reads the page as it was written back");
+	sprintf(h->buffer, "Page-30");
+	TEST_CHECK(markDirty(bm, h));
+	TEST_CHECK(unpinPage(bm, h));
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	free(bm);
+	free(h);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testOptimisticRead (void)
+{
+	int numFrames = 4;
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	BM_PageHandle read;
+	uint32_t version;
+	testName = "test optimistic reads of resident pages";
+
+	TEST_CHECK(initBufferPool(bm, TEST_FILENAME, numFrames, RS_LRU, NULL));
+	ASSERT_EQUALS_INT(RC_PAGE_NOT_IN_BUFFER, beginOptimisticRead(bm, &read, 5, &version), "page that is not resident has to be pinned");
+
+	TEST_CHECK(pinPage(bm, h, 5));
+	TEST_CHECK(unpinPage(bm, h));
+	TEST_CHECK(beginOptimisticRead(bm, &read, 5, &version));
+	checkPage(&read, 5);
+	ASSERT_TRUE(validateOptimisticRead(bm, &read, version), "unchanged frame validates");
+
+	// a write published through markDirty
+	TEST_CHECK(beginOptimisticRead(bm, &read, 5, &version));
+	TEST_CHECK(pinPage(bm, h, 5));
+	TEST_CHECK(markDirty(bm, h));
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_TRUE(!validateOptimisticRead(bm, &read, version), "written frame does not validate");
+
+	// the frame is reloaded with another page, then with the same page
+	TEST_CHECK(beginOptimisticRead(bm, &read, 5, &version));
+	for (int i = 0; i < numFrames; i++) {
+		TEST_CHECK(pinPage(bm, h, 100 + i));
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	ASSERT_TRUE(!validateOptimisticRead(bm, &read, version), "evicted frame does not validate");
+	for (int i = 0; i < numFrames; i++) {
+		TEST_CHECK(pinPage(bm, h, 5 + i));
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	ASSERT_TRUE(isResident(bm, 5), "page is resident again");
+	ASSERT_TRUE(!validateOptimisticRead(bm, &read, version), "reloaded page does not validate with its old version");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	free(bm);
+	free(h);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testPoolStats (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	BM_PoolStats stats;
+	testName = "test pool statistics snapshots";
+
+	TEST_CHECK(initBufferPool(bm, TEST_FILENAME, 4, RS_LRU, NULL));
+	getPoolStats(bm, &stats);
+	for (int c = 0; c < BM_STAT_COUNTER_COUNT; c++) {
+		ASSERT_EQUALS_INT(0, (int) stats.counters[c], "new pool has not counted anything");
+	}
+
+	// 4 misses, a hit, then 2 misses that evict page 1 (dirty) and page 2
+	for (int i = 0; i < 4; i++) {
+		TEST_CHECK(pinPage(bm, h, i));
+		if (i == 1) {
+			TEST_CHECK(markDirty(bm, h));
+		}
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	TEST_CHECK(pinPage(bm, h, 0));
+	TEST_CHECK(unpinPage(bm, h));
+	for (int i = 4; i < 6; i++) {
+		TEST_CHECK(pinPage(bm, h, i));
+		TEST_CHECK(unpinPage(bm, h));
+	}
+
+	// a ring of one frame: its first miss evicts through LRU, its second
+	// recycles the ring frame
+	BM_AccessStrategy *ring = createRingStrategy(bm, 1);
+	for (int i = 10; i < 12; i++) {
+		TEST_CHECK(pinPageWithStrategy(bm, h, i, ring));
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	freeAccessStrategy(ring);
+
+	getPoolStats(bm, &stats);
+	ASSERT_EQUALS_INT(1, (int) stats.counters[BM_STAT_HITS], "hits");
+	ASSERT_EQUALS_INT(8, (int) stats.counters[BM_STAT_MISSES], "misses");
+	ASSERT_EQUALS_INT(8, (int) stats.counters[BM_STAT_READS], "reads");
+	ASSERT_EQUALS_INT(4, (int) stats.counters[BM_STAT_EVICTIONS], "evictions");
+	ASSERT_EQUALS_INT(1, (int) stats.counters[BM_STAT_DIRTY_EVICTIONS], "dirty evictions");
+	ASSERT_EQUALS_INT(1, (int) stats.counters[BM_STAT_WRITES], "writes");
+
+	uint64_t *lru = stats.strategyCounters[RS_LRU];
+	uint64_t *ringCounters = stats.strategyCounters[BM_STAT_STRATEGY_RING];
+	ASSERT_EQUALS_INT(1, (int) lru[BM_STRATEGY_STAT_HITS], "LRU hits");
+	ASSERT_EQUALS_INT(6, (int) lru[BM_STRATEGY_STAT_MISSES], "LRU misses");
+	ASSERT_EQUALS_INT(3, (int) lru[BM_STRATEGY_STAT_EVICTIONS], "LRU evictions");
+	ASSERT_EQUALS_INT(0, (int) ringCounters[BM_STRATEGY_STAT_HITS], "ring hits");
+	ASSERT_EQUALS_INT(2, (int) ringCounters[BM_STRATEGY_STAT_MISSES], "ring misses");
+	ASSERT_EQUALS_INT(1, (int) ringCounters[BM_STRATEGY_STAT_EVICTIONS], "ring evictions");
+
+	// the single counter getters read the same counters
+	ASSERT_EQUALS_INT(8, getNumReadIO(bm), "getNumReadIO matches the snapshot");
+	ASSERT_EQUALS_INT(1, getNumWriteIO(bm), "getNumWriteIO matches the snapshot");
+
+	char *dump = sprintPoolStats(bm);
+	ASSERT_TRUE(strstr(dump, "pool=LRU pages=4 hit_ratio=0.1111") == dump, "dump starts with the pool line");
+	ASSERT_TRUE(strstr(dump, " misses=8 ") != NULL, "dump holds the pool counters");
+	ASSERT_TRUE(strstr(dump, "strategy=RING hits=0 misses=2 evictions=1") != NULL, "dump holds the ring counters");
+	free(dump);
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	free(bm);
+	free(h);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testWriteBlocks (void)
+{
+	// longer than one vectored write, past the end of the test file
+	int first = TEST_FILE_PAGES;
+	int n = 100;
+	SM_FileHandle fh;
+	char *pages = malloc((size_t) n * PAGE_SIZE);
+	SM_PageHandle buffers[n];
+	char page[PAGE_SIZE];
+	testName = "test writing a run of pages with writeBlocks";
+
+	TEST_CHECK(openPageFile(TEST_FILENAME, &fh));
+	ASSERT_ERROR(writeBlocks(first, n, &fh, buffers), "run past the end of the file");
+	TEST_CHECK(ensureCapacity(first + n, &fh));
+	for (int i = 0; i < n; i++) {
+		buffers[i] = pages + (size_t) i * PAGE_SIZE;
+		memset(buffers[i], 0, PAGE_SIZE);
+		sprintf(buffers[i], "Block-%i", first + i);
+	}
+	TEST_CHECK(writeBlocks(first, n, &fh, buffers));
+	for (int i = 0; i < n; i++) {
+		char expected[PAGE_SIZE];
+		sprintf(expected, "Block-%i", first + i);
+		TEST_CHECK(readBlock(first + i, &fh, page));
+		if (strcmp(expected, page) != 0) {
+			ASSERT_EQUALS_STRING(expected, page, "page of the run reads back");
+		}
+	}
+	TEST_CHECK(readBlock(first - 1, &fh, page));
+	ASSERT_EQUALS_STRING("Page-255", page, "page before the run is left alone");
+	TEST_CHECK(closePageFile(&fh));
+	free(pages);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testFlushOrder (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	WriteOrder order = { .numWrites = 0 };
+	BM_LogHooks hooks = { .logChange = countChange, .beforeWrite = recordWrite, .ctx = &order };
+	PageNumber pageNums[] = { 35, 33, 34, 39, 37, 12 };
+	PageNumber sorted[] = { 12, 33, 34, 35, 37, 39 };
+	int n = 6;
+	testName = "test forceFlushPool writes dirty pages in page order";
+
+	TEST_CHECK(initBufferPool(bm, TEST_FILENAME, 8, RS_FIFO, NULL));
+	TEST_CHECK(setPoolLogHooks(bm, &hooks));
+	for (int i = 0; i < n; i++) {
+		TEST_CHECK(pinPage(bm, h, pageNums[i]));
+		sprintf(h->buffer, "Flushed-%i", pageNums[i]);
+		TEST_CHECK(markDirty(bm, h));
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	TEST_CHECK(pinPage(bm, h, 20));
+	TEST_CHECK(unpinPage(bm, h));
+
+	TEST_CHECK(forceFlushPool(bm));
+	ASSERT_EQUALS_INT(n, order.numWrites, "every dirty page is written back");
+	for (int i = 0; i < n; i++) {
+		ASSERT_EQUALS_INT(sorted[i], order.pageNums[i], "pages are written in page order");
+	}
+	ASSERT_EQUALS_INT(n, getNumWriteIO(bm), "clean pages are not written");
+	bool *dirtyFlags = getDirtyFlags(bm);
+	for (int i = 0; i < bm->numPages; i++) {
+		ASSERT_TRUE(!dirtyFlags[i], "flushed frames are clean");
+	}
+
+	TEST_CHECK(forceFlushPool(bm));
+	ASSERT_EQUALS_INT(n, order.numWrites, "a second flush has nothing to write");
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	// what the runs wrote, then put the pages back
+	SM_FileHandle fh;
+	char page[PAGE_SIZE];
+	TEST_CHECK(openPageFile(TEST_FILENAME, &fh));
+	for (int i = 0; i < n; i++) {
+		char expected[PAGE_SIZE];
+		sprintf(expected, "Flushed-%i", pageNums[i]);
+		TEST_CHECK(readBlock(pageNums[i], &fh, page));
+		ASSERT_EQUALS_STRING(expected, page, "flushed page reads back");
+
+		memset(page, 0, PAGE_SIZE);
+		sprintf(page, "Page-%i", pageNums[i]);
+		TEST_CHECK(writeBlock(pageNums[i], &fh, page));
+	}
+	TEST_CHECK(closePageFile(&fh));
+	free(bm);
+	free(h);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testResidentPages (void)
+{
+	int numFrames = 8;
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	BM_PoolOptions options = BM_POOL_OPTIONS_DEFAULT;
+	BM_PoolStats stats;
+	options.residentBudget = 2;
+	testName = "test resident pages and their budget";
+
+	TEST_CHECK(initBufferPoolWithOptions(bm, TEST_FILENAME, numFrames, RS_LRU, NULL, &options));
+	TEST_CHECK(startPoolTrace(bm, TEST_TRACE_FILENAME));
+	TEST_CHECK(markPageResident(bm, 0));
+	TEST_CHECK(markPageResident(bm, 1));
+	TEST_CHECK(markPageResident(bm, 0));
+	ASSERT_EQUALS_INT(2, getNumResidentPages(bm), "marking a page twice keeps it once");
+	ASSERT_EQUALS_INT(RC_BM_RESIDENT_BUDGET_EXCEEDED, markPageResident(bm, 2), "budget is exhausted");
+	ASSERT_TRUE(!isResident(bm, 2), "page over the budget is not loaded");
+
+	// the internal pins are not pins of any caller
+	getPoolStats(bm, &stats);
+	ASSERT_EQUALS_INT(0, (int) (stats.counters[BM_STAT_HITS] + stats.counters[BM_STAT_MISSES]), "resident pins are not counted as pins");
+	ASSERT_EQUALS_INT(2, (int) stats.counters[BM_STAT_READS], "loading resident pages counts as reads");
+	int *fixCounts = getFixCounts(bm);
+	for (int i = 0; i < numFrames; i++) {
+		ASSERT_EQUALS_INT(0, fixCounts[i], "resident pins are not in the fix counts");
+	}
+	TEST_CHECK(stopPoolTrace(bm));
+	FILE *trace = fopen(TEST_TRACE_FILENAME, "rb");
+	fseek(trace, 0, SEEK_END);
+	ASSERT_EQUALS_INT((int) sizeof(BM_TraceHeader), (int) ftell(trace), "resident pins are not traced");
+	fclose(trace);
+	remove(TEST_TRACE_FILENAME);
+
+	// pins of a resident page still show
+	TEST_CHECK(pinPage(bm, h, 0));
+	ASSERT_EQUALS_INT(1, getFixCounts(bm)[frameOf(bm, 0)], "caller pin of a resident page is counted");
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_EQUALS_INT(0, getFixCounts(bm)[frameOf(bm, 0)], "caller pin is released");
+
+	for (int i = 100; i < 100 + 2 * numFrames; i++) {
+		TEST_CHECK(pinPage(bm, h, i));
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	ASSERT_TRUE(isResident(bm, 0) && isResident(bm, 1), "resident pages are never evicted");
+
+	// handing a page back frees room in the budget
+	TEST_CHECK(unmarkPageResident(bm, 0));
+	TEST_CHECK(unmarkPageResident(bm, 50));
+	ASSERT_EQUALS_INT(1, getNumResidentPages(bm), "unmarking gives back one page");
+	TEST_CHECK(markPageResident(bm, 2));
+	for (int i = 100; i < 100 + 2 * numFrames; i++) {
+		TEST_CHECK(pinPage(bm, h, i));
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	ASSERT_TRUE(!isResident(bm, 0), "unmarked page is evicted again");
+	ASSERT_TRUE(isResident(bm, 1) && isResident(bm, 2), "other resident pages stay");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	free(bm);
+	free(h);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+// Writes `numPages` pages that each hold their own page number
+void
+createTestFile (int numPages)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+
+	destroyPageFile(TEST_FILENAME);
+	TEST_CHECK(createPageFile(TEST_FILENAME));
+	TEST_CHECK(initBufferPool(bm, TEST_FILENAME, 8, RS_FIFO, NULL));
+	for (int i = 0; i < numPages; i++) {
+		TEST_CHECK(pinPage(bm, h, i));
+		sprintf(h->buffer, "Page-%i", i);
+		TEST_CHECK(markDirty(bm, h));
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	free(bm);
+	free(h);
+}
+
+void
+checkPage (BM_PageHandle *h, PageNumber pageNum)
+{
+	char expected[PAGE_SIZE];
+	sprintf(expected, "Page-%i", pageNum);
+	if (strcmp(expected, h->buffer) != 0) {
+		ASSERT_EQUALS_STRING(expected, h->buffer, "page holds its own number");
+	}
+}
+
+uint64_t
+countChange (void *ctx, BM_PageHandle *page, const char *before, bool isFirstChange)
+{
+	(void) ctx;
+	(void) page;
+	(void) before;
+	(void) isFirstChange;
+	return 1;
+}
+
+void
+recordWrite (void *ctx, const BM_PageHandle *page)
+{
+	WriteOrder *order = ctx;
+	order->pageNums[order->numWrites++] = page->pageNum;
+}
+
+bool
+isResident (BM_BufferPool *bm, PageNumber pageNum)
+{
+	return frameOf(bm, pageNum) >= 0;
+}
+
+// Frame holding `pageNum`, -1 if it is not resident
+int
+frameOf (BM_BufferPool *bm, PageNumber pageNum)
+{
+	PageNumber *frameContents = getFrameContents(bm);
+	for (int i = 0; i < bm->numPages; i++) {
+		if (frameContents[i] == pageNum) {
+			return i;
+		}
+	}
+	return -1;
+}
@@ -0,0 +1,630 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+/* linux specific */
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+
+#include "dberror.h"
+#include "expr.h"
+#include "record_mgr.h"
+#include "rm_page.h"
+#include "storage_mgr.h"
+#include "tables.h"
+#include "wal.h"
+#include "test_helper.h"
+
+// the record manager always works on these
+#define TEST_FILENAME "storage.db"
+#define TEST_WAL_FILENAME "storage.db.wal"
+#define TEST_SAVED_FILENAME "test_recovery.db.saved"
+#define TEST_SAVED_WAL_FILENAME "test_recovery.db.wal.saved"
+
+#define TEST_NUM_ROWS (20000)
+#define TEST_NUM_PASSES (4)
+#define TEST_NUM_POOL_PAGES (512)
+#define TEST_STRING_LEN (4)
+#define TEST_NUM_COMMITS (64)
+
+// pages of this file are changed through a pool with a log of its own
+#define TEST_PAGE_FILENAME "testwal.bin"
+#define TEST_PAGE_WAL_FILENAME "testwal.bin.wal"
+#define TEST_PAGE_DB_ID (0x5eed)
+#define TEST_PARTIAL_DIRTY_PAGES ((int) WAL_MAX_CHECKPOINT_PAGES + 16)
+#define TEST_PARTIAL_POOL_PAGES (TEST_PARTIAL_DIRTY_PAGES + 64)
+#define TEST_REDO_POOL_PAGES (64)
+
+// A commit waiting for the log to be durable up to `lsn`
+typedef struct Committer {
+	pthread_t thread;
+	pthread_barrier_t *start;  // every commit is issued at once
+	WAL_Log *log;
+	WAL_LSN lsn;
+	WAL_LSN flushedLSN;  // durable part of the log once the commit returned
+	RC rc;
+} Committer;
+
+// test methods
+static void testCrashRecovery (void);
+static void testGroupCommit (void);
+static void testPartialCheckpoint (void);
+static void testCheckpointRedoStart (void);
+
+// helper methods
+static void crashAfterCheckpoint (void);
+static void recoverAndCheck (int numWorkers, uint64_t *hash_out);
+static void crashChild (void (*body) (void));
+static Schema *testSchema (void);
+static void setRow (Record *record, Schema *schema, int a, int c);
+static void checkRows (int numRows, int numPasses);
+static void tearPage (PageNumber pageNum);
+static void copyFile (const char *from, const char *to);
+static uint64_t hashFile (const char *fileName);
+static void *commitMain (void *arg);
+static void crashWithPartialCheckpoint (void);
+static void crashWithCheckpoint (void);
+static void createTestPageFile (int numPages);
+static WAL_Log *openTestLog (BM_BufferPool *bm, int numPages);
+static void writePage (BM_BufferPool *bm, PageNumber pageNum, int value);
+static void flushPage (BM_BufferPool *bm, PageNumber pageNum);
+static int readPage (BM_BufferPool *bm, PageNumber pageNum);
+static WAL_CheckpointHeader readCheckpoint (void);
+
+// test name
+char *testName;
+
+// main method
+int
+main (void)
+{
+	testName = "";
+
+	testCrashRecovery();
+	testGroupCommit();
+	testPartialCheckpoint();
+	testCheckpointRedoStart();
+
+	destroyPageFile(TEST_FILENAME);
+	unlink(TEST_WAL_FILENAME);
+	printf("PASSED ALL TESTS\n");
+	return 0;
+}
+
+// ************************************************************
+// Crashes after a checkpoint with a page write torn in half, and recovers the
+// same copy of the crashed database with a single redo thread and with
+// several redo workers
+void
+testCrashRecovery (void)
+{
+	uint64_t serialHash;
+	uint64_t parallelHash;
+	testName = "test crash recovery after a checkpoint and a torn write";
+
+	crashChild(crashAfterCheckpoint);
+	copyFile(TEST_FILENAME, TEST_SAVED_FILENAME);
+	copyFile(TEST_WAL_FILENAME, TEST_SAVED_WAL_FILENAME);
+
+	recoverAndCheck(1, &serialHash);
+	recoverAndCheck(4, &parallelHash);
+	ASSERT_TRUE(serialHash == parallelHash, "serial and parallel redo recover the same pages");
+
+	unlink(TEST_SAVED_FILENAME);
+	unlink(TEST_SAVED_WAL_FILENAME);
+	TEST_DONE();
+}
+
+// Appends the records of every transaction, then commits them all at once
+// from as many threads: the commits share the writes of the log instead of
+// paying for one `fdatasync` each
+void
+testGroupCommit (void)
+{
+	Committer committers[TEST_NUM_COMMITS];
+	pthread_barrier_t start;
+	testName = "test group commit";
+
+	destroyPageFile(TEST_FILENAME);
+	unlink(TEST_WAL_FILENAME);
+	TEST_CHECK(initRecordManager(NULL));
+	WAL_Log *log = RM_getInstance()->wal;
+
+	Schema *schema = testSchema();
+	TEST_CHECK(createTable("commits", schema));
+	RM_TableData table;
+	TEST_CHECK(openTable(&table, "commits"));
+	Record *record;
+	TEST_CHECK(createRecord(&record, table.schema));
+	TEST_CHECK(WAL_commit(log));
+
+	pthread_mutex_lock(&log->lock);
+	uint64_t numFlushes = log->numFlushes;
+	pthread_mutex_unlock(&log->lock);
+
+	// only this thread appends
+	pthread_barrier_init(&start, NULL, TEST_NUM_COMMITS);
+	for (int i = 0; i < TEST_NUM_COMMITS; i++) {
+		setRow(record, table.schema, i, i);
+		TEST_CHECK(insertRecord(&table, record));
+		committers[i].log = log;
+		committers[i].lsn = WAL_getAppendLSN(log);
+		committers[i].start = &start;
+	}
+	for (int i = 0; i < TEST_NUM_COMMITS; i++) {
+		ASSERT_TRUE(pthread_create(&committers[i].thread, NULL, commitMain, &committers[i]) == 0, "commit started");
+	}
+
+	int numEarly = 0;
+	for (int i = 0; i < TEST_NUM_COMMITS; i++) {
+		pthread_join(committers[i].thread, NULL);
+		TEST_CHECK(committers[i].rc);
+		numEarly += committers[i].flushedLSN < committers[i].lsn;
+	}
+	pthread_barrier_destroy(&start);
+	ASSERT_EQUALS_INT(0, numEarly, "no commit returns before its records are durable");
+	ASSERT_TRUE(WAL_getFlushedLSN(log) >= committers[TEST_NUM_COMMITS - 1].lsn, "every commit is durable");
+
+	pthread_mutex_lock(&log->lock);
+	numFlushes = log->numFlushes - numFlushes;
+	pthread_mutex_unlock(&log->lock);
+	ASSERT_TRUE(numFlushes >= 1, "commits are written out");
+	ASSERT_TRUE(numFlushes < TEST_NUM_COMMITS, "commits share log writes");
+
+	freeRecord(record);
+	TEST_CHECK(closeTable(&table));
+	freeSchema(schema);
+	TEST_CHECK(shutdownRecordManager());
+	TEST_DONE();
+}
+
+// More pages are dirty than a checkpoint record holds: the checkpoint is only
+// a starting point then, and every record from there on is redone, for pages
+// in the logged part of the table or not
+void
+testPartialCheckpoint (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	testName = "test recovery from a partial checkpoint";
+
+	crashChild(crashWithPartialCheckpoint);
+	WAL_CheckpointHeader checkpoint = readCheckpoint();
+	ASSERT_TRUE(checkpoint.flags & WAL_CHECKPOINT_FLAGS_PARTIAL, "dirty page table did not fit");
+	ASSERT_EQUALS_INT((int) WAL_MAX_CHECKPOINT_PAGES, (int) checkpoint.numDirtyPages, "checkpoint holds as many pages as fit");
+
+	WAL_Log *log = openTestLog(bm, TEST_PARTIAL_POOL_PAGES);
+	// every dirty page, the page written back in between and the change
+	// after the checkpoint
+	ASSERT_EQUALS_INT(TEST_PARTIAL_DIRTY_PAGES + 2, (int) log->numRedone, "every record from the checkpoint start is redone");
+	int numWrong = 0;
+	for (int i = 1; i <= TEST_PARTIAL_DIRTY_PAGES + 1; i++) {
+		numWrong += readPage(bm, i) != (i == 2 ? -2 : i);
+	}
+	ASSERT_EQUALS_INT(0, numWrong, "every page holds its last change");
+
+	TEST_CHECK(WAL_close(log));
+	TEST_CHECK(shutdownBufferPool(bm));
+	free(bm);
+	destroyPageFile(TEST_PAGE_FILENAME);
+	unlink(TEST_PAGE_WAL_FILENAME);
+	TEST_DONE();
+}
+
+// Redo starts at the oldest change of the dirty page table, and skips the
+// records before the checkpoint of pages that are not in the table
+void
+testCheckpointRedoStart (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	testName = "test redo from the start of a checkpoint";
+
+	crashChild(crashWithCheckpoint);
+	WAL_CheckpointHeader checkpoint = readCheckpoint();
+	ASSERT_EQUALS_INT(0, (int) checkpoint.flags, "whole dirty page table logged");
+	ASSERT_EQUALS_INT(11, (int) checkpoint.numDirtyPages, "pages 2 and 11 to 20 are dirty");
+
+	WAL_Log *log = openTestLog(bm, TEST_REDO_POOL_PAGES);
+	// pages 2 and 11 to 20, then 3 and 21 after the checkpoint
+	ASSERT_EQUALS_INT(13, (int) log->numRedone, "only changes missing from the page file are redone");
+	int numWrong = 0;
+	for (int i = 1; i <= 21; i++) {
+		numWrong += readPage(bm, i) != (i == 3 ? 103 : i);
+	}
+	ASSERT_EQUALS_INT(0, numWrong, "every page holds its last change");
+
+	TEST_CHECK(WAL_close(log));
+	TEST_CHECK(shutdownBufferPool(bm));
+	free(bm);
+	destroyPageFile(TEST_PAGE_FILENAME);
+	unlink(TEST_PAGE_WAL_FILENAME);
+	TEST_DONE();
+}
+
+// ************************************************************
+// Runs in the child: dirties more pages than a checkpoint can list, with one
+// page written back after the oldest change, checkpoints and changes one of
+// the pages again
+void
+crashWithPartialCheckpoint (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	createTestPageFile(TEST_PARTIAL_POOL_PAGES);
+	WAL_Log *log = openTestLog(bm, TEST_PARTIAL_POOL_PAGES);
+
+	writePage(bm, 1, 1);
+	writePage(bm, TEST_PARTIAL_DIRTY_PAGES + 1, TEST_PARTIAL_DIRTY_PAGES + 1);
+	flushPage(bm, TEST_PARTIAL_DIRTY_PAGES + 1);
+	for (int i = 2; i <= TEST_PARTIAL_DIRTY_PAGES; i++) {
+		writePage(bm, i, i);
+	}
+	TEST_CHECK(WAL_checkpoint(log, bm));
+	writePage(bm, 2, -2);
+	TEST_CHECK(WAL_commit(log));
+	_exit(0);
+}
+
+// Runs in the child: page 1 is written back before page 2 is dirtied, and
+// pages 3 to 10 after. Pages 2 and 11 to 20 are dirty at the checkpoint,
+// pages 3 and 21 are changed after it.
+void
+crashWithCheckpoint (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	createTestPageFile(TEST_REDO_POOL_PAGES);
+	WAL_Log *log = openTestLog(bm, TEST_REDO_POOL_PAGES);
+
+	writePage(bm, 1, 1);
+	flushPage(bm, 1);
+	writePage(bm, 2, 2);
+	for (int i = 3; i <= 10; i++) {
+		writePage(bm, i, i);
+		flushPage(bm, i);
+	}
+	for (int i = 11; i <= 20; i++) {
+		writePage(bm, i, i);
+	}
+	TEST_CHECK(WAL_checkpoint(log, bm));
+	writePage(bm, 3, 103);
+	writePage(bm, 21, 21);
+	TEST_CHECK(WAL_commit(log));
+	_exit(0);
+}
+
+// ************************************************************
+// Runs in the child: fills a table, writes every page back and checkpoints,
+// then updates every row TEST_NUM_PASSES times and commits. The first half of
+// a page changed since the checkpoint is written over its copy in the page
+// file, as a crash in the middle of the write back would, and the process
+// exits without shutting anything down.
+void
+crashAfterCheckpoint (void)
+{
+	destroyPageFile(TEST_FILENAME);
+	unlink(TEST_WAL_FILENAME);
+	TEST_CHECK(initRecordManager(NULL));
+	BM_BufferPool *pool = RM_getInstance()->bufferPool;
+	WAL_Log *log = RM_getInstance()->wal;
+	WAL_setCheckpointInterval(log, 0);
+
+	Schema *schema = testSchema();
+	TEST_CHECK(createTable("recovery", schema));
+	RM_TableData table;
+	TEST_CHECK(openTable(&table, "recovery"));
+	Record *record;
+	TEST_CHECK(createRecord(&record, table.schema));
+
+	RID *rids = malloc(TEST_NUM_ROWS * sizeof(RID));
+	for (int i = 0; i < TEST_NUM_ROWS; i++) {
+		setRow(record, table.schema, i, i);
+		TEST_CHECK(insertRecord(&table, record));
+		rids[i] = record->id;
+	}
+
+	// every page is clean at the checkpoint, redo starts right at it
+	TEST_CHECK(forceFlushPool(pool));
+	TEST_CHECK(WAL_checkpoint(log, pool));
+	WAL_LSN checkpointLSN = WAL_getAppendLSN(log);
+
+	for (int pass = 1; pass <= TEST_NUM_PASSES; pass++) {
+		for (int i = 0; i < TEST_NUM_ROWS; i++) {
+			record->id = rids[i];
+			setRow(record, table.schema, i, pass * TEST_NUM_ROWS + i);
+			TEST_CHECK(updateRecord(&table, record));
+		}
+	}
+	TEST_CHECK(WAL_commit(log));
+	ASSERT_TRUE(WAL_getAppendLSN(log) - checkpointLSN >= WAL_PARALLEL_REDO_MIN_SIZE,
+			"enough log after the checkpoint for parallel redo");
+
+	tearPage(rids[0].page);
+	_exit(0);
+}
+
+// Recovers a fresh copy of the crashed database with `numWorkers` redo
+// workers, then checks every committed row through the record manager
+void
+recoverAndCheck (int numWorkers, uint64_t *hash_out)
+{
+	copyFile(TEST_SAVED_FILENAME, TEST_FILENAME);
+	copyFile(TEST_SAVED_WAL_FILENAME, TEST_WAL_FILENAME);
+
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	TEST_CHECK(initBufferPool(bm, TEST_FILENAME, TEST_NUM_POOL_PAGES, RS_LRU, NULL));
+	TEST_CHECK(pinPage(bm, h, RM_PAGE_DBHEADER));
+	uint64_t dbId = ((RM_DatabaseHeader *) h->buffer)->dbId;
+	TEST_CHECK(unpinPage(bm, h));
+
+	WAL_Options options = WAL_OPTIONS_DEFAULT;
+	options.numRedoWorkers = numWorkers;
+	WAL_Log *log = NULL;
+	TEST_CHECK(WAL_openWithOptions(TEST_WAL_FILENAME, dbId, bm, &options, &log));
+	ASSERT_EQUALS_INT(numWorkers, log->numRedoWorkers, "log replayed by the requested number of workers");
+	ASSERT_TRUE(log->numRedone > 0, "records after the checkpoint are redone");
+	TEST_CHECK(WAL_close(log));
+	TEST_CHECK(shutdownBufferPool(bm));
+	free(bm);
+	free(h);
+	*hash_out = hashFile(TEST_FILENAME);
+
+	checkRows(TEST_NUM_ROWS, TEST_NUM_PASSES);
+}
+
+// Runs `body` in a child process, which has to exit on its own: a crash has
+// to take the whole process down, the log and page file are left as they are
+void
+crashChild (void (*body) (void))
+{
+	fflush(stdout);
+	pid_t pid = fork();
+	if (pid < 0) {
+		printf("[%s-%s-L%i-%s] FAILED: cannot fork\n", TEST_INFO);
+		exit(1);
+	}
+	if (pid == 0) {
+		body();
+		exit(1);
+	}
+	int status = 0;
+	waitpid(pid, &status, 0);
+	ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0, "crashing process got to the crash");
+}
+
+Schema *
+testSchema (void)
+{
+	static char *names[] = { "a", "b", "c" };
+	static DataType dt[] = { DT_INT, DT_STRING, DT_INT };
+	static int sizes[] = { 0, TEST_STRING_LEN, 0 };
+	static int keys[] = { 0 };
+	return createSchema(3, names, dt, sizes, 1, keys);
+}
+
+// Row `a` holds `c` and a string derived from `a`
+void
+setRow (Record *record, Schema *schema, int a, int c)
+{
+	Value *value;
+	char b[TEST_STRING_LEN + 1];
+
+	MAKE_VALUE(value, DT_INT, a);
+	TEST_CHECK(setAttr(record, schema, 0, value));
+	freeVal(value);
+
+	for (int j = 0; j < TEST_STRING_LEN; j++) {
+		b[j] = (char) ('a' + (a + j) % 26);
+	}
+	b[TEST_STRING_LEN] = '\0';
+	MAKE_STRING_VALUE(value, b);
+	TEST_CHECK(setAttr(record, schema, 1, value));
+	freeVal(value);
+
+	MAKE_VALUE(value, DT_INT, c);
+	TEST_CHECK(setAttr(record, schema, 2, value));
+	freeVal(value);
+}
+
+// Opens the recovered database and checks that it holds rows 0 to
+// `numRows` - 1, each once and as the last of `numPasses` updates left it
+void
+checkRows (int numRows, int numPasses)
+{
+	RM_TableData table;
+	RM_ScanHandle scan;
+	Record *record;
+	Record *expected;
+	Value *value;
+	char *seen = calloc(numRows, 1);
+	int count = 0;
+	int numWrong = 0;
+
+	TEST_CHECK(initRecordManager(NULL));
+	TEST_CHECK(openTable(&table, "recovery"));
+	TEST_CHECK(createRecord(&record, table.schema));
+	TEST_CHECK(createRecord(&expected, table.schema));
+	TEST_CHECK(startScan(&table, &scan, NULL));
+	while (next(&scan, record) == RC_OK) {
+		getAttr(record, table.schema, 0, &value);
+		int a = value->v.intV;
+		freeVal(value);
+		if (a < 0 || a >= numRows || seen[a]) {
+			numWrong++;
+			continue;
+		}
+		seen[a] = 1;
+		count++;
+		setRow(expected, table.schema, a, numPasses * numRows + a);
+		numWrong += memcmp(record->data, expected->data, getRecordSize(table.schema)) != 0;
+	}
+	TEST_CHECK(closeScan(&scan));
+	ASSERT_EQUALS_INT(numRows, count, "every committed row is recovered");
+	ASSERT_EQUALS_INT(0, numWrong, "every row holds its last committed update");
+
+	freeRecord(expected);
+	freeRecord(record);
+	free(seen);
+	TEST_CHECK(closeTable(&table));
+	TEST_CHECK(shutdownRecordManager());
+}
+
+// Writes the first half of the pool's copy of a page over the page file: the
+// header carries the latest pageLSN, the rest is as of the last write back.
+// Redo of the changes since can only start from a logged image of the page.
+void
+tearPage (PageNumber pageNum)
+{
+	static char current[PAGE_SIZE];
+	static char stale[PAGE_SIZE];
+	BM_BufferPool *pool = RM_getInstance()->bufferPool;
+	BM_PageHandle page = {};
+
+	TEST_CHECK(pinPage(pool, &page, pageNum));
+	memcpy(current, page.buffer, PAGE_SIZE);
+	TEST_CHECK(unpinPage(pool, &page));
+
+	int fd = open(TEST_FILENAME, O_RDWR);
+	ASSERT_TRUE(fd >= 0, "page file opened");
+	off_t offset = (off_t) pageNum * PAGE_SIZE;
+	ASSERT_TRUE(pread(fd, stale, PAGE_SIZE, offset) == PAGE_SIZE, "page read back");
+	ASSERT_TRUE(memcmp(current + PAGE_SIZE / 2, stale + PAGE_SIZE / 2, PAGE_SIZE / 2) != 0,
+			"both halves of the page changed since it was written back");
+	ASSERT_TRUE(pwrite(fd, current, PAGE_SIZE / 2, offset) == PAGE_SIZE / 2, "half a page written");
+	close(fd);
+}
+
+void
+createTestPageFile (int numPages)
+{
+	SM_FileHandle fh;
+
+	destroyPageFile(TEST_PAGE_FILENAME);
+	unlink(TEST_PAGE_WAL_FILENAME);
+	TEST_CHECK(createPageFile(TEST_PAGE_FILENAME));
+	TEST_CHECK(openPageFile(TEST_PAGE_FILENAME, &fh));
+	TEST_CHECK(ensureCapacity(numPages, &fh));
+	TEST_CHECK(closePageFile(&fh));
+}
+
+// Opens the log of the test page file on a pool of `numPages` frames, after
+// replaying whatever it holds with a single thread
+WAL_Log *
+openTestLog (BM_BufferPool *bm, int numPages)
+{
+	WAL_Options options = WAL_OPTIONS_DEFAULT;
+	options.numRedoWorkers = 1;
+	options.checkpointInterval = 0;
+	WAL_Log *log = NULL;
+
+	TEST_CHECK(initBufferPool(bm, TEST_PAGE_FILENAME, numPages, RS_LRU, NULL));
+	TEST_CHECK(WAL_openWithOptions(TEST_PAGE_WAL_FILENAME, TEST_PAGE_DB_ID, bm, &options, &log));
+	return log;
+}
+
+// Logs one change: the last int of a data page becomes `value`
+void
+writePage (BM_BufferPool *bm, PageNumber pageNum, int value)
+{
+	BM_PageHandle h = {};
+
+	TEST_CHECK(pinPage(bm, &h, pageNum));
+	if (((RM_Page *) h.buffer)->header.kind != RM_PAGE_KIND_DATA) {
+		RM_Page_init(h.buffer, pageNum, RM_PAGE_KIND_DATA);
+	}
+	memcpy(h.buffer + PAGE_SIZE - sizeof(int), &value, sizeof(int));
+	TEST_CHECK(markDirty(bm, &h));
+	TEST_CHECK(unpinPage(bm, &h));
+}
+
+void
+flushPage (BM_BufferPool *bm, PageNumber pageNum)
+{
+	BM_PageHandle h = {};
+
+	TEST_CHECK(pinPage(bm, &h, pageNum));
+	TEST_CHECK(forcePage(bm, &h));
+	TEST_CHECK(unpinPage(bm, &h));
+}
+
+int
+readPage (BM_BufferPool *bm, PageNumber pageNum)
+{
+	BM_PageHandle h = {};
+	int value;
+
+	TEST_CHECK(pinPage(bm, &h, pageNum));
+	memcpy(&value, h.buffer + PAGE_SIZE - sizeof(int), sizeof(int));
+	TEST_CHECK(unpinPage(bm, &h));
+	return value;
+}
+
+// Reads the checkpoint the log of the test page file points at
+WAL_CheckpointHeader
+readCheckpoint (void)
+{
+	WAL_FileHeader header;
+	WAL_RecordHeader record;
+	WAL_CheckpointHeader checkpoint;
+
+	int fd = open(TEST_PAGE_WAL_FILENAME, O_RDONLY);
+	ASSERT_TRUE(fd >= 0, "log opened");
+	ASSERT_TRUE(pread(fd, &header, sizeof(header), 0) == sizeof(header), "log header read");
+	ASSERT_TRUE(header.checkpointLSN != WAL_NO_LSN, "log points at a checkpoint");
+	off_t offset = (off_t) (sizeof(WAL_FileHeader) + (header.checkpointLSN - header.baseLSN));
+	ASSERT_TRUE(pread(fd, &record, sizeof(record), offset) == sizeof(record), "checkpoint record read");
+	ASSERT_EQUALS_INT(WAL_RECORD_CHECKPOINT, record.type, "log header points at a checkpoint record");
+	ASSERT_TRUE(pread(fd, &checkpoint, sizeof(checkpoint), offset + sizeof(record)) == sizeof(checkpoint), "checkpoint read");
+	close(fd);
+	return checkpoint;
+}
+
+// ************************************************************
+void
+copyFile (const char *from, const char *to)
+{
+	int in = open(from, O_RDONLY);
+	int out = open(to, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	ASSERT_TRUE(in >= 0 && out >= 0, "files to copy opened");
+
+	char *buffer = malloc(1024 * 1024);
+	ssize_t n;
+	bool isComplete = true;
+	while ((n = read(in, buffer, 1024 * 1024)) > 0) {
+		isComplete &= write(out, buffer, n) == n;
+	}
+	ASSERT_TRUE(n == 0 && isComplete, "file copied");
+	free(buffer);
+	close(in);
+	close(out);
+}
+
+void *
+commitMain (void *arg)
+{
+	Committer *committer = arg;
+	pthread_barrier_wait(committer->start);
+	committer->rc = WAL_flush(committer->log, committer->lsn);
+	committer->flushedLSN = WAL_getFlushedLSN(committer->log);
+	return NULL;
+}
+
+// FNV-1a over the whole file
+uint64_t
+hashFile (const char *fileName)
+{
+	FILE *file = fopen(fileName, "rb");
+	if (file == NULL) {
+		return 0;
+	}
+
+	uint64_t hash = 14695981039346656037ull;
+	int c;
+	while ((c = fgetc(file)) != EOF) {
+		hash ^= (uint64_t) c;
+		hash *= 1099511628211ull;
+	}
+	fclose(file);
+	return hash;
+}
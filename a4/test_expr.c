@@ -29,6 +29,7 @@
 static void testValueSerialize (void);
 static void testOperators (void);
 static void testExpressions (void);
+static void testCompiledExpressions (void);
 
 char *testName;
 
@@ -41,6 +42,7 @@ main (void)
 	testValueSerialize();
 	testOperators();
 	testExpressions();
+	testCompiledExpressions();
 
 	return 0;
 }
@@ -123,3 +125,151 @@ testExpressions (void)
 
 	TEST_DONE();
 }
+
+// ************************************************************
+void
+testCompiledExpressions (void)
+{
+	Expr *exprs[8], *l, *r, *both, *cmp;
+	ExprProgram *program;
+	Record *records[27];
+	const char *data[27];
+	uint64_t selection[EXPR_BATCH_WORDS];
+	Value *res;
+	testName = "test compiled expressions";
+
+	char *names[] = { "a", "b", "c", "d" };
+	DataType dt[] = { DT_INT, DT_STRING, DT_FLOAT, DT_BOOL };
+	int sizes[] = { 0, 4, 0, 0 };
+	int keys[] = { 0 };
+	Schema *schema = createSchema(4, names, dt, sizes, 1, keys);
+
+	// a < 5
+	MAKE_ATTRREF(l, 0);
+	MAKE_CONS(r, stringToValue("i5"));
+	MAKE_BINOP_EXPR(exprs[0], l, r, OP_COMP_SMALLER);
+
+	// b = "ab"
+	MAKE_ATTRREF(l, 1);
+	MAKE_CONS(r, stringToValue("sab"));
+	MAKE_BINOP_EXPR(exprs[1], l, r, OP_COMP_EQUAL);
+
+	// "abc" < b
+	MAKE_CONS(l, stringToValue("sabc"));
+	MAKE_ATTRREF(r, 1);
+	MAKE_BINOP_EXPR(exprs[2], l, r, OP_COMP_SMALLER);
+
+	// NOT (c < 2.5) OR d
+	MAKE_ATTRREF(l, 2);
+	MAKE_CONS(r, stringToValue("f2.5"));
+	MAKE_BINOP_EXPR(both, l, r, OP_COMP_SMALLER);
+	MAKE_UNOP_EXPR(l, both, OP_BOOL_NOT);
+	MAKE_ATTRREF(r, 3);
+	MAKE_BINOP_EXPR(exprs[3], l, r, OP_BOOL_OR);
+
+	// (a < 5) AND (b = "ab"), sharing nothing with the ones above
+	MAKE_ATTRREF(l, 0);
+	MAKE_CONS(r, stringToValue("i5"));
+	MAKE_BINOP_EXPR(both, l, r, OP_COMP_SMALLER);
+	MAKE_ATTRREF(l, 1);
+	MAKE_CONS(r, stringToValue("sab"));
+	MAKE_BINOP_EXPR(cmp, l, r, OP_COMP_EQUAL);
+	MAKE_BINOP_EXPR(exprs[4], both, cmp, OP_BOOL_AND);
+
+	// a = a
+	MAKE_ATTRREF(l, 0);
+	MAKE_ATTRREF(r, 0);
+	MAKE_BINOP_EXPR(exprs[5], l, r, OP_COMP_EQUAL);
+
+	// 3 < a
+	MAKE_CONS(l, stringToValue("i3"));
+	MAKE_ATTRREF(r, 0);
+	MAKE_BINOP_EXPR(exprs[6], l, r, OP_COMP_SMALLER);
+
+	// NOT (c = 1.0) AND 2.5 < c
+	MAKE_ATTRREF(l, 2);
+	MAKE_CONS(r, stringToValue("f1.0"));
+	MAKE_BINOP_EXPR(both, l, r, OP_COMP_EQUAL);
+	MAKE_UNOP_EXPR(l, both, OP_BOOL_NOT);
+	MAKE_CONS(both, stringToValue("f2.5"));
+	MAKE_ATTRREF(r, 2);
+	MAKE_BINOP_EXPR(cmp, both, r, OP_COMP_SMALLER);
+	MAKE_BINOP_EXPR(exprs[7], l, cmp, OP_BOOL_AND);
+
+	char *strings[] = { "", "a", "ab", "abc", "abcd", "b" };
+	for (int i = 0; i < 27; i++)
+	{
+		Value *value;
+		Record *record;
+		TEST_CHECK(createRecord(&records[i], schema));
+		record = records[i];
+		data[i] = record->data;
+		MAKE_VALUE(value, DT_INT, i % 8);
+		TEST_CHECK(setAttr(record, schema, 0, value));
+		freeVal(value);
+		// attributes are only terminated when they are shorter than 4 bytes
+		memset(record->data + sizeof(int), 0, 4);
+		memcpy(record->data + sizeof(int), strings[i % 6], strlen(strings[i % 6]));
+		MAKE_VALUE(value, DT_FLOAT, (float) (i % 5));
+		TEST_CHECK(setAttr(record, schema, 2, value));
+		freeVal(value);
+		MAKE_VALUE(value, DT_BOOL, i % 3 == 0);
+		TEST_CHECK(setAttr(record, schema, 3, value));
+		freeVal(value);
+	}
+
+	// compiled, batch and interpreted evaluation agree on every record
+	for (int j = 0; j < 8; j++)
+	{
+		TEST_CHECK(compileExpr(exprs[j], schema, &program));
+		evalExprProgramBatch(program, data, 27, selection);
+		for (int i = 0; i < 27; i++)
+		{
+			TEST_CHECK(evalExpr(records[i], schema, exprs[j], &res));
+			ASSERT_TRUE(!evalExprProgram(program, records[i]->data) == !res->v.boolV, "compiled matches evalExpr");
+			ASSERT_TRUE(!((selection[i / 64] >> (i % 64)) & 1u) == !res->v.boolV, "batch matches evalExpr");
+			freeVal(res);
+		}
+		ASSERT_TRUE(selection[0] >> 27 == 0, "no bits past the batch");
+		freeExprProgram(program);
+	}
+
+	// comparisons of values of different datatypes do not compile
+	MAKE_ATTRREF(l, 0);
+	MAKE_CONS(r, stringToValue("sab"));
+	MAKE_BINOP_EXPR(both, l, r, OP_COMP_EQUAL);
+	ASSERT_TRUE(compileExpr(both, schema, &program) == RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE, "different datatypes");
+	freeExpr(both);
+
+	// varchars are not at a fixed offset, they are left to evalExpr
+	DataType vdt[] = { DT_INT, DT_VARCHAR };
+	int vsizes[] = { 0, 4 };
+	Schema *vschema = createSchema(2, names, vdt, vsizes, 1, keys);
+	Record *vrecord;
+	Value *value;
+	TEST_CHECK(createRecord(&vrecord, vschema));
+	value = stringToValue("sab");
+	TEST_CHECK(setAttr(vrecord, vschema, 1, value));
+	freeVal(value);
+	value = stringToValue("sabcde");
+	ASSERT_TRUE(setAttr(vrecord, vschema, 1, value) == RC_RM_VALUE_TOO_LONG, "varchar longer than its length");
+	freeVal(value);
+	MAKE_ATTRREF(l, 1);
+	MAKE_CONS(r, stringToValue("sab"));
+	MAKE_BINOP_EXPR(both, l, r, OP_COMP_EQUAL);
+	ASSERT_TRUE(compileExpr(both, vschema, &program) == RC_RM_EXPR_NOT_COMPILABLE, "varchar does not compile");
+	TEST_CHECK(evalExpr(vrecord, vschema, both, &res));
+	ASSERT_TRUE(res->v.boolV, "varchar b = \"ab\"");
+	freeVal(res);
+	freeExpr(both);
+	freeRecord(vrecord);
+	freeSchema(vschema);
+
+	for (int j = 0; j < 8; j++)
+		freeExpr(exprs[j]);
+	for (int i = 0; i < 27; i++)
+		freeRecord(records[i]);
+	freeSchema(schema);
+
+	TEST_DONE();
+}
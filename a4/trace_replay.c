@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "dberror.h"
+#include "storage_mgr.h"
+#include "buffer_mgr.h"
+#include "buffer_mgr_stat.h"
+#include "bm_trace.h"
+#include "replacement_strategy.h"
+
+#define REPLAY_FILENAME "trace_replay.db"
+#define REPLAY_MIN_NUM_PAGES (8)
+
+// Replays a pin trace recorded by `startPoolTrace` against every replacement
+// strategy at a range of pool sizes and prints one hit ratio line per run:
+//
+//     trace_replay <trace file> [pool size...]
+//
+// Without explicit sizes the pool doubles from REPLAY_MIN_NUM_PAGES up to the
+// number of distinct pages in the trace. Strategies that are still backed by
+// another strategy's handler are skipped rather than reported under their own
+// name.
+
+// helper methods
+static BM_TraceRecord *loadTrace (const char *fileName, BM_TraceHeader *header, long *numRecords);
+static void replay (const BM_TraceRecord *records, long numRecords, ReplacementStrategy strategy, int numPages);
+
+// main method
+int
+main (int argc, char **argv)
+{
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <trace file> [pool size...]\n", argv[0]);
+		return 1;
+	}
+
+	BM_TraceHeader header;
+	long numRecords = 0;
+	BM_TraceRecord *records = loadTrace(argv[1], &header, &numRecords);
+	if (records == NULL) {
+		return 1;
+	}
+
+	// size the page file and the default pool sizes after the trace
+	int maxPageNum = 0;
+	long tracedHits = 0;
+	for (long i = 0; i < numRecords; i++) {
+		if (records[i].pageNum > maxPageNum) {
+			maxPageNum = records[i].pageNum;
+		}
+		if (records[i].flags & BM_TRACE_FLAGS_HIT) {
+			tracedHits++;
+		}
+	}
+	char *seen = calloc(maxPageNum + 1, sizeof(char));
+	int numDistinct = 0;
+	for (long i = 0; i < numRecords; i++) {
+		if (!seen[records[i].pageNum]) {
+			seen[records[i].pageNum] = 1;
+			numDistinct++;
+		}
+	}
+	free(seen);
+
+	printf("trace=%s records=%ld distinct_pages=%d traced_strategy=%s traced_pages=%u "
+			"traced_hit_ratio=%.4f\n",
+			argv[1],
+			numRecords,
+			numDistinct,
+			strategyName((int) header.strategy),
+			header.numPages,
+			numRecords > 0 ? (double) tracedHits / numRecords : 0.0);
+
+	SM_FileHandle fh;
+	destroyPageFile(REPLAY_FILENAME);
+	CHECK(createPageFile(REPLAY_FILENAME));
+	CHECK(openPageFile(REPLAY_FILENAME, &fh));
+	CHECK(ensureCapacity(maxPageNum + 1, &fh));
+	CHECK(closePageFile(&fh));
+
+	for (int s = 0; s < BM_REPLACEMENT_STRAT_COUNT; s++) {
+		if (RS_StrategyHandlerImpl[s].strategy != (ReplacementStrategy) s) {
+			continue;
+		}
+		if (argc > 2) {
+			for (int i = 2; i < argc; i++) {
+				replay(records, numRecords, (ReplacementStrategy) s, atoi(argv[i]));
+			}
+		} else {
+			int numPages = REPLAY_MIN_NUM_PAGES;
+			for (; numPages < numDistinct; numPages *= 2) {
+				replay(records, numRecords, (ReplacementStrategy) s, numPages);
+			}
+			replay(records, numRecords, (ReplacementStrategy) s, numDistinct > 0 ? numDistinct : 1);
+		}
+	}
+
+	destroyPageFile(REPLAY_FILENAME);
+	free(records);
+	return 0;
+}
+
+// ************************************************************
+// Reads a whole trace file into memory, or returns NULL after printing why not
+BM_TraceRecord *
+loadTrace (const char *fileName, BM_TraceHeader *header, long *numRecords)
+{
+	FILE *file = fopen(fileName, "rb");
+	if (file == NULL) {
+		fprintf(stderr, "trace_replay: cannot open %s\n", fileName);
+		return NULL;
+	}
+
+	if (fread(header, sizeof(BM_TraceHeader), 1, file) != 1
+			|| memcmp(header->magic, BM_TRACE_MAGIC, BM_TRACE_MAGIC_LEN) != 0
+			|| header->version != BM_TRACE_VERSION) {
+		fprintf(stderr, "trace_replay: %s is not a version %d trace\n", fileName, BM_TRACE_VERSION);
+		fclose(file);
+		return NULL;
+	}
+
+	fseek(file, 0, SEEK_END);
+	long payload = ftell(file) - (long) sizeof(BM_TraceHeader);
+	fseek(file, sizeof(BM_TraceHeader), SEEK_SET);
+
+	// a trailing partial record is what an interrupted recorder leaves behind
+	*numRecords = payload / (long) sizeof(BM_TraceRecord);
+	BM_TraceRecord *records = malloc((*numRecords + 1) * sizeof(BM_TraceRecord));
+	if (fread(records, sizeof(BM_TraceRecord), *numRecords, file) != (size_t) *numRecords) {
+		fprintf(stderr, "trace_replay: short read on %s\n", fileName);
+		free(records);
+		fclose(file);
+		return NULL;
+	}
+	fclose(file);
+
+	// page numbers index the replay file and the distinct page count
+	for (long i = 0; i < *numRecords; i++) {
+		if (records[i].pageNum < 0) {
+			fprintf(stderr, "trace_replay: record %ld of %s has invalid page %d\n",
+					i, fileName, (int) records[i].pageNum);
+			free(records);
+			return NULL;
+		}
+	}
+
+	return records;
+}
+
+// ************************************************************
+// Pins and unpins every traced page in order on a cold pool. Scan ring pins
+// are replayed as regular pins, so the run measures the bare strategy.
+void
+replay (const BM_TraceRecord *records, long numRecords, ReplacementStrategy strategy, int numPages)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	BM_PoolOptions options = BM_POOL_OPTIONS_DEFAULT;
+	options.hugePages = FALSE;
+
+	CHECK(initBufferPoolWithOptions(bm, REPLAY_FILENAME, numPages, strategy, NULL, &options));
+
+	for (long i = 0; i < numRecords; i++) {
+		CHECK(pinPage(bm, h, records[i].pageNum));
+		CHECK(unpinPage(bm, h));
+	}
+
+	BM_PoolStats stats;
+	getPoolStats(bm, &stats);
+	uint64_t hits = stats.counters[BM_STAT_HITS];
+	uint64_t misses = stats.counters[BM_STAT_MISSES];
+
+	printf("strategy=%s pages=%d pins=%ld hits=%llu misses=%llu hit_ratio=%.4f\n",
+			strategyName(strategy),
+			numPages,
+			numRecords,
+			(unsigned long long) hits,
+			(unsigned long long) misses,
+			hits + misses > 0 ? (double) hits / (double) (hits + misses) : 0.0);
+
+	CHECK(shutdownBufferPool(bm));
+	free(bm);
+	free(h);
+}
@@ -0,0 +1,1143 @@
+// for `fallocate`
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+/* linux specific */
+#include <stdbool.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "dberror.h"
+#include "storage_mgr.h"
+#include "buffer_mgr.h"
+#include "rm_page.h"
+#include "rm_macros.h"
+#include "record_mgr.h"
+#include "wal.h"
+
+// Redo reads the log in chunks of this many bytes
+#define WAL_READ_CHUNK_SIZE (1024 * 1024)
+
+// Sequential reader over the valid records of a log file
+typedef struct WAL_Reader {
+    int fd;
+    char *chunk;
+    size_t chunkLen;      // bytes read into `chunk`
+    size_t pos;           // offset of the next record in `chunk`
+    off_t fileOffset;     // offset in the file of the byte after `chunk`
+    WAL_LSN nextLSN;      // LSN the next record has to start at
+} WAL_Reader;
+
+// Replays the records of the pages `pageNum % numWorkers` maps to it
+typedef struct WAL_RedoWorker {
+    struct WAL_Redo *redo;
+    pthread_t thread;
+    BM_BufferPool pool;   // private pool over the page file, holds only its pages
+    pthread_cond_t ready; // records were queued or the end of the log reached
+    char *queue;          // records queued since the worker last took them
+    size_t queueLen;
+    char *batch;          // records being replayed
+} WAL_RedoWorker;
+
+// Parallel redo of a log, see `WAL_replay`
+typedef struct WAL_Redo {
+    pthread_mutex_t lock;
+    pthread_cond_t taken;       // a worker took its queue, or failed
+    bool done;                  // every record has been queued
+    RC rc;                      // first error of any worker
+    int numWorkers;
+    WAL_RedoWorker *workers;
+    PageNumber *cachedPages;    // already in the pool being recovered, redone there
+    int numCachedPages;
+} WAL_Redo;
+
+// buffer pool hooks
+static uint64_t WAL_logChange(void *ctx, BM_PageHandle *page, const char *before, bool isFirstChange);
+static void WAL_beforeWrite(void *ctx, const BM_PageHandle *page);
+
+// helper methods
+static void *WAL_flusherMain(void *arg);
+static WAL_LSN WAL_append(WAL_Log *log, WAL_RecordHeader *record);
+static RC WAL_replay(WAL_Log *log, BM_BufferPool *pool);
+static bool WAL_readCheckpoint(WAL_Log *log, WAL_LSN *redoLSN_out, WAL_DirtyPage **pages_out, int *numPages_out);
+static bool WAL_isRedoNeeded(const WAL_RecordHeader *record, WAL_LSN checkpointLSN,
+        const WAL_DirtyPage *dirtyPages, int numDirtyPages);
+static RC WAL_redoRecord(BM_BufferPool *pool, const WAL_RecordHeader *record);
+static bool WAL_isPageImage(const WAL_RecordHeader *record);
+static RC WAL_ensurePage(BM_BufferPool *pool, PageNumber pageNum);
+static RC WAL_Redo_start(WAL_Redo *redo, BM_BufferPool *pool, int numWorkers);
+static RC WAL_Redo_dispatch(WAL_Redo *redo, BM_BufferPool *pool, const WAL_RecordHeader *record);
+static RC WAL_Redo_finish(WAL_Redo *redo);
+static void *WAL_redoWorkerMain(void *arg);
+static RC WAL_redoBatch(WAL_RedoWorker *worker, const char *batch, size_t len);
+static const WAL_RecordHeader *WAL_Reader_next(WAL_Reader *reader);
+static bool WAL_payloadFits(const WAL_RecordHeader *record);
+static size_t WAL_encodeDiff(const char *page, const char *before, char *out, uint16_t *numSegments_out);
+static size_t WAL_encodePage(const char *page, char *out, uint16_t *numSegments_out);
+static WAL_RecordType WAL_recordType(const BM_PageHandle *page, const char *before);
+static RC WAL_writeHeader(WAL_Log *log);
+static void WAL_reclaim(WAL_Log *log, WAL_LSN redoLSN);
+static int WAL_comparePageNums(const void *a, const void *b);
+static RC WAL_writeAll(int fd, const char *buf, size_t len, off_t offset);
+static uint32_t WAL_checksum(const WAL_RecordHeader *record);
+static uint64_t WAL_nowNanos(void);
+
+/**
+ * Opens the log of a database, creating it if needed, and attaches it to the
+ * buffer pool of the database.
+ *
+ * A log left behind by the same database (same `dbId`) is replayed first and
+ * then emptied, once every page it touched is durable. A log that belongs to
+ * some other database, or is not a log at all, is discarded.
+ *
+ * @param fileName  path of the log file
+ * @param dbId      identifies the database, see `RM_DatabaseHeader`
+ * @param pool      buffer pool over the page file of the database
+ * @param log_out   the opened log
+ */
+RC WAL_open(const char *fileName, uint64_t dbId, BM_BufferPool *pool, WAL_Log **log_out)
+{
+    WAL_Options options = WAL_OPTIONS_DEFAULT;
+    return WAL_openWithOptions(fileName, dbId, pool, &options, log_out);
+}
+
+RC WAL_openWithOptions(const char *fileName, uint64_t dbId, BM_BufferPool *pool,
+        const WAL_Options *options, WAL_Log **log_out)
+{
+    PANIC_IF_NULL(fileName);
+    PANIC_IF_NULL(pool);
+    PANIC_IF_NULL(options);
+    PANIC_IF_NULL(log_out);
+
+    int fd = open(fileName, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return RC_FILE_NOT_FOUND;
+    }
+
+    WAL_Log *log = calloc(1, sizeof(WAL_Log));
+    if (log == NULL) {
+        PANIC("calloc: failed to allocate write-ahead log");
+    }
+    log->fd = fd;
+    log->dbId = dbId;
+    log->buffer = malloc(WAL_BUFFER_SIZE);
+    log->flushBuffer = malloc(WAL_BUFFER_SIZE);
+    log->record = malloc(WAL_MAX_RECORD_SIZE);
+    log->ioError = RC_OK;
+    log->checkpointInterval = options->checkpointInterval;
+    log->numRedoWorkers = options->numRedoWorkers;
+    if (log->numRedoWorkers == WAL_REDO_WORKERS_AUTO) {
+        long numCpus = sysconf(_SC_NPROCESSORS_ONLN);
+        log->numRedoWorkers = numCpus > 0 ? (int) numCpus : 1;
+    }
+    if (log->numRedoWorkers > WAL_MAX_REDO_WORKERS) {
+        log->numRedoWorkers = WAL_MAX_REDO_WORKERS;
+    }
+    log->flushPending = malloc(pool->numPages * sizeof(PageNumber));
+
+    pthread_condattr_t condAttr;
+    pthread_condattr_init(&condAttr);
+    pthread_condattr_setclock(&condAttr, CLOCK_MONOTONIC);
+    pthread_mutex_init(&log->lock, NULL);
+    pthread_cond_init(&log->requested, &condAttr);
+    pthread_cond_init(&log->flushed, NULL);
+    pthread_condattr_destroy(&condAttr);
+
+    RC rc;
+    WAL_FileHeader header = {};
+    bool isOurs = pread(fd, &header, sizeof(WAL_FileHeader), 0) == sizeof(WAL_FileHeader)
+            && memcmp(header.magic, WAL_MAGIC, WAL_MAGIC_LEN) == 0
+            && header.version == WAL_VERSION
+            && header.dbId == dbId;
+    log->baseLSN = isOurs ? header.baseLSN : 0;
+    log->checkpointLSN = isOurs ? header.checkpointLSN : WAL_NO_LSN;
+    log->appendLSN = log->baseLSN;
+    log->flushedLSN = log->baseLSN;
+    log->requestedLSN = log->baseLSN;
+
+    if (isOurs) {
+        // redo what the last run did not get to write back, then make it stick
+        if ((rc = WAL_replay(log, pool)) != RC_OK) {
+            goto error;
+        }
+        if ((rc = syncBufferPool(pool)) != RC_OK) {
+            goto error;
+        }
+    }
+
+    // start over from an empty log, keeping LSNs increasing across runs
+    log->checkpointLSN = WAL_NO_LSN;
+    if (ftruncate(fd, 0) != 0) {
+        rc = RC_WRITE_FAILED;
+        goto error;
+    }
+    if ((rc = WAL_writeHeader(log)) != RC_OK) {
+        goto error;
+    }
+
+    if (pthread_create(&log->flusher, NULL, WAL_flusherMain, log) != 0) {
+        PANIC("pthread_create: failed to start the log flusher");
+    }
+
+    BM_LogHooks hooks = {
+            .logChange = WAL_logChange,
+            .beforeWrite = WAL_beforeWrite,
+            .ctx = log,
+    };
+    if ((rc = setPoolLogHooks(pool, &hooks)) != RC_OK) {
+        WAL_close(log);
+        return rc;
+    }
+
+    *log_out = log;
+    return RC_OK;
+
+    error:
+        close(fd);
+        pthread_cond_destroy(&log->flushed);
+        pthread_cond_destroy(&log->requested);
+        pthread_mutex_destroy(&log->lock);
+        free(log->flushPending);
+        free(log->record);
+        free(log->flushBuffer);
+        free(log->buffer);
+        free(log);
+        return rc;
+}
+
+/**
+ * Flushes whatever is left in the log and closes it. The log is not emptied,
+ * see `WAL_truncate`.
+ */
+RC WAL_close(WAL_Log *log)
+{
+    if (log == NULL) {
+        return RC_OK;
+    }
+
+    RC rc = WAL_commit(log);
+
+    pthread_mutex_lock(&log->lock);
+    log->stop = true;
+    pthread_cond_signal(&log->requested);
+    pthread_mutex_unlock(&log->lock);
+    pthread_join(log->flusher, NULL);
+
+    close(log->fd);
+    pthread_cond_destroy(&log->flushed);
+    pthread_cond_destroy(&log->requested);
+    pthread_mutex_destroy(&log->lock);
+    free(log->flushPending);
+    free(log->record);
+    free(log->flushBuffer);
+    free(log->buffer);
+    free(log);
+    return rc;
+}
+
+/**
+ * Waits until the log is durable up to `lsn`, or up to the last record
+ * appended if that is earlier. Callers arriving while a write is in flight
+ * are served together by the next one.
+ */
+RC WAL_flush(WAL_Log *log, WAL_LSN lsn)
+{
+    pthread_mutex_lock(&log->lock);
+    if (lsn > log->appendLSN) {
+        lsn = log->appendLSN;
+    }
+    while (log->flushedLSN < lsn && log->ioError == RC_OK) {
+        if (log->requestedLSN < lsn) {
+            log->requestedLSN = lsn;
+        }
+        pthread_cond_signal(&log->requested);
+        pthread_cond_wait(&log->flushed, &log->lock);
+    }
+    RC rc = log->ioError;
+    pthread_mutex_unlock(&log->lock);
+    return rc;
+}
+
+/**
+ * Makes every change logged so far durable. The changed pages themselves may
+ * stay dirty in the pool.
+ */
+RC WAL_commit(WAL_Log *log)
+{
+    return WAL_flush(log, WAL_getAppendLSN(log));
+}
+
+/**
+ * Empties the log. Only safe once every page changed by a logged record has
+ * been written back and synced, e.g. by `syncBufferPool`.
+ */
+RC WAL_truncate(WAL_Log *log)
+{
+    TRY_OR_RETURN(WAL_commit(log));
+    log->checkpointLSN = WAL_NO_LSN;
+    log->numFlushPending = 0;
+    log->nextFlushPending = 0;
+
+    // nothing is pending, so the flusher is idle until the next append
+    pthread_mutex_lock(&log->lock);
+    log->baseLSN = log->appendLSN;
+    RC rc = ftruncate(log->fd, sizeof(WAL_FileHeader)) == 0
+            ? WAL_writeHeader(log)
+            : RC_WRITE_FAILED;
+    pthread_mutex_unlock(&log->lock);
+    return rc;
+}
+
+/**
+ * Takes a fuzzy checkpoint: logs the dirty page table of `pool` without
+ * writing any page back, and queues the pages in it for `WAL_checkpointStep`.
+ * Pages written back before are synced to the page file first.
+ * Once the record is durable, recovery starts from the oldest change in the
+ * table instead of the start of the log.
+ */
+RC WAL_checkpoint(WAL_Log *log, BM_BufferPool *pool)
+{
+    // pages left out of the dirty page table are not redone from before the
+    // checkpoint, so what was written back of them has to be durable
+    BP_Metadata *meta = pool->mgmtData;
+    TRY_OR_RETURN(syncPageFile(meta->fileHandle));
+
+    BM_DirtyPage *dirtyPages = malloc(pool->numPages * sizeof(BM_DirtyPage));
+    int numDirtyPages = getDirtyPageTable(pool, dirtyPages);
+    int numLogged = numDirtyPages <= (int) WAL_MAX_CHECKPOINT_PAGES
+            ? numDirtyPages
+            : (int) WAL_MAX_CHECKPOINT_PAGES;
+
+    size_t length = sizeof(WAL_RecordHeader)
+            + sizeof(WAL_CheckpointHeader)
+            + numLogged * sizeof(WAL_DirtyPage);
+    char *buffer = malloc(length);
+    WAL_RecordHeader *record = (WAL_RecordHeader *) buffer;
+    record->length = (uint32_t) length;
+    record->type = WAL_RECORD_CHECKPOINT;
+    record->pageNum = NO_PAGE;
+    record->numSegments = 0;
+
+    // only the owner thread appends, so the record is going to start here
+    WAL_LSN checkpointLSN = log->appendLSN;
+    WAL_CheckpointHeader checkpoint = {
+            .redoLSN = checkpointLSN,
+            .numDirtyPages = (uint32_t) numLogged,
+            .flags = numLogged < numDirtyPages ? WAL_CHECKPOINT_FLAGS_PARTIAL : 0,
+    };
+    char *entries = buffer + sizeof(WAL_RecordHeader) + sizeof(WAL_CheckpointHeader);
+    for (int i = 0; i < numDirtyPages; i++) {
+        if (dirtyPages[i].recLSN < checkpoint.redoLSN) {
+            checkpoint.redoLSN = dirtyPages[i].recLSN;
+        }
+        if (i < numLogged) {
+            WAL_DirtyPage entry = {
+                    .pageNum = dirtyPages[i].pageNum,
+                    .recLSN = dirtyPages[i].recLSN,
+            };
+            memcpy(entries + i * sizeof(WAL_DirtyPage), &entry, sizeof(WAL_DirtyPage));
+        }
+        log->flushPending[i] = dirtyPages[i].pageNum;
+    }
+    memcpy(buffer + sizeof(WAL_RecordHeader), &checkpoint, sizeof(WAL_CheckpointHeader));
+    free(dirtyPages);
+
+    WAL_LSN lsn = WAL_append(log, record);
+    free(buffer);
+    TRY_OR_RETURN(WAL_flush(log, lsn));
+
+    // recovery may only start from the checkpoint once the record is durable
+    log->checkpointLSN = checkpointLSN;
+    TRY_OR_RETURN(WAL_writeHeader(log));
+    WAL_reclaim(log, checkpoint.redoLSN);
+
+    // write back in page order, so neighbouring pages go out one after another
+    qsort(log->flushPending, numDirtyPages, sizeof(PageNumber), WAL_comparePageNums);
+    log->numFlushPending = numDirtyPages;
+    log->nextFlushPending = 0;
+    return RC_OK;
+}
+
+/**
+ * Does a bounded amount of checkpointing work: writes back the next
+ * WAL_CHECKPOINT_PAGES_PER_STEP pages queued by the last checkpoint or, once
+ * those are done and `checkpointInterval` bytes were logged since, takes the
+ * next checkpoint. Called by the owner of the pool between operations.
+ */
+RC WAL_checkpointStep(WAL_Log *log, BM_BufferPool *pool)
+{
+    if (log->nextFlushPending < log->numFlushPending) {
+        int n = log->numFlushPending - log->nextFlushPending;
+        if (n > WAL_CHECKPOINT_PAGES_PER_STEP) {
+            n = WAL_CHECKPOINT_PAGES_PER_STEP;
+        }
+        // a page dirtied again after the checkpoint has been written back since
+        RC rc = flushDirtyPages(pool, log->flushPending + log->nextFlushPending, n, log->checkpointLSN - 1);
+        log->nextFlushPending += n;
+        return rc;
+    }
+
+    WAL_LSN lastLSN = log->checkpointLSN != WAL_NO_LSN ? log->checkpointLSN : log->baseLSN;
+    if (log->checkpointInterval == 0 || log->appendLSN - lastLSN < log->checkpointInterval) {
+        return RC_OK;
+    }
+    return WAL_checkpoint(log, pool);
+}
+
+/**
+ * Sets how many bytes are logged between two checkpoints, which bounds how
+ * much of the log recovery replays. 0 turns checkpoints off.
+ */
+void WAL_setCheckpointInterval(WAL_Log *log, uint64_t numBytes)
+{
+    log->checkpointInterval = numBytes;
+}
+
+WAL_LSN WAL_getAppendLSN(WAL_Log *log)
+{
+    pthread_mutex_lock(&log->lock);
+    WAL_LSN lsn = log->appendLSN;
+    pthread_mutex_unlock(&log->lock);
+    return lsn;
+}
+
+WAL_LSN WAL_getFlushedLSN(WAL_Log *log)
+{
+    pthread_mutex_lock(&log->lock);
+    WAL_LSN lsn = log->flushedLSN;
+    pthread_mutex_unlock(&log->lock);
+    return lsn;
+}
+
+// ************************************************************
+// Logs the bytes of `page` that differ from `before` and stamps the page with
+// the LSN of the record. Returns where the record starts.
+//
+// The first change to a clean page logs the whole page instead: a write back
+// that is torn by a crash can leave a new pageLSN over stale bytes, which no
+// diff could be redone on. Redo starts at or before this record for any page
+// that was dirty, see `WAL_isRedoNeeded`, and applies page images whatever
+// the page holds.
+static uint64_t WAL_logChange(void *ctx, BM_PageHandle *page, const char *before, bool isFirstChange)
+{
+    WAL_Log *log = ctx;
+    WAL_RecordHeader *record = (WAL_RecordHeader *) log->record;
+    uint16_t numSegments;
+    size_t payloadLen;
+    if (isFirstChange) {
+        payloadLen = WAL_encodePage(page->buffer, log->record + sizeof(WAL_RecordHeader), &numSegments);
+    } else {
+        payloadLen = WAL_encodeDiff(
+                page->buffer,
+                before,
+                log->record + sizeof(WAL_RecordHeader),
+                &numSegments);
+    }
+
+    record->numSegments = numSegments;
+    record->length = (uint32_t) (sizeof(WAL_RecordHeader) + payloadLen);
+    record->type = WAL_recordType(page, before);
+    record->pageNum = page->pageNum;
+    WAL_LSN lsn = WAL_append(log, record);
+
+    // the database header is not an `RM_Page`, it is only written on creation
+    if (page->pageNum != RM_PAGE_DBHEADER) {
+        ((RM_Page *) page->buffer)->header.pageLSN = lsn;
+    }
+    return lsn - record->length;
+}
+
+// Write-ahead rule: the log has to be durable up to the last change of the
+// page before the page is written back
+static void WAL_beforeWrite(void *ctx, const BM_PageHandle *page)
+{
+    WAL_Log *log = ctx;
+    WAL_LSN lsn = page->pageNum != RM_PAGE_DBHEADER
+            ? ((const RM_Page *) page->buffer)->header.pageLSN
+            : WAL_getAppendLSN(log);
+    WAL_flush(log, lsn);
+}
+
+// Copies a record into the log buffer and returns its LSN. Only the owner
+// thread appends, so the LSN is known before taking the lock.
+static WAL_LSN WAL_append(WAL_Log *log, WAL_RecordHeader *record)
+{
+    record->lsn = log->appendLSN + record->length;
+    record->checksum = WAL_checksum(record);
+
+    pthread_mutex_lock(&log->lock);
+    while (log->bufferLen + record->length > WAL_BUFFER_SIZE && log->ioError == RC_OK) {
+        // buffer is full, hand it to the flusher and wait for it to be taken
+        log->requestedLSN = log->appendLSN;
+        pthread_cond_signal(&log->requested);
+        pthread_cond_wait(&log->flushed, &log->lock);
+    }
+    if (log->ioError != RC_OK) {
+        // the next flush reports the error
+        pthread_mutex_unlock(&log->lock);
+        return record->lsn;
+    }
+
+    if (log->bufferLen == 0) {
+        log->firstAppendNanos = WAL_nowNanos();
+        pthread_cond_signal(&log->requested);
+    }
+    memcpy(log->buffer + log->bufferLen, record, record->length);
+    log->bufferLen += record->length;
+    log->appendLSN = record->lsn;
+    log->numRecords++;
+    pthread_mutex_unlock(&log->lock);
+    return record->lsn;
+}
+
+// Background writer. Takes the whole log buffer once somebody waits for it,
+// once it is half full, or WAL_GROUP_COMMIT_WINDOW_US after it stopped being
+// empty, and writes it out with a single write and `fdatasync`.
+static void *WAL_flusherMain(void *arg)
+{
+    WAL_Log *log = arg;
+
+    pthread_mutex_lock(&log->lock);
+    while (true) {
+        while (log->bufferLen == 0 && !log->stop) {
+            pthread_cond_wait(&log->requested, &log->lock);
+        }
+        if (log->bufferLen == 0) {
+            // only stop once everything appended has been written
+            break;
+        }
+
+        uint64_t deadline = log->firstAppendNanos + WAL_GROUP_COMMIT_WINDOW_US * 1000ull;
+        while (!log->stop
+               && log->requestedLSN <= log->flushedLSN
+               && log->bufferLen < WAL_BUFFER_SIZE / 2
+               && WAL_nowNanos() < deadline) {
+            struct timespec ts = {
+                    .tv_sec = (time_t) (deadline / 1000000000ull),
+                    .tv_nsec = (long) (deadline % 1000000000ull),
+            };
+            pthread_cond_timedwait(&log->requested, &log->lock, &ts);
+        }
+
+        char *buffer = log->buffer;
+        size_t len = log->bufferLen;
+        WAL_LSN endLSN = log->appendLSN;
+        off_t offset = (off_t) (sizeof(WAL_FileHeader) + (endLSN - len - log->baseLSN));
+        log->buffer = log->flushBuffer;
+        log->flushBuffer = buffer;
+        log->bufferLen = 0;
+        pthread_cond_broadcast(&log->flushed);
+        pthread_mutex_unlock(&log->lock);
+
+        RC rc = WAL_writeAll(log->fd, buffer, len, offset);
+        if (rc == RC_OK && fdatasync(log->fd) != 0) {
+            rc = RC_WRITE_FAILED;
+        }
+
+        pthread_mutex_lock(&log->lock);
+        if (rc != RC_OK) {
+            log->ioError = rc;
+        } else {
+            log->flushedLSN = endLSN;
+        }
+        log->numFlushes++;
+        pthread_cond_broadcast(&log->flushed);
+    }
+    pthread_mutex_unlock(&log->lock);
+    return NULL;
+}
+
+// ************************************************************
+// Redoes every valid record of the log, in order, stopping at the first torn
+// or corrupt one. Pages that were written back after a record are skipped.
+//
+// After a checkpoint, redo starts at the oldest change in its dirty page
+// table, and records from before the checkpoint are only redone for the pages
+// that were still dirty then.
+//
+// This thread only reads and filters the log when there is enough of it: the
+// records are handed to the redo workers, by page.
+static RC WAL_replay(WAL_Log *log, BM_BufferPool *pool)
+{
+    WAL_LSN redoLSN = log->baseLSN;
+    WAL_DirtyPage *dirtyPages = NULL;
+    int numDirtyPages = 0;
+    if (!WAL_readCheckpoint(log, &redoLSN, &dirtyPages, &numDirtyPages)) {
+        log->checkpointLSN = WAL_NO_LSN;
+    }
+
+    WAL_Reader reader = {
+            .fd = log->fd,
+            .chunk = malloc(WAL_READ_CHUNK_SIZE),
+            .chunkLen = 0,
+            .pos = 0,
+            .fileOffset = (off_t) (sizeof(WAL_FileHeader) + (redoLSN - log->baseLSN)),
+            .nextLSN = redoLSN,
+    };
+
+    struct stat fileStat;
+    bool isParallel = log->numRedoWorkers > 1
+            && fstat(log->fd, &fileStat) == 0
+            && fileStat.st_size - reader.fileOffset >= WAL_PARALLEL_REDO_MIN_SIZE;
+
+    RC rc = RC_OK;
+    WAL_Redo redo;
+    if (isParallel && (rc = WAL_Redo_start(&redo, pool, log->numRedoWorkers)) != RC_OK) {
+        free(dirtyPages);
+        free(reader.chunk);
+        return rc;
+    }
+
+    const WAL_RecordHeader *record;
+    while ((record = WAL_Reader_next(&reader)) != NULL) {
+        if (record->type == WAL_RECORD_CHECKPOINT
+            || !WAL_isRedoNeeded(record, log->checkpointLSN, dirtyPages, numDirtyPages)) {
+            continue;
+        }
+        rc = isParallel ? WAL_Redo_dispatch(&redo, pool, record) : WAL_redoRecord(pool, record);
+        if (rc != RC_OK) {
+            break;
+        }
+        log->numRedone++;
+    }
+    if (isParallel) {
+        RC finishRc = WAL_Redo_finish(&redo);
+        if (rc == RC_OK) {
+            rc = finishRc;
+        }
+    }
+    free(dirtyPages);
+
+    // LSNs carry on from the end of the valid part
+    log->appendLSN = reader.nextLSN;
+    log->flushedLSN = reader.nextLSN;
+    log->requestedLSN = reader.nextLSN;
+    log->baseLSN = reader.nextLSN;
+    free(reader.chunk);
+    return rc;
+}
+
+// Reads the checkpoint the log header points at. Returns false if there is
+// none or it cannot be read, the whole log is replayed then.
+static bool WAL_readCheckpoint(WAL_Log *log, WAL_LSN *redoLSN_out, WAL_DirtyPage **pages_out, int *numPages_out)
+{
+    if (log->checkpointLSN == WAL_NO_LSN || log->checkpointLSN < log->baseLSN) {
+        return false;
+    }
+
+    WAL_Reader reader = {
+            .fd = log->fd,
+            .chunk = malloc(WAL_READ_CHUNK_SIZE),
+            .chunkLen = 0,
+            .pos = 0,
+            .fileOffset = (off_t) (sizeof(WAL_FileHeader) + (log->checkpointLSN - log->baseLSN)),
+            .nextLSN = log->checkpointLSN,
+    };
+    const WAL_RecordHeader *record = WAL_Reader_next(&reader);
+    if (record == NULL || record->type != WAL_RECORD_CHECKPOINT) {
+        free(reader.chunk);
+        return false;
+    }
+
+    WAL_CheckpointHeader checkpoint;
+    const char *payload = (const char *) record + sizeof(WAL_RecordHeader);
+    memcpy(&checkpoint, payload, sizeof(WAL_CheckpointHeader));
+    *redoLSN_out = checkpoint.redoLSN > log->baseLSN ? checkpoint.redoLSN : log->baseLSN;
+
+    // without the whole table every record from `redoLSN` on is redone
+    if (!(checkpoint.flags & WAL_CHECKPOINT_FLAGS_PARTIAL)) {
+        *numPages_out = (int) checkpoint.numDirtyPages;
+        *pages_out = malloc((checkpoint.numDirtyPages + 1) * sizeof(WAL_DirtyPage));
+        memcpy(*pages_out, payload + sizeof(WAL_CheckpointHeader), checkpoint.numDirtyPages * sizeof(WAL_DirtyPage));
+        qsort(*pages_out, *numPages_out, sizeof(WAL_DirtyPage), WAL_comparePageNums);
+    }
+    free(reader.chunk);
+    return true;
+}
+
+// Records from before the checkpoint only matter for the pages that were dirty
+// at the checkpoint, and only from the change that dirtied them on
+static bool WAL_isRedoNeeded(const WAL_RecordHeader *record, WAL_LSN checkpointLSN,
+        const WAL_DirtyPage *dirtyPages, int numDirtyPages)
+{
+    WAL_LSN start = record->lsn - record->length;
+    if (dirtyPages == NULL || start >= checkpointLSN) {
+        return true;
+    }
+
+    WAL_DirtyPage key = {.pageNum = record->pageNum};
+    const WAL_DirtyPage *entry = bsearch(
+            &key, dirtyPages, numDirtyPages, sizeof(WAL_DirtyPage), WAL_comparePageNums);
+    return entry != NULL && start >= entry->recLSN;
+}
+
+static RC WAL_redoRecord(BM_BufferPool *pool, const WAL_RecordHeader *record)
+{
+    TRY_OR_RETURN(WAL_ensurePage(pool, record->pageNum));
+
+    BM_PageHandle pageHandle = {};
+    TRY_OR_RETURN(pinPage(pool, &pageHandle, record->pageNum));
+
+    // a page image replaces whatever the write back left, torn or not
+    RM_Page *page = (RM_Page *) pageHandle.buffer;
+    bool isStamped = record->pageNum != RM_PAGE_DBHEADER;
+    if (!isStamped || WAL_isPageImage(record) || page->header.pageLSN < record->lsn) {
+        const char *cur = (const char *) record + sizeof(WAL_RecordHeader);
+        for (int i = 0; i < record->numSegments; i++) {
+            WAL_Segment segment;
+            memcpy(&segment, cur, sizeof(WAL_Segment));
+            memcpy(pageHandle.buffer + segment.offset, cur + sizeof(WAL_Segment), segment.length);
+            cur += sizeof(WAL_Segment) + segment.length;
+        }
+        if (isStamped) {
+            page->header.pageLSN = record->lsn;
+        }
+        TRY_OR_RETURN(markDirty(pool, &pageHandle));
+    }
+
+    TRY_OR_RETURN(unpinPage(pool, &pageHandle));
+    return RC_OK;
+}
+
+// A record that is a single segment over the whole page
+static bool WAL_isPageImage(const WAL_RecordHeader *record)
+{
+    if (record->numSegments != 1) {
+        return false;
+    }
+    WAL_Segment segment;
+    memcpy(&segment, (const char *) record + sizeof(WAL_RecordHeader), sizeof(WAL_Segment));
+    return segment.offset == 0 && segment.length == PAGE_SIZE;
+}
+
+// A page that was allocated but never written back lies past the end of the
+// page file, extends the file up to it
+static RC WAL_ensurePage(BM_BufferPool *pool, PageNumber pageNum)
+{
+    BP_Metadata *meta = pool->mgmtData;
+    if (pageNum >= meta->fileHandle->totalNumPages) {
+        TRY_OR_RETURN(ensureCapacity(pageNum + 1, meta->fileHandle));
+    }
+    return RC_OK;
+}
+
+// ************************************************************
+// Starts `numWorkers` redo workers, each with a share of the frames of `pool`
+// for its private pool. Pages `pool` already holds are redone in `pool` by
+// the dispatching thread, a worker would not see its copy of them.
+static RC WAL_Redo_start(WAL_Redo *redo, BM_BufferPool *pool, int numWorkers)
+{
+    TRY_OR_RETURN(forceFlushPool(pool));
+
+    pthread_mutex_init(&redo->lock, NULL);
+    pthread_cond_init(&redo->taken, NULL);
+    redo->done = false;
+    redo->rc = RC_OK;
+    redo->numWorkers = numWorkers;
+    redo->workers = calloc(numWorkers, sizeof(WAL_RedoWorker));
+    redo->cachedPages = malloc(pool->numPages * sizeof(PageNumber));
+    redo->numCachedPages = 0;
+
+    PageNumber *frameContents = getFrameContents(pool);
+    for (int i = 0; i < pool->numPages; i++) {
+        if (frameContents[i] != NO_PAGE) {
+            redo->cachedPages[redo->numCachedPages++] = frameContents[i];
+        }
+    }
+    qsort(redo->cachedPages, redo->numCachedPages, sizeof(PageNumber), WAL_comparePageNums);
+
+    int numPages = pool->numPages / numWorkers;
+    if (numPages < WAL_REDO_MIN_POOL_PAGES) {
+        numPages = WAL_REDO_MIN_POOL_PAGES;
+    }
+    BM_PoolOptions options = BM_POOL_OPTIONS_DEFAULT;
+    options.hugePages = FALSE;
+
+    for (int i = 0; i < numWorkers; i++) {
+        WAL_RedoWorker *worker = &redo->workers[i];
+        RC rc = initBufferPoolWithOptions(&worker->pool, pool->pageFile, numPages, RS_LRU, NULL, &options);
+        if (rc != RC_OK) {
+            redo->numWorkers = i;
+            WAL_Redo_finish(redo);
+            return rc;
+        }
+        worker->redo = redo;
+        pthread_cond_init(&worker->ready, NULL);
+        worker->queue = malloc(WAL_REDO_QUEUE_SIZE);
+        worker->queueLen = 0;
+        worker->batch = malloc(WAL_REDO_QUEUE_SIZE);
+        if (pthread_create(&worker->thread, NULL, WAL_redoWorkerMain, worker) != 0) {
+            PANIC("pthread_create: failed to start a redo worker");
+        }
+    }
+    return RC_OK;
+}
+
+// Queues a record for the worker its page belongs to
+static RC WAL_Redo_dispatch(WAL_Redo *redo, BM_BufferPool *pool, const WAL_RecordHeader *record)
+{
+    PageNumber pageNum = record->pageNum;
+    if (bsearch(&pageNum, redo->cachedPages, redo->numCachedPages, sizeof(PageNumber), WAL_comparePageNums)) {
+        return WAL_redoRecord(pool, record);
+    }
+
+    // workers only ever find the page file grown, never grow it themselves
+    TRY_OR_RETURN(WAL_ensurePage(pool, pageNum));
+
+    WAL_RedoWorker *worker = &redo->workers[pageNum % redo->numWorkers];
+    pthread_mutex_lock(&redo->lock);
+    while (worker->queueLen + record->length > WAL_REDO_QUEUE_SIZE && redo->rc == RC_OK) {
+        pthread_cond_signal(&worker->ready);
+        pthread_cond_wait(&redo->taken, &redo->lock);
+    }
+    RC rc = redo->rc;
+    if (rc == RC_OK) {
+        if (worker->queueLen == 0) {
+            pthread_cond_signal(&worker->ready);
+        }
+        memcpy(worker->queue + worker->queueLen, record, record->length);
+        worker->queueLen += record->length;
+    }
+    pthread_mutex_unlock(&redo->lock);
+    return rc;
+}
+
+// Waits for the workers to replay what is queued, then writes back and syncs
+// their pools. Returns the first error of any worker.
+static RC WAL_Redo_finish(WAL_Redo *redo)
+{
+    pthread_mutex_lock(&redo->lock);
+    redo->done = true;
+    for (int i = 0; i < redo->numWorkers; i++) {
+        pthread_cond_signal(&redo->workers[i].ready);
+    }
+    pthread_mutex_unlock(&redo->lock);
+
+    RC rc = RC_OK;
+    for (int i = 0; i < redo->numWorkers; i++) {
+        WAL_RedoWorker *worker = &redo->workers[i];
+        pthread_join(worker->thread, NULL);
+
+        RC poolRc = syncBufferPool(&worker->pool);
+        if (rc == RC_OK) {
+            rc = poolRc;
+        }
+        forceShutdownBufferPool(&worker->pool);
+        pthread_cond_destroy(&worker->ready);
+        free(worker->queue);
+        free(worker->batch);
+    }
+    if (rc == RC_OK) {
+        rc = redo->rc;
+    }
+
+    pthread_cond_destroy(&redo->taken);
+    pthread_mutex_destroy(&redo->lock);
+    free(redo->cachedPages);
+    free(redo->workers);
+    return rc;
+}
+
+// Takes whatever is queued for the worker and replays it, until the end of
+// the log. After an error the rest is only drained so the reader never waits.
+static void *WAL_redoWorkerMain(void *arg)
+{
+    WAL_RedoWorker *worker = arg;
+    WAL_Redo *redo = worker->redo;
+
+    pthread_mutex_lock(&redo->lock);
+    while (true) {
+        while (worker->queueLen == 0 && !redo->done) {
+            pthread_cond_wait(&worker->ready, &redo->lock);
+        }
+        if (worker->queueLen == 0) {
+            break;
+        }
+
+        char *batch = worker->queue;
+        size_t len = worker->queueLen;
+        worker->queue = worker->batch;
+        worker->batch = batch;
+        worker->queueLen = 0;
+        bool isFailed = redo->rc != RC_OK;
+        pthread_cond_broadcast(&redo->taken);
+        pthread_mutex_unlock(&redo->lock);
+
+        RC rc = isFailed ? RC_OK : WAL_redoBatch(worker, batch, len);
+
+        pthread_mutex_lock(&redo->lock);
+        if (rc != RC_OK && redo->rc == RC_OK) {
+            redo->rc = rc;
+            pthread_cond_broadcast(&redo->taken);
+        }
+    }
+    pthread_mutex_unlock(&redo->lock);
+    return NULL;
+}
+
+// Replays a batch of records, keeping prefetches going for the pages of the
+// next WAL_REDO_PREFETCH_DEPTH records
+static RC WAL_redoBatch(WAL_RedoWorker *worker, const char *batch, size_t len)
+{
+    const char *end = batch + len;
+    const char *ahead = batch;
+    int numAhead = 0;
+    for (const char *cur = batch; cur < end; cur += ((const WAL_RecordHeader *) cur)->length) {
+        while (numAhead < WAL_REDO_PREFETCH_DEPTH && ahead < end) {
+            const WAL_RecordHeader *next = (const WAL_RecordHeader *) ahead;
+            TRY_OR_RETURN(WAL_ensurePage(&worker->pool, next->pageNum));
+            prefetchPage(&worker->pool, next->pageNum);
+            ahead += next->length;
+            numAhead++;
+        }
+
+        TRY_OR_RETURN(WAL_redoRecord(&worker->pool, (const WAL_RecordHeader *) cur));
+        numAhead--;
+    }
+    return RC_OK;
+}
+
+// Returns the next record, or NULL at the end of the valid part of the log
+static const WAL_RecordHeader *WAL_Reader_next(WAL_Reader *reader)
+{
+    size_t avail = reader->chunkLen - reader->pos;
+    if (avail < WAL_MAX_CHECKPOINT_SIZE) {
+        // keep a whole record in the chunk
+        memmove(reader->chunk, reader->chunk + reader->pos, avail);
+        reader->chunkLen = avail;
+        reader->pos = 0;
+        while (reader->chunkLen < WAL_READ_CHUNK_SIZE) {
+            ssize_t n = pread(
+                    reader->fd,
+                    reader->chunk + reader->chunkLen,
+                    WAL_READ_CHUNK_SIZE - reader->chunkLen,
+                    reader->fileOffset);
+            if (n <= 0) {
+                break;
+            }
+            reader->chunkLen += n;
+            reader->fileOffset += n;
+        }
+        avail = reader->chunkLen;
+    }
+
+    if (avail < sizeof(WAL_RecordHeader)) {
+        return NULL;
+    }
+    const WAL_RecordHeader *record = (const WAL_RecordHeader *) (reader->chunk + reader->pos);
+    bool isValid = record->length >= sizeof(WAL_RecordHeader)
+            && record->length <= WAL_MAX_CHECKPOINT_SIZE
+            && record->length <= avail
+            && record->lsn == reader->nextLSN + record->length
+            && record->checksum == WAL_checksum(record)
+            && WAL_payloadFits(record);
+    if (!isValid) {
+        return NULL;
+    }
+
+    reader->pos += record->length;
+    reader->nextLSN = record->lsn;
+    return record;
+}
+
+// Checks that the segments of a record add up to its length and stay within
+// a page, or that the dirty page table of a checkpoint does
+static bool WAL_payloadFits(const WAL_RecordHeader *record)
+{
+    if (record->type == WAL_RECORD_CHECKPOINT) {
+        WAL_CheckpointHeader checkpoint;
+        if (record->length < sizeof(WAL_RecordHeader) + sizeof(WAL_CheckpointHeader)) {
+            return false;
+        }
+        memcpy(&checkpoint, (const char *) record + sizeof(WAL_RecordHeader), sizeof(WAL_CheckpointHeader));
+        return record->length == sizeof(WAL_RecordHeader)
+                + sizeof(WAL_CheckpointHeader)
+                + (size_t) checkpoint.numDirtyPages * sizeof(WAL_DirtyPage);
+    }
+    if (record->length > WAL_MAX_RECORD_SIZE) {
+        return false;
+    }
+
+    const char *cur = (const char *) record + sizeof(WAL_RecordHeader);
+    const char *end = (const char *) record + record->length;
+    for (int i = 0; i < record->numSegments; i++) {
+        if (end - cur < (long) sizeof(WAL_Segment)) {
+            return false;
+        }
+        WAL_Segment segment;
+        memcpy(&segment, cur, sizeof(WAL_Segment));
+        if ((size_t) segment.offset + segment.length > PAGE_SIZE
+            || end - cur < (long) (sizeof(WAL_Segment) + segment.length)) {
+            return false;
+        }
+        cur += sizeof(WAL_Segment) + segment.length;
+    }
+    return cur == end;
+}
+
+// ************************************************************
+// Encodes the 8 byte words of `page` that differ from `before` as segments,
+// merging runs that are close together. Falls back to the full page once the
+// segments would be larger.
+//
+// @return the number of bytes written to `out`
+static size_t WAL_encodeDiff(const char *page, const char *before, char *out, uint16_t *numSegments_out)
+{
+    const uint64_t *cur = (const uint64_t *) page;
+    const uint64_t *old = (const uint64_t *) before;
+    const int numWords = PAGE_SIZE / sizeof(uint64_t);
+
+    size_t len = 0;
+    uint16_t numSegments = 0;
+    int i = 0;
+    while (i < numWords) {
+        if (cur[i] == old[i]) {
+            i++;
+            continue;
+        }
+
+        int begin = i;
+        int end = i + 1;
+        for (int j = end; j < numWords && j - end < WAL_SEGMENT_MERGE_GAP; j++) {
+            if (cur[j] != old[j]) {
+                end = j + 1;
+            }
+        }
+
+        WAL_Segment segment = {
+                .offset = (uint16_t) (begin * sizeof(uint64_t)),
+                .length = (uint16_t) ((end - begin) * sizeof(uint64_t)),
+        };
+        if (len + sizeof(WAL_Segment) + segment.length > PAGE_SIZE) {
+            return WAL_encodePage(page, out, numSegments_out);
+        }
+
+        memcpy(out + len, &segment, sizeof(WAL_Segment));
+        memcpy(out + len + sizeof(WAL_Segment), page + segment.offset, segment.length);
+        len += sizeof(WAL_Segment) + segment.length;
+        numSegments++;
+        i = end;
+    }
+
+    *numSegments_out = numSegments;
+    return len;
+}
+
+// Encodes the whole of `page` as a single segment
+static size_t WAL_encodePage(const char *page, char *out, uint16_t *numSegments_out)
+{
+    WAL_Segment segment = {.offset = 0, .length = PAGE_SIZE};
+    memcpy(out, &segment, sizeof(WAL_Segment));
+    memcpy(out + sizeof(WAL_Segment), page, PAGE_SIZE);
+    *numSegments_out = 1;
+    return sizeof(WAL_Segment) + PAGE_SIZE;
+}
+
+// Tells what kind of change a record holds from the page it was taken from
+static WAL_RecordType WAL_recordType(const BM_PageHandle *page, const char *before)
+{
+    if (page->pageNum <= RM_PAGE_INDEX) {
+        return WAL_RECORD_CATALOG;
+    }
+
+    const RM_Page *cur = (const RM_Page *) page->buffer;
+    const RM_Page *old = (const RM_Page *) before;
+    if (cur->header.kind != old->header.kind) {
+        return WAL_RECORD_ALLOC;
+    }
+    switch (cur->header.kind) {
+        case RM_PAGE_KIND_DATA:
+            return WAL_RECORD_HEAP;
+        case RM_PAGE_KIND_INDEX:
+            return WAL_RECORD_INDEX;
+        case RM_PAGE_KIND_SCHEMA:
+            return WAL_RECORD_CATALOG;
+        case RM_PAGE_KIND_FSM:
+            return WAL_RECORD_FSM;
+        default:
+            return WAL_RECORD_ALLOC;
+    }
+}
+
+static RC WAL_writeHeader(WAL_Log *log)
+{
+    WAL_FileHeader header = {};
+    memcpy(header.magic, WAL_MAGIC, WAL_MAGIC_LEN);
+    header.version = WAL_VERSION;
+    header.dbId = log->dbId;
+    header.baseLSN = log->baseLSN;
+    header.checkpointLSN = log->checkpointLSN;
+
+    TRY_OR_RETURN(WAL_writeAll(log->fd, (const char *) &header, sizeof(WAL_FileHeader), 0));
+    if (fdatasync(log->fd) != 0) {
+        return RC_WRITE_FAILED;
+    }
+    return RC_OK;
+}
+
+// Gives back the disk space of the log before `redoLSN`, which recovery never
+// reads again. Best effort, the log is emptied on the next open anyway.
+static void WAL_reclaim(WAL_Log *log, WAL_LSN redoLSN)
+{
+#ifdef FALLOC_FL_PUNCH_HOLE
+    off_t begin = PAGE_SIZE;  // leave the file header alone
+    off_t end = (off_t) (sizeof(WAL_FileHeader) + (redoLSN - log->baseLSN));
+    end -= end % PAGE_SIZE;
+    if (end > begin) {
+        fallocate(log->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, begin, end - begin);
+    }
+#else
+    (void) log;
+    (void) redoLSN;
+#endif
+}
+
+// Orders page numbers, and `WAL_DirtyPage` entries by their page number
+static int WAL_comparePageNums(const void *a, const void *b)
+{
+    int32_t x, y;
+    memcpy(&x, a, sizeof(int32_t));
+    memcpy(&y, b, sizeof(int32_t));
+    return (x > y) - (x < y);
+}
+
+static RC WAL_writeAll(int fd, const char *buf, size_t len, off_t offset)
+{
+    size_t n = 0;
+    while (n < len) {
+        ssize_t w = pwrite(fd, buf + n, len - n, offset + (off_t) n);
+        if (w <= 0) {
+            return RC_WRITE_FAILED;
+        }
+        n += w;
+    }
+    return RC_OK;
+}
+
+// FNV-1a over everything after the checksum field
+static uint32_t WAL_checksum(const WAL_RecordHeader *record)
+{
+    const size_t skip = offsetof(WAL_RecordHeader, lsn);
+    const unsigned char *cur = (const unsigned char *) record + skip;
+    const unsigned char *end = (const unsigned char *) record + record->length;
+    uint32_t hash = 2166136261u;
+    for (; cur < end; cur++) {
+        hash ^= *cur;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static uint64_t WAL_nowNanos(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include "dberror.h"
+#include "dt.h"
+#include "buffer_mgr.h"
+#include "rm_page.h"
+
+// Write-ahead log
+//
+// Every change to a page of the database is appended to the log, as the byte
+// ranges of the page that changed, before the page itself may be written back.
+// The first change to a page after it was last written back logs the whole
+// page, so redo does not depend on the page file copy, which a crash in the
+// middle of a write back may have torn.
+// The buffer pool is then free to keep pages dirty across commits (no-force)
+// and to write them back while they are still being changed (steal): after a
+// crash the log is replayed on top of whatever made it to the page file.
+//
+// An LSN is the logical position in the log just past the end of a record. A
+// page carries the LSN of the last record that changed it in its header, and
+// may only be written back once the log is durable up to there.
+//
+// Records are appended to an in-memory buffer and written out by a background
+// flusher. Concurrent commits that arrive while a write is in flight share
+// the next `fdatasync`, and records nobody waits for go out after at most
+// WAL_GROUP_COMMIT_WINDOW_US.
+//
+// Every `checkpointInterval` bytes of log, a fuzzy checkpoint records the
+// dirty page table of the pool without writing anything back, and the pages
+// in it are then written back a few at a time between operations. Recovery
+// only replays from the oldest change still missing from the page file as of
+// the last checkpoint, so restart time is bounded by the interval rather than
+// by how long the database has been running.
+//
+// Redo is split by page across worker threads, each with a private buffer
+// pool over the page file: a page belongs to exactly one worker, which
+// applies its records in log order and prefetches the pages of the records
+// queued behind the one it is applying.
+
+typedef uint64_t WAL_LSN;
+
+#define WAL_MAGIC "FANCYWAL"
+#define WAL_MAGIC_LEN (8)
+#define WAL_VERSION (2)
+
+// No LSN, e.g. no checkpoint has been taken yet
+#define WAL_NO_LSN (UINT64_MAX)
+
+typedef struct PACKED_STRUCT WAL_FileHeader {
+    char magic[WAL_MAGIC_LEN];
+    uint32_t version;
+    uint64_t dbId;        // database the log belongs to, see `RM_DatabaseHeader`
+    WAL_LSN baseLSN;      // LSN of the first byte after this header
+    WAL_LSN checkpointLSN; // start of the last checkpoint record
+} WAL_FileHeader;
+
+typedef uint8_t WAL_RecordType;
+#define WAL_RECORD_HEAP     1u  /* data page: record insert, update or delete */
+#define WAL_RECORD_INDEX    2u  /* B-tree node modification */
+#define WAL_RECORD_CATALOG  3u  /* database header, schema or index descriptor page */
+#define WAL_RECORD_ALLOC    4u  /* page (re)initialized: allocated or freed */
+#define WAL_RECORD_CHECKPOINT 5u  /* dirty page table of the pool, no page */
+#define WAL_RECORD_FSM      6u  /* free-space map page */
+
+typedef struct PACKED_STRUCT WAL_RecordHeader {
+    uint32_t length;      // of the whole record, this header included
+    uint32_t checksum;    // of everything after this field
+    WAL_LSN lsn;
+    WAL_RecordType type;
+    int32_t pageNum;
+    uint16_t numSegments;
+} WAL_RecordHeader;
+
+// A record is followed by `numSegments` segments, each of them this header
+// and then `length` bytes to be copied to `offset` in the page
+typedef struct PACKED_STRUCT WAL_Segment {
+    uint16_t offset;
+    uint16_t length;
+} WAL_Segment;
+
+#define WAL_MAX_RECORD_SIZE (sizeof(WAL_RecordHeader) + sizeof(WAL_Segment) + PAGE_SIZE)
+
+// A checkpoint record is followed by this header and `numDirtyPages` entries
+typedef struct PACKED_STRUCT WAL_CheckpointHeader {
+    WAL_LSN redoLSN;        // oldest change that may be missing from the page file
+    uint32_t numDirtyPages;
+    uint8_t flags;
+} WAL_CheckpointHeader;
+
+#define WAL_CHECKPOINT_FLAGS_PARTIAL ((uint8_t) (1u << 0u))  /* dirty page table did not fit */
+
+typedef struct PACKED_STRUCT WAL_DirtyPage {
+    int32_t pageNum;
+    WAL_LSN recLSN;         // start of the first record that dirtied the page
+} WAL_DirtyPage;
+
+#define WAL_MAX_CHECKPOINT_SIZE (64 * 1024)
+#define WAL_MAX_CHECKPOINT_PAGES \
+    ((WAL_MAX_CHECKPOINT_SIZE - sizeof(WAL_RecordHeader) - sizeof(WAL_CheckpointHeader)) \
+     / sizeof(WAL_DirtyPage))
+
+#define WAL_CHECKPOINT_INTERVAL_DEFAULT (8 * 1024 * 1024)
+// Pages written back per call to `WAL_checkpointStep`
+#define WAL_CHECKPOINT_PAGES_PER_STEP (8)
+
+// Changed words that are at most this many words apart go into one segment
+#define WAL_SEGMENT_MERGE_GAP (2)
+
+#define WAL_BUFFER_SIZE (256 * 1024)
+#define WAL_GROUP_COMMIT_WINDOW_US (5000)
+
+// One redo worker per CPU, up to WAL_MAX_REDO_WORKERS
+#define WAL_REDO_WORKERS_AUTO (0)
+#define WAL_MAX_REDO_WORKERS (8)
+// Less log than this is replayed by the thread opening it
+#define WAL_PARALLEL_REDO_MIN_SIZE (1024 * 1024)
+// Bytes of records queued for a worker before the reader waits for it
+#define WAL_REDO_QUEUE_SIZE (256 * 1024)
+// Records a worker looks ahead in its queue for pages to prefetch
+#define WAL_REDO_PREFETCH_DEPTH (16)
+#define WAL_REDO_MIN_POOL_PAGES (64)
+
+typedef struct WAL_Options {
+    int numRedoWorkers;           // threads replaying the log, or WAL_REDO_WORKERS_AUTO
+    uint64_t checkpointInterval;  // see `WAL_setCheckpointInterval`
+} WAL_Options;
+
+#define WAL_OPTIONS_DEFAULT ((WAL_Options) { .numRedoWorkers = WAL_REDO_WORKERS_AUTO, .checkpointInterval = WAL_CHECKPOINT_INTERVAL_DEFAULT })
+
+typedef struct WAL_Log {
+    int fd;
+    uint64_t dbId;
+    WAL_LSN baseLSN;
+    int numRedoWorkers;
+
+    pthread_mutex_t lock;
+    pthread_cond_t requested;   // records were appended or a flush was asked for
+    pthread_cond_t flushed;     // the flusher took the buffer or finished a write
+    pthread_t flusher;
+    bool stop;
+    RC ioError;                 // set once a write failed, every later flush fails
+
+    char *buffer;               // records appended since the flusher last took it
+    size_t bufferLen;
+    char *flushBuffer;          // records the flusher is writing out
+    uint64_t firstAppendNanos;  // when `buffer` was last empty
+    WAL_LSN appendLSN;          // end of the last record appended
+    WAL_LSN flushedLSN;         // end of the last record known to be durable
+    WAL_LSN requestedLSN;       // someone waits for the log to be durable up to here
+
+    char *record;               // owner thread only, record being built
+
+    // owner thread only
+    uint64_t checkpointInterval;  // bytes of log between checkpoints, 0 for none
+    WAL_LSN checkpointLSN;      // start of the last checkpoint record
+    PageNumber *flushPending;   // pages of the last checkpoint to write back
+    int numFlushPending;
+    int nextFlushPending;
+
+    uint64_t numRecords;
+    uint64_t numFlushes;
+    uint64_t numRedone;         // records applied when the log was opened
+} WAL_Log;
+
+RC WAL_open(const char *fileName, uint64_t dbId, BM_BufferPool *pool, WAL_Log **log_out);
+RC WAL_openWithOptions(const char *fileName, uint64_t dbId, BM_BufferPool *pool,
+        const WAL_Options *options, WAL_Log **log_out);
+RC WAL_close(WAL_Log *log);
+RC WAL_flush(WAL_Log *log, WAL_LSN lsn);
+RC WAL_commit(WAL_Log *log);
+RC WAL_truncate(WAL_Log *log);
+RC WAL_checkpoint(WAL_Log *log, BM_BufferPool *pool);
+RC WAL_checkpointStep(WAL_Log *log, BM_BufferPool *pool);
+void WAL_setCheckpointInterval(WAL_Log *log, uint64_t numBytes);
+WAL_LSN WAL_getAppendLSN(WAL_Log *log);
+WAL_LSN WAL_getFlushedLSN(WAL_Log *log);